@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include "src/base/platform/elapsed-timer.h"
+#include "src/bit-vector.h"
 #include "src/signature.h"
 
 #include "src/zone-containers.h"
@@ -39,15 +40,40 @@ struct Tree {
   WasmOpcode opcode() const { return static_cast<WasmOpcode>(*pc); }
 };
 
-// A production represents an incomplete decoded tree in the LR decoder.
+// A decoded expression on the value stack of the LR decoder.
+struct Value {
+  const byte* pc;  // start of the expression.
+  LocalType type;  // expression type.
+  TFNode* node;    // node in the TurboFan graph.
+  Tree* tree;      // syntax tree, only built when verifying.
+
+  WasmOpcode opcode() const { return static_cast<WasmOpcode>(*pc); }
+};
+
+// A production represents an incomplete decoded tree in the LR decoder. The
+// children decoded so far are the topmost {index} entries of the value stack.
 struct Production {
-  Tree* tree;  // the root of the syntax tree.
-  int index;   // the current index into the children of the tree.
+  const byte* pc;  // start of the syntax tree.
+  LocalType type;  // tree type.
+  TFNode* node;    // node in the TurboFan graph.
+  uint32_t count;  // number of children.
+  int index;       // the current index into the children of the tree.
+
+  WasmOpcode opcode() const { return static_cast<WasmOpcode>(*pc); }
+  bool done() const { return index >= count; }
+};
+
+struct SsaEnv;
+
+// A fixed-size chunk of the local variable renaming of SsaEnv environments.
+// Chunks are shared between the environments split from each other and are
+// copied on write, so that a split only costs the chunks that are modified
+// afterwards instead of all the locals.
+struct LocalsChunk {
+  static const int kSize = 16;
 
-  WasmOpcode opcode() const { return static_cast<WasmOpcode>(*pc()); }
-  const byte* pc() const { return tree->pc; }
-  bool done() const { return index >= tree->count; }
-  Tree* last() const { return index > 0 ? tree->children[index - 1] : nullptr; }
+  SsaEnv* owner;  // the environment that may update the chunk in place.
+  TFNode* nodes[kSize];
 };
 
 // An SsaEnv environment carries the current local variable renaming
@@ -60,7 +86,7 @@ struct SsaEnv {
   State state;
   TFNode* control;
   TFNode* effect;
-  TFNode** locals;
+  LocalsChunk** locals;
 
   bool go() { return state >= kReached; }
   void Kill(State new_state = kControlEnd) {
@@ -98,7 +124,9 @@ class LR_WasmDecoder : public Decoder {
       : Decoder(nullptr, nullptr),
         zone_(zone),
         builder_(builder),
+        build_trees_(builder == nullptr),
         trees_(zone),
+        values_(zone),
         stack_(zone),
         blocks_(zone),
         ifs_(zone) {}
@@ -110,6 +138,7 @@ class LR_WasmDecoder : public Decoder {
       decode_timer.Start();
     }
     trees_.clear();
+    values_.clear();
     stack_.clear();
     blocks_.clear();
     ifs_.clear();
@@ -122,6 +151,7 @@ class LR_WasmDecoder : public Decoder {
     base_ = base;
     Reset(pc, end);
     function_env_ = function_env;
+    top_level_count_ = 0;
 
     InitSsaEnv();
     DecodeFunctionBody();
@@ -130,15 +160,15 @@ class LR_WasmDecoder : public Decoder {
     if (ok()) {
       if (ssa_env_->go()) {
         if (stack_.size() > 0) {
-          error(stack_.back().pc(), end, "fell off end of code");
+          error(stack_.back().pc, end, "fell off end of code");
         }
         AddImplicitReturnAtEnd();
       }
-      if (trees_.size() == 0) {
+      if (top_level_count_ == 0) {
         if (function_env_->sig->return_count() > 0) {
           error(start_, "no trees created");
         }
-      } else {
+      } else if (build_trees_) {
         tree = trees_[0];
       }
     }
@@ -161,14 +191,23 @@ class LR_WasmDecoder : public Decoder {
 
   Zone* zone_;
   TFBuilder* builder_;
+  // Syntax trees are only materialized when verifying. Graph building works
+  // on the value stack alone, so the value, production and block stacks grow
+  // with the nesting of expressions and blocks rather than with the length of
+  // the function. The SSA environments are not bounded that way: every split
+  // at a block, if or branch allocates a table of locals chunks, and written
+  // chunks are copied, all in the zone until decoding ends.
+  bool build_trees_;
   const byte* base_;
   TreeResult result_;
 
   SsaEnv* ssa_env_;
   FunctionEnv* function_env_;
 
-  ZoneVector<Tree*> trees_;
+  ZoneVector<Tree*> trees_;     // top-level trees, only when verifying.
+  ZoneVector<Value> values_;    // value stack.
   ZoneVector<Production> stack_;
+  uint32_t top_level_count_;    // number of top-level expressions.
   ZoneVector<Block> blocks_;
   ZoneVector<IfEnv> ifs_;
 
@@ -178,45 +217,59 @@ class LR_WasmDecoder : public Decoder {
     FunctionSig* sig = function_env_->sig;
     int param_count = static_cast<int>(sig->parameter_count());
     TFNode* start = nullptr;
+    TFNode* start_effect = nullptr;
     SsaEnv* ssa_env = reinterpret_cast<SsaEnv*>(zone_->New(sizeof(SsaEnv)));
-    size_t size = sizeof(TFNode*) * EnvironmentCount();
+    int chunk_count = ChunkCount();
     ssa_env->state = SsaEnv::kReached;
     ssa_env->locals =
-        size > 0 ? reinterpret_cast<TFNode**>(zone_->New(size)) : nullptr;
+        chunk_count > 0 ? zone_->NewArray<LocalsChunk*>(chunk_count) : nullptr;
+    for (int i = 0; i < chunk_count; i++) {
+      ssa_env->locals[i] = NewLocalsChunk();
+      ssa_env->locals[i]->owner = ssa_env;
+    }
 
     int pos = 0;
     if (builder_) {
       start = builder_->Start(param_count + 1);
+      start_effect = builder_->StartEffect();
       // Initialize parameters.
       for (int i = 0; i < param_count; i++) {
-        ssa_env->locals[pos++] = builder_->Param(i, sig->GetParam(i));
+        SetLocal(ssa_env, pos++, builder_->Param(i, sig->GetParam(i)));
       }
       // Initialize int32 locals.
       if (function_env_->local_int32_count > 0) {
         TFNode* zero = builder_->Int32Constant(0);
         for (uint32_t i = 0; i < function_env_->local_int32_count; i++) {
-          ssa_env->locals[pos++] = zero;
+          SetLocal(ssa_env, pos++, zero);
         }
       }
       // Initialize int64 locals.
       if (function_env_->local_int64_count > 0) {
         TFNode* zero = builder_->Int64Constant(0);
         for (uint32_t i = 0; i < function_env_->local_int64_count; i++) {
-          ssa_env->locals[pos++] = zero;
+          SetLocal(ssa_env, pos++, zero);
         }
       }
       // Initialize float32 locals.
       if (function_env_->local_float32_count > 0) {
         TFNode* zero = builder_->Float32Constant(0);
         for (uint32_t i = 0; i < function_env_->local_float32_count; i++) {
-          ssa_env->locals[pos++] = zero;
+          SetLocal(ssa_env, pos++, zero);
         }
       }
       // Initialize float64 locals.
       if (function_env_->local_float64_count > 0) {
         TFNode* zero = builder_->Float64Constant(0);
         for (uint32_t i = 0; i < function_env_->local_float64_count; i++) {
-          ssa_env->locals[pos++] = zero;
+          SetLocal(ssa_env, pos++, zero);
+        }
+      }
+      // Initialize simd128 locals.
+      if (function_env_->local_simd128_count > 0) {
+        TFNode* zero = builder_->Unop(kExprI32x4Splat,
+                                      builder_->Int32Constant(0));
+        for (uint32_t i = 0; i < function_env_->local_simd128_count; i++) {
+          SetLocal(ssa_env, pos++, zero);
         }
       }
       DCHECK_EQ(function_env_->total_locals, pos);
@@ -224,50 +277,38 @@ class LR_WasmDecoder : public Decoder {
       builder_->set_module(function_env_->module);
     }
     ssa_env->control = start;
-    ssa_env->effect = start;
+    ssa_env->effect = start_effect;
     SetEnv("initial", ssa_env);
   }
 
   void Leaf(LocalType type, TFNode* node = nullptr) {
-    size_t size = sizeof(Tree);
-    Tree* tree = reinterpret_cast<Tree*>(zone_->New(size));
-    tree->type = type;
-    tree->count = 0;
-    tree->pc = pc_;
-    tree->node = node;
-    tree->children[0] = nullptr;
-    Reduce(tree);
+    Value value = {pc_, type, node, nullptr};
+    if (build_trees_) value.tree = NewTree(value, 0);
+    Reduce(value);
   }
 
   void Shift(LocalType type, uint32_t count) {
-    size_t size =
-        sizeof(Tree) + (count == 0 ? 0 : ((count - 1) * sizeof(Tree*)));
-    Tree* tree = reinterpret_cast<Tree*>(zone_->New(size));
-    tree->type = type;
-    tree->count = count;
-    tree->pc = pc_;
-    tree->node = nullptr;
-    for (uint32_t i = 0; i < count; i++) tree->children[i] = nullptr;
+    Production p = {pc_, type, nullptr, count, 0};
     if (count == 0) {
-      Production p = {tree, 0};
       Reduce(&p);
-      Reduce(tree);
+      Reduce(Complete(&p));
     } else {
-      stack_.push_back({tree, 0});
+      stack_.push_back(p);
     }
   }
 
-  void Reduce(Tree* tree) {
+  void Reduce(Value value) {
     while (true) {
       if (stack_.size() == 0) {
-        trees_.push_back(tree);
+        AddTopLevel(value);
         break;
       }
       Production* p = &stack_.back();
-      p->tree->children[p->index++] = tree;
+      values_.push_back(value);
+      p->index++;
       Reduce(p);
       if (p->done()) {
-        tree = p->tree;
+        value = Complete(p);
         stack_.pop_back();
       } else {
         break;
@@ -275,6 +316,57 @@ class LR_WasmDecoder : public Decoder {
     }
   }
 
+  // Pops the children of the completed production {p} off the value stack
+  // and returns its value.
+  Value Complete(Production* p) {
+    DCHECK(p->done());
+    Value value = {p->pc, p->type, p->node, nullptr};
+    if (build_trees_) {
+      value.tree = NewTree(value, p->count);
+      Value* children = &values_[values_.size() - p->count];
+      for (uint32_t i = 0; i < p->count; i++) {
+        value.tree->children[i] = children[i].tree;
+      }
+    }
+    values_.resize(values_.size() - p->count);
+    return value;
+  }
+
+  Tree* NewTree(const Value& value, uint32_t count) {
+    size_t size =
+        sizeof(Tree) + (count == 0 ? 0 : ((count - 1) * sizeof(Tree*)));
+    Tree* tree = reinterpret_cast<Tree*>(zone_->New(size));
+    tree->type = value.type;
+    tree->count = count;
+    tree->pc = value.pc;
+    tree->node = value.node;
+    tree->children[0] = nullptr;
+    return tree;
+  }
+
+  // Records a complete top-level expression. Only the last ones can be
+  // returned implicitly, so the value stack keeps no more than that.
+  void AddTopLevel(const Value& value) {
+    DCHECK(stack_.empty());
+    top_level_count_++;
+    if (build_trees_) trees_.push_back(value.tree);
+    size_t retcount = function_env_->sig->return_count();
+    if (retcount == 0) return;
+    if (values_.size() == retcount) values_.erase(values_.begin());
+    values_.push_back(value);
+  }
+
+  // The {i}th child of the topmost production {p}.
+  Value* Child(Production* p, int i) {
+    DCHECK_LT(i, p->index);
+    return &values_[values_.size() - p->index + i];
+  }
+
+  // The last decoded child of the topmost production {p}, if any.
+  Value* Last(Production* p) {
+    return p->index > 0 ? &values_.back() : nullptr;
+  }
+
   char* indentation() {
     static const int kMaxIndent = 64;
     static char bytes[kMaxIndent + 1];
@@ -346,7 +438,7 @@ class LR_WasmDecoder : public Decoder {
             PushBlock(break_env);
             SsaEnv* cont_env = Steal(break_env);
             // The continue environment is the inner environment.
-            PrepareForLoop(cont_env);
+            PrepareForLoop(cont_env, pc_);
             SetEnv("loop:start", Split(cont_env));
             if (ssa_env_->go()) ssa_env_->state = SsaEnv::kReached;
             PushBlock(cont_env);
@@ -471,7 +563,7 @@ class LR_WasmDecoder : public Decoder {
           uint32_t index;
           LocalType type = LocalOperand(pc_, &index, &len);
           TFNode* val =
-              build() && type != kAstStmt ? ssa_env_->locals[index] : nullptr;
+              build() && type != kAstStmt ? GetLocal(ssa_env_, index) : nullptr;
           Leaf(type, val);
           break;
         }
@@ -538,6 +630,49 @@ class LR_WasmDecoder : public Decoder {
         case kExprGrowMemory:
           Shift(kAstI32, 1);
           break;
+        case kExprI32x4ExtractLane:
+          len = DecodeSimdLane(pc_, kAstI32, 1);
+          break;
+        case kExprF32x4ExtractLane:
+          len = DecodeSimdLane(pc_, kAstF32, 1);
+          break;
+        case kExprI32x4ReplaceLane:
+        case kExprF32x4ReplaceLane:
+          len = DecodeSimdLane(pc_, kAstS128, 2);
+          break;
+        case kExprS32x4Shuffle: {
+          len = 5;
+          if (!checkAvailable(len)) {
+            error("expected 4 lane indexes for shuffle, fell off end");
+            break;
+          }
+          for (int i = 1; i < len; i++) {
+            if (pc_[i] >= 2 * kSimd128Lanes) {
+              error(pc_ + i, "invalid lane index in shuffle");
+            }
+          }
+          Shift(kAstS128, 2);
+          break;
+        }
+        case kExprS128LoadMem:
+          len = DecodeLoadMem(pc_, kAstS128);
+          break;
+        case kExprS128StoreMem:
+          len = DecodeStoreMem(pc_, kAstS128);
+          break;
+        case kExprI32AtomicAdd:
+        case kExprI32AtomicSub:
+        case kExprI32AtomicAnd:
+        case kExprI32AtomicOr:
+        case kExprI32AtomicXor:
+        case kExprI32AtomicExchange:
+        case kExprAtomicNotify:
+          len = DecodeAtomic(pc_, 2);
+          break;
+        case kExprI32AtomicCompareExchange:
+        case kExprI32AtomicWait:
+          len = DecodeAtomic(pc_, 3);
+          break;
         case kExprCallFunction: {
           uint32_t unused;
           FunctionSig* sig = FunctionSigOperand(pc_, &unused, &len);
@@ -585,6 +720,7 @@ class LR_WasmDecoder : public Decoder {
     int length = 2;
     uint32_t offset;
     MemoryAccessOperand(pc, &length, &offset);
+    CheckAtomicity(pc, kExprI32LoadMem);
     Shift(type, 1);
     return length;
   }
@@ -593,10 +729,35 @@ class LR_WasmDecoder : public Decoder {
     int length = 2;
     uint32_t offset;
     MemoryAccessOperand(pc, &length, &offset);
+    CheckAtomicity(pc, kExprI32StoreMem);
     Shift(type, 2);
     return length;
   }
 
+  // Only full 32-bit integer loads and stores can be atomic.
+  void CheckAtomicity(const byte* pc, WasmOpcode atomic_opcode) {
+    byte access = Operand<uint8_t>(pc);
+    if (MemoryAccess::AtomicityField::decode(access) != MemoryAccess::kNone &&
+        *pc != atomic_opcode) {
+      error(pc + 1, "atomic access must be a 32-bit integer access");
+    }
+  }
+
+  int DecodeAtomic(const byte* pc, int arity) {
+    int length = 2;
+    uint32_t offset;
+    MemoryAccessOperand(pc, &length, &offset);
+    Shift(kAstI32, arity);
+    return length;
+  }
+
+  int DecodeSimdLane(const byte* pc, LocalType type, int arity) {
+    int lane = Operand<uint8_t>(pc);
+    if (lane >= kSimd128Lanes) error(pc, "invalid lane index");
+    Shift(type, arity);
+    return 2;
+  }
+
   void AddImplicitReturnAtEnd() {
     int retcount = static_cast<int>(function_env_->sig->return_count());
     if (retcount == 0) {
@@ -604,10 +765,10 @@ class LR_WasmDecoder : public Decoder {
       return;
     }
 
-    if (trees_.size() < retcount) {
+    if (static_cast<int>(top_level_count_) < retcount) {
       error(limit_, nullptr,
             "ImplicitReturn expects %d arguments, only %d remain", retcount,
-            static_cast<int>(trees_.size()));
+            static_cast<int>(top_level_count_));
       return;
     }
 
@@ -615,15 +776,15 @@ class LR_WasmDecoder : public Decoder {
 
     TFNode** buffer = BUILD(Buffer, retcount);
     for (int index = 0; index < retcount; index++) {
-      Tree* tree = trees_[trees_.size() - 1 - index];
-      if (buffer) buffer[index] = tree->node;
+      Value* value = &values_[values_.size() - 1 - index];
+      if (buffer) buffer[index] = value->node;
       LocalType expected = function_env_->sig->GetReturn(index);
-      if (tree->type != expected) {
-        error(limit_, tree->pc,
+      if (value->type != expected) {
+        error(limit_, value->pc,
               "ImplicitReturn[%d] expected type %s, found %s of type %s", index,
               WasmOpcodes::TypeName(expected),
-              WasmOpcodes::OpcodeName(tree->opcode()),
-              WasmOpcodes::TypeName(tree->type));
+              WasmOpcodes::OpcodeName(value->opcode()),
+              WasmOpcodes::TypeName(value->type));
         return;
       }
     }
@@ -639,8 +800,8 @@ class LR_WasmDecoder : public Decoder {
 
   void Reduce(Production* p) {
     WasmOpcode opcode = p->opcode();
-    TRACE("-----reduce module+%-6d %s func+%d: 0x%02x %s\n", baserel(p->pc()),
-          indentation(), startrel(p->pc()), opcode,
+    TRACE("-----reduce module+%-6d %s func+%d: 0x%02x %s\n", baserel(p->pc),
+          indentation(), startrel(p->pc), opcode,
           WasmOpcodes::OpcodeName(opcode));
     FunctionSig* sig = WasmOpcodes::Signature(opcode);
     if (sig) {
@@ -648,10 +809,10 @@ class LR_WasmDecoder : public Decoder {
       TypeCheckLast(p, sig->GetParam(p->index - 1));
       if (p->done() && build()) {
         if (sig->parameter_count() == 2) {
-          p->tree->node = builder_->Binop(opcode, p->tree->children[0]->node,
-                                          p->tree->children[1]->node);
+          p->node =
+              builder_->Binop(opcode, Child(p, 0)->node, Child(p, 1)->node);
         } else if (sig->parameter_count() == 1) {
-          p->tree->node = builder_->Unop(opcode, p->tree->children[0]->node);
+          p->node = builder_->Unop(opcode, Child(p, 0)->node);
         } else {
           UNREACHABLE();
         }
@@ -692,7 +853,7 @@ class LR_WasmDecoder : public Decoder {
           SsaEnv* false_env = ssa_env_;
           SsaEnv* true_env = Split(ssa_env_);
           ifs_.push_back({nullptr, false_env, nullptr});
-          BUILD(Branch, p->last()->node, &true_env->control,
+          BUILD(Branch, Last(p)->node, &true_env->control,
                 &false_env->control);
           SetEnv("if:true", true_env);
         } else if (p->index == 2) {
@@ -715,7 +876,7 @@ class LR_WasmDecoder : public Decoder {
           SsaEnv* merge_env = ssa_env_;
           TFNode* if_true = nullptr;
           TFNode* if_false = nullptr;
-          BUILD(Branch, p->last()->node, &if_true, &if_false);
+          BUILD(Branch, Last(p)->node, &if_true, &if_false);
           SsaEnv* false_env = Split(ssa_env_);
           SsaEnv* true_env = Steal(ssa_env_);
           false_env->control = if_false;
@@ -725,14 +886,14 @@ class LR_WasmDecoder : public Decoder {
         } else if (p->index == 2) {
           // True expr done.
           IfEnv* env = &ifs_.back();
-          MergeIntoProduction(p, env->merge_env, p->last());
+          MergeIntoProduction(p, env->merge_env, Last(p));
           // Switch to environment for false branch.
           SsaEnv* false_env = ifs_.back().false_env;
           SetEnv("if_else:false", false_env);
         } else if (p->index == 3) {
           // False expr done.
           IfEnv* env = &ifs_.back();
-          MergeIntoProduction(p, env->merge_env, p->last());
+          MergeIntoProduction(p, env->merge_env, Last(p));
           SetEnv("if_else:merge", env->merge_env);
           ifs_.pop_back();
         }
@@ -744,31 +905,29 @@ class LR_WasmDecoder : public Decoder {
           TypeCheckLast(p, kAstI32);
         } else if (p->index == 2) {
           // True expression done.
-          p->tree->type = p->last()->type;
-          if (p->tree->type == kAstStmt) {
-            error(p->pc(), p->tree->children[1]->pc,
+          p->type = Last(p)->type;
+          if (p->type == kAstStmt) {
+            error(p->pc, Child(p, 1)->pc,
                   "select operand should be expression");
           }
         } else {
           // False expression done.
           DCHECK(p->done());
-          TypeCheckLast(p, p->tree->type);
+          TypeCheckLast(p, p->type);
           if (build()) {
             TFNode* controls[2];
-            builder_->Branch(p->tree->children[0]->node, &controls[0],
-                             &controls[1]);
+            builder_->Branch(Child(p, 0)->node, &controls[0], &controls[1]);
             TFNode* merge = builder_->Merge(2, controls);
-            TFNode* vals[2] = {p->tree->children[1]->node,
-                               p->tree->children[2]->node};
-            TFNode* phi = builder_->Phi(p->tree->type, 2, vals, merge);
-            p->tree->node = phi;
+            TFNode* vals[2] = {Child(p, 1)->node, Child(p, 2)->node};
+            TFNode* phi = builder_->Phi(p->type, 2, vals, merge);
+            p->node = phi;
             ssa_env_->control = merge;
           }
         }
         break;
       }
       case kExprBr: {
-        uint32_t depth = Operand<uint8_t>(p->pc());
+        uint32_t depth = Operand<uint8_t>(p->pc);
         if (depth >= blocks_.size()) {
           error("improperly nested branch");
           break;
@@ -781,7 +940,7 @@ class LR_WasmDecoder : public Decoder {
         if (p->index == 1) {
           TypeCheckLast(p, kAstI32);
         } else if (p->done()) {
-          uint32_t depth = Operand<uint8_t>(p->pc());
+          uint32_t depth = Operand<uint8_t>(p->pc);
           if (depth >= blocks_.size()) {
             error("improperly nested branch");
             break;
@@ -789,8 +948,7 @@ class LR_WasmDecoder : public Decoder {
           Block* block = &blocks_[blocks_.size() - depth - 1];
           SsaEnv* fenv = ssa_env_;
           SsaEnv* tenv = Split(fenv);
-          BUILD(Branch, p->tree->children[0]->node, &tenv->control,
-                &fenv->control);
+          BUILD(Branch, Child(p, 0)->node, &tenv->control, &fenv->control);
           ssa_env_ = tenv;
           ReduceBreakToExprBlock(p, block);
           ssa_env_ = fenv;
@@ -798,7 +956,7 @@ class LR_WasmDecoder : public Decoder {
         break;
       }
       case kExprTableSwitch: {
-        uint16_t table_count = *reinterpret_cast<const uint16_t*>(p->pc() + 3);
+        uint16_t table_count = *reinterpret_cast<const uint16_t*>(p->pc + 3);
         if (table_count == 1) {
           // Degenerate switch with only a default target.
           if (p->index == 1) {
@@ -820,10 +978,10 @@ class LR_WasmDecoder : public Decoder {
           // Switch key finished.
           TypeCheckLast(p, kAstI32);
 
-          TFNode* sw = BUILD(Switch, table_count, p->last()->node);
+          TFNode* sw = BUILD(Switch, table_count, Last(p)->node);
 
           // Allocate environments for each case.
-          uint16_t case_count = *reinterpret_cast<const uint16_t*>(p->pc() + 1);
+          uint16_t case_count = *reinterpret_cast<const uint16_t*>(p->pc + 1);
           SsaEnv** case_envs = zone_->NewArray<SsaEnv*>(case_count);
           for (int i = 0; i < case_count; i++) {
             case_envs[i] = UnreachableEnv();
@@ -837,7 +995,7 @@ class LR_WasmDecoder : public Decoder {
 
           // Build the environments for each case based on the table.
           const uint16_t* table =
-              reinterpret_cast<const uint16_t*>(p->pc() + 5);
+              reinterpret_cast<const uint16_t*>(p->pc + 5);
           for (int i = 0; i < table_count; i++) {
             uint16_t target = table[i];
             SsaEnv* env = Split(copy);
@@ -879,10 +1037,10 @@ class LR_WasmDecoder : public Decoder {
         TypeCheckLast(p, function_env_->sig->GetReturn(p->index - 1));
         if (p->done()) {
           if (build()) {
-            int count = p->tree->count;
+            int count = p->count;
             TFNode** buffer = builder_->Buffer(count);
             for (int i = 0; i < count; i++) {
-              buffer[i] = p->tree->children[i]->node;
+              buffer[i] = Child(p, i)->node;
             }
             BUILD(Return, count, buffer);
           }
@@ -893,26 +1051,26 @@ class LR_WasmDecoder : public Decoder {
       case kExprSetLocal: {
         int unused = 0;
         uint32_t index;
-        LocalType type = LocalOperand(p->pc(), &index, &unused);
-        Tree* val = p->last();
+        LocalType type = LocalOperand(p->pc, &index, &unused);
+        Value* val = Last(p);
         if (type == val->type) {
-          if (builder_) ssa_env_->locals[index] = val->node;
-          p->tree->node = val->node;
+          if (build()) SetLocal(ssa_env_, index, val->node);
+          p->node = val->node;
         } else {
-          error(p->pc(), val->pc, "Typecheck failed in SetLocal");
+          error(p->pc, val->pc, "Typecheck failed in SetLocal");
         }
         break;
       }
       case kExprStoreGlobal: {
         int unused = 0;
         uint32_t index;
-        LocalType type = GlobalOperand(p->pc(), &index, &unused);
-        Tree* val = p->last();
+        LocalType type = GlobalOperand(p->pc, &index, &unused);
+        Value* val = Last(p);
         if (type == val->type) {
           BUILD(StoreGlobal, index, val->node);
-          p->tree->node = val->node;
+          p->node = val->node;
         } else {
-          error(p->pc(), val->pc, "Typecheck failed in StoreGlobal");
+          error(p->pc, val->pc, "Typecheck failed in StoreGlobal");
         }
         break;
       }
@@ -973,47 +1131,79 @@ class LR_WasmDecoder : public Decoder {
 
       case kExprGrowMemory:
         TypeCheckLast(p, kAstI32);
-        // TODO: build node for GrowMemory
-        p->tree->node = BUILD(Int32Constant, 0);
+        p->node = BUILD(GrowMemory, Last(p)->node);
+        return;
+
+      case kExprI32x4ExtractLane:
+      case kExprF32x4ExtractLane:
+        TypeCheckLast(p, kAstS128);
+        p->node = BUILD(SimdExtractLane, opcode, p->pc[1], Last(p)->node);
         return;
+      case kExprI32x4ReplaceLane:
+        return ReduceSimdReplaceLane(p, kAstI32);
+      case kExprF32x4ReplaceLane:
+        return ReduceSimdReplaceLane(p, kAstF32);
+      case kExprS32x4Shuffle:
+        TypeCheckLast(p, kAstS128);
+        if (p->done()) {
+          p->node = BUILD(SimdShuffle, p->pc + 1, Child(p, 0)->node,
+                          Child(p, 1)->node);
+        }
+        return;
+      case kExprS128LoadMem:
+        return ReduceLoadMem(p, kAstS128, MachineType::Int32());
+      case kExprI32AtomicAdd:
+      case kExprI32AtomicSub:
+      case kExprI32AtomicAnd:
+      case kExprI32AtomicOr:
+      case kExprI32AtomicXor:
+      case kExprI32AtomicExchange:
+      case kExprI32AtomicCompareExchange:
+      case kExprI32AtomicWait:
+      case kExprAtomicNotify:
+        return ReduceAtomic(p);
+      case kExprS128StoreMem:
+        return ReduceStoreMem(p, kAstS128, MachineType::Int32());
 
       case kExprCallFunction: {
         int len;
         uint32_t index;
-        FunctionSig* sig = FunctionSigOperand(p->pc(), &index, &len);
+        FunctionSig* sig = FunctionSigOperand(p->pc, &index, &len);
         if (!sig) break;
         if (p->index > 0) {
           TypeCheckLast(p, sig->GetParam(p->index - 1));
         }
         if (p->done() && build()) {
-          uint32_t count = p->tree->count + 1;
+          uint32_t count = p->count + 1;
           TFNode** buffer = builder_->Buffer(count);
-          FunctionSig* sig = FunctionSigOperand(p->pc(), &index, &len);
+          FunctionSig* sig = FunctionSigOperand(p->pc, &index, &len);
           USE(sig);
           buffer[0] = nullptr;  // reserved for code object.
           for (int i = 1; i < count; i++) {
-            buffer[i] = p->tree->children[i - 1]->node;
+            buffer[i] = Child(p, i - 1)->node;
           }
-          p->tree->node = builder_->CallDirect(index, buffer);
+          p->node = builder_->CallDirect(index, buffer);
+          // An inlined callee that never returns ends the control flow.
+          if (ssa_env_->control == nullptr) ssa_env_->Kill();
         }
         break;
       }
       case kExprCallIndirect: {
         int len;
         uint32_t index;
-        FunctionSig* sig = SigOperand(p->pc(), &index, &len);
+        FunctionSig* sig = SigOperand(p->pc, &index, &len);
         if (p->index == 1) {
           TypeCheckLast(p, kAstI32);
         } else {
           TypeCheckLast(p, sig->GetParam(p->index - 2));
         }
         if (p->done() && build()) {
-          uint32_t count = p->tree->count;
+          uint32_t count = p->count;
           TFNode** buffer = builder_->Buffer(count);
           for (int i = 0; i < count; i++) {
-            buffer[i] = p->tree->children[i]->node;
+            buffer[i] = Child(p, i)->node;
           }
-          p->tree->node = builder_->CallIndirect(index, buffer);
+          p->node = builder_->CallIndirect(index, buffer);
         }
         break;
       }
@@ -1029,11 +1219,11 @@ class LR_WasmDecoder : public Decoder {
     } else {
       // Merge the value into the production for the block.
       Production* bp = &stack_[block->stack_depth];
-      MergeIntoProduction(bp, block->ssa_env, p->last());
+      MergeIntoProduction(bp, block->ssa_env, Last(p));
     }
   }
 
-  void MergeIntoProduction(Production* p, SsaEnv* target, Tree* expr) {
+  void MergeIntoProduction(Production* p, SsaEnv* target, Value* expr) {
     if (!ssa_env_->go()) return;
 
     bool first = target->state == SsaEnv::kUnreachable;
@@ -1042,18 +1232,18 @@ class LR_WasmDecoder : public Decoder {
 
     if (first) {
       // first merge to this environment; set the type and the node.
-      p->tree->type = expr->type;
-      p->tree->node = expr->node;
+      p->type = expr->type;
+      p->node = expr->node;
     } else {
       // merge with the existing value for this block.
-      LocalType type = p->tree->type;
+      LocalType type = p->type;
       if (expr->type != type) {
         type = kAstStmt;
-        p->tree->type = kAstStmt;
-        p->tree->node = nullptr;
+        p->type = kAstStmt;
+        p->node = nullptr;
       } else if (type != kAstStmt) {
-        p->tree->node = CreateOrMergeIntoPhi(type, target->control,
-                                             p->tree->node, expr->node);
+        p->node = CreateOrMergeIntoPhi(type, target->control, p->node,
+                                       expr->node);
       }
     }
   }
@@ -1064,9 +1254,14 @@ class LR_WasmDecoder : public Decoder {
     if (build()) {
       int length = 0;
       uint32_t offset = 0;
-      MemoryAccessOperand(p->pc(), &length, &offset);
-      p->tree->node =
-          builder_->LoadMem(type, mem_type, p->last()->node, offset);
+      MemoryAccessOperand(p->pc, &length, &offset);
+      if (type == kAstS128) {
+        p->node = builder_->SimdLoadMem(Last(p)->node, offset);
+      } else if (IsAtomicAccess(p)) {
+        p->node = builder_->AtomicOp(kExprI32LoadMem, Last(p)->node, offset);
+      } else {
+        p->node = builder_->LoadMem(type, mem_type, Last(p)->node, offset);
+      }
     }
   }
 
@@ -1079,25 +1274,59 @@ class LR_WasmDecoder : public Decoder {
       if (build()) {
         int length = 0;
         uint32_t offset = 0;
-        MemoryAccessOperand(p->pc(), &length, &offset);
-        TFNode* val = p->tree->children[1]->node;
-        builder_->StoreMem(mem_type, p->tree->children[0]->node, offset, val);
-        p->tree->node = val;
+        MemoryAccessOperand(p->pc, &length, &offset);
+        TFNode* val = Child(p, 1)->node;
+        if (type == kAstS128) {
+          builder_->SimdStoreMem(Child(p, 0)->node, offset, val);
+        } else if (IsAtomicAccess(p)) {
+          builder_->AtomicOp(kExprI32StoreMem, Child(p, 0)->node, offset, val);
+        } else {
+          builder_->StoreMem(mem_type, Child(p, 0)->node, offset, val);
+        }
+        p->node = val;
       }
     }
   }
 
+  bool IsAtomicAccess(Production* p) {
+    return MemoryAccess::AtomicityField::decode(p->pc[1]) !=
+           MemoryAccess::kNone;
+  }
+
+  void ReduceAtomic(Production* p) {
+    TypeCheckLast(p, kAstI32);
+    if (p->done() && build()) {
+      int length = 0;
+      uint32_t offset = 0;
+      MemoryAccessOperand(p->pc, &length, &offset);
+      TFNode* operand = p->count > 2 ? Child(p, 2)->node : nullptr;
+      p->node = builder_->AtomicOp(p->opcode(), Child(p, 0)->node, offset,
+                                   Child(p, 1)->node, operand);
+    }
+  }
+
+  void ReduceSimdReplaceLane(Production* p, LocalType lane_type) {
+    if (p->index == 1) {
+      TypeCheckLast(p, kAstS128);
+    } else {
+      DCHECK_EQ(2, p->index);
+      TypeCheckLast(p, lane_type);
+      p->node = BUILD(SimdReplaceLane, p->opcode(), p->pc[1],
+                      Child(p, 0)->node, Child(p, 1)->node);
+    }
+  }
+
   void TypeCheckLast(Production* p, LocalType expected) {
-    LocalType result = p->last()->type;
+    LocalType result = Last(p)->type;
     if (result == expected) return;
     if (result == kAstEnd) return;
     if (expected != kAstStmt) {
-      error(p->pc(), p->last()->pc,
+      error(p->pc, Last(p)->pc,
             "%s[%d] expected type %s, found %s of type %s",
             WasmOpcodes::OpcodeName(p->opcode()), p->index - 1,
             WasmOpcodes::TypeName(expected),
-            WasmOpcodes::OpcodeName(p->last()->opcode()),
-            WasmOpcodes::TypeName(p->last()->type));
+            WasmOpcodes::OpcodeName(Last(p)->opcode()),
+            WasmOpcodes::TypeName(Last(p)->type));
     }
   }
 
@@ -1141,12 +1370,16 @@ class LR_WasmDecoder : public Decoder {
         }
         // Merge SSA values.
         for (int i = EnvironmentCount() - 1; i >= 0; i--) {
-          TFNode* a = to->locals[i];
-          TFNode* b = from->locals[i];
+          if (SharesChunk(to, from, i)) {
+            i -= i % LocalsChunk::kSize;  // skip the rest of the chunk.
+            continue;
+          }
+          TFNode* a = GetLocal(to, i);
+          TFNode* b = GetLocal(from, i);
           if (a != b) {
             TFNode* vals[] = {a, b};
-            to->locals[i] =
-                builder_->Phi(function_env_->GetLocalType(i), 2, vals, merge);
+            SetLocal(to, i, builder_->Phi(function_env_->GetLocalType(i), 2,
+                                          vals, merge));
           }
         }
         break;
@@ -1168,8 +1401,8 @@ class LR_WasmDecoder : public Decoder {
         }
         // Merge locals.
         for (int i = EnvironmentCount() - 1; i >= 0; i--) {
-          TFNode* tnode = to->locals[i];
-          TFNode* fnode = from->locals[i];
+          TFNode* tnode = GetLocal(to, i);
+          TFNode* fnode = GetLocal(from, i);
           if (builder_->IsPhiWithMerge(tnode, merge)) {
             builder_->AppendToPhi(merge, tnode, fnode);
           } else if (tnode != fnode) {
@@ -1177,8 +1410,8 @@ class LR_WasmDecoder : public Decoder {
             TFNode** vals = builder_->Buffer(count);
             for (int j = 0; j < count - 1; j++) vals[j] = tnode;
             vals[count - 1] = fnode;
-            to->locals[i] = builder_->Phi(function_env_->GetLocalType(i), count,
-                                          vals, merge);
+            SetLocal(to, i, builder_->Phi(function_env_->GetLocalType(i), count,
+                                          vals, merge));
           }
         }
         break;
@@ -1205,7 +1438,7 @@ class LR_WasmDecoder : public Decoder {
 
   void BuildInfiniteLoop() {
     if (ssa_env_->go()) {
-      PrepareForLoop(ssa_env_);
+      PrepareForLoop(ssa_env_, nullptr);
       SsaEnv* cont_env = ssa_env_;
       ssa_env_ = Split(ssa_env_);
       ssa_env_->state = SsaEnv::kReached;
@@ -1213,26 +1446,231 @@ class LR_WasmDecoder : public Decoder {
     }
   }
 
-  void PrepareForLoop(SsaEnv* env) {
+  // Turns {env} into a loop header. If {pc} is the loop, only the locals that
+  // its body assigns get phis, otherwise all of them.
+  void PrepareForLoop(SsaEnv* env, const byte* pc) {
     if (env->go()) {
       env->state = SsaEnv::kMerged;
       if (builder_) {
+        BitVector* assigned = pc ? AnalyzeLoopAssignment(pc) : nullptr;
         env->control = builder_->Loop(env->control);
         env->effect = builder_->EffectPhi(1, &env->effect, env->control);
         builder_->Terminate(env->effect, env->control);
         for (int i = EnvironmentCount() - 1; i >= 0; i--) {
-          env->locals[i] = builder_->Phi(function_env_->GetLocalType(i), 1,
-                                         &env->locals[i], env->control);
+          if (assigned != nullptr && !assigned->Contains(i)) continue;
+          TFNode* node = GetLocal(env, i);
+          SetLocal(env, i, builder_->Phi(function_env_->GetLocalType(i), 1,
+                                         &node, env->control));
+        }
+      }
+    }
+  }
+
+  // Computes the locals that the body of the loop at {pc} may assign. The
+  // other locals keep their value from before the loop, so they need no phis.
+  // Returns null if the body cannot be scanned, leaving it to the decoder to
+  // report the error.
+  BitVector* AnalyzeLoopAssignment(const byte* pc) {
+    int local_count = EnvironmentCount();
+    BitVector* assigned = new (zone_) BitVector(local_count, zone_);
+    int remaining = pc[1];  // expressions left in the body.
+    pc += 2;
+    while (remaining > 0) {
+      if (pc >= limit_) return nullptr;
+      WasmOpcode opcode = static_cast<WasmOpcode>(*pc);
+      int length = 1;
+      int arity = 0;
+      FunctionSig* sig = WasmOpcodes::Signature(opcode);
+      if (sig) {
+        arity = static_cast<int>(sig->parameter_count());
+      } else {
+        switch (opcode) {
+          case kExprNop:
+          case kExprUnreachable:
+          case kExprMemorySize:
+            break;
+          case kExprBlock:
+          case kExprLoop:
+            if (limit_ - pc < 2) return nullptr;
+            arity = pc[1];
+            length = 2;
+            break;
+          case kExprIf:
+            arity = 2;
+            break;
+          case kExprIfElse:
+          case kExprSelect:
+            arity = 3;
+            break;
+          case kExprBr:
+            arity = 1;
+            length = 2;
+            break;
+          case kExprBrIf:
+            arity = 2;
+            length = 2;
+            break;
+          case kExprI32x4ExtractLane:
+          case kExprF32x4ExtractLane:
+            arity = 1;
+            length = 2;
+            break;
+          case kExprI32x4ReplaceLane:
+          case kExprF32x4ReplaceLane:
+            arity = 2;
+            length = 2;
+            break;
+          case kExprS32x4Shuffle:
+            arity = 2;
+            length = 5;
+            break;
+          case kExprTableSwitch: {
+            if (limit_ - pc < 5) return nullptr;
+            uint16_t case_count = *reinterpret_cast<const uint16_t*>(pc + 1);
+            uint16_t table_count = *reinterpret_cast<const uint16_t*>(pc + 3);
+            arity = 1 + case_count;
+            length = 5 + table_count * 2;
+            break;
+          }
+          case kExprReturn:
+            arity = static_cast<int>(function_env_->sig->return_count());
+            break;
+          case kExprGrowMemory:
+            arity = 1;
+            break;
+          case kExprI8Const:
+            length = 2;
+            break;
+          case kExprI32Const:
+          case kExprF32Const:
+            length = 5;
+            break;
+          case kExprI64Const:
+          case kExprF64Const:
+            length = 9;
+            break;
+          case kExprStoreGlobal:
+            arity = 1;
+          // Fall through.
+          case kExprGetLocal:
+          case kExprLoadGlobal: {
+            uint32_t index;
+            if (!AnalyzeIndexOperand(pc, &length, &index)) return nullptr;
+            break;
+          }
+          case kExprSetLocal: {
+            uint32_t index;
+            if (!AnalyzeIndexOperand(pc, &length, &index)) return nullptr;
+            if (static_cast<int>(index) >= local_count) return nullptr;
+            assigned->Add(static_cast<int>(index));
+            arity = 1;
+            break;
+          }
+          case kExprCallFunction: {
+            uint32_t index;
+            if (!AnalyzeIndexOperand(pc, &length, &index)) return nullptr;
+            if (!function_env_->module->IsValidFunction(index)) return nullptr;
+            sig = function_env_->module->GetFunctionSignature(index);
+            arity = static_cast<int>(sig->parameter_count());
+            break;
+          }
+          case kExprCallIndirect: {
+            uint32_t index;
+            if (!AnalyzeIndexOperand(pc, &length, &index)) return nullptr;
+            if (!function_env_->module->IsValidSignature(index)) return nullptr;
+            sig = function_env_->module->GetSignature(index);
+            arity = static_cast<int>(1 + sig->parameter_count());
+            break;
+          }
+#define DECLARE_OPCODE_CASE(name, opcode, sig) case kExpr##name:
+            FOREACH_LOAD_MEM_OPCODE(DECLARE_OPCODE_CASE)
+          case kExprS128LoadMem:
+            arity = 1;
+            if (!AnalyzeMemoryAccessOperand(pc, &length)) return nullptr;
+            break;
+            FOREACH_STORE_MEM_OPCODE(DECLARE_OPCODE_CASE)
+          case kExprS128StoreMem:
+            arity = 2;
+            if (!AnalyzeMemoryAccessOperand(pc, &length)) return nullptr;
+            break;
+            FOREACH_ATOMIC_OPCODE(DECLARE_OPCODE_CASE)
+            arity = opcode == kExprI32AtomicCompareExchange ||
+                            opcode == kExprI32AtomicWait
+                        ? 3
+                        : 2;
+            if (!AnalyzeMemoryAccessOperand(pc, &length)) return nullptr;
+            break;
+#undef DECLARE_OPCODE_CASE
+          default:
+            return nullptr;
         }
       }
+      pc += length;
+      remaining += arity - 1;
+    }
+    return assigned;
+  }
+
+  // Reads the varint index operand of the opcode at {pc} like
+  // {UnsignedLEB128Operand}, but without reporting errors.
+  bool AnalyzeIndexOperand(const byte* pc, int* length, uint32_t* index) {
+    if (ReadUnsignedLEB128Operand(pc + 1, limit_, length, index) != kNoError) {
+      return false;
+    }
+    (*length)++;
+    return true;
+  }
+
+  // Computes the length of the memory access at {pc} like
+  // {MemoryAccessOperand}, but without reporting errors.
+  bool AnalyzeMemoryAccessOperand(const byte* pc, int* length) {
+    if (limit_ - pc < 2) return false;
+    *length = 2;
+    if (MemoryAccess::OffsetField::decode(pc[1])) {
+      uint32_t offset;
+      if (!AnalyzeIndexOperand(pc + 1, length, &offset)) return false;
+      (*length)++;  // to account for the memory access byte
+    }
+    return true;
+  }
+
+  TFNode* GetLocal(SsaEnv* env, int index) {
+    return env->locals[index / LocalsChunk::kSize]
+        ->nodes[index % LocalsChunk::kSize];
+  }
+
+  // Updates a local of {env}, copying the chunk of the local first unless
+  // {env} is its only user.
+  void SetLocal(SsaEnv* env, int index, TFNode* node) {
+    LocalsChunk** chunk = &env->locals[index / LocalsChunk::kSize];
+    if ((*chunk)->owner != env) {
+      LocalsChunk* copy = NewLocalsChunk();
+      *copy = **chunk;
+      copy->owner = env;
+      *chunk = copy;
     }
+    (*chunk)->nodes[index % LocalsChunk::kSize] = node;
   }
 
-  // Create a complete copy of the {from}.
+  LocalsChunk* NewLocalsChunk() {
+    return reinterpret_cast<LocalsChunk*>(zone_->New(sizeof(LocalsChunk)));
+  }
+
+  // Returns {true} if {a} and {b} share the chunk of the local {index}.
+  bool SharesChunk(SsaEnv* a, SsaEnv* b, int index) {
+    int chunk = index / LocalsChunk::kSize;
+    return a->locals[chunk] == b->locals[chunk];
+  }
+
+  int ChunkCount() {
+    return (EnvironmentCount() + LocalsChunk::kSize - 1) / LocalsChunk::kSize;
+  }
+
+  // Create a copy of the {from}, which shares the chunks of its locals.
   SsaEnv* Split(SsaEnv* from) {
     DCHECK_NOT_NULL(from);
     SsaEnv* result = reinterpret_cast<SsaEnv*>(zone_->New(sizeof(SsaEnv)));
-    size_t size = sizeof(TFNode*) * EnvironmentCount();
+    int chunk_count = ChunkCount();
     result->control = from->control;
     result->effect = from->effect;
     result->state = from->state == SsaEnv::kUnreachable ? SsaEnv::kUnreachable
@@ -1240,9 +1678,14 @@ class LR_WasmDecoder : public Decoder {
 
     if (from->go()) {
       result->state = SsaEnv::kReached;
-      result->locals =
-          size > 0 ? reinterpret_cast<TFNode**>(zone_->New(size)) : nullptr;
-      memcpy(result->locals, from->locals, size);
+      result->locals = chunk_count > 0
+                           ? zone_->NewArray<LocalsChunk*>(chunk_count)
+                           : nullptr;
+      for (int i = 0; i < chunk_count; i++) {
+        // Neither environment may update a shared chunk in place.
+        from->locals[i]->owner = nullptr;
+        result->locals[i] = from->locals[i];
+      }
     } else {
       result->state = SsaEnv::kUnreachable;
       result->locals = nullptr;
@@ -1372,27 +1815,27 @@ class LR_WasmDecoder : public Decoder {
   }
 
 #if DEBUG
-  void PrintStackForDebugging() { PrintProduction(0); }
-
-  void PrintProduction(size_t depth) {
-    if (depth >= stack_.size()) return;
-    Production* p = &stack_[depth];
-    for (size_t d = 0; d < depth; d++) PrintF("  ");
-
-    PrintF("@%d %s [%d]\n", static_cast<int>(p->tree->pc - start_),
-           WasmOpcodes::OpcodeName(p->opcode()), p->tree->count);
-    for (int i = 0; i < p->index; i++) {
-      Tree* child = p->tree->children[i];
-      for (size_t d = 0; d <= depth; d++) PrintF("  ");
-      PrintF("@%d %s [%d]", static_cast<int>(child->pc - start_),
-             WasmOpcodes::OpcodeName(child->opcode()), child->count);
-      if (child->node) {
-        PrintF(" => TF");
-        compiler::WasmGraphBuilder::PrintDebugName(child->node);
+  void PrintStackForDebugging() {
+    size_t first = values_.size();
+    for (const Production& p : stack_) first -= p.index;
+    for (size_t depth = 0; depth < stack_.size(); depth++) {
+      Production* p = &stack_[depth];
+      for (size_t d = 0; d < depth; d++) PrintF("  ");
+
+      PrintF("@%d %s [%d]\n", static_cast<int>(p->pc - start_),
+             WasmOpcodes::OpcodeName(p->opcode()), p->count);
+      for (int i = 0; i < p->index; i++) {
+        Value* child = &values_[first++];
+        for (size_t d = 0; d <= depth; d++) PrintF("  ");
+        PrintF("@%d %s", static_cast<int>(child->pc - start_),
+               WasmOpcodes::OpcodeName(child->opcode()));
+        if (child->node) {
+          PrintF(" => TF");
+          compiler::WasmGraphBuilder::PrintDebugName(child->node);
+        }
+        PrintF("\n");
       }
-      PrintF("\n");
     }
-    PrintProduction(depth + 1);
   }
 #endif
 };
@@ -1460,6 +1903,9 @@ int OpcodeLength(const byte* pc) {
 #define DECLARE_OPCODE_CASE(name, opcode, sig) case kExpr##name:
     FOREACH_LOAD_MEM_OPCODE(DECLARE_OPCODE_CASE)
     FOREACH_STORE_MEM_OPCODE(DECLARE_OPCODE_CASE)
+    FOREACH_SIMD_MEM_OPCODE(DECLARE_OPCODE_CASE)
+    FOREACH_SIMD_LANE_OPCODE(DECLARE_OPCODE_CASE)
+    FOREACH_ATOMIC_OPCODE(DECLARE_OPCODE_CASE)
 #undef DECLARE_OPCODE_CASE
 
     case kExprI8Const:
@@ -1474,6 +1920,8 @@ int OpcodeLength(const byte* pc) {
     case kExprI64Const:
     case kExprF64Const:
       return 9;
+    case kExprS32x4Shuffle:
+      return 5;
     case kExprStoreGlobal:
     case kExprSetLocal:
     case kExprLoadGlobal:
@@ -1556,6 +2004,8 @@ int OpcodeArity(FunctionEnv* env, const byte* pc) {
       FOREACH_STORE_MEM_OPCODE(DECLARE_OPCODE_CASE)
       FOREACH_MISC_MEM_OPCODE(DECLARE_OPCODE_CASE)
       FOREACH_SIMPLE_OPCODE(DECLARE_OPCODE_CASE)
+      FOREACH_SIMD_OPCODE(DECLARE_OPCODE_CASE)
+      FOREACH_ATOMIC_OPCODE(DECLARE_OPCODE_CASE)
 #undef DECLARE_OPCODE_CASE
   }
 }
@@ -30,6 +30,7 @@ struct FunctionEnv {
   uint32_t local_int64_count;    // number of int64 locals
   uint32_t local_float32_count;  // number of float32 locals
   uint32_t local_float64_count;  // number of float64 locals
+  uint32_t local_simd128_count;  // number of simd128 locals
   uint32_t total_locals;         // sum of parameters and all locals
 
   bool IsValidLocal(uint32_t index) { return index < total_locals; }
@@ -44,6 +45,8 @@ struct FunctionEnv {
     if (index < local_float32_count) return kAstF32;
     index -= local_float32_count;
     if (index < local_float64_count) return kAstF64;
+    index -= local_float64_count;
+    if (index < local_simd128_count) return kAstS128;
     return kAstStmt;
   }
 
@@ -61,19 +64,22 @@ struct FunctionEnv {
       case kAstF64:
         local_float64_count += count;
         break;
+      case kAstS128:
+        local_simd128_count += count;
+        break;
       default:
         UNREACHABLE();
     }
     total_locals += count;
     DCHECK(total_locals ==
            (sig->parameter_count() + local_int32_count + local_int64_count +
-            local_float32_count + local_float64_count));
+            local_float32_count + local_float64_count + local_simd128_count));
   }
 
   void SumLocals() {
     total_locals = static_cast<uint32_t>(sig->parameter_count()) +
                    local_int32_count + local_int64_count + local_float32_count +
-                   local_float64_count;
+                   local_float64_count + local_simd128_count;
   }
 };
 
@@ -82,8 +88,12 @@ typedef Result<Tree*> TreeResult;
 
 std::ostream& operator<<(std::ostream& os, const Tree& tree);
 
+// Verifies the function body and returns the syntax tree of its first
+// top-level expression.
 TreeResult VerifyWasmCode(FunctionEnv* env, const byte* base, const byte* start,
                           const byte* end);
+// Builds the TurboFan graph of the function body with {builder}. No syntax
+// trees are materialized, so the result only carries the error, if any.
 TreeResult BuildTFGraph(TFBuilder* builder, FunctionEnv* env, const byte* base,
                         const byte* start, const byte* end);
 
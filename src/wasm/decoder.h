@@ -56,14 +56,7 @@ class Decoder {
     TRACE("  +%d  %-20s: ", static_cast<int>(pc_ - start_),
           name ? name : "uint16_t");
     if (checkAvailable(2)) {
-#ifdef V8_TARGET_LITTLE_ENDIAN
-      byte b0 = pc_[0];
-      byte b1 = pc_[1];
-#else
-      byte b1 = pc_[0];
-      byte b0 = pc_[1];
-#endif
-      uint16_t val = static_cast<uint16_t>(b1 << 8) | b0;
+      uint16_t val = read_u16(pc_);
       TRACE("%02x %02x = %d\n", pc_[0], pc_[1], val);
       pc_ += 2;
       return val;
@@ -78,20 +71,7 @@ class Decoder {
     TRACE("  +%d  %-20s: ", static_cast<int>(pc_ - start_),
           name ? name : "uint32_t");
     if (checkAvailable(4)) {
-#ifdef V8_TARGET_LITTLE_ENDIAN
-      byte b0 = pc_[0];
-      byte b1 = pc_[1];
-      byte b2 = pc_[2];
-      byte b3 = pc_[3];
-#else
-      byte b3 = pc_[0];
-      byte b2 = pc_[1];
-      byte b1 = pc_[2];
-      byte b0 = pc_[3];
-#endif
-      uint32_t val = static_cast<uint32_t>(b3 << 24) |
-                     static_cast<uint32_t>(b2 << 16) |
-                     static_cast<uint32_t>(b1 << 8) | b0;
+      uint32_t val = read_u32(pc_);
       TRACE("%02x %02x %02x %02x = %u\n", pc_[0], pc_[1], pc_[2], pc_[3], val);
       pc_ += 4;
       return val;
@@ -112,9 +92,21 @@ class Decoder {
     }
 
     const byte* pos = pc_;
-    const byte* end = pc_ + 5;
-    if (end > limit_) end = limit_;
+    if (limit_ - pc_ >= 5) {
+      // All five bytes that the longest varint can take are available, so
+      // {read_u32v} can read them without checking each one.
+      uint32_t result;
+      pc_ += read_u32v(pc_, &result);
+      *length = static_cast<int>(pc_ - pos);
+      if (pc_[-1] & 0x80) {
+        error(pc_ - 1, "varint too large");
+      } else {
+        TRACE("= %u\n", result);
+      }
+      return result;
+    }
 
+    const byte* end = limit_;
     uint32_t result = 0;
     int shift = 0;
     byte b = 0;
@@ -135,6 +127,83 @@ class Decoder {
     return result;
   }
 
+  // Unchecked versions of {u8}, {u16} and {u32}, for reading records whose
+  // bytes have all been checked to be available at once, for example with
+  // {checkAvailable}. They neither trace nor record errors.
+  uint8_t unchecked_u8() { return *pc_++; }
+
+  uint16_t unchecked_u16() {
+    uint16_t val = read_u16(pc_);
+    pc_ += 2;
+    return val;
+  }
+
+  uint32_t unchecked_u32() {
+    uint32_t val = read_u32(pc_);
+    pc_ += 4;
+    return val;
+  }
+
+  // Reads the 16-bit unsigned integer (little endian) at {p}.
+  static uint16_t read_u16(const byte* p) {
+#ifdef V8_TARGET_LITTLE_ENDIAN
+    byte b0 = p[0];
+    byte b1 = p[1];
+#else
+    byte b1 = p[0];
+    byte b0 = p[1];
+#endif
+    return static_cast<uint16_t>(b1 << 8) | b0;
+  }
+
+  // Reads the 32-bit unsigned integer (little endian) at {p}.
+  static uint32_t read_u32(const byte* p) {
+#ifdef V8_TARGET_LITTLE_ENDIAN
+    byte b0 = p[0];
+    byte b1 = p[1];
+    byte b2 = p[2];
+    byte b3 = p[3];
+#else
+    byte b3 = p[0];
+    byte b2 = p[1];
+    byte b1 = p[2];
+    byte b0 = p[3];
+#endif
+    return static_cast<uint32_t>(b3 << 24) | static_cast<uint32_t>(b2 << 16) |
+           static_cast<uint32_t>(b1 << 8) | b0;
+  }
+
+  // Reads the LEB128 variable-length 32-bit integer at {p} into {result}
+  // and returns its length. At least 5 bytes must be available at {p}. The
+  // varint is too large if the last byte read has its continuation bit set.
+  static int read_u32v(const byte* p, uint32_t* result) {
+    uint32_t b = p[0];
+    uint32_t val = b & 0x7F;
+    int length = 1;
+    if (b & 0x80) {
+      b = p[1];
+      val |= (b & 0x7F) << 7;
+      length = 2;
+      if (b & 0x80) {
+        b = p[2];
+        val |= (b & 0x7F) << 14;
+        length = 3;
+        if (b & 0x80) {
+          b = p[3];
+          val |= (b & 0x7F) << 21;
+          length = 4;
+          if (b & 0x80) {
+            b = p[4];
+            val |= (b & 0x7F) << 28;
+            length = 5;
+          }
+        }
+      }
+    }
+    *result = val;
+    return length;
+  }
+
   // Check that at least {size} bytes exist between {pc_} and {limit_}.
   bool checkAvailable(int size) {
     if (pc_ < start_ || (pc_ + size) > limit_) {
@@ -51,6 +51,15 @@ void EmitVarInt(byte** b, size_t val) {
     }
   }
 }
+
+size_t SizeOfVarInt(size_t value) {
+  size_t size = 0;
+  do {
+    size++;
+    value = value >> 7;
+  } while (value > 0);
+  return size;
+}
 }
 
 struct WasmFunctionBuilder::Type {
@@ -99,9 +108,7 @@ void WasmFunctionBuilder::EmitCode(const byte* code, uint32_t code_size,
                                    const uint32_t* local_indices,
                                    uint32_t indices_size) {
   size_t size = body_.size();
-  for (size_t i = 0; i < code_size; i++) {
-    body_.push_back(code[i]);
-  }
+  body_.insert(body_.end(), code, code + code_size);
   for (size_t i = 0; i < indices_size; i++) {
     local_indices_.push_back(local_indices[i] + static_cast<uint32_t>(size));
   }
@@ -139,29 +146,23 @@ WasmFunctionEncoder* WasmFunctionBuilder::Build(Zone* zone,
                                                 WasmModuleBuilder* mb) const {
   WasmFunctionEncoder* e =
       new (zone) WasmFunctionEncoder(zone, return_type_, exported_, external_);
-  auto var_index = new uint16_t[locals_.size()];
-  IndexVars(e, var_index);
+  e->var_index_.resize(locals_.size());
+  IndexVars(e, e->var_index_.data());
+  // Only compute the size of the body with the local indices remapped here,
+  // the body itself is remapped by {WasmFunctionEncoder::Serialize}.
+  e->body_ = &body_;
+  e->local_indices_ = &local_indices_;
+  size_t body_size = body_.size();
   const byte* start = body_.data();
   const byte* end = start + body_.size();
-  size_t local_index = 0;
-  for (size_t i = 0; i < body_.size();) {
-    if (local_index < local_indices_.size() &&
-        i == local_indices_[local_index]) {
-      int length = 0;
-      uint32_t index;
-      ReadUnsignedLEB128Operand(start + i, end, &length, &index);
-      uint16_t new_index = var_index[index];
-      const std::vector<uint8_t>& index_vec = UnsignedLEB128From(new_index);
-      for (size_t j = 0; j < index_vec.size(); j++) {
-        e->body_.push_back(index_vec.at(j));
-      }
-      i += length;
-      local_index++;
-    } else {
-      e->body_.push_back(*(start + i));
-      i++;
-    }
-  }
+  for (uint32_t offset : local_indices_) {
+    int length = 0;
+    uint32_t index;
+    ReadUnsignedLEB128Operand(start + offset, end, &length, &index);
+    body_size -= length;
+    body_size += SizeOfVarInt(e->var_index_[index]);
+  }
+  e->body_size_ = static_cast<uint32_t>(body_size);
   FunctionSig::Builder sig(zone, return_type_ == kAstStmt ? 0 : 1,
                            e->params_.size());
   if (return_type_ != kAstStmt) {
@@ -171,7 +172,6 @@ WasmFunctionEncoder* WasmFunctionBuilder::Build(Zone* zone,
     sig.AddParam(static_cast<LocalType>(e->params_[i]));
   }
   e->signature_index_ = mb->AddSignature(sig.Build());
-  delete[] var_index;
   e->name_.insert(e->name_.begin(), name_.begin(), name_.end());
   return e;
 }
@@ -183,6 +183,7 @@ void WasmFunctionBuilder::IndexVars(WasmFunctionEncoder* e,
   uint16_t int64 = 0;
   uint16_t float32 = 0;
   uint16_t float64 = 0;
+  uint16_t simd128 = 0;
   for (size_t i = 0; i < locals_.size(); i++) {
     if (locals_.at(i).param_) {
       param++;
@@ -194,12 +195,16 @@ void WasmFunctionBuilder::IndexVars(WasmFunctionEncoder* e,
       float32++;
     } else if (locals_.at(i).type_ == kAstF64) {
       float64++;
+    } else if (locals_.at(i).type_ == kAstS128) {
+      simd128++;
     }
   }
   e->local_int32_count_ = int32;
   e->local_int64_count_ = int64;
   e->local_float32_count_ = float32;
   e->local_float64_count_ = float64;
+  e->local_simd128_count_ = simd128;
+  simd128 = param + int32 + int64 + float32 + float64;
   float64 = param + int32 + int64 + float32;
   float32 = param + int32 + int64;
   int64 = param + int32;
@@ -217,25 +222,34 @@ void WasmFunctionBuilder::IndexVars(WasmFunctionEncoder* e,
       var_index[i] = float32++;
     } else if (locals_.at(i).type_ == kAstF64) {
       var_index[i] = float64++;
+    } else if (locals_.at(i).type_ == kAstS128) {
+      var_index[i] = simd128++;
     }
   }
 }
 
 WasmFunctionEncoder::WasmFunctionEncoder(Zone* zone, LocalType return_type,
                                          bool exported, bool external)
-    : params_(zone), exported_(exported), external_(external), body_(zone),
+    : params_(zone),
+      exported_(exported),
+      external_(external),
+      body_(nullptr),
+      local_indices_(nullptr),
+      var_index_(zone),
+      body_size_(0),
       name_(zone) {}
 
 uint32_t WasmFunctionEncoder::HeaderSize() const {
   uint32_t size = 3;
   if (HasLocals()) size += 8;
+  if (HasSimdLocals()) size += 2;
   if (!external_) size += 2;
   if (HasName()) size += 4;
   return size;
 }
 
 uint32_t WasmFunctionEncoder::BodySize(void) const {
-  return external_ ? 0 : static_cast<uint32_t>(body_.size());
+  return external_ ? 0 : body_size_;
 }
 
 uint32_t WasmFunctionEncoder::NameSize() const {
@@ -247,6 +261,7 @@ void WasmFunctionEncoder::Serialize(byte* buffer, byte** header,
   uint8_t decl_bits = (exported_ ? kDeclFunctionExport : 0) |
                       (external_ ? kDeclFunctionImport : 0) |
                       (HasLocals() ? kDeclFunctionLocals : 0) |
+                      (HasSimdLocals() ? kDeclFunctionSimdLocals : 0) |
                       (HasName() ? kDeclFunctionName : 0);
 
   EmitUint8(header, decl_bits);
@@ -266,19 +281,34 @@ void WasmFunctionEncoder::Serialize(byte* buffer, byte** header,
     EmitUint16(header, local_float64_count_);
   }
 
+  if (HasSimdLocals()) {
+    EmitUint16(header, local_simd128_count_);
+  }
+
   if (!external_) {
-    EmitUint16(header, static_cast<uint16_t>(body_.size()));
-    std::memcpy(*header, body_.data(), body_.size());
-    (*header) += body_.size();
+    EmitUint16(header, static_cast<uint16_t>(body_size_));
+    // Copy the body in runs between the local indices, which are remapped.
+    const byte* start = body_->data();
+    const byte* end = start + body_->size();
+    size_t pos = 0;
+    for (uint32_t offset : *local_indices_) {
+      std::memcpy(*header, start + pos, offset - pos);
+      (*header) += offset - pos;
+      int length = 0;
+      uint32_t index;
+      ReadUnsignedLEB128Operand(start + offset, end, &length, &index);
+      EmitVarInt(header, var_index_[index]);
+      pos = offset + length;
+    }
+    std::memcpy(*header, start + pos, body_->size() - pos);
+    (*header) += body_->size() - pos;
   }
 }
 
 WasmDataSegmentEncoder::WasmDataSegmentEncoder(Zone* zone, const byte* data,
                                                uint32_t size, uint32_t dest)
     : data_(zone), dest_(dest) {
-  for (size_t i = 0; i < size; i++) {
-    data_.push_back(data[i]);
-  }
+  data_.insert(data_.end(), data, data + size);
 }
 
 uint32_t WasmDataSegmentEncoder::HeaderSize() const {
@@ -449,8 +479,8 @@ WasmModuleIndex* WasmModuleWriter::WriteTo(Zone* zone) const {
 
   if (sizes.body_size > 0) sizes.Add(1, 0);
 
-  ZoneVector<uint8_t> buffer_vector(sizes.total(), zone);
-  byte* buffer = buffer_vector.data();
+  // Every byte of the buffer is written below, so it is not cleared first.
+  byte* buffer = zone->NewArray<byte>(sizes.total());
   byte* header = buffer;
   byte* body = buffer + sizes.header_size;
 
@@ -521,6 +551,8 @@ WasmModuleIndex* WasmModuleWriter::WriteTo(Zone* zone) const {
   }
 
   if (sizes.body_size > 0) EmitUint8(&header, kDeclEnd);
+  DCHECK(header == buffer + sizes.header_size);
+  DCHECK(body == buffer + sizes.total());
 
   return new (zone) WasmModuleIndex(buffer, buffer + sizes.total());
 }
@@ -20,6 +20,10 @@ namespace wasm {
 
 class WasmModuleBuilder;
 
+// The encoding of a single function. The encoder refers to the body of the
+// function builder instead of copying it, and remaps the local indices in the
+// body while serializing it, so that every byte of the body is copied only
+// once, straight into the module.
 class WasmFunctionEncoder : public ZoneObject {
  public:
   uint32_t HeaderSize() const;
@@ -37,9 +41,13 @@ class WasmFunctionEncoder : public ZoneObject {
   uint16_t local_int64_count_;
   uint16_t local_float32_count_;
   uint16_t local_float64_count_;
+  uint16_t local_simd128_count_;
   bool exported_;
   bool external_;
-  ZoneVector<uint8_t> body_;
+  const ZoneVector<uint8_t>* body_;
+  const ZoneVector<uint32_t>* local_indices_;
+  ZoneVector<uint16_t> var_index_;
+  uint32_t body_size_;  // size of the body with the local indices remapped.
   ZoneVector<char> name_;
 
   bool HasLocals() const {
@@ -47,6 +55,8 @@ class WasmFunctionEncoder : public ZoneObject {
             local_float64_count_) > 0;
   }
 
+  bool HasSimdLocals() const { return local_simd128_count_ > 0; }
+
   bool HasName() const {
     return exported_ && name_.size() > 0;
   }
@@ -67,6 +77,8 @@ class WasmFunctionBuilder : public ZoneObject {
   void EditImmediate(uint32_t offset, const byte immediate);
   void Exported(uint8_t flag);
   void External(uint8_t flag);
+  // The encoder refers to the body of this builder, which must not change
+  // until the encoder is serialized.
   WasmFunctionEncoder* Build(Zone* zone, WasmModuleBuilder* mb) const;
 
  private:
@@ -6,6 +6,14 @@
 #include "src/macro-assembler.h"
 #include "src/objects.h"
 
+#include <algorithm>
+#include <unordered_map>
+
+#include "include/v8-platform.h"
+#include "src/base/functional.h"
+#include "src/base/platform/mutex.h"
+#include "src/base/platform/platform.h"
+#include "src/base/platform/semaphore.h"
 #include "src/wasm/decoder.h"
 #include "src/wasm/module-decoder.h"
 
@@ -22,12 +30,131 @@ namespace wasm {
 #define TRACE(...)
 #endif
 
+namespace {
+// Sets up {fenv} for verifying the body of {function}.
+void InitFunctionEnv(FunctionEnv* fenv, ModuleEnv* menv,
+                     const WasmFunction* function) {
+  fenv->module = menv;
+  fenv->sig = function->sig;
+  fenv->local_int32_count = function->local_int32_count;
+  fenv->local_int64_count = function->local_int64_count;
+  fenv->local_float32_count = function->local_float32_count;
+  fenv->local_float64_count = function->local_float64_count;
+  fenv->local_simd128_count = function->local_simd128_count;
+  fenv->SumLocals();
+}
+
+// A queue of function bodies verified in parallel by the background
+// verification tasks and the main thread. Function bodies are independent
+// once the signatures are decoded. Only the index of the first function
+// that fails is recorded, so that the caller can verify that one again and
+// report the same error as verifying one function after the other.
+class VerificationQueue {
+ public:
+  VerificationQueue(ModuleEnv* menv, const byte* base, uint32_t count)
+      : menv_(menv), base_(base), next_(0), first_failure_(count) {}
+
+  // Verifies the next function in the queue. Returns {false} if there is no
+  // work left.
+  bool VerifyNext() {
+    uint32_t index;
+    {
+      base::LockGuard<base::Mutex> guard(&mutex_);
+      // Functions after the first failure need not be verified.
+      if (next_ >= first_failure_) return false;
+      index = next_++;
+    }
+    const WasmFunction* function = &menv_->module->functions->at(index);
+    if (function->external) return true;
+    FunctionEnv fenv;
+    InitFunctionEnv(&fenv, menv_, function);
+    TreeResult result =
+        VerifyWasmCode(&fenv, base_, base_ + function->code_start_offset,
+                       base_ + function->code_end_offset);
+    if (result.failed()) {
+      base::LockGuard<base::Mutex> guard(&mutex_);
+      if (index < first_failure_) first_failure_ = index;
+    }
+    return true;
+  }
+
+  // Returns the index of the first function that failed to verify, or the
+  // number of functions if all of them verified.
+  uint32_t first_failure() {
+    base::LockGuard<base::Mutex> guard(&mutex_);
+    return first_failure_;
+  }
+
+ private:
+  base::Mutex mutex_;
+  ModuleEnv* menv_;
+  const byte* base_;
+  uint32_t next_;
+  uint32_t first_failure_;
+};
+
+class VerificationTask : public v8::Task {
+ public:
+  VerificationTask(VerificationQueue* queue, base::Semaphore* done)
+      : queue_(queue), done_(done) {}
+
+  void Run() override {
+    while (queue_->VerifyNext()) {
+    }
+    done_->Signal();
+  }
+
+ private:
+  VerificationQueue* queue_;
+  base::Semaphore* done_;
+};
+
+// Hashes and compares signatures by their contents.
+struct SignatureHash {
+  size_t operator()(FunctionSig* sig) const {
+    size_t hash = base::hash_combine(sig->return_count(),
+                                     sig->parameter_count());
+    for (size_t i = 0; i < sig->return_count(); i++) {
+      hash = base::hash_combine(hash, static_cast<int>(sig->GetReturn(i)));
+    }
+    for (size_t i = 0; i < sig->parameter_count(); i++) {
+      hash = base::hash_combine(hash, static_cast<int>(sig->GetParam(i)));
+    }
+    return hash;
+  }
+};
+
+struct SignatureEqual {
+  bool operator()(FunctionSig* a, FunctionSig* b) const {
+    if (a->return_count() != b->return_count()) return false;
+    if (a->parameter_count() != b->parameter_count()) return false;
+    for (size_t i = 0; i < a->return_count(); i++) {
+      if (a->GetReturn(i) != b->GetReturn(i)) return false;
+    }
+    for (size_t i = 0; i < a->parameter_count(); i++) {
+      if (a->GetParam(i) != b->GetParam(i)) return false;
+    }
+    return true;
+  }
+};
+}  // namespace
+
 // The main logic for decoding the bytes of a module.
 class ModuleDecoder : public Decoder {
  public:
   ModuleDecoder(Zone* zone, const byte* module_start, const byte* module_end,
                 bool asm_js)
-      : Decoder(module_start, module_end), module_zone(zone), asm_js_(asm_js) {
+      : Decoder(module_start, module_end),
+        module_zone(zone),
+        asm_js_(asm_js),
+        client_(nullptr),
+        section_(kDeclEnd),
+        section_count_(0),
+        section_index_(0),
+        end_reached_(false),
+        verify_functions_(false),
+        deferred_offsets_(false),
+        unchecked_(false) {
     result_.start = start_;
     if (limit_ < start_) {
       error(start_, "end is less than start");
@@ -37,164 +164,392 @@ class ModuleDecoder : public Decoder {
 
   virtual void onFirstError() {
     pc_ = limit_;  // On error, terminate section decoding loop.
+    unchecked_ = false;  // The bytes after {pc_} are no longer available.
   }
 
   // Decodes an entire module.
   ModuleResult DecodeModule(WasmModule* module, bool verify_functions = true) {
+    StartModule(module, verify_functions);
+
+    // Decode the module sections.
+    DecodeRemainingUnits(module);
+
+    return toResult(module);
+  }
+
+  // Decodes the units up to the end of the module bytes.
+  void DecodeRemainingUnits(WasmModule* module) {
+    while (pc_ < limit_ || (in_section() && ok())) {
+      DecodeUnit(module);
+    }
+  }
+
+  // Prepares {module} for decoding, one unit at a time, with {DecodeUnit}.
+  void StartModule(WasmModule* module, bool verify_functions) {
     pc_ = start_;
     module->module_start = start_;
     module->module_end = limit_;
     module->min_mem_size_log2 = 0;
     module->max_mem_size_log2 = 0;
     module->mem_export = false;
+    module->mem_shared = false;
     module->mem_external = false;
-    module->globals = new std::vector<WasmGlobal>();
-    module->signatures = new std::vector<FunctionSig*>();
-    module->functions = new std::vector<WasmFunction>();
-    module->data_segments = new std::vector<WasmDataSegment>();
-    module->function_table = new std::vector<uint16_t>();
+    module->globals = NewVector<WasmGlobal>();
+    module->signatures = NewVector<FunctionSig*>();
+    module->canonical_sig_indices = NewVector<uint16_t>();
+    module->functions = NewVector<WasmFunction>();
+    module->data_segments = NewVector<WasmDataSegment>();
+    module->function_table = NewVector<uint16_t>();
 
-    bool sections[kMaxModuleSectionCode];
-    memset(sections, 0, sizeof(sections));
+    memset(sections_, 0, sizeof(sections_));
+    section_ = kDeclEnd;
+    section_count_ = 0;
+    section_index_ = 0;
+    end_reached_ = false;
+    verify_functions_ = verify_functions;
+  }
 
-    // Decode the module sections.
-    while (pc_ < limit_) {
-      TRACE("DecodeSection\n");
-      WasmSectionDeclCode section =
-          static_cast<WasmSectionDeclCode>(u8("section"));
-      // Each section should appear at most once.
-      if (section < kMaxModuleSectionCode) {
-        CheckForPreviousSection(sections, section, false);
-        sections[section] = true;
-      }
+  // Decodes the next unit of the module: either a section header or a single
+  // entry of the current section.
+  void DecodeUnit(WasmModule* module) {
+    if (in_section()) {
+      DecodeSectionEntry(module);
+    } else {
+      DecodeSectionHeader(module);
+    }
+  }
 
-      switch (section) {
-        case kDeclEnd:
-          // Terminate section decoding.
-          limit_ = pc_;
-          break;
-        case kDeclMemory:
-          module->min_mem_size_log2 = u8("min memory");
-          module->max_mem_size_log2 = u8("max memory");
-          module->mem_export = u8("export memory") != 0;
-          break;
-        case kDeclSignatures: {
-          int length;
-          uint32_t signatures_count = u32v(&length, "signatures count");
-          module->signatures->reserve(SafeReserve(signatures_count));
-          // Decode signatures.
-          for (uint32_t i = 0; i < signatures_count; i++) {
-            if (failed()) break;
-            TRACE("DecodeSignature[%d] module+%d\n", i,
-                  static_cast<int>(pc_ - start_));
-            FunctionSig* s = sig();  // read function sig.
-            module->signatures->push_back(s);
-          }
-          break;
-        }
-        case kDeclFunctions: {
-          // Functions require a signature table first.
-          CheckForPreviousSection(sections, kDeclSignatures, true);
-          int length;
-          uint32_t functions_count = u32v(&length, "functions count");
-          module->functions->reserve(SafeReserve(functions_count));
-          // Set up module environment for verification.
-          ModuleEnv menv;
-          menv.module = module;
-          menv.globals_area = 0;
-          menv.mem_start = 0;
-          menv.mem_end = 0;
-          menv.function_code = nullptr;
-          menv.asm_js = asm_js_;
-          // Decode functions.
-          for (uint32_t i = 0; i < functions_count; i++) {
-            if (failed()) break;
-            TRACE("DecodeFunction[%d] module+%d\n", i,
-                  static_cast<int>(pc_ - start_));
-
-            module->functions->push_back(
-                {nullptr, 0, 0, 0, 0, 0, 0, false, false});
-            WasmFunction* function = &module->functions->back();
-            DecodeFunctionInModule(module, function, false);
-          }
-          if (ok() && verify_functions) {
-            for (uint32_t i = 0; i < functions_count; i++) {
-              if (failed()) break;
-              WasmFunction* function = &module->functions->at(i);
-              if (!function->external) {
-                VerifyFunctionBody(i, &menv, function);
-                if (result_.failed())
-                  error(result_.error_pc, result_.error_msg.get());
-              }
-            }
-          }
-          break;
-        }
-        case kDeclGlobals: {
-          int length;
-          uint32_t globals_count = u32v(&length, "globals count");
-          module->globals->reserve(SafeReserve(globals_count));
-          // Decode globals.
-          for (uint32_t i = 0; i < globals_count; i++) {
-            if (failed()) break;
-            TRACE("DecodeGlobal[%d] module+%d\n", i,
-                  static_cast<int>(pc_ - start_));
-            module->globals->push_back({0, MachineType::Int32(), 0, false});
-            WasmGlobal* global = &module->globals->back();
-            DecodeGlobalInModule(global);
-          }
-          break;
+  // Checks whether all bytes of the next unit are available. Used when the
+  // module bytes arrive incrementally, so that a unit is only decoded once
+  // it is complete.
+  bool NextUnitAvailable() {
+    if (end_reached_ || failed()) return false;
+    const byte* p = pc_;
+    if (in_section()) {
+      switch (section_) {
+        case kDeclSignatures:
+          // Parameter count, return type and parameter types.
+          return Available(p, 1) && Available(p, 2 + p[0]);
+        case kDeclFunctions:
+          return FunctionEntryAvailable(p);
+        case kDeclGlobals:
+          return Available(p, kDeclGlobalSize);
+        case kDeclDataSegments:
+          return Available(p, kDeclDataSegmentSize);
+        case kDeclFunctionTable:
+          return Available(p, 2);
+        default:
+          UNREACHABLE();
+          return false;
+      }
+    }
+    if (!Available(p, 1)) return false;
+    switch (p[0]) {
+      case kDeclMemory:
+        return Available(p, 1 + kDeclMemorySize);
+      case kDeclSignatures:
+      case kDeclFunctions:
+      case kDeclGlobals:
+      case kDeclDataSegments:
+      case kDeclFunctionTable:
+        // The section code is followed by a varint entry count.
+        for (int i = 1; i <= 5; i++) {
+          if (!Available(p, i + 1)) return false;
+          if ((p[i] & 0x80) == 0) break;
         }
-        case kDeclDataSegments: {
-          int length;
-          uint32_t data_segments_count = u32v(&length, "data segments count");
-          module->data_segments->reserve(SafeReserve(data_segments_count));
-          // Decode data segments.
-          for (uint32_t i = 0; i < data_segments_count; i++) {
-            if (failed()) break;
-            TRACE("DecodeDataSegment[%d] module+%d\n", i,
-                  static_cast<int>(pc_ - start_));
-            module->data_segments->push_back({0, 0, 0});
-            WasmDataSegment* segment = &module->data_segments->back();
-            DecodeDataSegmentInModule(segment);
-          }
+        return true;
+      default:
+        // The end of the module or an invalid section.
+        return true;
+    }
+  }
+
+  // Extends decoding to the newly arrived bytes up to {end}, which follow
+  // the bytes decoded so far.
+  void Extend(WasmModule* module, const byte* end) {
+    if (!end_reached_) limit_ = end;
+    module->module_end = end;
+  }
+
+  // Continues decoding from a copy of the bytes decoded so far at {start}.
+  // Only valid while decoding has not failed, since errors keep pointers.
+  void Rebase(WasmModule* module, const byte* start) {
+    DCHECK(ok());
+    pc_ = start + (pc_ - start_);
+    limit_ = start + (limit_ - start_);
+    module->module_end = start + (module->module_end - start_);
+    module->module_start = start;
+    result_.start = start;
+    start_ = start;
+  }
+
+  // Checks the offsets into the module bytes that could not be checked while
+  // the bytes were still arriving.
+  void CheckOffsets(WasmModule* module) {
+    deferred_offsets_ = false;
+    uint32_t size = static_cast<uint32_t>(module->module_end - start_);
+    for (const WasmFunction& function : *module->functions) {
+      if (function.name_offset > size) {
+        return error(start_, "function name offset out of bounds of module");
+      }
+    }
+    for (const WasmGlobal& global : *module->globals) {
+      if (global.name_offset > size) {
+        return error(start_, "global name offset out of bounds of module");
+      }
+    }
+    for (const WasmDataSegment& segment : *module->data_segments) {
+      if (segment.source_offset > size) {
+        return error(start_, "data segment offset out of bounds of module");
+      }
+    }
+  }
+
+  // Defers the bounds checks of offsets until {CheckOffsets}.
+  void set_deferred_offsets(bool deferred) { deferred_offsets_ = deferred; }
+
+  void set_client(StreamingDecoder::Client* client) { client_ = client; }
+
+  bool in_section() const { return section_index_ < section_count_; }
+
+  void DecodeSectionHeader(WasmModule* module) {
+    TRACE("DecodeSection\n");
+    WasmSectionDeclCode section =
+        static_cast<WasmSectionDeclCode>(u8("section"));
+    // Each section should appear at most once.
+    if (section < kMaxModuleSectionCode) {
+      CheckForPreviousSection(sections_, section, false);
+      sections_[section] = true;
+    }
+
+    section_ = section;
+    section_index_ = 0;
+    section_count_ = 0;
+    int length;
+    switch (section) {
+      case kDeclEnd:
+        // Terminate section decoding.
+        limit_ = pc_;
+        end_reached_ = true;
+        break;
+      case kDeclMemory: {
+        module->min_mem_size_log2 = u8("min memory");
+        module->max_mem_size_log2 = u8("max memory");
+        uint8_t flags = u8("memory flags");
+        module->mem_export = (flags & kDeclMemoryExport) != 0;
+        module->mem_shared = (flags & kDeclMemoryShared) != 0;
+        break;
+      }
+      case kDeclSignatures:
+        section_count_ = u32v(&length, "signatures count");
+        module->signatures->reserve(SafeReserve(section_count_, 2));
+        module->canonical_sig_indices->reserve(SafeReserve(section_count_, 2));
+        break;
+      case kDeclFunctions:
+        // Functions require a signature table first.
+        CheckForPreviousSection(sections_, kDeclSignatures, true);
+        section_count_ = u32v(&length, "functions count");
+        module->functions->reserve(SafeReserve(section_count_, 3));
+        break;
+      case kDeclGlobals:
+        section_count_ = u32v(&length, "globals count");
+        module->globals->reserve(
+            SafeReserve(section_count_, kDeclGlobalSize));
+        break;
+      case kDeclDataSegments:
+        section_count_ = u32v(&length, "data segments count");
+        module->data_segments->reserve(
+            SafeReserve(section_count_, kDeclDataSegmentSize));
+        break;
+      case kDeclFunctionTable:
+        // An indirect function table requires functions first.
+        CheckForPreviousSection(sections_, kDeclFunctions, true);
+        section_count_ = u32v(&length, "function table count");
+        module->function_table->reserve(SafeReserve(section_count_, 2));
+        break;
+      default:
+        error(pc_ - 1, nullptr, "unrecognized section 0x%02x", section);
+        break;
+    }
+    if (failed()) {
+      section_count_ = 0;
+    } else if (section_count_ == 0) {
+      FinishSection(module);
+    }
+  }
+
+  void DecodeSectionEntry(WasmModule* module) {
+    if (FixedSizeEntriesAvailable()) {
+      // The bytes of all the remaining entries are available, so they are
+      // decoded at once without checking each field.
+      unchecked_ = true;
+      while (in_section() && ok()) DecodeEntry(module);
+      unchecked_ = false;
+    } else {
+      DecodeEntry(module);
+    }
+    if (failed()) {
+      section_count_ = 0;
+    } else if (section_index_ == section_count_) {
+      FinishSection(module);
+    }
+  }
+
+  // Decodes the next entry of the current section.
+  void DecodeEntry(WasmModule* module) {
+    uint32_t i = section_index_++;
+    switch (section_) {
+      case kDeclSignatures: {
+        TRACE("DecodeSignature[%d] module+%d\n", i,
+              static_cast<int>(pc_ - start_));
+        FunctionSig* s = sig();  // read function sig.
+        module->signatures->push_back(s);
+        module->canonical_sig_indices->push_back(CanonicalSigIndex(s, i));
+        break;
+      }
+      case kDeclFunctions: {
+        TRACE("DecodeFunction[%d] module+%d\n", i,
+              static_cast<int>(pc_ - start_));
+        module->functions->push_back(
+            {nullptr, 0, 0, 0, false, false, 0, 0, 0, 0, 0, 0});
+        WasmFunction* function = &module->functions->back();
+        // An entry whose bytes are all available, including the body, is
+        // decoded without checking each field.
+        unchecked_ = !FLAG_trace_wasm_decoder && FunctionEntryAvailable(pc_);
+        DecodeFunctionInModule(module, function, false);
+        unchecked_ = false;
+        if (ok() && client_) client_->OnFunctionBody(module, i);
+        break;
+      }
+      case kDeclGlobals: {
+        TRACE("DecodeGlobal[%d] module+%d\n", i,
+              static_cast<int>(pc_ - start_));
+        module->globals->push_back({0, MachineType::Int32(), 0, false});
+        WasmGlobal* global = &module->globals->back();
+        DecodeGlobalInModule(global);
+        break;
+      }
+      case kDeclDataSegments: {
+        TRACE("DecodeDataSegment[%d] module+%d\n", i,
+              static_cast<int>(pc_ - start_));
+        module->data_segments->push_back({0, 0, 0});
+        WasmDataSegment* segment = &module->data_segments->back();
+        DecodeDataSegmentInModule(segment);
+        break;
+      }
+      case kDeclFunctionTable: {
+        TRACE("DecodeFunctionTable[%d] module+%d\n", i,
+              static_cast<int>(pc_ - start_));
+        uint16_t index = field_u16(nullptr);
+        if (index >= module->functions->size()) {
+          error(pc_ - 2, "invalid function index");
           break;
         }
-        case kDeclFunctionTable: {
-          // An indirect function table requires functions first.
-          CheckForPreviousSection(sections, kDeclFunctions, true);
-          int length;
-          uint32_t function_table_count = u32v(&length, "function table count");
-          module->function_table->reserve(SafeReserve(function_table_count));
-          // Decode function table.
-          for (uint32_t i = 0; i < function_table_count; i++) {
-            if (failed()) break;
-            TRACE("DecodeFunctionTable[%d] module+%d\n", i,
-                  static_cast<int>(pc_ - start_));
-            uint16_t index = u16();
-            if (index >= module->functions->size()) {
-              error(pc_ - 2, "invalid function index");
-              break;
-            }
-            module->function_table->push_back(index);
-          }
-          break;
+        module->function_table->push_back(index);
+        break;
+      }
+      default:
+        UNREACHABLE();
+        break;
+    }
+  }
+
+  // Checks whether the entries of the current section have a fixed size and
+  // the bytes of all the remaining ones are available. Tracing decodes the
+  // entries one at a time, to trace every field.
+  bool FixedSizeEntriesAvailable() {
+    if (FLAG_trace_wasm_decoder) return false;
+    uint64_t size;
+    switch (section_) {
+      case kDeclGlobals:
+        size = kDeclGlobalSize;
+        break;
+      case kDeclDataSegments:
+        size = kDeclDataSegmentSize;
+        break;
+      case kDeclFunctionTable:
+        size = 2;
+        break;
+      default:
+        return false;
+    }
+    uint64_t remaining = section_count_ - section_index_;
+    return static_cast<uint64_t>(limit_ - pc_) >= remaining * size;
+  }
+
+  void FinishSection(WasmModule* module) {
+    if (section_ == kDeclFunctions && verify_functions_) {
+      // Set up module environment for verification.
+      ModuleEnv menv;
+      menv.module = module;
+      menv.globals_area = 0;
+      menv.mem_start = 0;
+      menv.mem_end = 0;
+      menv.function_code = nullptr;
+      menv.asm_js = asm_js_;
+      uint32_t functions_count = static_cast<uint32_t>(section_count_);
+      // Functions before the first one that failed in parallel are valid.
+      uint32_t first = VerifyInParallel(&menv, functions_count);
+      for (uint32_t i = first; i < functions_count; i++) {
+        if (failed()) break;
+        WasmFunction* function = &module->functions->at(i);
+        if (!function->external) {
+          VerifyFunctionBody(i, &menv, function);
+          if (result_.failed())
+            error(result_.error_pc, result_.error_msg.get());
         }
-        default:
-          error(pc_ - 1, nullptr, "unrecognized section 0x%02x", section);
-          break;
       }
     }
+    if (ok() && client_) client_->OnSection(module, section_);
+  }
 
-    return toResult(module);
+  // Verifies the bodies of the first {count} functions of the module on the
+  // platform's background threads, with this thread helping out. Returns
+  // the index of the first function that failed, or {count} if all of them
+  // verified. Returns 0, leaving all the functions to the caller, if there
+  // are no background threads or if verification is traced.
+  uint32_t VerifyInParallel(ModuleEnv* menv, uint32_t count) {
+    if (count < 2) return 0;
+    if (FLAG_trace_wasm_decoder || FLAG_trace_wasm_decode_time) return 0;
+    v8::Platform* platform = V8::GetCurrentPlatform();
+    size_t num_tasks = platform->NumberOfAvailableBackgroundThreads();
+    if (num_tasks == 0) return 0;
+
+    VerificationQueue queue(menv, start_, count);
+    base::Semaphore done(0);
+    size_t task_count = std::min(num_tasks, static_cast<size_t>(count));
+    for (size_t i = 0; i < task_count; i++) {
+      platform->CallOnBackgroundThread(new VerificationTask(&queue, &done),
+                                       v8::Platform::kShortRunningTask);
+    }
+    while (queue.VerifyNext()) {
+    }
+    for (size_t i = 0; i < task_count; i++) done.Wait();
+    return queue.first_failure();
   }
 
-  uint32_t SafeReserve(uint32_t count) {
-    // Avoid OOM by only reserving up to a certain size.
+  // Returns how many of the {count} entries of a section, each at least
+  // {min_size} bytes long, to reserve space for. Reserving exactly as many
+  // entries as there are avoids growing the tables in the zone, which does
+  // not reclaim the space of the old backing stores. To avoid OOM on bogus
+  // counts, only up to a certain number of entries are reserved unless the
+  // bytes of all of them could be present.
+  uint32_t SafeReserve(uint32_t count, size_t min_size) {
+    if (static_cast<uint64_t>(limit_ - pc_) >=
+        static_cast<uint64_t>(count) * min_size) {
+      return count;
+    }
     const uint32_t kMaxReserve = 20000;
     return count < kMaxReserve ? count : kMaxReserve;
   }
 
+  // Allocates a table of the module in the zone of the module.
+  template <typename T>
+  ZoneVector<T>* NewVector() {
+    return new (module_zone->New(sizeof(ZoneVector<T>)))
+        ZoneVector<T>(module_zone);
+  }
+
   void CheckForPreviousSection(bool* sections, WasmSectionDeclCode section,
                                bool present) {
     if (section >= kMaxModuleSectionCode) return;
@@ -235,6 +590,7 @@ class ModuleDecoder : public Decoder {
                                       WasmFunction* function) {
     pc_ = start_;
     function->sig = sig();                       // read signature
+    function->sig_index = 0;                     // ---- signature index
     function->name_offset = 0;                   // ---- name
     function->code_start_offset = off(pc_ + 8);  // ---- code start
     function->code_end_offset = off(limit_);     // ---- code end
@@ -242,6 +598,7 @@ class ModuleDecoder : public Decoder {
     function->local_int64_count = u16();         // read u16
     function->local_float32_count = u16();       // read u16
     function->local_float64_count = u16();       // read u16
+    function->local_simd128_count = 0;           // ---- simd128 count
     function->exported = false;                  // ---- exported
     function->external = false;                  // ---- external
 
@@ -264,24 +621,76 @@ class ModuleDecoder : public Decoder {
   Zone* module_zone;
   ModuleResult result_;
   bool asm_js_;
+  StreamingDecoder::Client* client_;
+  bool sections_[kMaxModuleSectionCode];
+  WasmSectionDeclCode section_;  // the section being decoded.
+  uint32_t section_count_;       // number of entries in the section.
+  uint32_t section_index_;       // index of the next entry in the section.
+  bool end_reached_;             // true once the end section was decoded.
+  bool verify_functions_;
+  bool deferred_offsets_;  // true if offsets are checked by {CheckOffsets}.
+  bool unchecked_;  // true if the bytes of the current entry are available.
+  // The canonical index of each distinct signature decoded so far.
+  std::unordered_map<FunctionSig*, uint16_t, SignatureHash, SignatureEqual>
+      canonical_sigs_;
+
+  // Returns the canonical index of the signature {sig} decoded at {index}:
+  // the index of the first signature equal to it.
+  uint16_t CanonicalSigIndex(FunctionSig* sig, uint32_t index) {
+    auto entry = canonical_sigs_.insert(
+        std::make_pair(sig, static_cast<uint16_t>(index)));
+    return entry.first->second;
+  }
+
+  bool Available(const byte* p, size_t size) {
+    return static_cast<size_t>(limit_ - p) >= size;
+  }
+
+  // Checks whether a function entry, including its body, is complete.
+  bool FunctionEntryAvailable(const byte* p) {
+    size_t size = 3;  // declaration bits and signature index.
+    if (!Available(p, size)) return false;
+    byte decl_bits = p[0];
+    if (decl_bits & kDeclFunctionName) size += 4;
+    if (decl_bits & kDeclFunctionImport) return Available(p, size);
+    if (decl_bits & kDeclFunctionLocals) size += 8;
+    if (decl_bits & kDeclFunctionSimdLocals) size += 2;
+    if (!Available(p, size + 2)) return false;
+    size_t body_size = p[size] | (p[size + 1] << 8);
+    return Available(p, size + 2 + body_size);
+  }
 
   uint32_t off(const byte* ptr) { return static_cast<uint32_t>(ptr - start_); }
 
+  // Reads a field of an entry, without checks if the bytes of the whole
+  // entry are known to be available.
+  uint8_t field_u8(const char* name) {
+    return unchecked_ ? unchecked_u8() : u8(name);
+  }
+
+  uint16_t field_u16(const char* name) {
+    return unchecked_ ? unchecked_u16() : u16(name);
+  }
+
+  uint32_t field_u32(const char* name) {
+    return unchecked_ ? unchecked_u32() : u32(name);
+  }
+
   // Decodes a single global entry inside a module starting at {pc_}.
   void DecodeGlobalInModule(WasmGlobal* global) {
     global->name_offset = string("global name");
     global->type = mem_type();
     global->offset = 0;
-    global->exported = u8("exported") != 0;
+    global->exported = field_u8("exported") != 0;
   }
 
   // Decodes a single function entry inside a module starting at {pc_}.
   void DecodeFunctionInModule(WasmModule* module, WasmFunction* function,
                               bool verify_body = true) {
-    byte decl_bits = u8("function decl");
+    byte decl_bits = field_u8("function decl");
 
     const byte* sigpos = pc_;
-    function->sig_index = u16("signature index");
+    function->sig_index = field_u16("signature index");
 
     if (function->sig_index >= module->signatures->size()) {
       return error(sigpos, "invalid signature index");
@@ -289,11 +698,12 @@ class ModuleDecoder : public Decoder {
       function->sig = module->signatures->at(function->sig_index);
     }
 
-    TRACE("  +%d  <function attributes:%s%s%s%s%s>\n",
+    TRACE("  +%d  <function attributes:%s%s%s%s%s%s>\n",
           static_cast<int>(pc_ - start_),
           decl_bits & kDeclFunctionName ? " name" : "",
           decl_bits & kDeclFunctionImport ? " imported" : "",
           decl_bits & kDeclFunctionLocals ? " locals" : "",
+          decl_bits & kDeclFunctionSimdLocals ? " simd locals" : "",
           decl_bits & kDeclFunctionExport ? " exported" : "",
           (decl_bits & kDeclFunctionImport) == 0 ? " body" : "");
 
@@ -301,7 +711,7 @@ class ModuleDecoder : public Decoder {
       function->name_offset = string("function name");
     }
 
-    function->exported = decl_bits & kDeclFunctionExport;
+    function->exported = (decl_bits & kDeclFunctionExport) != 0;
 
     // Imported functions have no locals or body.
     if (decl_bits & kDeclFunctionImport) {
@@ -310,13 +720,16 @@ class ModuleDecoder : public Decoder {
     }
 
     if (decl_bits & kDeclFunctionLocals) {
-      function->local_int32_count = u16("int32 count");
-      function->local_int64_count = u16("int64 count");
-      function->local_float32_count = u16("float32 count");
-      function->local_float64_count = u16("float64 count");
+      function->local_int32_count = field_u16("int32 count");
+      function->local_int64_count = field_u16("int64 count");
+      function->local_float32_count = field_u16("float32 count");
+      function->local_float64_count = field_u16("float64 count");
+    }
+    if (decl_bits & kDeclFunctionSimdLocals) {
+      function->local_simd128_count = field_u16("simd128 count");
     }
 
-    uint16_t size = u16("body size");
+    uint16_t size = field_u16("body size");
     if (ok()) {
       if ((pc_ + size) > limit_) {
         return error(pc_, limit_,
@@ -333,11 +746,11 @@ class ModuleDecoder : public Decoder {
   // Decodes a single data segment entry inside a module starting at {pc_}.
   void DecodeDataSegmentInModule(WasmDataSegment* segment) {
     segment->dest_addr =
-        u32("destination");  // TODO: check it's within the memory size.
+        field_u32("destination");  // TODO: check it's within the memory size.
     segment->source_offset = offset("source offset");
     segment->source_size =
-        u32("source size");  // TODO: check the size is reasonable.
-    segment->init = u8("init");
+        field_u32("source size");  // TODO: check the size is reasonable.
+    segment->init = field_u8("init");
   }
 
   // Verifies the body (code) of a given function.
@@ -353,13 +766,7 @@ class ModuleDecoder : public Decoder {
       os << std::endl;
     }
     FunctionEnv fenv;
-    fenv.module = menv;
-    fenv.sig = function->sig;
-    fenv.local_int32_count = function->local_int32_count;
-    fenv.local_int64_count = function->local_int64_count;
-    fenv.local_float32_count = function->local_float32_count;
-    fenv.local_float64_count = function->local_float64_count;
-    fenv.SumLocals();
+    InitFunctionEnv(&fenv, menv, function);
 
     TreeResult result =
         VerifyWasmCode(&fenv, start_, start_ + function->code_start_offset,
@@ -385,8 +792,8 @@ class ModuleDecoder : public Decoder {
   // Reads a single 32-bit unsigned integer interpreted as an offset, checking
   // the offset is within bounds and advances.
   uint32_t offset(const char* name = nullptr) {
-    uint32_t offset = u32(name ? name : "offset");
-    if (offset > (limit_ - start_)) {
+    uint32_t offset = field_u32(name ? name : "offset");
+    if (!deferred_offsets_ && offset > (limit_ - start_)) {
       error(pc_ - sizeof(uint32_t), "offset out of bounds of module");
     }
     return offset;
@@ -421,7 +828,7 @@ class ModuleDecoder : public Decoder {
 
   // Reads a single 8-bit integer, interpreting it as a memory type.
   MachineType mem_type() {
-    byte val = u8("memory type");
+    byte val = field_u8("memory type");
     MemTypeCode t = static_cast<MemTypeCode>(val);
     switch (t) {
       case kMemI8:
@@ -503,6 +910,114 @@ ModuleResult DecodeWasmModule(Isolate* isolate, Zone* zone,
   return decoder.DecodeModule(module, verify_functions);
 }
 
+namespace {
+// The reservation for the bytes of a module of unknown size, which grows by
+// doubling as they arrive.
+const size_t kInitialStreamingReservation = 64 * KB;
+}  // namespace
+
+StreamingDecoder::StreamingDecoder(Isolate* isolate, Zone* zone,
+                                   Client* client, bool verify_functions,
+                                   bool asm_js, size_t expected_size)
+    : start_(nullptr),
+      size_(0),
+      limit_(expected_size > 0 ? expected_size : kMaxModuleSize - 1),
+      reserved_(0),
+      committed_(0),
+      growable_(expected_size == 0),
+      module_(new WasmModule()),
+      decoder_(nullptr),
+      finished_(false) {
+  if (limit_ < kMaxModuleSize) {
+    reserved_ = RoundUp(growable_ ? kInitialStreamingReservation : limit_,
+                        base::OS::AllocateAlignment());
+    start_ =
+        reinterpret_cast<byte*>(base::VirtualMemory::ReserveRegion(reserved_));
+    if (start_ == nullptr) reserved_ = 0;
+  }
+  decoder_ = new ModuleDecoder(zone, start_, start_, asm_js);
+  decoder_->StartModule(module_, verify_functions);
+  decoder_->set_client(client);
+  decoder_->set_deferred_offsets(true);
+  if (limit_ >= kMaxModuleSize) {
+    decoder_->error("size > maximum module size");
+  } else if (start_ == nullptr) {
+    decoder_->error("out of memory for the module bytes");
+  }
+}
+
+StreamingDecoder::~StreamingDecoder() {
+  delete decoder_;
+  delete module_;
+  if (start_ != nullptr) {
+    base::VirtualMemory::ReleaseRegion(start_, reserved_);
+  }
+}
+
+bool StreamingDecoder::AddBytes(const byte* bytes, size_t size) {
+  DCHECK(!finished_);
+  if (decoder_->failed()) return false;
+  if (size > limit_ - size_) {
+    decoder_->error(limit_ < kMaxModuleSize - 1
+                        ? "size > expected module size"
+                        : "size > maximum module size");
+    return false;
+  }
+  size_t committed = RoundUp(size_ + size, base::OS::CommitPageSize());
+  if (committed > reserved_ && !Grow(committed)) {
+    decoder_->error("out of memory for the module bytes");
+    return false;
+  }
+  if (committed > committed_) {
+    if (!base::VirtualMemory::CommitRegion(start_ + committed_,
+                                           committed - committed_, false)) {
+      decoder_->error("out of memory for the module bytes");
+      return false;
+    }
+    committed_ = committed;
+  }
+  memcpy(start_ + size_, bytes, size);
+  size_ += size;
+  decoder_->Extend(module_, start_ + size_);
+  while (decoder_->NextUnitAvailable()) decoder_->DecodeUnit(module_);
+  return decoder_->ok();
+}
+
+bool StreamingDecoder::Grow(size_t committed) {
+  DCHECK(growable_);
+  size_t reserved = RoundUp(
+      std::max(std::min(2 * reserved_, kMaxModuleSize), committed),
+      base::OS::AllocateAlignment());
+  byte* start =
+      reinterpret_cast<byte*>(base::VirtualMemory::ReserveRegion(reserved));
+  if (start == nullptr) return false;
+  if (!base::VirtualMemory::CommitRegion(start, committed, false)) {
+    base::VirtualMemory::ReleaseRegion(start, reserved);
+    return false;
+  }
+  memcpy(start, start_, size_);
+  base::VirtualMemory::ReleaseRegion(start_, reserved_);
+  decoder_->Rebase(module_, start);
+  start_ = start;
+  reserved_ = reserved;
+  committed_ = committed;
+  return true;
+}
+
+ModuleResult StreamingDecoder::Finish() {
+  DCHECK(!finished_);
+  finished_ = true;
+  if (decoder_->ok()) {
+    // Decode what is left as usual, which reports incomplete units.
+    decoder_->DecodeRemainingUnits(module_);
+  }
+  if (decoder_->ok()) decoder_->CheckOffsets(module_);
+  ModuleResult result = decoder_->toResult(module_);
+  // Ownership of the module passes to the caller upon success.
+  if (result.ok()) module_ = nullptr;
+  return result;
+}
+
 FunctionSig* DecodeWasmSignatureForTesting(Zone* zone, const byte* start,
                                            const byte* end) {
   ModuleDecoder decoder(zone, start, end, false);
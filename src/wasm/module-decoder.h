@@ -12,10 +12,73 @@ namespace v8 {
 namespace internal {
 namespace wasm {
 // Decodes the bytes of a WASM module between {module_start} and {module_end}.
+// The tables of the module are allocated in {zone}, which must outlive it.
 ModuleResult DecodeWasmModule(Isolate* isolate, Zone* zone,
                               const byte* module_start, const byte* module_end,
                               bool verify_functions, bool asm_js);
 
+class ModuleDecoder;
+
+// Decodes a module whose bytes arrive in chunks, for example over the
+// network. Each section header and section entry is decoded as soon as its
+// bytes are complete, and the client is notified of every function body as
+// soon as it has arrived, so that work on the module can overlap with the
+// transfer of the rest of it. The bytes are stored in a reservation of
+// address space that is committed as they arrive, so that they never move.
+class StreamingDecoder {
+ public:
+  class Client {
+   public:
+    virtual ~Client() {}
+
+    // Called when the entry of function {index}, including its body, has
+    // been decoded. Offsets are relative to {module->module_start}, which
+    // stays valid as long as the decoder if the size of the module was
+    // given, and until the next bytes are added otherwise.
+    virtual void OnFunctionBody(WasmModule* module, uint32_t index) = 0;
+
+    // Called when {section} has been decoded completely. Function bodies are
+    // verified, if requested, when the functions section is complete.
+    virtual void OnSection(WasmModule* module, WasmSectionDeclCode section) = 0;
+  };
+
+  // {expected_size}, if not 0, is the size of the whole module, for example
+  // from the Content-Length of a response, so that exactly that much address
+  // space is reserved and the bytes never move. Otherwise the reservation
+  // starts small and doubles whenever the bytes outgrow it, moving the bytes
+  // that arrived before.
+  StreamingDecoder(Isolate* isolate, Zone* zone, Client* client,
+                   bool verify_functions, bool asm_js,
+                   size_t expected_size = 0);
+  ~StreamingDecoder();
+
+  // Appends the next chunk of module bytes and decodes as much of the module
+  // as possible. Returns {false} once decoding failed, or if the bytes exceed
+  // the expected size; the error is reported by {Finish}.
+  bool AddBytes(const byte* bytes, size_t size);
+
+  // Decodes the rest of the module after the last chunk has arrived. The
+  // result is the same as that of {DecodeWasmModule} for all the bytes. The
+  // module refers to the bytes owned by this decoder, so it must not outlive
+  // the decoder.
+  ModuleResult Finish();
+
+ private:
+  // Moves the bytes to a larger reservation with at least {committed} bytes
+  // committed. Returns {false} if it cannot be reserved.
+  bool Grow(size_t committed);
+
+  byte* start_;       // the reservation holding the bytes.
+  size_t size_;       // the bytes that have arrived.
+  size_t limit_;      // the bytes that may arrive.
+  size_t reserved_;   // the size of the reservation.
+  size_t committed_;  // the committed bytes of the reservation.
+  bool growable_;     // true if the size of the module is unknown.
+  WasmModule* module_;
+  ModuleDecoder* decoder_;
+  bool finished_;
+};
+
 // Exposed for testing. Decodes a single function signature, allocating it
 // in the given zone. Returns {nullptr} upon failure.
 FunctionSig* DecodeWasmSignatureForTesting(Zone* zone, const byte* start,
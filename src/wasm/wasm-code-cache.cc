@@ -0,0 +1,230 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/base/platform/elapsed-timer.h"
+#include "src/base/smart-pointers.h"
+#include "src/factory.h"
+#include "src/flags.h"
+#include "src/global-handles.h"
+#include "src/isolate.h"
+#include "src/zone.h"
+
+#include "src/wasm/module-decoder.h"
+#include "src/wasm/wasm-code-cache.h"
+#include "src/wasm/wasm-module-bytes.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+namespace {
+// Layout of the object holding a cache.
+const int kCacheForeign = 0;    // the {WasmCodeCache}.
+const int kCacheTemplates = 1;  // the template instances, by entry slot.
+const int kCacheFieldCount = 2;
+
+const int kInitialTemplateSlots = 4;
+}  // namespace
+
+// A cached module. The entry owns the zone of the decoded module, which in
+// turn owns a reference to the shared module bytes. The template instance
+// lives in the {slot} of the templates of the holder, so that only the
+// context of the cache keeps the code alive.
+struct WasmCodeCache::Entry {
+  uint32_t flag_hash;  // hash of the flags the module was compiled with.
+  BoundsCheckMode bounds_checks;  // the mode the module was compiled with.
+  Zone zone;
+  WasmModule* module;
+  int slot;
+  size_t size;
+
+  Entry()
+      : flag_hash(0),
+        bounds_checks(kExplicitBoundsChecks),
+        module(nullptr),
+        slot(-1),
+        size(0) {}
+  ~Entry() { delete module; }
+};
+
+Handle<JSObject> WasmCodeCache::New(Isolate* isolate) {
+  Factory* factory = isolate->factory();
+  Handle<Map> map = factory->NewMap(
+      JS_OBJECT_TYPE, JSObject::kHeaderSize + kCacheFieldCount * kPointerSize);
+  Handle<JSObject> holder = factory->NewJSObjectFromMap(map, TENURED);
+  holder->SetInternalField(
+      kCacheTemplates,
+      *factory->NewFixedArray(kInitialTemplateSlots, TENURED));
+  WasmCodeCache* cache = new WasmCodeCache(isolate, holder);
+  holder->SetInternalField(
+      kCacheForeign,
+      *factory->NewForeign(reinterpret_cast<Address>(cache), TENURED));
+  return holder;
+}
+
+WasmCodeCache* WasmCodeCache::Get(Handle<JSObject> holder) {
+  return reinterpret_cast<WasmCodeCache*>(
+      Foreign::cast(holder->GetInternalField(kCacheForeign))
+          ->foreign_address());
+}
+
+WasmCodeCache::WasmCodeCache(Isolate* isolate, Handle<JSObject> holder)
+    : isolate_(isolate),
+      budget_(kDefaultBudget),
+      size_(0),
+      hits_(0),
+      misses_(0),
+      evictions_(0) {
+  holder_ = isolate->global_handles()->Create(*holder).location();
+  GlobalHandles::MakeWeak(holder_, this, &WasmCodeCache::WeakCallback,
+                          v8::WeakCallbackType::kParameter);
+}
+
+WasmCodeCache::~WasmCodeCache() {
+  for (Entry* entry : entries_) delete entry;
+}
+
+void WasmCodeCache::WeakCallback(const v8::WeakCallbackInfo<void>& data) {
+  WasmCodeCache* cache = reinterpret_cast<WasmCodeCache*>(data.GetParameter());
+  GlobalHandles::Destroy(cache->holder_);
+  delete cache;
+}
+
+FixedArray* WasmCodeCache::templates() {
+  return FixedArray::cast(
+      JSObject::cast(*holder_)->GetInternalField(kCacheTemplates));
+}
+
+MaybeHandle<JSObject> WasmCodeCache::Instantiate(
+    ErrorThrower& thrower, const byte* module_start, const byte* module_end,
+    Handle<JSObject> ffi, Handle<JSArrayBuffer> memory,
+    BoundsCheckMode bounds_checks, WasmCompilationStats* stats) {
+  ModuleBytes* bytes = ModuleBytes::Get(module_start, module_end);
+  MaybeHandle<JSObject> object =
+      Instantiate(thrower, bytes, ffi, memory, bounds_checks, stats);
+  bytes->Release();
+  return object;
+}
+
+MaybeHandle<JSObject> WasmCodeCache::Instantiate(
+    ErrorThrower& thrower, ModuleBytes* bytes, Handle<JSObject> ffi,
+    Handle<JSArrayBuffer> memory, BoundsCheckMode bounds_checks,
+    WasmCompilationStats* stats) {
+  // Changing the flags that affect code generation must not hit stale code.
+  uint32_t flag_hash = FlagList::Hash();
+  Entry* entry = Lookup(flag_hash, bounds_checks, bytes);
+  if (entry != nullptr) {
+    hits_++;
+    if (stats) stats->cached = true;
+    Handle<JSObject> templ(JSObject::cast(templates()->get(entry->slot)),
+                           isolate_);
+    return entry->module->Reinstantiate(isolate_, templ, ffi, memory);
+  }
+  misses_++;
+
+  // Decode but avoid a redundant pass over function bodies for verification.
+  // Verification will happen during compilation.
+  base::SmartPointer<Entry> fresh(new Entry());
+  fresh->flag_hash = flag_hash;
+  fresh->bounds_checks = bounds_checks;
+  base::ElapsedTimer decode_timer;
+  if (stats) decode_timer.Start();
+  ModuleResult result = DecodeWasmModule(isolate_, &fresh->zone, bytes->start(),
+                                         bytes->end(), false, false);
+  if (stats) stats->decode_time = decode_timer.Elapsed().InMillisecondsF();
+  if (result.failed()) {
+    thrower.Failed("", result);
+    if (result.val) delete result.val;
+    return MaybeHandle<JSObject>();
+  }
+  // The module keeps pointers into the bytes for as long as it is cached.
+  fresh->module = result.val;
+  fresh->module->bytes = bytes;
+  bytes->AddRef();
+
+  MaybeHandle<JSObject> object = fresh->module->Instantiate(
+      isolate_, ffi, memory, kEagerCompilation, bounds_checks, stats);
+  Handle<JSObject> instance;
+  if (!object.ToHandle(&instance)) return object;
+
+  fresh->size = bytes->length() + WasmModule::CodeSize(instance);
+
+  // Modules that would not fit even into an empty cache are not cached.
+  if (fresh->size <= budget_) {
+    Insert(fresh.Detach(), WasmModule::CreateTemplate(isolate_, instance));
+  }
+  return instance;
+}
+
+WasmCodeCache::Entry* WasmCodeCache::Lookup(uint32_t flag_hash,
+                                            BoundsCheckMode bounds_checks,
+                                            ModuleBytes* bytes) {
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    Entry* entry = *it;
+    // Identical bytes are always shared, so comparing the copies suffices.
+    if (entry->module->bytes != bytes) continue;
+    if (entry->flag_hash != flag_hash) continue;
+    if (entry->bounds_checks != bounds_checks) continue;
+    // Move the entry to the front of the LRU list.
+    entries_.erase(it);
+    entries_.push_front(entry);
+    return entry;
+  }
+  return nullptr;
+}
+
+void WasmCodeCache::Insert(Entry* entry, Handle<JSObject> templ) {
+  Handle<FixedArray> old_templates(templates(), isolate_);
+  int length = old_templates->length();
+  int slot = 0;
+  while (slot < length && old_templates->get(slot)->IsJSObject()) slot++;
+  if (slot == length) {
+    // All slots are taken, so double the templates.
+    Handle<FixedArray> new_templates =
+        isolate_->factory()->NewFixedArray(2 * length, TENURED);
+    for (int i = 0; i < length; i++) {
+      new_templates->set(i, old_templates->get(i));
+    }
+    JSObject::cast(*holder_)->SetInternalField(kCacheTemplates,
+                                               *new_templates);
+  }
+  templates()->set(slot, *templ);
+  entry->slot = slot;
+  entries_.push_front(entry);
+  size_ += entry->size;
+  Evict();
+}
+
+void WasmCodeCache::Evict() {
+  while (size_ > budget_ && !entries_.empty()) {
+    Entry* entry = entries_.back();
+    entries_.pop_back();
+    evictions_++;
+    Remove(entry);
+  }
+}
+
+void WasmCodeCache::Remove(Entry* entry) {
+  // Let the template and the code die unless instances still use it.
+  templates()->set_undefined(entry->slot);
+  size_ -= entry->size;
+  delete entry;
+}
+
+void WasmCodeCache::SetBudget(size_t budget) {
+  budget_ = budget;
+  Evict();
+}
+
+void WasmCodeCache::Clear() {
+  for (Entry* entry : entries_) Remove(entry);
+  entries_.clear();
+}
+
+WasmCodeCache::Stats WasmCodeCache::GetStats() const {
+  return {hits_, misses_, evictions_, entries_.size(), size_, budget_};
+}
+}
+}
+}
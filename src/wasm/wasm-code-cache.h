@@ -0,0 +1,104 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8_WASM_CODE_CACHE_H_
+#define V8_WASM_CODE_CACHE_H_
+
+#include <list>
+
+#include "src/handles.h"
+
+#include "src/wasm/wasm-module.h"
+#include "src/wasm/wasm-result.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+class ModuleBytes;
+
+// A per-context cache of compiled modules, keyed by the shared copy of the
+// module bytes and by a hash of the flags they were compiled with. On a hit,
+// decoding and compilation are skipped entirely and the new instance shares
+// the cached code through {WasmModule::Reinstantiate}. Entries are evicted in
+// least recently used order once they exceed the memory budget.
+// The cached code refers to the native context it was compiled in, so each
+// cache belongs to a context: it is held by an object that only the context
+// refers to, and is deleted with its entries once that object dies.
+class WasmCodeCache {
+ public:
+  static const size_t kDefaultBudget = 64 * 1024 * 1024;
+
+  struct Stats {
+    size_t hits;       // instantiations that reused cached code.
+    size_t misses;     // instantiations that compiled the module.
+    size_t evictions;  // entries evicted to stay within the budget.
+    size_t entries;    // number of cached modules.
+    size_t size;       // bytes of module bytes and code held by the cache.
+    size_t budget;     // maximum number of bytes held by the cache.
+  };
+
+  // Creates a cache for the current native context of {isolate} and returns
+  // the object holding it, which the context must keep alive.
+  static Handle<JSObject> New(Isolate* isolate);
+
+  // Gets the cache held by {holder}.
+  static WasmCodeCache* Get(Handle<JSObject> holder);
+
+  // Instantiates the module between {module_start} and {module_end}, reusing
+  // the code of an earlier instantiation of the same bytes if it is cached.
+  // Code compiled with other {bounds_checks} is not reused.
+  // Records the statistics of the instantiation in {stats}, if given; on a
+  // hit, they only say that the code was cached.
+  MaybeHandle<JSObject> Instantiate(
+      ErrorThrower& thrower, const byte* module_start, const byte* module_end,
+      Handle<JSObject> ffi, Handle<JSArrayBuffer> memory,
+      BoundsCheckMode bounds_checks = kExplicitBoundsChecks,
+      WasmCompilationStats* stats = nullptr);
+
+  // Instantiates the module with the shared {bytes}, which the cache keeps
+  // alive for as long as it holds the compiled module.
+  MaybeHandle<JSObject> Instantiate(
+      ErrorThrower& thrower, ModuleBytes* bytes, Handle<JSObject> ffi,
+      Handle<JSArrayBuffer> memory,
+      BoundsCheckMode bounds_checks = kExplicitBoundsChecks,
+      WasmCompilationStats* stats = nullptr);
+
+  // Sets the memory budget, evicting entries if necessary.
+  void SetBudget(size_t budget);
+
+  // Evicts all entries.
+  void Clear();
+
+  Stats GetStats() const;
+
+ private:
+  struct Entry;
+
+  WasmCodeCache(Isolate* isolate, Handle<JSObject> holder);
+  ~WasmCodeCache();
+
+  static void WeakCallback(const v8::WeakCallbackInfo<void>& data);
+
+  Entry* Lookup(uint32_t flag_hash, BoundsCheckMode bounds_checks,
+               ModuleBytes* bytes);
+  void Insert(Entry* entry, Handle<JSObject> templ);
+  void Evict();
+  void Remove(Entry* entry);
+  FixedArray* templates();
+
+  Isolate* isolate_;
+  Object** holder_;  // weak global handle to the object holding the cache.
+  std::list<Entry*> entries_;  // most recently used first.
+  size_t budget_;
+  size_t size_;
+  size_t hits_;
+  size_t misses_;
+  size_t evictions_;
+};
+}
+}
+}
+
+#endif  // V8_WASM_CODE_CACHE_H_
@@ -3,6 +3,8 @@
 // found in the LICENSE file.
 
 
+#include "src/base/platform/elapsed-timer.h"
+
 #include "src/compiler/access-builder.h"
 #include "src/compiler/change-lowering.h"
 #include "src/compiler/common-operator.h"
@@ -26,9 +28,13 @@
 
 #include "src/code-stubs.h"
 #include "src/code-factory.h"
+#include "src/log.h"
+#include "src/profiler/cpu-profiler.h"
 
 #include "src/wasm/ast-decoder.h"
 #include "src/wasm/wasm-compiler.h"
+#include "src/wasm/wasm-memory.h"
+#include "src/wasm/wasm-module-bytes.h"
 #include "src/wasm/wasm-module.h"
 #include "src/wasm/wasm-opcodes.h"
 
@@ -54,24 +60,17 @@ void MergeControlToEnd(JSGraph* graph, Node* node) {
 }
 
 
-enum TrapReason {
-  kTrapUnreachable,
-  kTrapMemOutOfBounds,
-  kTrapDivByZero,
-  kTrapDivUnrepresentable,
-  kTrapRemByZero,
-  kTrapFloatUnrepresentable,
-  kTrapFuncInvalid,
-  kTrapFuncSigMismatch,
-  kTrapCount
-};
-
-
-static const char* kTrapMessages[] = {
-    "unreachable",       "memory access out of bounds",
-    "divide by zero",    "divide result unrepresentable",
-    "remainder by zero", "integer result unrepresentable",
-    "invalid function",  "function signature mismatch"};
+using wasm::TrapReason;
+using wasm::kTrapUnreachable;
+using wasm::kTrapMemOutOfBounds;
+using wasm::kTrapDivByZero;
+using wasm::kTrapDivUnrepresentable;
+using wasm::kTrapRemByZero;
+using wasm::kTrapFuncInvalid;
+using wasm::kTrapFuncSigMismatch;
+using wasm::kTrapUnalignedAtomic;
+using wasm::kTrapAtomicWait;
+using wasm::kTrapCount;
 }  // namespace
 
 
@@ -83,7 +82,19 @@ class WasmTrapHelper : public ZoneObject {
  public:
   explicit WasmTrapHelper(WasmGraphBuilder* b)
       : builder(b), graph(b->graph), g(b->graph ? b->graph->graph() : nullptr) {
-    for (int i = 0; i < kTrapCount; i++) traps[i] = nullptr;
+    for (int i = 0; i < kTrapCount; i++) {
+      traps[i] = nullptr;
+      exceptions[i] = nullptr;
+    }
+  }
+
+  // Create the exception strings and the runtime call target for all traps
+  // up front, so that trap code can be built without allocating.
+  void PrepareHeapConstants() {
+    for (int i = 0; i < kTrapCount; i++) {
+      Exception(static_cast<TrapReason>(i));
+    }
+    graph->CEntryStubConstant(1);
   }
 
   // Make the current control path trap to unreachable.
@@ -148,6 +159,15 @@ class WasmTrapHelper : public ZoneObject {
   Graph* g;
   Node* traps[kTrapCount];
   Node* effects[kTrapCount];
+  Node* exceptions[kTrapCount];
+
+  Node* Exception(TrapReason reason) {
+    if (exceptions[reason] == nullptr) {
+      exceptions[reason] =
+          builder->String(wasm::WasmOpcodes::TrapReasonMessage(reason));
+    }
+    return exceptions[reason];
+  }
 
   void ConnectTrap(TrapReason reason) {
     if (traps[reason] == nullptr) {
@@ -160,7 +180,7 @@ class WasmTrapHelper : public ZoneObject {
   }
 
   void BuildTrapCode(TrapReason reason) {
-    Node* exception = builder->String(kTrapMessages[reason]);
+    Node* exception = Exception(reason);
     Node* end;
     Node** control = builder->control;
     Node** effect = builder->effect;
@@ -176,12 +196,19 @@ class WasmTrapHelper : public ZoneObject {
       CallDescriptor* desc = Linkage::GetRuntimeCallDescriptor(
           graph->zone(), f, fun->nargs, Operator::kNoProperties,
           CallDescriptor::kNoFlags);
+      Node* ref;
+      if (module->instance_data.is_null()) {
+        ref = graph->ExternalConstant(ExternalReference(f, graph->isolate()));
+      } else {
+        // Instance-independent code loads the runtime entry at run time.
+        ref = builder->LoadInstanceField(
+            MachineType::Pointer(), wasm::ModuleEnv::kInstanceThrowEntryOffset);
+      }
       Node* inputs[] = {graph->CEntryStubConstant(fun->result_size),  // C entry
-                        exception,  // exception
-                        graph->ExternalConstant(
-                            ExternalReference(f, graph->isolate())),  // ref
-                        graph->Int32Constant(fun->nargs),             // arity
-                        graph->Constant(module->context),             // context
+                        exception,                         // exception
+                        ref,                               // ref
+                        graph->Int32Constant(fun->nargs),  // arity
+                        graph->Constant(module->context),  // context
                         *effect,
                         *control};
 
@@ -214,12 +241,26 @@ WasmGraphBuilder::WasmGraphBuilder(Zone* z, JSGraph* g)
       module(nullptr),
       mem_buffer(nullptr),
       mem_size(nullptr),
+      globals_area(nullptr),
       function_table(nullptr),
       control(nullptr),
       effect(nullptr),
       cur_buffer(def_buffer),
       cur_bufsize(kDefaultBufferSize),
-      trap(new (z) WasmTrapHelper(this)) {}
+      next_bounds_check(0),
+      side_effects(0),
+      calls(0),
+      mem_size_after_call(nullptr),
+      mem_size_calls(0),
+      current_loop(nullptr),
+      loop_side_effects(0),
+      inlining(false),
+      inlined_call(nullptr),
+      inlining_depth(0),
+      inlined_bytes(0),
+      trap(new (z) WasmTrapHelper(this)) {
+  memset(bounds_checks, 0, sizeof(bounds_checks));
+}
 
 Node* WasmGraphBuilder::Error() {
   DCHECK_NOT_NULL(graph);
@@ -228,14 +269,22 @@ Node* WasmGraphBuilder::Error() {
 
 Node* WasmGraphBuilder::Start(unsigned params) {
   DCHECK_NOT_NULL(graph);
+  if (inlined_call) return inlined_call->control;
   Graph* g = graph->graph();
   Node* start = g->NewNode(graph->common()->Start(params));
   g->SetStart(start);
   return start;
 }
 
+Node* WasmGraphBuilder::StartEffect() {
+  DCHECK_NOT_NULL(graph);
+  if (inlined_call) return inlined_call->effect;
+  return graph->graph()->start();
+}
+
 Node* WasmGraphBuilder::Param(unsigned index, wasm::LocalType type) {
   DCHECK_NOT_NULL(graph);
+  if (inlined_call) return inlined_call->args[index];
   Graph* g = graph->graph();
   // TODO(titzer): use wasm::LocalType for parameters
   return g->NewNode(graph->common()->Parameter(index), g->start());
@@ -243,7 +292,9 @@ Node* WasmGraphBuilder::Param(unsigned index, wasm::LocalType type) {
 
 Node* WasmGraphBuilder::Loop(Node* entry) {
   DCHECK_NOT_NULL(graph);
-  return graph->graph()->NewNode(graph->common()->Loop(1), entry);
+  current_loop = graph->graph()->NewNode(graph->common()->Loop(1), entry);
+  loop_side_effects = side_effects;
+  return current_loop;
 }
 
 Node* WasmGraphBuilder::Terminate(Node* effect, Node* control) {
@@ -259,6 +310,13 @@ unsigned WasmGraphBuilder::InputCount(Node* node) {
 }
 
 bool WasmGraphBuilder::IsPhiWithMerge(Node* phi, Node* merge) {
+  if (IsSimdValue(phi)) {
+    // The phi of a SIMD value is a phi for each of its lanes.
+    for (int i = 0; i < wasm::kSimd128Lanes; i++) {
+      if (!IsPhiWithMerge(phi->InputAt(i), merge)) return false;
+    }
+    return true;
+  }
   return phi && IrOpcode::IsPhiOpcode(phi->opcode()) &&
          NodeProperties::GetControlInput(phi) == merge;
 }
@@ -274,6 +332,12 @@ void WasmGraphBuilder::AppendToMerge(Node* merge, Node* from) {
 
 void WasmGraphBuilder::AppendToPhi(Node* merge, Node* phi, Node* from) {
   DCHECK_NOT_NULL(graph);
+  if (IsSimdValue(phi)) {
+    for (int i = 0; i < wasm::kSimd128Lanes; i++) {
+      AppendToPhi(merge, phi->InputAt(i), from->InputAt(i));
+    }
+    return;
+  }
   DCHECK(IrOpcode::IsPhiOpcode(phi->opcode()));
   DCHECK(IrOpcode::IsMergeOpcode(merge->opcode()));
   int new_size = phi->InputCount();
@@ -291,6 +355,7 @@ Node* WasmGraphBuilder::Merge(unsigned count, Node** controls) {
 Node* WasmGraphBuilder::Phi(wasm::LocalType type, unsigned count, Node** vals,
                             Node* control) {
   DCHECK(IrOpcode::IsMergeOpcode(control->opcode()));
+  if (type == wasm::kAstS128) return SimdPhi(count, vals, control);
   Node** buf = Realloc(vals, count + 1);
   buf[count] = control;
   return graph->graph()->NewNode(graph->common()->Phi(type, count), count + 1,
@@ -332,6 +397,9 @@ Node* WasmGraphBuilder::Binop(wasm::WasmOpcode opcode, Node* left,
                               Node* right) {
   // TODO(titzer): insert manual divide-by-zero checks.
   DCHECK_NOT_NULL(graph);
+  if (wasm::WasmOpcodes::IsSimdOpcode(opcode)) {
+    return SimdBinop(opcode, left, right);
+  }
   const Operator* op;
   MachineOperatorBuilder* m = graph->machine();
   switch (opcode) {
@@ -645,6 +713,7 @@ Node* WasmGraphBuilder::Binop(wasm::WasmOpcode opcode, Node* left,
 
 Node* WasmGraphBuilder::Unop(wasm::WasmOpcode opcode, Node* input) {
   DCHECK_NOT_NULL(graph);
+  if (wasm::WasmOpcodes::IsSimdOpcode(opcode)) return SimdUnop(opcode, input);
   const Operator* op;
   MachineOperatorBuilder* m = graph->machine();
   switch (opcode) {
@@ -737,8 +806,7 @@ Node* WasmGraphBuilder::Unop(wasm::WasmOpcode opcode, Node* input) {
         op = m->Float32RoundDown().op();
         break;
       } else {
-        op = UnsupportedOpcode(opcode);
-        break;
+        return BuildFloatRound(opcode, input);
       }
     }
     case wasm::kExprF32Ceil: {
@@ -746,8 +814,7 @@ Node* WasmGraphBuilder::Unop(wasm::WasmOpcode opcode, Node* input) {
         op = m->Float32RoundUp().op();
         break;
       } else {
-        op = UnsupportedOpcode(opcode);
-        break;
+        return BuildFloatRound(opcode, input);
       }
     }
     case wasm::kExprF32Trunc: {
@@ -755,8 +822,7 @@ Node* WasmGraphBuilder::Unop(wasm::WasmOpcode opcode, Node* input) {
         op = m->Float32RoundTruncate().op();
         break;
       } else {
-        op = UnsupportedOpcode(opcode);
-        break;
+        return BuildFloatRound(opcode, input);
       }
     }
     case wasm::kExprF32NearestInt: {
@@ -764,8 +830,7 @@ Node* WasmGraphBuilder::Unop(wasm::WasmOpcode opcode, Node* input) {
         op = m->Float32RoundTiesEven().op();
         break;
       } else {
-        op = UnsupportedOpcode(opcode);
-        break;
+        return BuildFloatRound(opcode, input);
       }
     }
     case wasm::kExprF64Floor: {
@@ -773,8 +838,7 @@ Node* WasmGraphBuilder::Unop(wasm::WasmOpcode opcode, Node* input) {
         op = m->Float64RoundDown().op();
         break;
       } else {
-        op = UnsupportedOpcode(opcode);
-        break;
+        return BuildFloatRound(opcode, input);
       }
     }
     case wasm::kExprF64Ceil: {
@@ -782,8 +846,7 @@ Node* WasmGraphBuilder::Unop(wasm::WasmOpcode opcode, Node* input) {
         op = m->Float64RoundUp().op();
         break;
       } else {
-        op = UnsupportedOpcode(opcode);
-        break;
+        return BuildFloatRound(opcode, input);
       }
     }
     case wasm::kExprF64Trunc: {
@@ -791,8 +854,7 @@ Node* WasmGraphBuilder::Unop(wasm::WasmOpcode opcode, Node* input) {
         op = m->Float64RoundTruncate().op();
         break;
       } else {
-        op = UnsupportedOpcode(opcode);
-        break;
+        return BuildFloatRound(opcode, input);
       }
     }
     case wasm::kExprF64NearestInt: {
@@ -800,8 +862,7 @@ Node* WasmGraphBuilder::Unop(wasm::WasmOpcode opcode, Node* input) {
         op = m->Float64RoundTiesEven().op();
         break;
       } else {
-        op = UnsupportedOpcode(opcode);
-        break;
+        return BuildFloatRound(opcode, input);
       }
     }
 
@@ -914,6 +975,14 @@ Node* WasmGraphBuilder::Return(unsigned count, Node** vals) {
   DCHECK_NOT_NULL(*control);
   DCHECK_NOT_NULL(*effect);
 
+  if (inlined_call) {
+    // Returning from an inlined body continues after the call.
+    inlined_call->controls.push_back(*control);
+    inlined_call->effects.push_back(*effect);
+    inlined_call->values.push_back(count == 0 ? nullptr : vals[0]);
+    return nullptr;
+  }
+
   if (count == 0) {
     // Handle a return of void.
     vals[0] = graph->Int32Constant(0);
@@ -987,69 +1056,30 @@ Node* WasmGraphBuilder::BuildF64CopySign(Node* left, Node* right) {
 Node* WasmGraphBuilder::BuildI32Ctz(Node* input) {
   DCHECK_NOT_NULL(graph);
   //// Implement the following code as TF graph.
-  // value = value | (value << 1);
-  // value = value | (value << 2);
-  // value = value | (value << 4);
-  // value = value | (value << 8);
-  // value = value | (value << 16);
-  // return CountPopulation32(0xffffffff XOR value);
-
-  Node* result =
-      Binop(wasm::kExprI32Ior, input,
-            Binop(wasm::kExprI32Shl, input, graph->Int32Constant(1)));
-
-  result = Binop(wasm::kExprI32Ior, result,
-                 Binop(wasm::kExprI32Shl, result, graph->Int32Constant(2)));
-
-  result = Binop(wasm::kExprI32Ior, result,
-                 Binop(wasm::kExprI32Shl, result, graph->Int32Constant(4)));
-
-  result = Binop(wasm::kExprI32Ior, result,
-                 Binop(wasm::kExprI32Shl, result, graph->Int32Constant(8)));
-
-  result = Binop(wasm::kExprI32Ior, result,
-                 Binop(wasm::kExprI32Shl, result, graph->Int32Constant(16)));
-
-  result = BuildI32Popcnt(
-      Binop(wasm::kExprI32Xor, graph->Int32Constant(0xffffffff), result));
-
-  return result;
+  // return CountPopulation32(~value & (value - 1));
+  // The bits that are set are exactly the trailing zeros of {value}. The
+  // population count goes through {Unop}, so that it is a single instruction
+  // on machines that have one.
+  Node* result = Binop(
+      wasm::kExprI32And,
+      Binop(wasm::kExprI32Xor, input, graph->Int32Constant(0xffffffff)),
+      Binop(wasm::kExprI32Sub, input, graph->Int32Constant(1)));
+
+  return Unop(wasm::kExprI32Popcnt, result);
 }
 
 
 Node* WasmGraphBuilder::BuildI64Ctz(Node* input) {
+  DCHECK_NOT_NULL(graph);
   //// Implement the following code as TF graph.
-  // value = value | (value << 1);
-  // value = value | (value << 2);
-  // value = value | (value << 4);
-  // value = value | (value << 8);
-  // value = value | (value << 16);
-  // value = value | (value << 32);
-  // return CountPopulation64(0xffffffffffffffff XOR value);
-
-  Node* result =
-      Binop(wasm::kExprI64Ior, input,
-            Binop(wasm::kExprI64Shl, input, graph->Int64Constant(1)));
-
-  result = Binop(wasm::kExprI64Ior, result,
-                 Binop(wasm::kExprI64Shl, result, graph->Int64Constant(2)));
-
-  result = Binop(wasm::kExprI64Ior, result,
-                 Binop(wasm::kExprI64Shl, result, graph->Int64Constant(4)));
-
-  result = Binop(wasm::kExprI64Ior, result,
-                 Binop(wasm::kExprI64Shl, result, graph->Int64Constant(8)));
-
-  result = Binop(wasm::kExprI64Ior, result,
-                 Binop(wasm::kExprI64Shl, result, graph->Int64Constant(16)));
-
-  result = Binop(wasm::kExprI64Ior, result,
-                 Binop(wasm::kExprI64Shl, result, graph->Int64Constant(32)));
-
-  result = BuildI64Popcnt(Binop(
-      wasm::kExprI64Xor, graph->Int64Constant(0xffffffffffffffff), result));
-
-  return result;
+  // return CountPopulation64(~value & (value - 1));
+  Node* result = Binop(
+      wasm::kExprI64And,
+      Binop(wasm::kExprI64Xor, input,
+            graph->Int64Constant(0xffffffffffffffff)),
+      Binop(wasm::kExprI64Sub, input, graph->Int64Constant(1)));
+
+  return Unop(wasm::kExprI64Popcnt, result);
 }
 
 Node* WasmGraphBuilder::BuildI32Popcnt(Node* input) {
@@ -1158,6 +1188,56 @@ Node* WasmGraphBuilder::BuildI64Popcnt(Node* input) {
 }
 
 
+Node* WasmGraphBuilder::BuildFloatRound(wasm::WasmOpcode opcode,
+                                        Node* input) {
+  DCHECK_NOT_NULL(graph);
+  //// Implement the following code as TF graph.
+  // if (!(abs(value) < 2^52)) return value;  // integral, infinite or NaN.
+  // rounded = (abs(value) + 2^52) - 2^52;    // nearest, ties to even.
+  // trunc: rounded = rounded - (rounded > abs(value));
+  // rounded = copysign(rounded, value);
+  // floor: rounded = rounded - (rounded > value);
+  // ceil:  rounded = rounded + (rounded < value);
+  // return copysign(rounded, value);
+  // The result always has the sign of {value}, which takes care of -0. For
+  // float32, the constant is 2^23.
+  bool is_f32 = opcode == wasm::kExprF32Floor ||
+                opcode == wasm::kExprF32Ceil ||
+                opcode == wasm::kExprF32Trunc ||
+                opcode == wasm::kExprF32NearestInt;
+  wasm::WasmOpcode abs = is_f32 ? wasm::kExprF32Abs : wasm::kExprF64Abs;
+  wasm::WasmOpcode add = is_f32 ? wasm::kExprF32Add : wasm::kExprF64Add;
+  wasm::WasmOpcode sub = is_f32 ? wasm::kExprF32Sub : wasm::kExprF64Sub;
+  wasm::WasmOpcode lt = is_f32 ? wasm::kExprF32Lt : wasm::kExprF64Lt;
+  wasm::WasmOpcode gt = is_f32 ? wasm::kExprF32Gt : wasm::kExprF64Gt;
+  wasm::WasmOpcode convert =
+      is_f32 ? wasm::kExprF32SConvertI32 : wasm::kExprF64SConvertI32;
+  wasm::WasmOpcode copysign =
+      is_f32 ? wasm::kExprF32CopySign : wasm::kExprF64CopySign;
+  Node* limit = is_f32 ? graph->Float32Constant(8388608.0f)
+                       : graph->Float64Constant(4503599627370496.0);
+
+  Node* magnitude = Unop(abs, input);
+  Node* rounded = Binop(sub, Binop(add, magnitude, limit), limit);
+  if (opcode == wasm::kExprF32Trunc || opcode == wasm::kExprF64Trunc) {
+    rounded = Binop(sub, rounded, Unop(convert, Binop(gt, rounded, magnitude)));
+  }
+  rounded = Binop(copysign, rounded, input);
+  if (opcode == wasm::kExprF32Floor || opcode == wasm::kExprF64Floor) {
+    Node* correction = Unop(convert, Binop(gt, rounded, input));
+    rounded = Binop(copysign, Binop(sub, rounded, correction), input);
+  } else if (opcode == wasm::kExprF32Ceil || opcode == wasm::kExprF64Ceil) {
+    Node* correction = Unop(convert, Binop(lt, rounded, input));
+    rounded = Binop(copysign, Binop(add, rounded, correction), input);
+  }
+
+  Diamond d(graph->graph(), graph->common(), Binop(lt, magnitude, limit));
+  return d.Phi(is_f32 ? MachineRepresentation::kFloat32
+                      : MachineRepresentation::kFloat64,
+               rounded, input);
+}
+
+
 Node* WasmGraphBuilder::BuildWasmCall(wasm::FunctionSig* sig, Node** args) {
   const size_t params = sig->parameter_count();
   const size_t extra = 2;  // effect and control inputs.
@@ -1175,6 +1255,8 @@ Node* WasmGraphBuilder::BuildWasmCall(wasm::FunctionSig* sig, Node** args) {
   Node* call = graph->graph()->NewNode(op, static_cast<int>(count), args);
 
   *effect = call;
+  side_effects++;
+  calls++;
   return call;
 }
 
@@ -1182,6 +1264,9 @@ Node* WasmGraphBuilder::CallDirect(uint32_t index, Node** args) {
   DCHECK_NOT_NULL(graph);
   DCHECK_NULL(args[0]);
 
+  Node* result;
+  if (inlining && InlineCall(index, args, &result)) return result;
+
   // Add code object as constant.
   args[0] = Constant(module->GetFunctionCode(index));
   wasm::FunctionSig* sig = module->GetFunctionSignature(index);
@@ -1189,6 +1274,81 @@ Node* WasmGraphBuilder::CallDirect(uint32_t index, Node** args) {
   return BuildWasmCall(sig, args);
 }
 
+bool WasmGraphBuilder::InlineCall(uint32_t index, Node** args,
+                                  Node** result) {
+  wasm::WasmModule* wasm_module = module->module;
+  if (wasm_module == nullptr || wasm_module->module_start == nullptr) {
+    return false;  // the bodies of the functions are not available.
+  }
+  const wasm::WasmFunction& function = wasm_module->functions->at(index);
+  int size =
+      static_cast<int>(function.code_end_offset - function.code_start_offset);
+  if (size <= 0 || size > kMaxInlinedFunctionSize) return false;
+  if (inlining_depth == kMaxInliningDepth) return false;
+  if (inlined_bytes + size > kInliningBudget) return false;
+
+  wasm::FunctionEnv env;
+  env.module = module;
+  env.sig = function.sig;
+  env.local_int32_count = function.local_int32_count;
+  env.local_int64_count = function.local_int64_count;
+  env.local_float32_count = function.local_float32_count;
+  env.local_float64_count = function.local_float64_count;
+  env.local_simd128_count = function.local_simd128_count;
+  env.SumLocals();
+
+  // A body that fails to decode half-way leaves a broken graph behind, so
+  // only bodies that verify are inlined.
+  const byte* base = wasm_module->module_start;
+  const byte* start = base + function.code_start_offset;
+  const byte* end = base + function.code_end_offset;
+  if (wasm::VerifyWasmCode(&env, base, start, end).failed()) return false;
+
+  // The arguments are in the shared buffer, which decoding the body reuses.
+  size_t param_count = function.sig->parameter_count();
+  InlinedCall call(zone);
+  call.args = zone->NewArray<Node*>(static_cast<int>(param_count) + 1);
+  memcpy(call.args, args + 1, param_count * sizeof(Node*));
+  call.control = *control;
+  call.effect = *effect;
+
+  InlinedCall* outer_call = inlined_call;
+  Node** outer_control = control;
+  Node** outer_effect = effect;
+  inlined_call = &call;
+  inlining_depth++;
+  inlined_bytes += size;
+  wasm::TreeResult decoded = wasm::BuildTFGraph(this, &env, base, start, end);
+  DCHECK(decoded.ok());
+  USE(decoded);
+  inlined_call = outer_call;
+  inlining_depth--;
+  control = outer_control;
+  effect = outer_effect;
+
+  // Merge the returns of the body.
+  unsigned count = static_cast<unsigned>(call.controls.size());
+  if (count == 0) {
+    // The callee never returns, so the code after the call is unreachable.
+    *control = nullptr;
+    *effect = nullptr;
+    *result = nullptr;
+  } else if (count == 1) {
+    *control = call.controls[0];
+    *effect = call.effects[0];
+    *result = call.values[0];
+  } else {
+    Node* merge = Merge(count, &call.controls[0]);
+    *control = merge;
+    *effect = EffectPhi(count, &call.effects[0], merge);
+    *result = function.sig->return_count() == 0
+                  ? nullptr
+                  : Phi(function.sig->GetReturn(), count, &call.values[0],
+                        merge);
+  }
+  return true;
+}
+
 Node* WasmGraphBuilder::CallIndirect(uint32_t index, Node** args) {
   DCHECK_NOT_NULL(graph);
   DCHECK_NOT_NULL(args[0]);
@@ -1209,32 +1369,36 @@ Node* WasmGraphBuilder::CallIndirect(uint32_t index, Node** args) {
   }
 
   // Load signature from the table and check.
-  // The table is a FixedArray; signatures are encoded as SMIs.
-  // [sig1, sig2, sig3, ...., code1, code2, code3 ...]
+  // The table is a FixedArray; signatures are encoded as SMIs, next to the
+  // code they belong to.
+  // [sig1, code1, sig2, code2, sig3, code3, ...]
+  // Signatures are compared by their canonical index, so that a function
+  // matches any of the structurally equal signatures of the module.
   ElementAccess access = AccessBuilder::ForFixedArrayElement();
   const int fixed_offset = access.header_size - access.tag();
+  Node* entry = g->NewNode(
+      machine->Word32Shl(), key,
+      Int32Constant(kPointerSizeLog2 + ModuleEnv::kFunctionTableEntrySizeLog2));
   {
-    Node* load_sig =
-        g->NewNode(machine->Load(MachineType::AnyTagged()), table,
-                   g->NewNode(machine->Int32Add(),
-                              g->NewNode(machine->Word32Shl(), key,
-                                         Int32Constant(kPointerSizeLog2)),
-                              Int32Constant(fixed_offset)),
-                   *effect, *control);
+    int offset =
+        fixed_offset + kPointerSize * ModuleEnv::kFunctionTableSigOffset;
+    Node* load_sig = g->NewNode(
+        machine->Load(MachineType::AnyTagged()), table,
+        g->NewNode(machine->Int32Add(), entry, Int32Constant(offset)),
+        *effect, *control);
     Node* sig_match =
-        g->NewNode(machine->WordEqual(), load_sig, graph->SmiConstant(index));
+        g->NewNode(machine->WordEqual(), load_sig,
+                   graph->SmiConstant(module->GetCanonicalSigIndex(index)));
     trap->AddTrapIfFalse(kTrapFuncSigMismatch, sig_match);
   }
 
   // Load code object from the table.
-  int offset = fixed_offset + kPointerSize * table_size;
-  Node* load_code =
-      g->NewNode(machine->Load(MachineType::AnyTagged()), table,
-                 g->NewNode(machine->Int32Add(),
-                            g->NewNode(machine->Word32Shl(), key,
-                                       Int32Constant(kPointerSizeLog2)),
-                            Int32Constant(offset)),
-                 *effect, *control);
+  int offset =
+      fixed_offset + kPointerSize * ModuleEnv::kFunctionTableCodeOffset;
+  Node* load_code = g->NewNode(
+      machine->Load(MachineType::AnyTagged()), table,
+      g->NewNode(machine->Int32Add(), entry, Int32Constant(offset)), *effect,
+      *control);
 
   args[0] = load_code;
   wasm::FunctionSig* sig = module->GetSignature(index);
@@ -1271,10 +1435,7 @@ Node* WasmGraphBuilder::FromJS(Node* node, Node* context,
   DCHECK_NOT_NULL(graph);
   Graph* g = graph->graph();
   // Do a JavaScript ToNumber.
-  Node* num = g->NewNode(graph->javascript()->ToNumber(), node, context,
-                         graph->EmptyFrameState(), *effect, *control);
-  *control = num;
-  *effect = num;
+  Node* num = BuildJavaScriptToNumber(node, context);
 
   // Change representation.
   SimplifiedOperatorBuilder simplified(graph->zone());
@@ -1309,6 +1470,45 @@ Node* WasmGraphBuilder::FromJS(Node* node, Node* context,
   return num;
 }
 
+Node* WasmGraphBuilder::BuildJavaScriptToNumber(Node* node, Node* context) {
+  Graph* g = graph->graph();
+  CommonOperatorBuilder* common = graph->common();
+  MachineOperatorBuilder* machine = graph->machine();
+
+  // Smis are numbers already.
+  Node* is_smi = g->NewNode(
+      machine->WordEqual(),
+      g->NewNode(machine->WordAnd(), node, graph->IntPtrConstant(kSmiTagMask)),
+      graph->IntPtrConstant(kSmiTag));
+  Node* branch_smi =
+      g->NewNode(common->Branch(BranchHint::kTrue), is_smi, *control);
+  Node* if_smi = g->NewNode(common->IfTrue(), branch_smi);
+  Node* if_not_smi = g->NewNode(common->IfFalse(), branch_smi);
+
+  // So are heap numbers.
+  Node* map = g->NewNode(
+      machine->Load(MachineType::AnyTagged()), node,
+      graph->IntPtrConstant(HeapObject::kMapOffset - kHeapObjectTag), *effect,
+      if_not_smi);
+  Node* is_heap_number = g->NewNode(
+      machine->WordEqual(), map,
+      graph->HeapConstant(graph->isolate()->factory()->heap_number_map()));
+  Node* branch_heap_number = g->NewNode(common->Branch(BranchHint::kTrue),
+                                        is_heap_number, if_not_smi);
+  Node* if_heap_number = g->NewNode(common->IfTrue(), branch_heap_number);
+  Node* if_other = g->NewNode(common->IfFalse(), branch_heap_number);
+
+  // Everything else goes through a JavaScript ToNumber.
+  Node* num = g->NewNode(graph->javascript()->ToNumber(), node, context,
+                         graph->EmptyFrameState(), map, if_other);
+
+  Node* merge = g->NewNode(common->Merge(3), if_smi, if_heap_number, num);
+  *control = merge;
+  *effect = g->NewNode(common->EffectPhi(3), *effect, map, num, merge);
+  return g->NewNode(common->Phi(MachineRepresentation::kTagged, 3), node, node,
+                    num, merge);
+}
+
 Node* WasmGraphBuilder::Invert(Node* node) {
   DCHECK_NOT_NULL(graph);
   return Unop(wasm::kExprBoolNot, node);
@@ -1354,6 +1554,95 @@ void WasmGraphBuilder::BuildJSToWasmWrapper(Handle<Code> wasm_code,
   MergeControlToEnd(graph, ret);
 }
 
+void WasmGraphBuilder::BuildBatchedJSToWasmWrapper(Handle<Code> wasm_code,
+                                                   wasm::FunctionSig* sig) {
+  DCHECK_NOT_NULL(graph);
+
+  int params = static_cast<int>(sig->parameter_count());
+  Graph* g = graph->graph();
+  CommonOperatorBuilder* common = graph->common();
+  MachineOperatorBuilder* machine = graph->machine();
+  const int kSlotSize = static_cast<int>(sizeof(wasm::WasmNativeValue));
+
+  // Build the start and the JS parameter node of the batch buffer.
+  Node* start = Start(1 + 3);
+  *control = start;
+  *effect = start;
+  Node* buffer = g->NewNode(common->Parameter(0), start);
+
+  // Load the batch from the backing store of the buffer.
+  Node* batch = *effect = g->NewNode(
+      machine->Load(MachineType::Pointer()), buffer,
+      graph->IntPtrConstant(JSArrayBuffer::kBackingStoreOffset -
+                            kHeapObjectTag),
+      *effect, *control);
+  Node* count = *effect = g->NewNode(
+      machine->Load(MachineType::Int32()), batch,
+      graph->IntPtrConstant(offsetof(wasm::WasmNativeBatch, count)), *effect,
+      *control);
+  Node* first_args = *effect = g->NewNode(
+      machine->Load(MachineType::Pointer()), batch,
+      graph->IntPtrConstant(offsetof(wasm::WasmNativeBatch, args)), *effect,
+      *control);
+  Node* first_results = *effect = g->NewNode(
+      machine->Load(MachineType::Pointer()), batch,
+      graph->IntPtrConstant(offsetof(wasm::WasmNativeBatch, results)),
+      *effect, *control);
+
+  // Loop over the argument tuples. The back edges are filled in below.
+  MachineRepresentation pointer_rep = MachineType::PointerRepresentation();
+  Node* loop = g->NewNode(common->Loop(2), start, start);
+  Node* loop_effect = g->NewNode(common->EffectPhi(2), *effect, *effect, loop);
+  Node* i = g->NewNode(common->Phi(MachineRepresentation::kWord32, 2),
+                       Int32Constant(0), Int32Constant(0), loop);
+  Node* args = g->NewNode(common->Phi(pointer_rep, 2), first_args,
+                          first_args, loop);
+  Node* results = g->NewNode(common->Phi(pointer_rep, 2), first_results,
+                             first_results, loop);
+  Node* branch = g->NewNode(common->Branch(),
+                            g->NewNode(machine->Int32LessThan(), i, count),
+                            loop);
+  *control = g->NewNode(common->IfTrue(), branch);
+  *effect = loop_effect;
+
+  // Load the raw arguments of one tuple and call the WASM code with them.
+  int call_count = params + 3;
+  Node** call_args = Buffer(call_count);
+  int pos = 0;
+  call_args[pos++] = Constant(wasm_code);
+  for (int p = 0; p < params; p++) {
+    call_args[pos++] = *effect = g->NewNode(
+        machine->Load(wasm::WasmOpcodes::MachineTypeFor(sig->GetParam(p))),
+        args, graph->IntPtrConstant(p * kSlotSize), *effect, *control);
+  }
+  call_args[pos++] = *effect;
+  call_args[pos++] = *control;
+  CallDescriptor* desc = module->GetWasmCallDescriptor(graph->zone(), sig);
+  Node* call = *effect = g->NewNode(common->Call(desc), call_count, call_args);
+  if (sig->return_count() > 0) {
+    StoreRepresentation rep(wasm::WasmOpcodes::MachineTypeFor(sig->GetReturn()),
+                            kNoWriteBarrier);
+    *effect = g->NewNode(machine->Store(rep), results,
+                         graph->IntPtrConstant(0), call, *effect, *control);
+  }
+
+  // Advance to the next tuple.
+  loop->ReplaceInput(1, *control);
+  loop_effect->ReplaceInput(1, *effect);
+  i->ReplaceInput(1, g->NewNode(machine->Int32Add(), i, Int32Constant(1)));
+  args->ReplaceInput(1, g->NewNode(machine->IntAdd(), args,
+                                   graph->IntPtrConstant(params * kSlotSize)));
+  results->ReplaceInput(1, g->NewNode(machine->IntAdd(), results,
+                                      graph->IntPtrConstant(kSlotSize)));
+  MergeControlToEnd(graph,
+                    g->NewNode(common->Terminate(), loop_effect, loop));
+
+  Node* ret =
+      g->NewNode(common->Return(), graph->UndefinedConstant(), loop_effect,
+                 g->NewNode(common->IfFalse(), branch));
+  MergeControlToEnd(graph, ret);
+}
+
 void WasmGraphBuilder::BuildWasmToJSWrapper(Handle<JSFunction> function,
                                             wasm::FunctionSig* sig) {
   DCHECK_NOT_NULL(graph);
@@ -1426,8 +1715,40 @@ void WasmGraphBuilder::BuildWasmToJSWrapper(Handle<JSFunction> function,
   MergeControlToEnd(graph, ret);
 }
 
+
+void WasmGraphBuilder::BuildOutOfBoundsTrap() {
+  Node* start = Start(1);
+  *control = start;
+  *effect = start;
+  // The trap throws, so the return that follows it is never reached.
+  trap->AddTrapIfTrue(kTrapMemOutOfBounds, graph->Int32Constant(1));
+  ReturnVoid();
+}
+
+Node* WasmGraphBuilder::LoadInstanceField(MachineType type, int offset) {
+  DCHECK(!module->instance_data.is_null());
+  // The instance data does not change while wasm code runs, so the load
+  // only depends on the start of the function.
+  Graph* g = graph->graph();
+  Node* data = graph->Constant(module->instance_data);
+  Node* field = graph->IntPtrConstant(ByteArray::kHeaderSize - kHeapObjectTag +
+                                      offset);
+  return g->NewNode(graph->machine()->Load(type), data, field, g->start(),
+                    g->start());
+}
+
 Node* WasmGraphBuilder::MemBuffer(uint32_t offset) {
   if (!graph) return nullptr;
+  if (!module->instance_data.is_null()) {
+    // Instance-independent code loads the memory start at run time.
+    if (!mem_buffer) {
+      mem_buffer = LoadInstanceField(MachineType::Pointer(),
+                                     wasm::ModuleEnv::kInstanceMemStartOffset);
+    }
+    if (offset == 0) return mem_buffer;
+    return graph->graph()->NewNode(graph->machine()->IntAdd(), mem_buffer,
+                                   graph->IntPtrConstant(offset));
+  }
   if (offset == 0) {
     if (!mem_buffer) mem_buffer = graph->IntPtrConstant(module->mem_start);
     return mem_buffer;
@@ -1438,6 +1759,35 @@ Node* WasmGraphBuilder::MemBuffer(uint32_t offset) {
 
 Node* WasmGraphBuilder::MemSize(uint32_t offset) {
   if (!graph) return nullptr;
+  if (!module->instance_data.is_null()) {
+    // Instance-independent code loads the memory size at run time.
+    Node* size;
+    if (calls == 0) {
+      if (!mem_size) {
+        mem_size = LoadInstanceField(MachineType::Uint32(),
+                                     wasm::ModuleEnv::kInstanceMemSizeOffset);
+      }
+      size = mem_size;
+    } else {
+      // The memory may have grown during a call, so load the size again
+      // unless it was loaded since the last call on a dominating path.
+      if (!mem_size_after_call || mem_size_calls != calls ||
+          !Dominates(NodeProperties::GetControlInput(mem_size_after_call),
+                     *control)) {
+        Node* field = graph->IntPtrConstant(
+            ByteArray::kHeaderSize - kHeapObjectTag +
+            wasm::ModuleEnv::kInstanceMemSizeOffset);
+        mem_size_after_call = graph->graph()->NewNode(
+            graph->machine()->Load(MachineType::Uint32()),
+            graph->Constant(module->instance_data), field, *effect, *control);
+        mem_size_calls = calls;
+      }
+      size = mem_size_after_call;
+    }
+    if (offset == 0) return size;
+    return graph->graph()->NewNode(graph->machine()->Int32Add(), size,
+                                   graph->Int32Constant(offset));
+  }
   int32_t size = static_cast<int>(module->mem_end - module->mem_start);
   if (offset == 0) {
     if (!mem_size) mem_size = graph->Int32Constant(size);
@@ -1447,6 +1797,40 @@ Node* WasmGraphBuilder::MemSize(uint32_t offset) {
   }
 }
 
+Node* WasmGraphBuilder::GrowMemory(Node* delta) {
+  if (!graph) return nullptr;
+  if (module->instance_data.is_null()) {
+    // Code that embeds the memory size cannot let the memory grow.
+    return graph->Int32Constant(-1);
+  }
+  // The memory grows in place without allocating on the JS heap, so the
+  // runtime entry is called directly as a C function.
+  MachineType sig_types[] = {MachineType::Int32(), MachineType::Pointer(),
+                             MachineType::Uint32()};
+  MachineSignature sig(1, 2, sig_types);
+  CallDescriptor* desc = Linkage::GetSimplifiedCDescriptor(graph->zone(), &sig);
+  Node* target = LoadInstanceField(
+      MachineType::Pointer(), wasm::ModuleEnv::kInstanceGrowMemoryEntryOffset);
+  Node* call = graph->graph()->NewNode(
+      graph->common()->Call(desc), target,
+      graph->Constant(module->instance_data), delta, *effect, *control);
+  *effect = call;
+  side_effects++;
+  calls++;
+  return call;
+}
+
+Node* WasmGraphBuilder::GlobalsArea() {
+  if (!module->instance_data.is_null()) {
+    // Instance-independent code loads the globals area at run time.
+    if (!globals_area) {
+      globals_area = LoadInstanceField(
+          MachineType::Pointer(), wasm::ModuleEnv::kInstanceGlobalsAreaOffset);
+    }
+    return globals_area;
+  }
+  return graph->IntPtrConstant(module->globals_area);
+}
 
 Node* WasmGraphBuilder::FunctionTable() {
   if (!graph) return nullptr;
@@ -1461,11 +1845,11 @@ Node* WasmGraphBuilder::FunctionTable() {
 Node* WasmGraphBuilder::LoadGlobal(uint32_t index) {
   DCHECK_NOT_NULL(graph);
   MachineType mem_type = module->GetGlobalType(index);
-  Node* addr = graph->IntPtrConstant(module->globals_area +
-                                     module->module->globals->at(index).offset);
+  uint32_t offset = module->module->globals->at(index).offset;
   const Operator* op = graph->machine()->Load(mem_type);
-  Node* node = graph->graph()->NewNode(op, addr, graph->Int32Constant(0),
-                                       *effect, *control);
+  Node* node = graph->graph()->NewNode(op, GlobalsArea(),
+                                       graph->Int32Constant(offset), *effect,
+                                       *control);
   *effect = node;
   return node;
 }
@@ -1474,36 +1858,173 @@ Node* WasmGraphBuilder::LoadGlobal(uint32_t index) {
 Node* WasmGraphBuilder::StoreGlobal(uint32_t index, Node* val) {
   DCHECK_NOT_NULL(graph);
   MachineType mem_type = module->GetGlobalType(index);
-  Node* addr = graph->IntPtrConstant(module->globals_area +
-                                     module->module->globals->at(index).offset);
+  uint32_t offset = module->module->globals->at(index).offset;
   const Operator* op =
       graph->machine()->Store(StoreRepresentation(mem_type, kNoWriteBarrier));
-  Node* node = graph->graph()->NewNode(op, addr, graph->Int32Constant(0), val,
+  Node* node = graph->graph()->NewNode(op, GlobalsArea(),
+                                       graph->Int32Constant(offset), val,
                                        *effect, *control);
   *effect = node;
+  side_effects++;
   return node;
 }
 
-void WasmGraphBuilder::BoundsCheckMem(MachineType memtype, Node* index,
-                                      uint32_t offset) {
-  // TODO(turbofan): fold bounds checks for constant indexes.
+Node* WasmGraphBuilder::BoundsCheckMem(uint32_t size, Node* index,
+                                       uint32_t offset) {
+  uint64_t end = static_cast<uint64_t>(offset) + size;
+  // Fold constant indexes into the end of the access, so that accesses to
+  // constant addresses share a single check against the memory size.
+  Node* checked = index;
+  Int32Matcher m(index);
+  if (m.HasValue()) {
+    checked = nullptr;
+    end += static_cast<uint32_t>(m.Value());
+    if (module->instance_data.is_null()) {
+      // The access is in bounds of the fixed memory size.
+      CHECK_GE(module->mem_end, module->mem_start);
+      if (end <= static_cast<uint64_t>(module->mem_end - module->mem_start)) {
+        return index;
+      }
+    }
+  }
+  if (!FindBoundsCheck(checked, end)) AddBoundsCheck(checked, end);
+  return index;
+}
+
+
+bool WasmGraphBuilder::IsGuardedAccess(uint32_t size, uint32_t offset) {
+  // Every address formed from the index and {offset} lies in the guard
+  // region, provided the index is zero-extended into the address.
+  return module && module->guard_region && !module->instance_data.is_null() &&
+         static_cast<uint64_t>(offset) + size <= kMaxUInt32;
+}
+
+
+Node* WasmGraphBuilder::BoundsCheckCondition(Node* index, uint64_t end) {
   Graph* g = graph->graph();
+  if (end > kMaxUInt32) {
+    // The access will always throw.
+    return graph->Int32Constant(0);
+  }
+  Node* access_end = graph->Int32Constant(static_cast<uint32_t>(end));
+  if (!module->instance_data.is_null()) {
+    // The memory size is only known at run time. Check that the access fits
+    // both below the size and below the limit derived from it, since
+    // computing the limit may wrap around for small memories.
+    Node* size = MemSize(0);
+    Node* fits = g->NewNode(graph->machine()->Uint32LessThanOrEqual(),
+                            access_end, size);
+    if (index == nullptr) return fits;
+    Node* limit = g->NewNode(graph->machine()->Int32Sub(), size, access_end);
+    Node* in_bounds = g->NewNode(graph->machine()->Uint32LessThanOrEqual(),
+                                 index, limit);
+    return g->NewNode(graph->machine()->Word32And(), fits, in_bounds);
+  }
   CHECK_GE(module->mem_end, module->mem_start);
-  ptrdiff_t size = module->mem_end - module->mem_start;
-  byte memsize = wasm::WasmOpcodes::MemSize(memtype);
-  Node* cond;
-  if (offset >= size || (offset + memsize) > size) {
+  uint64_t size = static_cast<uint64_t>(module->mem_end - module->mem_start);
+  if (end > size) {
     // The access will always throw.
-    cond = graph->Int32Constant(0);
+    return graph->Int32Constant(0);
+  }
+  if (index == nullptr) return graph->Int32Constant(1);
+  // Check against the limit.
+  uint64_t limit = size - end;
+  CHECK(limit <= kMaxUInt32);
+  return g->NewNode(graph->machine()->Uint32LessThanOrEqual(), index,
+                    graph->Int32Constant(static_cast<uint32_t>(limit)));
+}
+
+
+bool WasmGraphBuilder::FindBoundsCheck(Node* index, uint64_t end) {
+  for (int i = 0; i < kBoundsCheckCacheSize; i++) {
+    BoundsCheck& check = bounds_checks[i];
+    if (check.branch == nullptr || check.index != index) continue;
+    if (end <= check.end && Dominates(check.control, *control)) return true;
+    if (check.control == *control && check.side_effects == side_effects) {
+      // Nothing observable happened since the earlier check, so trapping
+      // there instead of here is fine. Extend it to cover this access too.
+      Node* current_control = *control;
+      Node* current_effect = *effect;
+      *control = NodeProperties::GetControlInput(check.branch);
+      *effect = check.effect;
+      check.branch->ReplaceInput(0, BoundsCheckCondition(index, end));
+      *control = current_control;
+      *effect = current_effect;
+      check.end = end;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+void WasmGraphBuilder::AddBoundsCheck(Node* index, uint64_t end) {
+  // A check at the start of a loop whose index is defined outside of it is
+  // moved in front of the loop, provided nothing observable happens in the
+  // loop before the check. Loops always run their first iteration, so the
+  // check traps at the same time as it would have in the loop.
+  Node* loop = current_loop;
+  Node* loop_effect = nullptr;
+  if (loop != nullptr && *control == loop &&
+      side_effects == loop_side_effects &&
+      (index == nullptr || index->id() < loop->id())) {
+    for (Node* use : loop->uses()) {
+      if (use->opcode() == IrOpcode::kEffectPhi) {
+        loop_effect = use;
+        break;
+      }
+    }
+  }
+  Node* branch;
+  Node* effect_before;
+  if (loop_effect != nullptr) {
+    Node* effect_in_loop = *effect;
+    effect_before = NodeProperties::GetEffectInput(loop_effect);
+    *control = NodeProperties::GetControlInput(loop);
+    *effect = effect_before;
+    trap->AddTrapIfFalse(kTrapMemOutOfBounds,
+                         BoundsCheckCondition(index, end));
+    branch = NodeProperties::GetControlInput(*control);
+    loop->ReplaceInput(0, *control);
+    *control = loop;
+    *effect = effect_in_loop;
   } else {
-    // Check against the limit.
-    size_t limit = size - offset - memsize;
-    CHECK(limit <= kMaxUInt32);
-    cond = g->NewNode(graph->machine()->Uint32LessThanOrEqual(), index,
-                      graph->Int32Constant(static_cast<uint32_t>(limit)));
+    effect_before = *effect;
+    trap->AddTrapIfFalse(kTrapMemOutOfBounds,
+                         BoundsCheckCondition(index, end));
+    branch = NodeProperties::GetControlInput(*control);
   }
 
-  trap->AddTrapIfFalse(kTrapMemOutOfBounds, cond);
+  BoundsCheck& check = bounds_checks[next_bounds_check];
+  next_bounds_check = (next_bounds_check + 1) % kBoundsCheckCacheSize;
+  check.index = index;
+  check.end = end;
+  check.branch = branch;
+  check.control = *control;
+  check.effect = effect_before;
+  check.side_effects = side_effects;
+}
+
+
+bool WasmGraphBuilder::Dominates(Node* dominator, Node* node) {
+  // Walk up the control chain for a bounded number of steps. The entry of a
+  // loop dominates the loop, but merges of several paths end the walk.
+  const int kMaxSteps = 32;
+  for (int i = 0; i < kMaxSteps; i++) {
+    if (node == dominator) return true;
+    switch (node->opcode()) {
+      case IrOpcode::kLoop:
+        break;
+      case IrOpcode::kMerge:
+        if (node->InputCount() != 1) return false;
+        break;
+      default:
+        if (node->op()->ControlInputCount() != 1) return false;
+        break;
+    }
+    node = NodeProperties::GetControlInput(node);
+  }
+  return false;
 }
 
 
@@ -1514,20 +2035,27 @@ Node* WasmGraphBuilder::LoadMem(wasm::LocalType type, MachineType memtype,
   Graph* g = graph->graph();
   Node* load;
 
+  uint32_t size = wasm::WasmOpcodes::MemSize(memtype);
   if (module && module->asm_js) {
     // asm.js semantics use CheckedLoad (i.e. OOB reads return 0ish).
     DCHECK_EQ(0, offset);
     const Operator* op = graph->machine()->CheckedLoad(memtype);
     load = g->NewNode(op, MemBuffer(0), index, MemSize(0), *effect, *control);
+    *effect = load;
+  } else if (IsGuardedAccess(size, offset)) {
+    // Out-of-bounds accesses fault in the guard region and throw from there.
+    index = g->NewNode(graph->machine()->ChangeUint32ToUint64(), index);
+    load = g->NewNode(graph->machine()->Load(memtype), MemBuffer(offset), index,
+                      *effect, *control);
+    *effect = load;
   } else {
     // WASM semantics throw on OOB. Introduce explicit bounds check.
-    BoundsCheckMem(memtype, index, offset);
+    index = BoundsCheckMem(size, index, offset);
     load = g->NewNode(graph->machine()->Load(memtype), MemBuffer(offset), index,
                       *effect, *control);
+    *effect = load;
   }
 
-  *effect = load;
-
   if (type == wasm::kAstI64 && ElementSizeLog2Of(memtype.representation()) < 3) {
     // TODO(titzer): TF zeroes the upper bits of 64-bit loads for subword sizes.
     if (memtype.IsSigned()) {
@@ -1548,25 +2076,367 @@ Node* WasmGraphBuilder::StoreMem(MachineType memtype, Node* index,
   if (!graph) return nullptr;
 
   Node* store;
+  uint32_t size = wasm::WasmOpcodes::MemSize(memtype);
   if (module && module->asm_js) {
     // asm.js semantics use CheckedStore (i.e. ignore OOB writes).
     DCHECK_EQ(0, offset);
     const Operator* op = graph->machine()->CheckedStore(memtype);
     store = graph->graph()->NewNode(op, MemBuffer(0), index, MemSize(0), val,
                                     *effect, *control);
+  } else if (IsGuardedAccess(size, offset)) {
+    // Out-of-bounds accesses fault in the guard region and throw from there.
+    index = graph->graph()->NewNode(graph->machine()->ChangeUint32ToUint64(),
+                                    index);
+    StoreRepresentation rep(memtype, kNoWriteBarrier);
+    store =
+        graph->graph()->NewNode(graph->machine()->Store(rep), MemBuffer(offset),
+                                index, val, *effect, *control);
   } else {
     // WASM semantics throw on OOB. Introduce explicit bounds check.
-    BoundsCheckMem(memtype, index, offset);
+    index = BoundsCheckMem(size, index, offset);
     StoreRepresentation rep(memtype, kNoWriteBarrier);
     store =
         graph->graph()->NewNode(graph->machine()->Store(rep), MemBuffer(offset),
                                 index, val, *effect, *control);
   }
   *effect = store;
+  side_effects++;
   return store;
 }
 
 
+Node* WasmGraphBuilder::AtomicOp(wasm::WasmOpcode opcode, Node* index,
+                                 uint32_t offset, Node* value, Node* operand) {
+  if (!graph) return nullptr;
+
+  Graph* g = graph->graph();
+  // Atomics always check their bounds, even in asm.js code.
+  index = BoundsCheckMem(sizeof(int32_t), index, offset);
+  if (opcode == wasm::kExprI32AtomicWait &&
+      (module->module == nullptr || !module->module->mem_shared)) {
+    // No other thread can notify a wait on a memory that is not shared.
+    trap->AddTrapIfTrue(kTrapAtomicWait, graph->Int32Constant(1));
+  }
+  // Atomic accesses must be aligned to their size.
+  const uint32_t kAlignmentMask = sizeof(int32_t) - 1;
+  Int32Matcher m(index);
+  if (!m.HasValue() ||
+      ((static_cast<uint32_t>(m.Value()) + offset) & kAlignmentMask) != 0) {
+    Node* effective = index;
+    if ((offset & kAlignmentMask) != 0) {
+      effective = g->NewNode(graph->machine()->Int32Add(), index,
+                             graph->Int32Constant(offset & kAlignmentMask));
+    }
+    trap->AddTrapIfTrue(
+        kTrapUnalignedAtomic,
+        g->NewNode(graph->machine()->Word32And(), effective,
+                   graph->Int32Constant(kAlignmentMask)));
+  }
+
+  // There are no atomic machine operators, so the operation is done by a C
+  // function that is called directly, like the runtime entry for growing the
+  // memory.
+  Node* address = index;
+  if (graph->machine()->Is64()) {
+    address = g->NewNode(graph->machine()->ChangeUint32ToUint64(), index);
+  }
+  address = g->NewNode(graph->machine()->IntAdd(), MemBuffer(offset), address);
+  MachineType sig_types[] = {MachineType::Int32(), MachineType::Int32(),
+                             MachineType::Pointer(), MachineType::Int32(),
+                             MachineType::Int32()};
+  MachineSignature sig(1, 4, sig_types);
+  CallDescriptor* desc = Linkage::GetSimplifiedCDescriptor(graph->zone(), &sig);
+  Node* target;
+  if (module->instance_data.is_null()) {
+    ApiFunction function(FUNCTION_ADDR(wasm::AtomicOp));
+    target = graph->ExternalConstant(ExternalReference(
+        &function, ExternalReference::BUILTIN_CALL, graph->isolate()));
+  } else {
+    // Instance-independent code loads the entry at run time.
+    target = LoadInstanceField(MachineType::Pointer(),
+                               wasm::ModuleEnv::kInstanceAtomicEntryOffset);
+  }
+  Node* call = g->NewNode(
+      graph->common()->Call(desc), target, graph->Int32Constant(opcode),
+      address, value ? value : graph->Int32Constant(0),
+      operand ? operand : graph->Int32Constant(0), *effect, *control);
+  *effect = call;
+  side_effects++;
+  if (opcode == wasm::kExprI32AtomicWait) {
+    // The thread may not block.
+    trap->TrapIfEq32(kTrapAtomicWait, call, wasm::kAtomicWaitNotAllowed);
+  }
+  return call;
+}
+
+
+// The lanes of SIMD values are 32 bits wide.
+static const int kSimd128LaneSize = 4;
+
+
+Node* WasmGraphBuilder::SimdValue(Node** lanes) {
+  DCHECK_NOT_NULL(graph);
+  return graph->graph()->NewNode(
+      graph->common()->StateValues(wasm::kSimd128Lanes), wasm::kSimd128Lanes,
+      lanes);
+}
+
+
+bool WasmGraphBuilder::IsSimdValue(Node* node) {
+  return node && node->opcode() == IrOpcode::kStateValues &&
+         node->InputCount() == wasm::kSimd128Lanes;
+}
+
+
+// Lanes are word32 values, so float lanes are reinterpreted on the way in
+// and out. A reinterpretation of a reinterpretation is left out.
+Node* WasmGraphBuilder::SimdLane(Node* simd, int lane, wasm::LocalType type) {
+  DCHECK(IsSimdValue(simd));
+  Node* node = simd->InputAt(lane);
+  if (type == wasm::kAstI32) return node;
+  DCHECK_EQ(wasm::kAstF32, type);
+  if (node->opcode() == IrOpcode::kBitcastFloat32ToInt32) {
+    return node->InputAt(0);
+  }
+  return graph->graph()->NewNode(graph->machine()->BitcastInt32ToFloat32(),
+                                 node);
+}
+
+
+Node* WasmGraphBuilder::SimdLaneValue(Node* value, wasm::LocalType type) {
+  if (type == wasm::kAstI32) return value;
+  DCHECK_EQ(wasm::kAstF32, type);
+  if (value->opcode() == IrOpcode::kBitcastInt32ToFloat32) {
+    return value->InputAt(0);
+  }
+  return graph->graph()->NewNode(graph->machine()->BitcastFloat32ToInt32(),
+                                 value);
+}
+
+
+Node* WasmGraphBuilder::SimdPhi(unsigned count, Node** vals, Node* control) {
+  // {vals} may be the buffer that building the phis reuses, so the lanes are
+  // collected first.
+  Node** inputs = zone->NewArray<Node*>(count * wasm::kSimd128Lanes);
+  for (unsigned i = 0; i < count; i++) {
+    DCHECK(IsSimdValue(vals[i]));
+    for (int j = 0; j < wasm::kSimd128Lanes; j++) {
+      inputs[j * count + i] = vals[i]->InputAt(j);
+    }
+  }
+  Node* lanes[wasm::kSimd128Lanes];
+  for (int j = 0; j < wasm::kSimd128Lanes; j++) {
+    lanes[j] = Phi(wasm::kAstI32, count, &inputs[j * count], control);
+  }
+  return SimdValue(lanes);
+}
+
+
+Node* WasmGraphBuilder::SimdBinop(wasm::WasmOpcode opcode, Node* left,
+                                  Node* right) {
+  wasm::WasmOpcode lane_opcode;
+  wasm::LocalType type = wasm::kAstI32;
+  switch (opcode) {
+    case wasm::kExprI32x4Add:
+      lane_opcode = wasm::kExprI32Add;
+      break;
+    case wasm::kExprI32x4Sub:
+      lane_opcode = wasm::kExprI32Sub;
+      break;
+    case wasm::kExprI32x4Mul:
+      lane_opcode = wasm::kExprI32Mul;
+      break;
+    case wasm::kExprS128And:
+      lane_opcode = wasm::kExprI32And;
+      break;
+    case wasm::kExprS128Or:
+      lane_opcode = wasm::kExprI32Ior;
+      break;
+    case wasm::kExprS128Xor:
+      lane_opcode = wasm::kExprI32Xor;
+      break;
+    case wasm::kExprF32x4Add:
+      lane_opcode = wasm::kExprF32Add;
+      type = wasm::kAstF32;
+      break;
+    case wasm::kExprF32x4Sub:
+      lane_opcode = wasm::kExprF32Sub;
+      type = wasm::kAstF32;
+      break;
+    case wasm::kExprF32x4Mul:
+      lane_opcode = wasm::kExprF32Mul;
+      type = wasm::kAstF32;
+      break;
+    case wasm::kExprF32x4Div:
+      lane_opcode = wasm::kExprF32Div;
+      type = wasm::kAstF32;
+      break;
+    case wasm::kExprF32x4Min:
+      lane_opcode = wasm::kExprF32Min;
+      type = wasm::kAstF32;
+      break;
+    case wasm::kExprF32x4Max:
+      lane_opcode = wasm::kExprF32Max;
+      type = wasm::kAstF32;
+      break;
+    default:
+      UnsupportedOpcode(opcode);
+      return nullptr;
+  }
+  Node* lanes[wasm::kSimd128Lanes];
+  for (int i = 0; i < wasm::kSimd128Lanes; i++) {
+    Node* result = Binop(lane_opcode, SimdLane(left, i, type),
+                         SimdLane(right, i, type));
+    lanes[i] = SimdLaneValue(result, type);
+  }
+  return SimdValue(lanes);
+}
+
+
+Node* WasmGraphBuilder::SimdUnop(wasm::WasmOpcode opcode, Node* input) {
+  wasm::WasmOpcode lane_opcode;
+  wasm::LocalType input_type = wasm::kAstF32;
+  Node* lanes[wasm::kSimd128Lanes];
+  switch (opcode) {
+    case wasm::kExprI32x4Splat:
+    case wasm::kExprF32x4Splat: {
+      wasm::LocalType type =
+          opcode == wasm::kExprI32x4Splat ? wasm::kAstI32 : wasm::kAstF32;
+      Node* lane = SimdLaneValue(input, type);
+      for (int i = 0; i < wasm::kSimd128Lanes; i++) lanes[i] = lane;
+      return SimdValue(lanes);
+    }
+    case wasm::kExprF32x4Abs:
+      lane_opcode = wasm::kExprF32Abs;
+      break;
+    case wasm::kExprF32x4Neg:
+      lane_opcode = wasm::kExprF32Neg;
+      break;
+    case wasm::kExprF32x4Sqrt:
+      lane_opcode = wasm::kExprF32Sqrt;
+      break;
+    case wasm::kExprF32x4SConvertI32x4:
+      lane_opcode = wasm::kExprF32SConvertI32;
+      input_type = wasm::kAstI32;
+      break;
+    default:
+      UnsupportedOpcode(opcode);
+      return nullptr;
+  }
+  for (int i = 0; i < wasm::kSimd128Lanes; i++) {
+    Node* result = Unop(lane_opcode, SimdLane(input, i, input_type));
+    lanes[i] = SimdLaneValue(result, wasm::kAstF32);
+  }
+  return SimdValue(lanes);
+}
+
+
+Node* WasmGraphBuilder::SimdExtractLane(wasm::WasmOpcode opcode, int lane,
+                                        Node* input) {
+  DCHECK_LT(lane, wasm::kSimd128Lanes);
+  wasm::LocalType type = opcode == wasm::kExprI32x4ExtractLane
+                             ? wasm::kAstI32
+                             : wasm::kAstF32;
+  return SimdLane(input, lane, type);
+}
+
+
+Node* WasmGraphBuilder::SimdReplaceLane(wasm::WasmOpcode opcode, int lane,
+                                        Node* input, Node* replacement) {
+  DCHECK_LT(lane, wasm::kSimd128Lanes);
+  wasm::LocalType type = opcode == wasm::kExprI32x4ReplaceLane
+                             ? wasm::kAstI32
+                             : wasm::kAstF32;
+  Node* lanes[wasm::kSimd128Lanes];
+  for (int i = 0; i < wasm::kSimd128Lanes; i++) lanes[i] = input->InputAt(i);
+  lanes[lane] = SimdLaneValue(replacement, type);
+  return SimdValue(lanes);
+}
+
+
+Node* WasmGraphBuilder::SimdShuffle(const byte* lanes, Node* left,
+                                    Node* right) {
+  Node* result[wasm::kSimd128Lanes];
+  for (int i = 0; i < wasm::kSimd128Lanes; i++) {
+    DCHECK_LT(lanes[i], 2 * wasm::kSimd128Lanes);
+    result[i] = lanes[i] < wasm::kSimd128Lanes
+                    ? left->InputAt(lanes[i])
+                    : right->InputAt(lanes[i] - wasm::kSimd128Lanes);
+  }
+  return SimdValue(result);
+}
+
+
+Node* WasmGraphBuilder::SimdLoadMem(Node* index, uint32_t offset) {
+  if (!graph) return nullptr;
+
+  Graph* g = graph->graph();
+  Node* lanes[wasm::kSimd128Lanes];
+  if (module && module->asm_js) {
+    // Lanes out of bounds read as 0, like the other asm.js loads.
+    DCHECK_EQ(0, offset);
+    for (int i = 0; i < wasm::kSimd128Lanes; i++) {
+      Node* lane_index =
+          i == 0 ? index
+                 : g->NewNode(graph->machine()->Int32Add(), index,
+                              graph->Int32Constant(i * kSimd128LaneSize));
+      lanes[i] = LoadMem(wasm::kAstI32, MachineType::Int32(), lane_index, 0);
+    }
+  } else {
+    // A single bounds check covers all lanes. The offsets of the lanes can
+    // only wrap around if the check always traps.
+    index = BoundsCheckMem(wasm::kSimd128Lanes * kSimd128LaneSize, index,
+                           offset);
+    for (int i = 0; i < wasm::kSimd128Lanes; i++) {
+      lanes[i] = g->NewNode(graph->machine()->Load(MachineType::Int32()),
+                            MemBuffer(offset + i * kSimd128LaneSize), index,
+                            *effect, *control);
+      *effect = lanes[i];
+    }
+  }
+  return SimdValue(lanes);
+}
+
+
+Node* WasmGraphBuilder::SimdStoreMem(Node* index, uint32_t offset,
+                                     Node* val) {
+  if (!graph) return nullptr;
+
+  Graph* g = graph->graph();
+  Node* store = nullptr;
+  if (module && module->asm_js) {
+    // Lanes out of bounds are not written, like the other asm.js stores.
+    DCHECK_EQ(0, offset);
+    for (int i = 0; i < wasm::kSimd128Lanes; i++) {
+      Node* lane_index =
+          i == 0 ? index
+                 : g->NewNode(graph->machine()->Int32Add(), index,
+                              graph->Int32Constant(i * kSimd128LaneSize));
+      store = StoreMem(MachineType::Int32(), lane_index, 0, val->InputAt(i));
+    }
+  } else {
+    // A single bounds check covers all lanes, see {SimdLoadMem}.
+    index = BoundsCheckMem(wasm::kSimd128Lanes * kSimd128LaneSize, index,
+                           offset);
+    StoreRepresentation rep(MachineType::Int32(), kNoWriteBarrier);
+    for (int i = 0; i < wasm::kSimd128Lanes; i++) {
+      store = g->NewNode(graph->machine()->Store(rep),
+                         MemBuffer(offset + i * kSimd128LaneSize), index,
+                         val->InputAt(i), *effect, *control);
+      *effect = store;
+      side_effects++;
+    }
+  }
+  return store;
+}
+
+
+void WasmGraphBuilder::PrepareHeapConstants() {
+  if (!graph) return;
+  trap->PrepareHeapConstants();
+}
+
+
 void WasmGraphBuilder::PrintDebugName(Node* node) {
   PrintF("#%d:%s", node->id(), node->op()->mnemonic());
 }
@@ -1579,6 +2449,50 @@ Node* WasmGraphBuilder::String(const char* string) {
 }
 
 
+void RecordWasmCodeCreation(Isolate* isolate, wasm::WasmModule* module,
+                            uint32_t index, const char* kind,
+                            Handle<Code> code) {
+  if (code.is_null()) return;
+  if (!isolate->logger()->is_logging_code_events() &&
+      !isolate->cpu_profiler()->is_profiling()) {
+    return;
+  }
+  uint32_t module_id =
+      module->bytes ? module->bytes->hash()
+                    : static_cast<uint32_t>(
+                          reinterpret_cast<uintptr_t>(module->module_start));
+  const char* name = "";
+  if (index < module->functions->size()) {
+    uint32_t name_offset = module->functions->at(index).name_offset;
+    if (name_offset > 0) name = module->GetName(name_offset);
+  }
+  static const int kBufferSize = 128;
+  char buffer[kBufferSize];
+  snprintf(buffer, kBufferSize, "%s #%d:%s <module %08x>", kind, index, name,
+           module_id);
+  PROFILE(isolate, CodeCreateEvent(Logger::FUNCTION_TAG, *code, buffer));
+}
+
+
+Handle<JSFunction> NewJSToWasmFunction(Isolate* isolate,
+                                       wasm::ModuleEnv* module,
+                                       Handle<String> name,
+                                       Handle<Code> wasm_code,
+                                       Handle<Code> wrapper_code,
+                                       uint32_t index) {
+  wasm::WasmFunction* func = &module->module->functions->at(index);
+  Handle<SharedFunctionInfo> shared =
+      isolate->factory()->NewSharedFunctionInfo(name, wasm_code, false);
+  int params = static_cast<int>(func->sig->parameter_count());
+  shared->set_length(params);
+  shared->set_internal_formal_parameter_count(1 + params);
+  Handle<JSFunction> function = isolate->factory()->NewFunction(name);
+  function->set_shared(*shared);
+  if (!wrapper_code.is_null()) function->set_code(*wrapper_code);
+  return function;
+}
+
+
 Handle<JSFunction> CompileJSToWasmWrapper(Isolate* isolate,
                                           wasm::ModuleEnv* module,
                                           Handle<String> name,
@@ -1589,13 +2503,8 @@ Handle<JSFunction> CompileJSToWasmWrapper(Isolate* isolate,
   //----------------------------------------------------------------------------
   // Create the JSFunction object.
   //----------------------------------------------------------------------------
-  Handle<SharedFunctionInfo> shared =
-      isolate->factory()->NewSharedFunctionInfo(name, wasm_code, false);
-  int params = static_cast<int>(func->sig->parameter_count());
-  shared->set_length(params);
-  shared->set_internal_formal_parameter_count(1 + params);
-  Handle<JSFunction> function = isolate->factory()->NewFunction(name);
-  function->set_shared(*shared);
+  Handle<JSFunction> function = NewJSToWasmFunction(
+      isolate, module, name, wasm_code, Handle<Code>::null(), index);
 
   //----------------------------------------------------------------------------
   // Create the Graph
@@ -1667,6 +2576,8 @@ Handle<JSFunction> CompileJSToWasmWrapper(Isolate* isolate,
       code->Disassemble(buffer, os);
     }
 #endif
+    RecordWasmCodeCreation(isolate, module->module, index,
+                           "JS->WASM function wrapper", code);
     // Set the JSFunction's machine code.
     function->set_code(*code);
   }
@@ -1674,6 +2585,110 @@ Handle<JSFunction> CompileJSToWasmWrapper(Isolate* isolate,
 }
 
 
+Handle<JSFunction> CompileBatchedJSToWasmWrapper(Isolate* isolate,
+                                                 wasm::ModuleEnv* module,
+                                                 Handle<String> name,
+                                                 Handle<Code> wasm_code,
+                                                 uint32_t index) {
+  wasm::WasmFunction* func = &module->module->functions->at(index);
+
+  //----------------------------------------------------------------------------
+  // Create the Graph
+  //----------------------------------------------------------------------------
+  Zone zone;
+  Graph graph(&zone);
+  CommonOperatorBuilder common(&zone);
+  JSOperatorBuilder javascript(&zone);
+  MachineOperatorBuilder machine(&zone);
+  JSGraph jsgraph(isolate, &graph, &common, &javascript, nullptr, &machine);
+
+  Node* control = nullptr;
+  Node* effect = nullptr;
+
+  WasmGraphBuilder builder(&zone, &jsgraph);
+  builder.set_control_ptr(&control);
+  builder.set_effect_ptr(&effect);
+  builder.set_module(module);
+  builder.BuildBatchedJSToWasmWrapper(wasm_code, func->sig);
+
+  //----------------------------------------------------------------------------
+  // Run the compilation pipeline.
+  //----------------------------------------------------------------------------
+  // The graph only has machine operators, so it needs no lowering.
+  CallDescriptor* incoming = Linkage::GetJSCallDescriptor(
+      &zone, false, 1 + 1, CallDescriptor::kNoFlags);
+  CompilationInfo info("batched-js-to-wasm", isolate, &zone);
+  info.set_output_code_kind(Code::WASM_FUNCTION);
+  Handle<Code> code =
+      Pipeline::GenerateCodeForTesting(&info, incoming, &graph, nullptr);
+  RecordWasmCodeCreation(isolate, module->module, index,
+                         "batched JS->WASM function wrapper", code);
+
+  //----------------------------------------------------------------------------
+  // Create the JSFunction object, which takes the batch buffer.
+  //----------------------------------------------------------------------------
+  return NewBatchedJSToWasmFunction(isolate, name, code);
+}
+
+
+Handle<Code> CompileOutOfBoundsTrap(Isolate* isolate, Handle<Context> context) {
+  //----------------------------------------------------------------------------
+  // Create the Graph
+  //----------------------------------------------------------------------------
+  Zone zone;
+  Graph graph(&zone);
+  CommonOperatorBuilder common(&zone);
+  JSOperatorBuilder javascript(&zone);
+  MachineOperatorBuilder machine(&zone);
+  JSGraph jsgraph(isolate, &graph, &common, &javascript, nullptr, &machine);
+
+  Node* control = nullptr;
+  Node* effect = nullptr;
+
+  // The trap code only needs the context to call the runtime in.
+  wasm::ModuleEnv module;
+  module.module = nullptr;
+  module.context = context;
+  module.asm_js = false;
+
+  WasmGraphBuilder builder(&zone, &jsgraph);
+  builder.set_control_ptr(&control);
+  builder.set_effect_ptr(&effect);
+  builder.set_module(&module);
+  builder.BuildOutOfBoundsTrap();
+
+  //----------------------------------------------------------------------------
+  // Run the compilation pipeline.
+  //----------------------------------------------------------------------------
+  // The graph only has machine operators, so it needs no lowering.
+  wasm::FunctionSig sig(0, 0, nullptr);
+  CallDescriptor* incoming = module.GetWasmCallDescriptor(&zone, &sig);
+  CompilationInfo info("wasm-out-of-bounds-trap", isolate, &zone);
+  info.set_output_code_kind(Code::WASM_FUNCTION);
+  Handle<Code> code =
+      Pipeline::GenerateCodeForTesting(&info, incoming, &graph, nullptr);
+  if (!code.is_null()) {
+    PROFILE(isolate, CodeCreateEvent(Logger::FUNCTION_TAG, *code,
+                                     "WASM out-of-bounds trap"));
+  }
+  return code;
+}
+
+
+Handle<JSFunction> NewBatchedJSToWasmFunction(Isolate* isolate,
+                                              Handle<String> name,
+                                              Handle<Code> wrapper_code) {
+  Handle<SharedFunctionInfo> shared =
+      isolate->factory()->NewSharedFunctionInfo(name, wrapper_code, false);
+  shared->set_length(1);
+  shared->set_internal_formal_parameter_count(1 + 1);
+  Handle<JSFunction> function = isolate->factory()->NewFunction(name);
+  function->set_shared(*shared);
+  function->set_code(*wrapper_code);
+  return function;
+}
+
+
 Handle<Code> CompileWasmToJSWrapper(Isolate* isolate, wasm::ModuleEnv* module,
                                     Handle<JSFunction> function,
                                     uint32_t index) {
@@ -1743,70 +2758,113 @@ Handle<Code> CompileWasmToJSWrapper(Isolate* isolate, wasm::ModuleEnv* module,
       code->Disassemble(buffer, os);
     }
 #endif
+    RecordWasmCodeCreation(isolate, module->module, index,
+                           "WASM->JS function wrapper", code);
   }
   return code;
 }
 
 
-// Helper function to compile a single function.
-Handle<Code> CompileWasmFunction(wasm::ErrorThrower& thrower, Isolate* isolate,
-                                 wasm::ModuleEnv* module_env,
-                                 const wasm::WasmFunction& function,
-                                 int index) {
+WasmCompilationUnit::WasmCompilationUnit(Isolate* isolate,
+                                         wasm::ModuleEnv* module_env,
+                                         const wasm::WasmFunction* function,
+                                         uint32_t index,
+                                         wasm::WasmCompilationStats* stats)
+    : isolate_(isolate),
+      module_env_(module_env),
+      function_(function),
+      index_(index),
+      stats_(stats),
+      decode_time_(0),
+      node_count_(0) {
+  // Initialize the function environment for decoding.
+  env_.module = module_env;
+  env_.sig = function->sig;
+  env_.local_int32_count = function->local_int32_count;
+  env_.local_int64_count = function->local_int64_count;
+  env_.local_float32_count = function->local_float32_count;
+  env_.local_float64_count = function->local_float64_count;
+  env_.local_simd128_count = function->local_simd128_count;
+  env_.SumLocals();
+
+  // Set up the TF graph in this unit's zone. Everything that allocates on the
+  // heap happens here, on the main thread.
+  Graph* graph = new (&zone_) Graph(&zone_);
+  CommonOperatorBuilder* common = new (&zone_) CommonOperatorBuilder(&zone_);
+  MachineOperatorBuilder* machine = new (&zone_) MachineOperatorBuilder(
+      &zone_, MachineType::PointerRepresentation(),
+      InstructionSelector::SupportedMachineOperatorFlags());
+  jsgraph_ = new (&zone_)
+      JSGraph(isolate, graph, common, nullptr, nullptr, machine);
+  builder_.Reset(new WasmGraphBuilder(&zone_, jsgraph_));
+  builder_->PrepareHeapConstants();
+  builder_->set_inlining(true);
+}
+
+
+WasmCompilationUnit::~WasmCompilationUnit() {}
+
+
+void WasmCompilationUnit::ExecuteCompilation() {
   if (FLAG_trace_wasm_compiler || FLAG_trace_wasm_decode_time) {
     // TODO(titzer): clean me up a bit.
     OFStream os(stdout);
-    os << "Compiling WASM function #" << index << ":";
-    if (function.name_offset > 0) {
-      os << module_env->module->GetName(function.name_offset);
+    os << "Compiling WASM function #" << index_ << ":";
+    if (function_->name_offset > 0) {
+      os << module_env_->module->GetName(function_->name_offset);
     }
     os << std::endl;
   }
-  // Initialize the function environment for decoding.
-  wasm::FunctionEnv env;
-  env.module = module_env;
-  env.sig = function.sig;
-  env.local_int32_count = function.local_int32_count;
-  env.local_int64_count = function.local_int64_count;
-  env.local_float32_count = function.local_float32_count;
-  env.local_float64_count = function.local_float64_count;
-  env.SumLocals();
-
+  base::ElapsedTimer decode_timer;
+  if (stats_) decode_timer.Start();
   // Create a TF graph during decoding.
-  Zone zone;
-  Graph graph(&zone);
-  CommonOperatorBuilder common(&zone);
-  MachineOperatorBuilder machine(
-      &zone, MachineType::PointerRepresentation(),
-      InstructionSelector::SupportedMachineOperatorFlags());
-  JSGraph jsgraph(isolate, &graph, &common, nullptr, nullptr, &machine);
-  WasmGraphBuilder builder(&zone, &jsgraph);
-  wasm::TreeResult result = wasm::BuildTFGraph(
-      &builder, &env,                                                 // --
-      module_env->module->module_start,                               // --
-      module_env->module->module_start + function.code_start_offset,  // --
-      module_env->module->module_start + function.code_end_offset);   // --
+  const byte* module_start = module_env_->module->module_start;
+  result_ = wasm::BuildTFGraph(
+      builder_.get(), &env_,                           // --
+      module_start,                                    // --
+      module_start + function_->code_start_offset,     // --
+      module_start + function_->code_end_offset);      // --
+  if (stats_) {
+    decode_time_ = decode_timer.Elapsed().InMillisecondsF();
+    node_count_ = jsgraph_->graph()->NodeCount();
+  }
+}
 
-  if (result.failed()) {
+
+Handle<Code> WasmCompilationUnit::FinishCompilation(
+    wasm::ErrorThrower& thrower) {
+  if (result_.failed()) {
     if (FLAG_trace_wasm_compiler) {
       OFStream os(stdout);
-      os << "Compilation failed: " << result << std::endl;
+      os << "Compilation failed: " << result_ << std::endl;
     }
     // Add the function as another context for the exception
     char buffer[256];
-    snprintf(buffer, 256, "Compiling WASM function #%d:%s failed:", index,
-             module_env->module->GetName(function.name_offset));
-    thrower.Failed(buffer, result);
+    snprintf(buffer, 256, "Compiling WASM function #%d:%s failed:", index_,
+             module_env_->module->GetName(function_->name_offset));
+    thrower.Failed(buffer, result_);
     return Handle<Code>::null();
   }
 
   // Run the compiler pipeline to generate machine code.
   CallDescriptor* descriptor = const_cast<CallDescriptor*>(
-      module_env->GetWasmCallDescriptor(&zone, function.sig));
-  CompilationInfo info("wasm", isolate, &zone);
+      module_env_->GetWasmCallDescriptor(&zone_, function_->sig));
+  CompilationInfo info("wasm", isolate_, &zone_);
   info.set_output_code_kind(Code::WASM_FUNCTION);
+  base::ElapsedTimer pipeline_timer;
+  if (stats_) pipeline_timer.Start();
   Handle<Code> code =
-      Pipeline::GenerateCodeForTesting(&info, descriptor, &graph);
+      Pipeline::GenerateCodeForTesting(&info, descriptor, jsgraph_->graph());
+  if (stats_ && !code.is_null()) {
+    wasm::WasmFunctionStats function_stats;
+    function_stats.index = index_;
+    function_stats.decode_time = decode_time_;
+    function_stats.node_count = node_count_;
+    function_stats.pipeline_time = pipeline_timer.Elapsed().InMillisecondsF();
+    function_stats.code_size = code->instruction_size();
+    function_stats.graph_zone_bytes = zone_.allocation_size();
+    stats_->functions.push_back(function_stats);
+  }
 
 #ifdef ENABLE_DISASSEMBLER
   // Disassemble the code for debugging.
@@ -1814,17 +2872,32 @@ Handle<Code> CompileWasmFunction(wasm::ErrorThrower& thrower, Isolate* isolate,
     static const int kBufferSize = 128;
     char buffer[kBufferSize];
     const char* name = "";
-    if (function.name_offset > 0) {
-      const byte* ptr = module_env->module->module_start + function.name_offset;
+    if (function_->name_offset > 0) {
+      const byte* ptr =
+          module_env_->module->module_start + function_->name_offset;
       name = reinterpret_cast<const char*>(ptr);
     }
-    snprintf(buffer, kBufferSize, "WASM function #%d:%s", index, name);
+    snprintf(buffer, kBufferSize, "WASM function #%d:%s", index_, name);
     OFStream os(stdout);
     code->Disassemble(buffer, os);
   }
 #endif
+  RecordWasmCodeCreation(isolate_, module_env_->module, index_,
+                         "WASM function", code);
   return code;
 }
+
+
+// Helper function to compile a single function.
+Handle<Code> CompileWasmFunction(wasm::ErrorThrower& thrower, Isolate* isolate,
+                                 wasm::ModuleEnv* module_env,
+                                 const wasm::WasmFunction& function,
+                                 int index,
+                                 wasm::WasmCompilationStats* stats) {
+  WasmCompilationUnit unit(isolate, module_env, &function, index, stats);
+  unit.ExecuteCompilation();
+  return unit.FinishCompilation(thrower);
+}
 }
 }
 }
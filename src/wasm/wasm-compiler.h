@@ -5,8 +5,11 @@
 #ifndef V8_WASM_TF_BUILDER_H_
 #define V8_WASM_TF_BUILDER_H_
 
+#include "src/base/smart-pointers.h"
 #include "src/zone.h"
+#include "src/zone-containers.h"
 
+#include "src/wasm/ast-decoder.h"
 #include "src/wasm/wasm-opcodes.h"
 
 namespace v8 {
@@ -22,6 +25,8 @@ namespace wasm {
 // Forward declarations for some WASM data structures.
 struct ModuleEnv;
 struct WasmFunction;
+struct WasmModule;
+struct WasmCompilationStats;
 class ErrorThrower;
 
 // Expose {Node} and {Graph} opaquely as {wasm::TFNode} and {wasm::TFGraph}.
@@ -30,10 +35,12 @@ typedef compiler::JSGraph TFGraph;
 }
 
 namespace compiler {
-// Compiles a single function, producing a code object.
+// Compiles a single function, producing a code object. Adds the statistics
+// of the compilation to {stats}, if given.
 Handle<Code> CompileWasmFunction(wasm::ErrorThrower& thrower, Isolate* isolate,
                                  wasm::ModuleEnv* module_env,
-                                 const wasm::WasmFunction& function, int index);
+                                 const wasm::WasmFunction& function, int index,
+                                 wasm::WasmCompilationStats* stats = nullptr);
 
 // Wraps a JS function, producing a code object that can be called from WASM.
 Handle<Code> CompileWasmToJSWrapper(Isolate* isolate, wasm::ModuleEnv* module,
@@ -48,6 +55,45 @@ Handle<JSFunction> CompileJSToWasmWrapper(Isolate* isolate,
                                           Handle<Code> wasm_code,
                                           uint32_t index);
 
+// Wraps a given wasm code object, producing a JSFunction that takes the array
+// buffer of a {wasm::WasmNativeBatch} and calls the code once for each of its
+// argument tuples, for {wasm::WasmNativeEntry}.
+Handle<JSFunction> CompileBatchedJSToWasmWrapper(Isolate* isolate,
+                                                 wasm::ModuleEnv* module,
+                                                 Handle<String> name,
+                                                 Handle<Code> wasm_code,
+                                                 uint32_t index);
+
+// Compiles the code that out-of-bounds accesses into a guard region continue
+// in, see {wasm::SetOutOfBoundsTrapCode}. It throws the trap in {context}.
+Handle<Code> CompileOutOfBoundsTrap(Isolate* isolate, Handle<Context> context);
+
+// Creates the JSFunction for a {wasm::WasmNativeEntry} from batched JS->WASM
+// wrapper code that has already been compiled, e.g. copied from another
+// function with the same signature.
+Handle<JSFunction> NewBatchedJSToWasmFunction(Isolate* isolate,
+                                              Handle<String> name,
+                                              Handle<Code> wrapper_code);
+
+// Creates the JSFunction for an exported wasm function from JS->WASM wrapper
+// code that has already been compiled, e.g. copied from another instance.
+Handle<JSFunction> NewJSToWasmFunction(Isolate* isolate,
+                                       wasm::ModuleEnv* module,
+                                       Handle<String> name,
+                                       Handle<Code> wasm_code,
+                                       Handle<Code> wrapper_code,
+                                       uint32_t index);
+
+// Reports {code}, of the {kind} given as in "WASM function", for the function
+// {index} of {module} to the code event listeners, such as the perf map and
+// jitdump writers of --perf-basic-prof and --perf-prof. The code is named
+// after its kind, the function index and name, and the module, which is
+// identified by the hash of its bytes if it has shared bytes and by their
+// address otherwise. Does nothing unless code events are logged.
+void RecordWasmCodeCreation(Isolate* isolate, wasm::WasmModule* module,
+                            uint32_t index, const char* kind,
+                            Handle<Code> code);
+
 // Abstracts details of building TurboFan graph nodes for WASM to separate
 // the WASM decoder from the internal details of TurboFan.
 class WasmTrapHelper;
@@ -69,7 +115,11 @@ class WasmGraphBuilder {
   // Operations independent of {control} or {effect}.
   //-----------------------------------------------------------------------
   Node* Error();
+  // The start of the graph and the effect at the start. While the body of a
+  // callee is inlined, these are the control and effect before the call, and
+  // its parameters are the arguments of the call.
   Node* Start(unsigned params);
+  Node* StartEffect();
   Node* Param(unsigned index, wasm::LocalType type);
   Node* Loop(Node* entry);
   Node* Terminate(Node* effect, Node* control);
@@ -99,11 +149,18 @@ class WasmGraphBuilder {
   Node* ReturnVoid();
   Node* Unreachable();
 
+  // Calls the function {index}, or inlines its body if inlining is enabled
+  // and the body is small enough. Inlining a callee that never returns leaves
+  // {control} and {effect} null.
   Node* CallDirect(uint32_t index, Node** args);
   Node* CallIndirect(uint32_t index, Node** args);
   void BuildJSToWasmWrapper(Handle<Code> wasm_code, wasm::FunctionSig* sig);
+  void BuildBatchedJSToWasmWrapper(Handle<Code> wasm_code,
+                                   wasm::FunctionSig* sig);
   void BuildWasmToJSWrapper(Handle<JSFunction> function,
                             wasm::FunctionSig* sig);
+  // Builds a function without parameters that throws the out-of-bounds trap.
+  void BuildOutOfBoundsTrap();
   Node* ToJS(Node* node, Node* context, wasm::LocalType type);
   Node* FromJS(Node* node, Node* context, wasm::LocalType type);
   Node* Invert(Node* node);
@@ -113,14 +170,36 @@ class WasmGraphBuilder {
   // Operations that concern the linear memory.
   //-----------------------------------------------------------------------
   Node* MemSize(uint32_t offset);
+  Node* GrowMemory(Node* delta);
   Node* LoadGlobal(uint32_t index);
   Node* StoreGlobal(uint32_t index, Node* val);
   Node* LoadMem(wasm::LocalType type, MachineType memtype, Node* index,
                 uint32_t offset);
   Node* StoreMem(MachineType type, Node* index, uint32_t offset, Node* val);
+  // Builds the atomic {opcode} on the 32-bit integer at {index} + {offset}.
+  // Atomic loads and stores use the opcodes of 32-bit integer loads and
+  // stores. {operand} is only used by the operations with three inputs.
+  Node* AtomicOp(wasm::WasmOpcode opcode, Node* index, uint32_t offset,
+                 Node* value = nullptr, Node* operand = nullptr);
+
+  //-----------------------------------------------------------------------
+  // SIMD operations. A SIMD value is lowered to its four 32-bit lanes, which
+  // are bundled into a single node that is only used by the builder.
+  //-----------------------------------------------------------------------
+  Node* SimdExtractLane(wasm::WasmOpcode opcode, int lane, Node* input);
+  Node* SimdReplaceLane(wasm::WasmOpcode opcode, int lane, Node* input,
+                        Node* replacement);
+  // Selects the result lanes from the eight lanes of {left} and {right}.
+  Node* SimdShuffle(const byte* lanes, Node* left, Node* right);
+  Node* SimdLoadMem(Node* index, uint32_t offset);
+  Node* SimdStoreMem(Node* index, uint32_t offset, Node* val);
 
   static void PrintDebugName(Node* node);
 
+  // Allocates the heap constants referenced by trap code ahead of time, so
+  // that building the rest of the graph does not need to touch the heap.
+  void PrepareHeapConstants();
+
   Node* Control() { return *control; }
   Node* Effect() { return *effect; }
 
@@ -130,15 +209,50 @@ class WasmGraphBuilder {
 
   void set_effect_ptr(Node** effect) { this->effect = effect; }
 
+  void set_inlining(bool inlining) { this->inlining = inlining; }
+
  private:
   static const int kDefaultBufferSize = 16;
+  static const int kBoundsCheckCacheSize = 8;
+  // The limits for inlining: the size of the body of an inlined callee, the
+  // nesting of inlined calls, and the size of all bodies inlined into one
+  // function, in bytes.
+  static const int kMaxInlinedFunctionSize = 32;
+  static const int kMaxInliningDepth = 2;
+  static const int kInliningBudget = 1024;
   friend class WasmTrapHelper;
 
+  // A call whose callee body is being inlined. The returns of the body are
+  // collected to be merged into the code after the call.
+  struct InlinedCall {
+    explicit InlinedCall(Zone* zone)
+        : controls(zone), effects(zone), values(zone) {}
+
+    Node** args;                 // the arguments, after the code object.
+    Node* control;               // the control before the call.
+    Node* effect;                // the effect before the call.
+    ZoneVector<Node*> controls;  // the controls of the returns.
+    ZoneVector<Node*> effects;   // the effects of the returns.
+    ZoneVector<Node*> values;    // the values returned, if any.
+  };
+
+  // A bounds check built for a memory access. Later accesses to the same
+  // index that it covers need no check of their own.
+  struct BoundsCheck {
+    Node* index;       // the index checked, or nullptr for constant indexes.
+    uint64_t end;      // the end of the accesses checked, past the index.
+    Node* branch;      // the branch to the trap.
+    Node* control;     // the control after the check.
+    Node* effect;      // the effect before the check.
+    int side_effects;  // the number of side effects built before the check.
+  };
+
   Zone* zone;
   JSGraph* graph;
   wasm::ModuleEnv* module;
   Node* mem_buffer;
   Node* mem_size;
+  Node* globals_area;
   Node* function_table;
   Node** control;
   Node** effect;
@@ -146,20 +260,74 @@ class WasmGraphBuilder {
   size_t cur_bufsize;
   Node* def_buffer[kDefaultBufferSize];
 
+  // The most recent bounds checks, replaced round-robin.
+  BoundsCheck bounds_checks[kBoundsCheckCacheSize];
+  int next_bounds_check;
+  // The number of stores and calls built so far.
+  int side_effects;
+  // The number of calls built so far. Calls may grow the memory, so code
+  // after a call loads the memory size again, into {mem_size_after_call}.
+  int calls;
+  Node* mem_size_after_call;
+  int mem_size_calls;  // {calls} when {mem_size_after_call} was loaded.
+  // The loop built last, and the number of side effects built before it.
+  Node* current_loop;
+  int loop_side_effects;
+
+  bool inlining;              // true if small direct callees are inlined.
+  InlinedCall* inlined_call;  // the innermost call being inlined, if any.
+  int inlining_depth;         // the number of calls being inlined.
+  int inlined_bytes;          // the size of the bodies inlined so far.
+
   WasmTrapHelper* trap;
 
   // Internal helper methods.
   Node* String(const char* string);
   Node* MemBuffer(uint32_t offset);
-  void BoundsCheckMem(MachineType memtype, Node* index, uint32_t offset);
+  Node* GlobalsArea();
+  Node* LoadInstanceField(MachineType type, int offset);
+  // Checks the bounds of a memory access of {size} bytes and returns the
+  // index to access the memory with.
+  Node* BoundsCheckMem(uint32_t size, Node* index, uint32_t offset);
+  // Returns true if the access of {size} bytes at {offset} goes to a memory
+  // in a guard region without a bounds check, see {kGuardRegionBoundsChecks}.
+  bool IsGuardedAccess(uint32_t size, uint32_t offset);
+  // Builds the condition that {index + end} is within the memory, where a
+  // null {index} stands for index 0.
+  Node* BoundsCheckCondition(Node* index, uint64_t end);
+  // Returns {true} if an earlier check covers {index + end}, possibly after
+  // extending that check to {end}.
+  bool FindBoundsCheck(Node* index, uint64_t end);
+  void AddBoundsCheck(Node* index, uint64_t end);
+  // Returns {true} if the control node {dominator} dominates {node}.
+  bool Dominates(Node* dominator, Node* node);
 
   Node* BuildWasmCall(wasm::FunctionSig* sig, Node** args);
+  // Converts the JavaScript value {node} to a number. Smis and heap numbers
+  // are checked for inline, and only other values call ToNumber.
+  Node* BuildJavaScriptToNumber(Node* node, Node* context);
+  // Inlines the body of the function {index} at a call with {args} and
+  // returns {true}, with the returned value in {result}, or returns {false}
+  // if the callee cannot be inlined.
+  bool InlineCall(uint32_t index, Node** args, Node** result);
   Node* BuildF32CopySign(Node* left, Node* right);
   Node* BuildF64CopySign(Node* left, Node* right);
   Node* BuildI32Ctz(Node* input);
   Node* BuildI32Popcnt(Node* input);
   Node* BuildI64Ctz(Node* input);
   Node* BuildI64Popcnt(Node* input);
+  // Rounds {input} with the float rounding {opcode} on machines without a
+  // rounding instruction.
+  Node* BuildFloatRound(wasm::WasmOpcode opcode, Node* input);
+
+  // Helpers for the lowering of SIMD values to their lanes.
+  Node* SimdValue(Node** lanes);
+  bool IsSimdValue(Node* node);
+  Node* SimdLane(Node* simd, int lane, wasm::LocalType type);
+  Node* SimdLaneValue(Node* value, wasm::LocalType type);
+  Node* SimdPhi(unsigned count, Node** vals, Node* control);
+  Node* SimdBinop(wasm::WasmOpcode opcode, Node* left, Node* right);
+  Node* SimdUnop(wasm::WasmOpcode opcode, Node* input);
 
   Node** Realloc(Node** buffer, size_t count) {
     Node** buf = Buffer(count);
@@ -167,6 +335,42 @@ class WasmGraphBuilder {
     return buf;
   }
 };
+
+// A single function compilation, split into a graph building phase that
+// does not allocate on the JS heap and can therefore run on a background
+// thread, and a code generation phase that must run on the main thread.
+// With {stats}, both phases are measured, and the statistics are added to
+// {stats} once the code is generated.
+class WasmCompilationUnit {
+ public:
+  WasmCompilationUnit(Isolate* isolate, wasm::ModuleEnv* module_env,
+                      const wasm::WasmFunction* function, uint32_t index,
+                      wasm::WasmCompilationStats* stats = nullptr);
+  ~WasmCompilationUnit();
+
+  // Decodes the function body and builds the TurboFan graph.
+  void ExecuteCompilation();
+  // Runs the TurboFan pipeline on the graph and returns the code object, or
+  // reports the decoding error to {thrower} and returns null.
+  Handle<Code> FinishCompilation(wasm::ErrorThrower& thrower);
+
+  bool ok() const { return result_.ok(); }
+  uint32_t index() const { return index_; }
+
+ private:
+  Isolate* isolate_;
+  wasm::ModuleEnv* module_env_;
+  const wasm::WasmFunction* function_;
+  uint32_t index_;
+  wasm::FunctionEnv env_;
+  Zone zone_;
+  JSGraph* jsgraph_;
+  base::SmartPointer<WasmGraphBuilder> builder_;
+  wasm::TreeResult result_;
+  wasm::WasmCompilationStats* stats_;
+  double decode_time_;
+  size_t node_count_;
+};
 }
 }
 }  // namespace v8::internal::wasm
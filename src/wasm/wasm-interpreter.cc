@@ -0,0 +1,1068 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "src/base/bits.h"
+#include "src/isolate.h"
+
+#include "src/wasm/ast-decoder.h"
+#include "src/wasm/wasm-interpreter.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+namespace {
+// Reads a value of type {T} from a possibly unaligned address.
+template <typename T>
+T ReadUnaligned(const byte* ptr) {
+  T value;
+  memcpy(&value, ptr, sizeof(T));
+  return value;
+}
+
+template <typename T>
+void WriteUnaligned(byte* ptr, T value) {
+  memcpy(ptr, &value, sizeof(T));
+}
+
+uint32_t ReadLEB128(const byte* pc, const byte* end, int* length) {
+  uint32_t result = 0;
+  ReadUnsignedLEB128Operand(pc, end, length, &result);
+  return result;
+}
+
+// Computes the length of the opcode at {pc} including its immediates, or
+// returns 0 if it is not a valid opcode.
+int OpcodeLengthAt(const byte* pc, const byte* end) {
+  WasmOpcode opcode = static_cast<WasmOpcode>(*pc);
+  if (WasmOpcodes::Signature(opcode) != nullptr) return 1;
+  int length = 0;
+  switch (opcode) {
+    case kExprNop:
+    case kExprIf:
+    case kExprIfElse:
+    case kExprSelect:
+    case kExprReturn:
+    case kExprUnreachable:
+    case kExprMemorySize:
+    case kExprGrowMemory:
+      return 1;
+    case kExprI8Const:
+    case kExprBlock:
+    case kExprLoop:
+    case kExprBr:
+    case kExprBrIf:
+      return 2;
+    case kExprI32Const:
+    case kExprF32Const:
+      return 5;
+    case kExprI64Const:
+    case kExprF64Const:
+      return 9;
+    case kExprGetLocal:
+    case kExprSetLocal:
+    case kExprLoadGlobal:
+    case kExprStoreGlobal:
+    case kExprCallFunction:
+    case kExprCallIndirect:
+      ReadLEB128(pc + 1, end, &length);
+      return 1 + length;
+#define DECLARE_OPCODE_CASE(name, opcode, sig) case kExpr##name:
+      FOREACH_LOAD_MEM_OPCODE(DECLARE_OPCODE_CASE)
+      FOREACH_STORE_MEM_OPCODE(DECLARE_OPCODE_CASE)
+      FOREACH_ATOMIC_OPCODE(DECLARE_OPCODE_CASE)
+#undef DECLARE_OPCODE_CASE
+      if (pc + 1 < end && MemoryAccess::OffsetField::decode(pc[1])) {
+        ReadLEB128(pc + 2, end, &length);
+      }
+      return 2 + length;
+    case kExprTableSwitch:
+      if (end - pc < 5) return 0;
+      return 5 + 2 * ReadUnaligned<uint16_t>(pc + 3);
+    default:
+      return 0;
+  }
+}
+
+bool HasI64(FunctionSig* sig) {
+  for (size_t i = 0; i < sig->parameter_count(); i++) {
+    if (sig->GetParam(i) == kAstI64) return true;
+  }
+  for (size_t i = 0; i < sig->return_count(); i++) {
+    if (sig->GetReturn(i) == kAstI64) return true;
+  }
+  return false;
+}
+
+// Minimum and maximum with JavaScript semantics for NaN and -0.
+template <typename T>
+T JSMin(T a, T b) {
+  if (std::isnan(a)) return a;
+  if (std::isnan(b)) return b;
+  if (a == b) return std::signbit(a) ? a : b;
+  return a < b ? a : b;
+}
+
+template <typename T>
+T JSMax(T a, T b) {
+  if (std::isnan(a)) return a;
+  if (std::isnan(b)) return b;
+  if (a == b) return std::signbit(a) ? b : a;
+  return a > b ? a : b;
+}
+
+// Converts a loaded or stored integer to a value of the given local type.
+WasmVal IntVal(LocalType type, int64_t value) {
+  if (type == kAstI64) return WasmVal(value);
+  return WasmVal(static_cast<int32_t>(value));
+}
+
+int64_t IntBits(WasmVal val) {
+  return val.type == kAstI64 ? val.val.i64 : val.val.i32;
+}
+}  // namespace
+
+// The state of one interpreted function call. Expressions are evaluated
+// recursively in the order of the prefix encoding. Branches, returns and
+// traps are signalled through {signal_}; a branch unwinds until the
+// targeted block, with every expression on the way skipping its remaining
+// operands, so that {pc_} is always behind the expression just evaluated.
+class WasmInterpreter::Activation {
+ public:
+  Activation(WasmInterpreter* interpreter, const WasmFunction* function,
+             WasmVal* args)
+      : interpreter_(interpreter),
+        module_(interpreter->module_),
+        function_(function),
+        pc_(module_->module_start + function->code_start_offset),
+        end_(module_->module_start + function->code_end_offset),
+        signal_(kNone),
+        break_depth_(0) {
+    FunctionSig* sig = function->sig;
+    for (size_t i = 0; i < sig->parameter_count(); i++) {
+      locals_.push_back(args[i]);
+    }
+    locals_.insert(locals_.end(), function->local_int32_count,
+                   WasmVal(static_cast<int32_t>(0)));
+    locals_.insert(locals_.end(), function->local_int64_count,
+                   WasmVal(static_cast<int64_t>(0)));
+    locals_.insert(locals_.end(), function->local_float32_count,
+                   WasmVal(0.0f));
+    locals_.insert(locals_.end(), function->local_float64_count,
+                   WasmVal(0.0));
+  }
+
+  Outcome Run(WasmVal* result) {
+    // The body is a sequence of expressions; the last one is the result.
+    WasmVal val;
+    while (pc_ < end_ && signal_ == kNone) val = Eval();
+    switch (signal_) {
+      case kNone:
+        *result = function_->sig->return_count() > 0 ? val : WasmVal();
+        return kReturned;
+      case kReturn:
+        *result = signal_value_;
+        return kReturned;
+      case kTrap:
+        return kTrapped;
+      case kThrow:
+        return kThrew;
+      case kOverflow:
+        return kStackOverflow;
+      case kBreak:
+        break;
+    }
+    UNREACHABLE();
+    return kTrapped;
+  }
+
+ private:
+  enum Signal { kNone, kBreak, kReturn, kTrap, kThrow, kOverflow };
+
+  WasmInterpreter* interpreter_;
+  WasmModule* module_;
+  const WasmFunction* function_;
+  const byte* pc_;
+  const byte* end_;
+  std::vector<WasmVal> locals_;
+  Signal signal_;
+  uint32_t break_depth_;
+  WasmVal signal_value_;
+
+  // Everything but a branch unwinds the whole activation, so there is no
+  // need to keep {pc_} accurate.
+  bool aborted() const { return signal_ > kBreak; }
+
+  WasmVal Trap(TrapReason reason) {
+    signal_ = kTrap;
+    interpreter_->trap_reason_ = reason;
+    return WasmVal();
+  }
+
+  void Break(uint32_t depth, WasmVal val) {
+    signal_ = kBreak;
+    break_depth_ = depth;
+    signal_value_ = val;
+  }
+
+  // Ends a block: catches a branch to it, or passes a branch to an
+  // enclosing block on.
+  void EndBlock(WasmVal* val) {
+    if (signal_ != kBreak) return;
+    if (break_depth_ == 0) {
+      signal_ = kNone;
+      *val = signal_value_;
+    } else {
+      break_depth_--;
+    }
+  }
+
+  int Arity(const byte* pc) {
+    WasmOpcode opcode = static_cast<WasmOpcode>(*pc);
+    FunctionSig* sig = WasmOpcodes::Signature(opcode);
+    if (sig != nullptr) return static_cast<int>(sig->parameter_count());
+    int length;
+    switch (opcode) {
+      case kExprBlock:
+      case kExprLoop:
+        return pc[1];
+      case kExprBr:
+      case kExprSetLocal:
+      case kExprStoreGlobal:
+      case kExprGrowMemory:
+        return 1;
+      case kExprIf:
+      case kExprBrIf:
+        return 2;
+      case kExprIfElse:
+      case kExprSelect:
+        return 3;
+      case kExprReturn:
+        return static_cast<int>(function_->sig->return_count());
+      case kExprTableSwitch:
+        return 1 + ReadUnaligned<uint16_t>(pc + 1);
+      case kExprCallFunction: {
+        uint32_t index = ReadLEB128(pc + 1, end_, &length);
+        return static_cast<int>(
+            module_->functions->at(index).sig->parameter_count());
+      }
+      case kExprCallIndirect: {
+        uint32_t index = ReadLEB128(pc + 1, end_, &length);
+        return 1 + static_cast<int>(
+                       module_->signatures->at(index)->parameter_count());
+      }
+#define DECLARE_OPCODE_CASE(name, opcode, sig) case kExpr##name:
+        FOREACH_LOAD_MEM_OPCODE(DECLARE_OPCODE_CASE)
+        return 1;
+        FOREACH_STORE_MEM_OPCODE(DECLARE_OPCODE_CASE)
+        return 2;
+#undef DECLARE_OPCODE_CASE
+      default:
+        return 0;
+    }
+  }
+
+  // Skips the expression at {pc_} without evaluating it.
+  void Skip() {
+    const byte* pc = pc_;
+    int arity = Arity(pc);
+    pc_ += OpcodeLengthAt(pc, end_);
+    for (int i = 0; i < arity; i++) Skip();
+  }
+
+  void SkipOperands(int count) {
+    if (aborted()) return;
+    for (int i = 0; i < count; i++) Skip();
+  }
+
+  // Evaluates the next {count} expressions into {vals}. Returns {false} if
+  // one of them signalled, in which case the rest have been skipped.
+  bool EvalOperands(int count, WasmVal* vals) {
+    for (int i = 0; i < count; i++) {
+      vals[i] = Eval();
+      if (signal_ != kNone) {
+        SkipOperands(count - i - 1);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Evaluates the next {count} expressions and returns the value of the
+  // last one.
+  WasmVal EvalSequence(int count) {
+    WasmVal val;
+    for (int i = 0; i < count; i++) {
+      val = Eval();
+      if (signal_ != kNone) {
+        SkipOperands(count - i - 1);
+        break;
+      }
+    }
+    return val;
+  }
+
+  // Decodes the memory access immediate and advances {pc_} past it.
+  uint32_t MemoryAccessOffset() {
+    uint32_t offset = 0;
+    int length = 0;
+    if (MemoryAccess::OffsetField::decode(pc_[1])) {
+      offset = ReadLEB128(pc_ + 2, end_, &length);
+    }
+    pc_ += 2 + length;
+    return offset;
+  }
+
+  byte* BoundsCheck(WasmVal index, uint32_t offset, MachineType mem_type) {
+    uint64_t effective = static_cast<uint64_t>(
+                             static_cast<uint32_t>(index.val.i32)) +
+                         offset;
+    uint64_t size = WasmOpcodes::MemSize(mem_type);
+    if (effective + size > interpreter_->mem_size_) return nullptr;
+    return interpreter_->mem_start_ + effective;
+  }
+
+  WasmVal Load(LocalType type, MachineType mem_type, byte* addr) {
+    if (mem_type == MachineType::Int8()) {
+      return IntVal(type, ReadUnaligned<int8_t>(addr));
+    } else if (mem_type == MachineType::Uint8()) {
+      return IntVal(type, ReadUnaligned<uint8_t>(addr));
+    } else if (mem_type == MachineType::Int16()) {
+      return IntVal(type, ReadUnaligned<int16_t>(addr));
+    } else if (mem_type == MachineType::Uint16()) {
+      return IntVal(type, ReadUnaligned<uint16_t>(addr));
+    } else if (mem_type == MachineType::Int32()) {
+      return IntVal(type, ReadUnaligned<int32_t>(addr));
+    } else if (mem_type == MachineType::Uint32()) {
+      return IntVal(type, ReadUnaligned<uint32_t>(addr));
+    } else if (mem_type == MachineType::Int64() ||
+               mem_type == MachineType::Uint64()) {
+      return WasmVal(ReadUnaligned<int64_t>(addr));
+    } else if (mem_type == MachineType::Float32()) {
+      return WasmVal(ReadUnaligned<float>(addr));
+    } else if (mem_type == MachineType::Float64()) {
+      return WasmVal(ReadUnaligned<double>(addr));
+    }
+    UNREACHABLE();
+    return WasmVal();
+  }
+
+  void Store(MachineType mem_type, byte* addr, WasmVal val) {
+    switch (mem_type.representation()) {
+      case MachineRepresentation::kWord8:
+        WriteUnaligned(addr, static_cast<int8_t>(IntBits(val)));
+        break;
+      case MachineRepresentation::kWord16:
+        WriteUnaligned(addr, static_cast<int16_t>(IntBits(val)));
+        break;
+      case MachineRepresentation::kWord32:
+        WriteUnaligned(addr, static_cast<int32_t>(IntBits(val)));
+        break;
+      case MachineRepresentation::kWord64:
+        WriteUnaligned(addr, IntBits(val));
+        break;
+      case MachineRepresentation::kFloat32:
+        WriteUnaligned(addr, val.val.f32);
+        break;
+      case MachineRepresentation::kFloat64:
+        WriteUnaligned(addr, val.val.f64);
+        break;
+      default:
+        UNREACHABLE();
+    }
+  }
+
+  WasmVal EvalLoadMem(LocalType type, MachineType mem_type) {
+    uint32_t offset = MemoryAccessOffset();
+    WasmVal index = Eval();
+    if (signal_ != kNone) return WasmVal();
+    byte* addr = BoundsCheck(index, offset, mem_type);
+    if (addr == nullptr) return Trap(kTrapMemOutOfBounds);
+    return Load(type, mem_type, addr);
+  }
+
+  WasmVal EvalStoreMem(MachineType mem_type) {
+    uint32_t offset = MemoryAccessOffset();
+    WasmVal vals[2];
+    if (!EvalOperands(2, vals)) return WasmVal();
+    byte* addr = BoundsCheck(vals[0], offset, mem_type);
+    if (addr == nullptr) return Trap(kTrapMemOutOfBounds);
+    Store(mem_type, addr, vals[1]);
+    return vals[1];
+  }
+
+  WasmVal EvalCall(uint32_t index, int count, WasmVal* args) {
+    WasmVal result;
+    if (!interpreter_->host_->CallFunction(index, args, &result)) {
+      signal_ = kThrow;
+    }
+    interpreter_->mem_size_ = interpreter_->host_->MemorySize();
+    return result;
+  }
+
+  WasmVal Eval() {
+    StackLimitCheck check(interpreter_->isolate_);
+    if (check.HasOverflowed()) {
+      signal_ = kOverflow;
+      return WasmVal();
+    }
+
+    WasmOpcode opcode = static_cast<WasmOpcode>(*pc_);
+    FunctionSig* sig = WasmOpcodes::Signature(opcode);
+    if (sig != nullptr) {
+      // A simple expression with a fixed signature.
+      pc_++;
+      WasmVal vals[2];
+      int count = static_cast<int>(sig->parameter_count());
+      if (!EvalOperands(count, vals)) return WasmVal();
+      return count == 1 ? ExecuteUnop(opcode, vals[0])
+                        : ExecuteBinop(opcode, vals[0], vals[1]);
+    }
+
+    int length = 0;
+    switch (opcode) {
+      case kExprNop:
+        pc_++;
+        return WasmVal();
+      case kExprBlock: {
+        int count = pc_[1];
+        pc_ += 2;
+        WasmVal val = EvalSequence(count);
+        EndBlock(&val);
+        return val;
+      }
+      case kExprLoop: {
+        // Branches of depth 0 continue the loop, branches of depth 1 leave
+        // it, and falling off the end leaves it as well.
+        int count = pc_[1];
+        pc_ += 2;
+        const byte* body = pc_;
+        while (true) {
+          WasmVal val = EvalSequence(count);
+          if (signal_ == kBreak && break_depth_ == 0) {
+            signal_ = kNone;
+            interpreter_->back_edges_++;
+            pc_ = body;
+            continue;
+          }
+          if (signal_ == kBreak) {
+            if (break_depth_ == 1) {
+              signal_ = kNone;
+              val = signal_value_;
+            } else {
+              break_depth_ -= 2;
+            }
+          }
+          return val;
+        }
+      }
+      case kExprIf: {
+        pc_++;
+        WasmVal cond = Eval();
+        if (signal_ != kNone) {
+          SkipOperands(1);
+        } else if (cond.val.i32 != 0) {
+          Eval();
+        } else {
+          Skip();
+        }
+        return WasmVal();
+      }
+      case kExprIfElse: {
+        pc_++;
+        WasmVal cond = Eval();
+        WasmVal val;
+        if (signal_ != kNone) {
+          SkipOperands(2);
+        } else if (cond.val.i32 != 0) {
+          val = Eval();
+          SkipOperands(1);
+        } else {
+          Skip();
+          val = Eval();
+        }
+        return val;
+      }
+      case kExprSelect: {
+        pc_++;
+        WasmVal vals[3];
+        if (!EvalOperands(3, vals)) return WasmVal();
+        return vals[0].val.i32 != 0 ? vals[1] : vals[2];
+      }
+      case kExprBr: {
+        uint32_t depth = pc_[1];
+        pc_ += 2;
+        WasmVal val = Eval();
+        if (signal_ == kNone) Break(depth, val);
+        return WasmVal();
+      }
+      case kExprBrIf: {
+        uint32_t depth = pc_[1];
+        pc_ += 2;
+        WasmVal vals[2];
+        if (EvalOperands(2, vals) && vals[0].val.i32 != 0) {
+          Break(depth, vals[1]);
+        }
+        return WasmVal();
+      }
+      case kExprTableSwitch: {
+        // The switch is a block of its own: branches of depth 0 inside the
+        // cases leave it, and the cases fall through into each other.
+        int case_count = ReadUnaligned<uint16_t>(pc_ + 1);
+        uint32_t table_count = ReadUnaligned<uint16_t>(pc_ + 3);
+        const byte* table = pc_ + 5;
+        pc_ += 5 + 2 * table_count;
+        WasmVal key = Eval();
+        if (signal_ != kNone) {
+          SkipOperands(case_count);
+          return WasmVal();
+        }
+        // A switch with only a default target executes all cases.
+        uint16_t target = 0;
+        if (table_count > 1) {
+          uint32_t entry =
+              std::min(static_cast<uint32_t>(key.val.i32), table_count - 1);
+          target = ReadUnaligned<uint16_t>(table + 2 * entry);
+        }
+        WasmVal val;
+        if (target >= 0x8000) {
+          SkipOperands(case_count);
+          Break(target - 0x8000, WasmVal());
+        } else {
+          for (int i = 0; i < target; i++) Skip();
+          val = EvalSequence(case_count - target);
+        }
+        EndBlock(&val);
+        return val;
+      }
+      case kExprReturn: {
+        pc_++;
+        WasmVal val;
+        if (function_->sig->return_count() > 0) {
+          val = Eval();
+          if (signal_ != kNone) return WasmVal();
+        }
+        signal_ = kReturn;
+        signal_value_ = val;
+        return WasmVal();
+      }
+      case kExprUnreachable:
+        pc_++;
+        return Trap(kTrapUnreachable);
+      case kExprI8Const: {
+        int32_t value = static_cast<int8_t>(pc_[1]);
+        pc_ += 2;
+        return WasmVal(value);
+      }
+      case kExprI32Const:
+        pc_ += 5;
+        return WasmVal(ReadUnaligned<int32_t>(pc_ - 4));
+      case kExprI64Const:
+        pc_ += 9;
+        return WasmVal(ReadUnaligned<int64_t>(pc_ - 8));
+      case kExprF32Const:
+        pc_ += 5;
+        return WasmVal(ReadUnaligned<float>(pc_ - 4));
+      case kExprF64Const:
+        pc_ += 9;
+        return WasmVal(ReadUnaligned<double>(pc_ - 8));
+      case kExprGetLocal: {
+        uint32_t index = ReadLEB128(pc_ + 1, end_, &length);
+        pc_ += 1 + length;
+        return locals_[index];
+      }
+      case kExprSetLocal: {
+        uint32_t index = ReadLEB128(pc_ + 1, end_, &length);
+        pc_ += 1 + length;
+        WasmVal val = Eval();
+        if (signal_ == kNone) locals_[index] = val;
+        return val;
+      }
+      case kExprLoadGlobal: {
+        uint32_t index = ReadLEB128(pc_ + 1, end_, &length);
+        pc_ += 1 + length;
+        const WasmGlobal& global = module_->globals->at(index);
+        return Load(WasmOpcodes::LocalTypeFor(global.type), global.type,
+                    interpreter_->globals_area_ + global.offset);
+      }
+      case kExprStoreGlobal: {
+        uint32_t index = ReadLEB128(pc_ + 1, end_, &length);
+        pc_ += 1 + length;
+        WasmVal val = Eval();
+        if (signal_ != kNone) return WasmVal();
+        const WasmGlobal& global = module_->globals->at(index);
+        Store(global.type, interpreter_->globals_area_ + global.offset, val);
+        return val;
+      }
+      case kExprI32LoadMem8S:
+        return EvalLoadMem(kAstI32, MachineType::Int8());
+      case kExprI32LoadMem8U:
+        return EvalLoadMem(kAstI32, MachineType::Uint8());
+      case kExprI32LoadMem16S:
+        return EvalLoadMem(kAstI32, MachineType::Int16());
+      case kExprI32LoadMem16U:
+        return EvalLoadMem(kAstI32, MachineType::Uint16());
+      case kExprI32LoadMem:
+        return EvalLoadMem(kAstI32, MachineType::Int32());
+      case kExprI64LoadMem8S:
+        return EvalLoadMem(kAstI64, MachineType::Int8());
+      case kExprI64LoadMem8U:
+        return EvalLoadMem(kAstI64, MachineType::Uint8());
+      case kExprI64LoadMem16S:
+        return EvalLoadMem(kAstI64, MachineType::Int16());
+      case kExprI64LoadMem16U:
+        return EvalLoadMem(kAstI64, MachineType::Uint16());
+      case kExprI64LoadMem32S:
+        return EvalLoadMem(kAstI64, MachineType::Int32());
+      case kExprI64LoadMem32U:
+        return EvalLoadMem(kAstI64, MachineType::Uint32());
+      case kExprI64LoadMem:
+        return EvalLoadMem(kAstI64, MachineType::Int64());
+      case kExprF32LoadMem:
+        return EvalLoadMem(kAstF32, MachineType::Float32());
+      case kExprF64LoadMem:
+        return EvalLoadMem(kAstF64, MachineType::Float64());
+      case kExprI32StoreMem8:
+      case kExprI64StoreMem8:
+        return EvalStoreMem(MachineType::Int8());
+      case kExprI32StoreMem16:
+      case kExprI64StoreMem16:
+        return EvalStoreMem(MachineType::Int16());
+      case kExprI32StoreMem:
+      case kExprI64StoreMem32:
+        return EvalStoreMem(MachineType::Int32());
+      case kExprI64StoreMem:
+        return EvalStoreMem(MachineType::Int64());
+      case kExprF32StoreMem:
+        return EvalStoreMem(MachineType::Float32());
+      case kExprF64StoreMem:
+        return EvalStoreMem(MachineType::Float64());
+      case kExprMemorySize:
+        pc_++;
+        return WasmVal(static_cast<int32_t>(interpreter_->mem_size_));
+      case kExprGrowMemory: {
+        pc_++;
+        WasmVal delta = Eval();
+        if (signal_ != kNone) return WasmVal();
+        int32_t old_size = interpreter_->host_->GrowMemory(
+            static_cast<uint32_t>(delta.val.i32));
+        interpreter_->mem_size_ = interpreter_->host_->MemorySize();
+        return WasmVal(old_size);
+      }
+      case kExprCallFunction: {
+        uint32_t index = ReadLEB128(pc_ + 1, end_, &length);
+        pc_ += 1 + length;
+        int count = static_cast<int>(
+            module_->functions->at(index).sig->parameter_count());
+        std::vector<WasmVal> args(count);
+        if (!EvalOperands(count, args.data())) return WasmVal();
+        return EvalCall(index, count, args.data());
+      }
+      case kExprCallIndirect: {
+        uint32_t sig_index = ReadLEB128(pc_ + 1, end_, &length);
+        pc_ += 1 + length;
+        int count = 1 + static_cast<int>(
+                            module_->signatures->at(sig_index)
+                                ->parameter_count());
+        std::vector<WasmVal> args(count);
+        if (!EvalOperands(count, args.data())) return WasmVal();
+        uint32_t key = static_cast<uint32_t>(args[0].val.i32);
+        ZoneVector<uint16_t>* table = module_->function_table;
+        if (table == nullptr || key >= table->size()) {
+          return Trap(kTrapFuncInvalid);
+        }
+        uint32_t index = table->at(key);
+        uint16_t callee_sig = module_->functions->at(index).sig_index;
+        if (module_->CanonicalSigIndex(callee_sig) !=
+            module_->CanonicalSigIndex(sig_index)) {
+          return Trap(kTrapFuncSigMismatch);
+        }
+        return EvalCall(index, count - 1, args.data() + 1);
+      }
+      default:
+        break;
+    }
+    UNREACHABLE();
+    return WasmVal();
+  }
+
+  WasmVal ExecuteBinop(WasmOpcode opcode, WasmVal a, WasmVal b) {
+    int32_t i32a = a.val.i32, i32b = b.val.i32;
+    uint32_t u32a = static_cast<uint32_t>(i32a);
+    uint32_t u32b = static_cast<uint32_t>(i32b);
+    int64_t i64a = a.val.i64, i64b = b.val.i64;
+    uint64_t u64a = static_cast<uint64_t>(i64a);
+    uint64_t u64b = static_cast<uint64_t>(i64b);
+    float f32a = a.val.f32, f32b = b.val.f32;
+    double f64a = a.val.f64, f64b = b.val.f64;
+    switch (opcode) {
+      case kExprI32Add:
+        return WasmVal(static_cast<int32_t>(u32a + u32b));
+      case kExprI32Sub:
+        return WasmVal(static_cast<int32_t>(u32a - u32b));
+      case kExprI32Mul:
+        return WasmVal(static_cast<int32_t>(u32a * u32b));
+      case kExprI32DivS:
+        if (i32b == 0) return Trap(kTrapDivByZero);
+        if (i32b == -1 && i32a == kMinInt) {
+          return Trap(kTrapDivUnrepresentable);
+        }
+        return WasmVal(i32a / i32b);
+      case kExprI32DivU:
+        if (u32b == 0) return Trap(kTrapDivByZero);
+        return WasmVal(static_cast<int32_t>(u32a / u32b));
+      case kExprI32RemS:
+        if (i32b == 0) return Trap(kTrapRemByZero);
+        if (i32b == -1) return WasmVal(static_cast<int32_t>(0));
+        return WasmVal(i32a % i32b);
+      case kExprI32RemU:
+        if (u32b == 0) return Trap(kTrapRemByZero);
+        return WasmVal(static_cast<int32_t>(u32a % u32b));
+      case kExprI32And:
+        return WasmVal(i32a & i32b);
+      case kExprI32Ior:
+        return WasmVal(i32a | i32b);
+      case kExprI32Xor:
+        return WasmVal(i32a ^ i32b);
+      case kExprI32Shl:
+        return WasmVal(static_cast<int32_t>(u32a << (u32b & 31)));
+      case kExprI32ShrU:
+        return WasmVal(static_cast<int32_t>(u32a >> (u32b & 31)));
+      case kExprI32ShrS:
+        return WasmVal(i32a >> (u32b & 31));
+      case kExprI32Eq:
+        return WasmVal(static_cast<int32_t>(i32a == i32b));
+      case kExprI32Ne:
+        return WasmVal(static_cast<int32_t>(i32a != i32b));
+      case kExprI32LtS:
+        return WasmVal(static_cast<int32_t>(i32a < i32b));
+      case kExprI32LeS:
+        return WasmVal(static_cast<int32_t>(i32a <= i32b));
+      case kExprI32LtU:
+        return WasmVal(static_cast<int32_t>(u32a < u32b));
+      case kExprI32LeU:
+        return WasmVal(static_cast<int32_t>(u32a <= u32b));
+      case kExprI32GtS:
+        return WasmVal(static_cast<int32_t>(i32a > i32b));
+      case kExprI32GeS:
+        return WasmVal(static_cast<int32_t>(i32a >= i32b));
+      case kExprI32GtU:
+        return WasmVal(static_cast<int32_t>(u32a > u32b));
+      case kExprI32GeU:
+        return WasmVal(static_cast<int32_t>(u32a >= u32b));
+
+      case kExprI64Add:
+        return WasmVal(static_cast<int64_t>(u64a + u64b));
+      case kExprI64Sub:
+        return WasmVal(static_cast<int64_t>(u64a - u64b));
+      case kExprI64Mul:
+        return WasmVal(static_cast<int64_t>(u64a * u64b));
+      case kExprI64DivS:
+        if (i64b == 0) return Trap(kTrapDivByZero);
+        if (i64b == -1 && i64a == std::numeric_limits<int64_t>::min()) {
+          return Trap(kTrapDivUnrepresentable);
+        }
+        return WasmVal(i64a / i64b);
+      case kExprI64DivU:
+        if (u64b == 0) return Trap(kTrapDivByZero);
+        return WasmVal(static_cast<int64_t>(u64a / u64b));
+      case kExprI64RemS:
+        if (i64b == 0) return Trap(kTrapRemByZero);
+        if (i64b == -1) return WasmVal(static_cast<int64_t>(0));
+        return WasmVal(i64a % i64b);
+      case kExprI64RemU:
+        if (u64b == 0) return Trap(kTrapRemByZero);
+        return WasmVal(static_cast<int64_t>(u64a % u64b));
+      case kExprI64And:
+        return WasmVal(i64a & i64b);
+      case kExprI64Ior:
+        return WasmVal(i64a | i64b);
+      case kExprI64Xor:
+        return WasmVal(i64a ^ i64b);
+      case kExprI64Shl:
+        return WasmVal(static_cast<int64_t>(u64a << (u64b & 63)));
+      case kExprI64ShrU:
+        return WasmVal(static_cast<int64_t>(u64a >> (u64b & 63)));
+      case kExprI64ShrS:
+        return WasmVal(i64a >> (u64b & 63));
+      case kExprI64Eq:
+        return WasmVal(static_cast<int32_t>(i64a == i64b));
+      case kExprI64Ne:
+        return WasmVal(static_cast<int32_t>(i64a != i64b));
+      case kExprI64LtS:
+        return WasmVal(static_cast<int32_t>(i64a < i64b));
+      case kExprI64LeS:
+        return WasmVal(static_cast<int32_t>(i64a <= i64b));
+      case kExprI64LtU:
+        return WasmVal(static_cast<int32_t>(u64a < u64b));
+      case kExprI64LeU:
+        return WasmVal(static_cast<int32_t>(u64a <= u64b));
+      case kExprI64GtS:
+        return WasmVal(static_cast<int32_t>(i64a > i64b));
+      case kExprI64GeS:
+        return WasmVal(static_cast<int32_t>(i64a >= i64b));
+      case kExprI64GtU:
+        return WasmVal(static_cast<int32_t>(u64a > u64b));
+      case kExprI64GeU:
+        return WasmVal(static_cast<int32_t>(u64a >= u64b));
+
+      case kExprF32Add:
+        return WasmVal(f32a + f32b);
+      case kExprF32Sub:
+        return WasmVal(f32a - f32b);
+      case kExprF32Mul:
+        return WasmVal(f32a * f32b);
+      case kExprF32Div:
+        return WasmVal(f32a / f32b);
+      case kExprF32Min:
+        return WasmVal(JSMin(f32a, f32b));
+      case kExprF32Max:
+        return WasmVal(JSMax(f32a, f32b));
+      case kExprF32CopySign:
+        return WasmVal(std::copysign(f32a, f32b));
+      case kExprF32Eq:
+        return WasmVal(static_cast<int32_t>(f32a == f32b));
+      case kExprF32Ne:
+        return WasmVal(static_cast<int32_t>(f32a != f32b));
+      case kExprF32Lt:
+        return WasmVal(static_cast<int32_t>(f32a < f32b));
+      case kExprF32Le:
+        return WasmVal(static_cast<int32_t>(f32a <= f32b));
+      case kExprF32Gt:
+        return WasmVal(static_cast<int32_t>(f32a > f32b));
+      case kExprF32Ge:
+        return WasmVal(static_cast<int32_t>(f32a >= f32b));
+
+      case kExprF64Add:
+        return WasmVal(f64a + f64b);
+      case kExprF64Sub:
+        return WasmVal(f64a - f64b);
+      case kExprF64Mul:
+        return WasmVal(f64a * f64b);
+      case kExprF64Div:
+        return WasmVal(f64a / f64b);
+      case kExprF64Min:
+        return WasmVal(JSMin(f64a, f64b));
+      case kExprF64Max:
+        return WasmVal(JSMax(f64a, f64b));
+      case kExprF64CopySign:
+        return WasmVal(std::copysign(f64a, f64b));
+      case kExprF64Eq:
+        return WasmVal(static_cast<int32_t>(f64a == f64b));
+      case kExprF64Ne:
+        return WasmVal(static_cast<int32_t>(f64a != f64b));
+      case kExprF64Lt:
+        return WasmVal(static_cast<int32_t>(f64a < f64b));
+      case kExprF64Le:
+        return WasmVal(static_cast<int32_t>(f64a <= f64b));
+      case kExprF64Gt:
+        return WasmVal(static_cast<int32_t>(f64a > f64b));
+      case kExprF64Ge:
+        return WasmVal(static_cast<int32_t>(f64a >= f64b));
+      default:
+        break;
+    }
+    UNREACHABLE();
+    return WasmVal();
+  }
+
+  WasmVal ExecuteUnop(WasmOpcode opcode, WasmVal a) {
+    int32_t i32 = a.val.i32;
+    uint32_t u32 = static_cast<uint32_t>(i32);
+    int64_t i64 = a.val.i64;
+    uint64_t u64 = static_cast<uint64_t>(i64);
+    float f32 = a.val.f32;
+    double f64 = a.val.f64;
+    switch (opcode) {
+      case kExprI32Clz:
+        return WasmVal(
+            static_cast<int32_t>(base::bits::CountLeadingZeros32(u32)));
+      case kExprI32Ctz:
+        return WasmVal(
+            static_cast<int32_t>(base::bits::CountTrailingZeros32(u32)));
+      case kExprI32Popcnt:
+        return WasmVal(
+            static_cast<int32_t>(base::bits::CountPopulation32(u32)));
+      case kExprBoolNot:
+        return WasmVal(static_cast<int32_t>(i32 == 0));
+      case kExprI64Clz:
+        return WasmVal(
+            static_cast<int64_t>(base::bits::CountLeadingZeros64(u64)));
+      case kExprI64Ctz:
+        return WasmVal(
+            static_cast<int64_t>(base::bits::CountTrailingZeros64(u64)));
+      case kExprI64Popcnt:
+        return WasmVal(
+            static_cast<int64_t>(base::bits::CountPopulation64(u64)));
+
+      case kExprF32Abs:
+        return WasmVal(std::fabs(f32));
+      case kExprF32Neg:
+        return WasmVal(-f32);
+      case kExprF32Ceil:
+        return WasmVal(std::ceil(f32));
+      case kExprF32Floor:
+        return WasmVal(std::floor(f32));
+      case kExprF32Trunc:
+        return WasmVal(std::trunc(f32));
+      case kExprF32NearestInt:
+        return WasmVal(std::nearbyint(f32));
+      case kExprF32Sqrt:
+        return WasmVal(std::sqrt(f32));
+      case kExprF64Abs:
+        return WasmVal(std::fabs(f64));
+      case kExprF64Neg:
+        return WasmVal(-f64);
+      case kExprF64Ceil:
+        return WasmVal(std::ceil(f64));
+      case kExprF64Floor:
+        return WasmVal(std::floor(f64));
+      case kExprF64Trunc:
+        return WasmVal(std::trunc(f64));
+      case kExprF64NearestInt:
+        return WasmVal(std::nearbyint(f64));
+      case kExprF64Sqrt:
+        return WasmVal(std::sqrt(f64));
+
+      // Float to integer conversions trap if the truncated value is not
+      // representable in the result type.
+      case kExprI32SConvertF32:
+        f64 = f32;
+      // Fall through.
+      case kExprI32SConvertF64:
+        if (!(f64 > -2147483649.0 && f64 < 2147483648.0)) {
+          return Trap(kTrapFloatUnrepresentable);
+        }
+        return WasmVal(static_cast<int32_t>(f64));
+      case kExprI32UConvertF32:
+        f64 = f32;
+      // Fall through.
+      case kExprI32UConvertF64:
+        if (!(f64 > -1.0 && f64 < 4294967296.0)) {
+          return Trap(kTrapFloatUnrepresentable);
+        }
+        return WasmVal(static_cast<int32_t>(static_cast<uint32_t>(f64)));
+      case kExprI64SConvertF32:
+        f64 = f32;
+      // Fall through.
+      case kExprI64SConvertF64:
+        if (!(f64 >= -9223372036854775808.0 && f64 < 9223372036854775808.0)) {
+          return Trap(kTrapFloatUnrepresentable);
+        }
+        return WasmVal(static_cast<int64_t>(f64));
+      case kExprI64UConvertF32:
+        f64 = f32;
+      // Fall through.
+      case kExprI64UConvertF64:
+        if (!(f64 > -1.0 && f64 < 18446744073709551616.0)) {
+          return Trap(kTrapFloatUnrepresentable);
+        }
+        return WasmVal(static_cast<int64_t>(static_cast<uint64_t>(f64)));
+
+      case kExprI32ConvertI64:
+        return WasmVal(static_cast<int32_t>(i64));
+      case kExprI64SConvertI32:
+        return WasmVal(static_cast<int64_t>(i32));
+      case kExprI64UConvertI32:
+        return WasmVal(static_cast<int64_t>(u32));
+      case kExprF32SConvertI32:
+        return WasmVal(static_cast<float>(i32));
+      case kExprF32UConvertI32:
+        return WasmVal(static_cast<float>(u32));
+      case kExprF32SConvertI64:
+        return WasmVal(static_cast<float>(i64));
+      case kExprF32UConvertI64:
+        return WasmVal(static_cast<float>(u64));
+      case kExprF32ConvertF64:
+        return WasmVal(static_cast<float>(f64));
+      case kExprF32ReinterpretI32:
+        return WasmVal(bit_cast<float>(i32));
+      case kExprF64SConvertI32:
+        return WasmVal(static_cast<double>(i32));
+      case kExprF64UConvertI32:
+        return WasmVal(static_cast<double>(u32));
+      case kExprF64SConvertI64:
+        return WasmVal(static_cast<double>(i64));
+      case kExprF64UConvertI64:
+        return WasmVal(static_cast<double>(u64));
+      case kExprF64ConvertF32:
+        return WasmVal(static_cast<double>(f32));
+      case kExprF64ReinterpretI64:
+        return WasmVal(bit_cast<double>(i64));
+      case kExprI32ReinterpretF32:
+        return WasmVal(bit_cast<int32_t>(f32));
+      case kExprI64ReinterpretF64:
+        return WasmVal(bit_cast<int64_t>(f64));
+      default:
+        break;
+    }
+    UNREACHABLE();
+    return WasmVal();
+  }
+};
+
+WasmInterpreter::WasmInterpreter(Isolate* isolate, WasmModule* module,
+                                 Host* host, byte* mem_start,
+                                 uint32_t mem_size, byte* globals_area)
+    : isolate_(isolate),
+      module_(module),
+      host_(host),
+      mem_start_(mem_start),
+      mem_size_(mem_size),
+      globals_area_(globals_area),
+      trap_reason_(kTrapCount),
+      back_edges_(0) {}
+
+WasmInterpreter::Outcome WasmInterpreter::Execute(uint32_t index,
+                                                  WasmVal* args,
+                                                  WasmVal* result) {
+  Activation activation(this, &module_->functions->at(index), args);
+  return activation.Run(result);
+}
+
+bool WasmInterpreter::CanInterpret(WasmModule* module,
+                                   const WasmFunction& function) {
+  if (HasI64(function.sig)) return false;
+  // WasmVal has no SIMD values, so SIMD code is always compiled.
+  if (function.local_simd128_count > 0) return false;
+  const byte* pc = module->module_start + function.code_start_offset;
+  const byte* end = module->module_start + function.code_end_offset;
+  // Immediates directly follow their opcode, so the opcodes of the body can
+  // be visited in a linear scan.
+  while (pc < end) {
+    WasmOpcode opcode = static_cast<WasmOpcode>(*pc);
+    int length = OpcodeLengthAt(pc, end);
+    if (length == 0) return false;  // leave the error to the compiler.
+    if (WasmOpcodes::IsSimdOpcode(opcode)) return false;
+    // Atomic operations need the memory barriers of compiled code.
+    if (WasmOpcodes::IsAtomicOpcode(opcode)) return false;
+    if ((opcode == kExprI32LoadMem || opcode == kExprI32StoreMem) &&
+        pc + 1 < end &&
+        MemoryAccess::AtomicityField::decode(pc[1]) != MemoryAccess::kNone) {
+      return false;
+    }
+    if (opcode == kExprCallFunction || opcode == kExprCallIndirect) {
+      int unused;
+      uint32_t index = ReadLEB128(pc + 1, end, &unused);
+      FunctionSig* sig = nullptr;
+      if (opcode == kExprCallFunction) {
+        if (index < module->functions->size()) {
+          sig = module->functions->at(index).sig;
+        }
+      } else if (index < module->signatures->size()) {
+        sig = module->signatures->at(index);
+      }
+      if (sig == nullptr || HasI64(sig)) return false;
+    }
+    pc += length;
+  }
+  return true;
+}
+}
+}
+}
@@ -0,0 +1,95 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8_WASM_INTERPRETER_H_
+#define V8_WASM_INTERPRETER_H_
+
+#include "src/wasm/wasm-module.h"
+#include "src/wasm/wasm-opcodes.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+// A value in the interpreter, tagged with its local type.
+struct WasmVal {
+  LocalType type;
+  union {
+    int32_t i32;
+    int64_t i64;
+    float f32;
+    double f64;
+  } val;
+
+  WasmVal() : type(kAstStmt) { val.i64 = 0; }
+  explicit WasmVal(int32_t v) : type(kAstI32) { val.i32 = v; }
+  explicit WasmVal(int64_t v) : type(kAstI64) { val.i64 = v; }
+  explicit WasmVal(float v) : type(kAstF32) { val.f32 = v; }
+  explicit WasmVal(double v) : type(kAstF64) { val.f64 = v; }
+};
+
+// An interpreter that executes function bodies straight from the module
+// bytes, without building a graph or any other intermediate representation.
+// It is the baseline tier of tiered compilation: functions run without any
+// compilation delay, while the interpreter counts the loop iterations they
+// execute to find the ones worth compiling with TurboFan.
+// Function bodies must have been verified before they are interpreted.
+class WasmInterpreter {
+ public:
+  enum Outcome {
+    kReturned,       // the function returned normally.
+    kTrapped,        // the function trapped, see {trap_reason}.
+    kThrew,          // a call out of the interpreter threw an exception.
+    kStackOverflow,  // the interpreter ran out of stack.
+  };
+
+  // Calls from interpreted code to other functions go through the host.
+  class Host {
+   public:
+    virtual ~Host() {}
+    // Calls the function {index} with the arguments in {args} and stores the
+    // result in {result}. Returns {false} if the call threw an exception.
+    virtual bool CallFunction(uint32_t index, WasmVal* args,
+                              WasmVal* result) = 0;
+    // Grows the memory by {delta} bytes and returns the previous size, or -1
+    // if the memory cannot grow that much.
+    virtual int32_t GrowMemory(uint32_t delta) = 0;
+    // Returns the current size of the memory, which calls may have grown.
+    virtual uint32_t MemorySize() = 0;
+  };
+
+  WasmInterpreter(Isolate* isolate, WasmModule* module, Host* host,
+                  byte* mem_start, uint32_t mem_size, byte* globals_area);
+
+  // Interprets the function {index} with the arguments in {args}.
+  Outcome Execute(uint32_t index, WasmVal* args, WasmVal* result);
+
+  TrapReason trap_reason() const { return trap_reason_; }
+  // The number of loop iterations executed by this interpreter so far.
+  uint32_t back_edges() const { return back_edges_; }
+
+  // Returns {true} if {function} can be interpreted. Interpreted functions
+  // exchange arguments and results with compiled code as JavaScript numbers,
+  // so neither the function nor any function it calls may take or return
+  // i64 values. Functions that use SIMD values or atomic operations are not
+  // interpreted either.
+  static bool CanInterpret(WasmModule* module, const WasmFunction& function);
+
+ private:
+  class Activation;
+
+  Isolate* isolate_;
+  WasmModule* module_;
+  Host* host_;
+  byte* mem_start_;
+  uint32_t mem_size_;
+  byte* globals_area_;
+  TrapReason trap_reason_;
+  uint32_t back_edges_;
+};
+}
+}
+}
+
+#endif  // V8_WASM_INTERPRETER_H_
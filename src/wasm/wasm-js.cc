@@ -8,6 +8,7 @@
 #include "src/ast/ast.h"
 #include "src/ast/scopes.h"
 #include "src/factory.h"
+#include "src/global-handles.h"
 #include "src/handles.h"
 #include "src/isolate.h"
 #include "src/objects.h"
@@ -16,7 +17,9 @@
 
 #include "src/wasm/asm-wasm-builder.h"
 #include "src/wasm/encoder.h"
+#include "src/wasm/wasm-code-cache.h"
 #include "src/wasm/wasm-js.h"
+#include "src/wasm/wasm-memory.h"
 #include "src/wasm/wasm-module.h"
 #include "src/wasm/module-decoder.h"
 #include "src/wasm/wasm-result.h"
@@ -34,25 +37,35 @@ struct RawBuffer {
   size_t size() { return static_cast<size_t>(end - start); }
 };
 
+// Gets the bytes of the array buffer or typed array in argument 0 without
+// copying them or externalizing the buffer. The bytes must be used or copied
+// before any JavaScript code runs that could detach the buffer.
 RawBuffer GetRawBufferArgument(
     ErrorThrower& thrower, const v8::FunctionCallbackInfo<v8::Value>& args) {
-  if (args.Length() < 1 || !args[0]->IsArrayBuffer()) {
-    thrower.Error("Argument 0 must be an array buffer");
+  const byte* start = nullptr;
+  size_t length = 0;
+  if (args.Length() > 0 && args[0]->IsArrayBuffer()) {
+    Local<ArrayBuffer> buffer = Local<ArrayBuffer>::Cast(args[0]);
+    ArrayBuffer::Contents contents = buffer->GetContents();
+    start = reinterpret_cast<const byte*>(contents.Data());
+    length = contents.ByteLength();
+  } else if (args.Length() > 0 && args[0]->IsArrayBufferView()) {
+    // A view may cover only a part of its buffer.
+    Local<ArrayBufferView> view = Local<ArrayBufferView>::Cast(args[0]);
+    ArrayBuffer::Contents contents = view->Buffer()->GetContents();
+    start = reinterpret_cast<const byte*>(contents.Data());
+    if (start != nullptr) start += view->ByteOffset();
+    length = view->ByteLength();
+  } else {
+    thrower.Error("Argument 0 must be an array buffer or a typed array");
     return {nullptr, nullptr};
   }
-  Local<ArrayBuffer> buffer = Local<ArrayBuffer>::Cast(args[0]);
-  ArrayBuffer::Contents contents =
-      buffer->IsExternal() ? buffer->GetContents() : buffer->Externalize();
-
-  // TODO(titzer): allow offsets into buffers, views, etc.
-
-  const byte* start = reinterpret_cast<const byte*>(contents.Data());
-  const byte* end = start + contents.ByteLength();
 
   if (start == nullptr) {
     thrower.Error("ArrayBuffer argument is empty");
+    return {nullptr, nullptr};
   }
-  return {start, end};
+  return {start, start + length};
 }
 
 void VerifyModule(const v8::FunctionCallbackInfo<v8::Value>& args) {
@@ -79,7 +92,6 @@ void VerifyFunction(const v8::FunctionCallbackInfo<v8::Value>& args) {
   i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
   ErrorThrower thrower(isolate, "WASM.verifyFunction()");
 
-  // TODO(titzer): no need to externalize to get the bytes for verification.
   RawBuffer buffer = GetRawBufferArgument(thrower, args);
   if (thrower.error()) return;
 
@@ -177,6 +189,14 @@ void AsmCompileRun(const v8::FunctionCallbackInfo<v8::Value>& args) {
   args.GetReturnValue().Set(result);
 }
 
+// Gets the code cache of the context that the WASM function being called was
+// installed in, which is held by the data of the function.
+internal::wasm::WasmCodeCache* GetCodeCache(
+    const v8::FunctionCallbackInfo<v8::Value>& args) {
+  return internal::wasm::WasmCodeCache::Get(
+      i::Handle<i::JSObject>::cast(v8::Utils::OpenHandle(*args.Data())));
+}
+
 // TODO(aseemgarg): deal with arraybuffer and foreign functions
 void InstantiateModuleFromAsm(const v8::FunctionCallbackInfo<v8::Value>& args) {
   HandleScope scope(args.GetIsolate());
@@ -205,24 +225,64 @@ void InstantiateModuleFromAsm(const v8::FunctionCallbackInfo<v8::Value>& args) {
   }
 
   i::Handle<i::JSArrayBuffer> memory = i::Handle<i::JSArrayBuffer>::null();
-  internal::wasm::ModuleResult result = internal::wasm::DecodeWasmModule(
-      isolate, &zone, module->Begin(), module->End(), false, false);
+  i::Handle<i::JSObject> ffi = i::Handle<i::JSObject>::null();
 
-  if (result.failed()) {
-    thrower.Failed("", result);
-  } else {
-    // Success. Instantiate the module and return the object.
-    i::Handle<i::JSObject> ffi = i::Handle<i::JSObject>::null();
-    
-    i::MaybeHandle<i::JSObject> object =
-        result.val->Instantiate(isolate, ffi, memory);
-
-    if (!object.is_null()) {
-      args.GetReturnValue().Set(v8::Utils::ToLocal(object.ToHandleChecked()));
-    }
+  // Instantiate the module through the code cache and return the object.
+  // Heap accesses out of bounds keep the asm.js semantics.
+  i::MaybeHandle<i::JSObject> object =
+      GetCodeCache(args)->Instantiate(
+          thrower, module->Begin(), module->End(), ffi, memory,
+          internal::wasm::kAsmJsBoundsChecks);
+
+  if (!object.is_null()) {
+    args.GetReturnValue().Set(v8::Utils::ToLocal(object.ToHandleChecked()));
+  }
+}
+
+// Gets the optional memory argument {index}, which is used as the memory of
+// an instance and no longer accounted for by the heap.
+i::Handle<i::JSArrayBuffer> GetMemoryArgument(
+    const v8::FunctionCallbackInfo<v8::Value>& args, int index) {
+  i::Handle<i::JSArrayBuffer> memory = i::Handle<i::JSArrayBuffer>::null();
+  if (args.Length() > index &&
+      (args[index]->IsArrayBuffer() || args[index]->IsSharedArrayBuffer())) {
+    Local<Object> obj = Local<Object>::Cast(args[index]);
+    i::Handle<i::Object> mem_obj = v8::Utils::OpenHandle(*obj);
+    memory = i::Handle<i::JSArrayBuffer>(i::JSArrayBuffer::cast(*mem_obj));
+    i::Isolate* isolate = memory->GetIsolate();
+    memory->set_is_external(true);
+    isolate->heap()->UnregisterArrayBuffer(*memory);
   }
+  return memory;
+}
 
-  if (result.val) delete result.val;
+// Gets the optional foreign function interface argument {index}.
+i::Handle<i::JSObject> GetFfiArgument(
+    const v8::FunctionCallbackInfo<v8::Value>& args, int index) {
+  i::Handle<i::JSObject> ffi = i::Handle<i::JSObject>::null();
+  if (args.Length() > index && args[index]->IsObject()) {
+    Local<Object> obj = Local<Object>::Cast(args[index]);
+    ffi = i::Handle<i::JSObject>::cast(v8::Utils::OpenHandle(*obj));
+  }
+  return ffi;
+}
+
+// Instantiates the module in the buffer argument, with the optional foreign
+// function interface and memory arguments, through the code cache.
+i::MaybeHandle<i::JSObject> InstantiateModuleCommon(
+    const v8::FunctionCallbackInfo<v8::Value>& args, ErrorThrower& thrower,
+    internal::wasm::WasmCompilationStats* stats) {
+  RawBuffer buffer = GetRawBufferArgument(thrower, args);
+  if (buffer.start == nullptr) return i::MaybeHandle<i::JSObject>();
+
+  i::Handle<i::JSArrayBuffer> memory = GetMemoryArgument(args, 2);
+  i::Handle<i::JSObject> ffi = GetFfiArgument(args, 1);
+
+  // Instantiate the module through the code cache, which skips decoding and
+  // compilation if the same bytes were instantiated before.
+  return GetCodeCache(args)->Instantiate(
+      thrower, buffer.start, buffer.end, ffi, memory,
+      internal::wasm::kExplicitBoundsChecks, stats);
 }
 
 void InstantiateModule(const v8::FunctionCallbackInfo<v8::Value>& args) {
@@ -230,53 +290,244 @@ void InstantiateModule(const v8::FunctionCallbackInfo<v8::Value>& args) {
   i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
   ErrorThrower thrower(isolate, "WASM.instantiateModule()");
 
+  i::MaybeHandle<i::JSObject> object =
+      InstantiateModuleCommon(args, thrower, nullptr);
+
+  if (!object.is_null()) {
+    args.GetReturnValue().Set(v8::Utils::ToLocal(object.ToHandleChecked()));
+  }
+}
+
+// Sets the property {name} of {object} to {value}.
+void SetProperty(v8::Isolate* isolate, Local<Object> object, const char* name,
+                 Local<Value> value) {
+  Local<String> key =
+      String::NewFromUtf8(isolate, name, NewStringType::kNormal)
+          .ToLocalChecked();
+  object->Set(isolate->GetCurrentContext(), key, value).FromJust();
+}
+
+void SetProperty(v8::Isolate* isolate, Local<Object> object, const char* name,
+                 double value) {
+  SetProperty(isolate, object, name, Number::New(isolate, value));
+}
+
+// Like {InstantiateModule}, but returns an object with the instance as the
+// "instance" property and the statistics of the instantiation as the "stats"
+// property. Times are in milliseconds.
+void InstantiateModuleWithStats(
+    const v8::FunctionCallbackInfo<v8::Value>& args) {
+  HandleScope scope(args.GetIsolate());
+  i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
+  ErrorThrower thrower(isolate, "WASM.instantiateModuleWithStats()");
+
+  internal::wasm::WasmCompilationStats stats;
+  i::Handle<i::JSObject> instance;
+  if (!InstantiateModuleCommon(args, thrower, &stats).ToHandle(&instance)) {
+    return;
+  }
+
+  v8::Isolate* api_isolate = args.GetIsolate();
+  Local<Context> context = api_isolate->GetCurrentContext();
+  Local<Array> functions =
+      Array::New(api_isolate, static_cast<int>(stats.functions.size()));
+  for (size_t i = 0; i < stats.functions.size(); i++) {
+    const internal::wasm::WasmFunctionStats& function = stats.functions[i];
+    Local<Object> entry = Object::New(api_isolate);
+    SetProperty(api_isolate, entry, "index", function.index);
+    SetProperty(api_isolate, entry, "decodeTime", function.decode_time);
+    SetProperty(api_isolate, entry, "nodeCount",
+                static_cast<double>(function.node_count));
+    SetProperty(api_isolate, entry, "pipelineTime", function.pipeline_time);
+    SetProperty(api_isolate, entry, "codeSize",
+                static_cast<double>(function.code_size));
+    SetProperty(api_isolate, entry, "graphZoneBytes",
+                static_cast<double>(function.graph_zone_bytes));
+    functions->Set(context, static_cast<uint32_t>(i), entry).FromJust();
+  }
+
+  Local<Object> module_stats = Object::New(api_isolate);
+  SetProperty(api_isolate, module_stats, "cached",
+              Boolean::New(api_isolate, stats.cached));
+  SetProperty(api_isolate, module_stats, "decodeTime", stats.decode_time);
+  SetProperty(api_isolate, module_stats, "compileTime", stats.compile_time);
+  SetProperty(api_isolate, module_stats, "linkTime", stats.link_time);
+  SetProperty(api_isolate, module_stats, "dataSegmentsTime",
+              stats.data_segments_time);
+  SetProperty(api_isolate, module_stats, "functions", functions);
+
+  Local<Object> result = Object::New(api_isolate);
+  SetProperty(api_isolate, result, "instance", v8::Utils::ToLocal(instance));
+  SetProperty(api_isolate, result, "stats", module_stats);
+  args.GetReturnValue().Set(result);
+}
+
+// Layout of the object returned by {WASM.instantiateModuleStreaming}.
+const int kStreamingForeign = 0;  // the {StreamingInstantiation}.
+const int kStreamingFieldCount = 1;
+
+// The streaming compilation of a module, owned by the object that the
+// module bytes are added through, and deleted once that object dies.
+struct StreamingInstantiation {
+  StreamingInstantiation(i::Isolate* isolate, size_t expected_size)
+      : compilation(isolate, expected_size), holder(nullptr), finished(false) {}
+
+  static void WeakCallback(const v8::WeakCallbackInfo<void>& data) {
+    StreamingInstantiation* streaming =
+        reinterpret_cast<StreamingInstantiation*>(data.GetParameter());
+    i::GlobalHandles::Destroy(streaming->holder);
+    delete streaming;
+  }
+
+  internal::wasm::WasmStreamingCompilation compilation;
+  i::Object** holder;  // weak global handle to the object.
+  bool finished;
+};
+
+// Gets the streaming compilation of the object that the method being called
+// belongs to, which is held by the data of the method.
+StreamingInstantiation* GetStreamingInstantiation(
+    const v8::FunctionCallbackInfo<v8::Value>& args) {
+  i::Handle<i::JSObject> holder =
+      i::Handle<i::JSObject>::cast(v8::Utils::OpenHandle(*args.Data()));
+  return reinterpret_cast<StreamingInstantiation*>(
+      i::Foreign::cast(holder->GetInternalField(kStreamingForeign))
+          ->foreign_address());
+}
+
+// Adds the bytes of the array buffer or typed array argument to a streamed
+// module, compiling the functions that are complete. Returns false once the
+// module failed to decode.
+void StreamingAddBytes(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  HandleScope scope(args.GetIsolate());
+  i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
+  ErrorThrower thrower(isolate, "WASM.instantiateModuleStreaming().addBytes()");
+
+  StreamingInstantiation* streaming = GetStreamingInstantiation(args);
+  if (streaming->finished) {
+    thrower.Error("Module already finished");
+    return;
+  }
   RawBuffer buffer = GetRawBufferArgument(thrower, args);
   if (buffer.start == nullptr) return;
+  bool ok = streaming->compilation.AddBytes(buffer.start, buffer.size());
+  args.GetReturnValue().Set(ok);
+}
 
-  i::Handle<i::JSArrayBuffer> memory = i::Handle<i::JSArrayBuffer>::null();
-  if (args.Length() > 2 && args[2]->IsArrayBuffer()) {
-    Local<Object> obj = Local<Object>::Cast(args[2]);
-    i::Handle<i::Object> mem_obj = v8::Utils::OpenHandle(*obj);
-    memory = i::Handle<i::JSArrayBuffer>(i::JSArrayBuffer::cast(*mem_obj));
-    i::Isolate* isolate = memory->GetIsolate();
-    memory->set_is_external(true);
-    isolate->heap()->UnregisterArrayBuffer(*memory);
+// Instantiates a streamed module once all its bytes have been added, with the
+// optional foreign function interface and memory arguments.
+void StreamingFinish(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  HandleScope scope(args.GetIsolate());
+  i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
+  ErrorThrower thrower(isolate, "WASM.instantiateModuleStreaming().finish()");
+
+  StreamingInstantiation* streaming = GetStreamingInstantiation(args);
+  if (streaming->finished) {
+    thrower.Error("Module already finished");
+    return;
   }
+  streaming->finished = true;
+  i::Handle<i::JSArrayBuffer> memory = GetMemoryArgument(args, 1);
+  i::Handle<i::JSObject> ffi = GetFfiArgument(args, 0);
+  i::MaybeHandle<i::JSObject> object =
+      streaming->compilation.Finish(ffi, memory, thrower);
+
+  if (!object.is_null()) {
+    args.GetReturnValue().Set(v8::Utils::ToLocal(object.ToHandleChecked()));
+  }
+}
 
-  // Decode but avoid a redundant pass over function bodies for verification.
-  // Verification will happen during compilation.
-  i::Zone zone;
-  internal::wasm::ModuleResult result = internal::wasm::DecodeWasmModule(
-      isolate, &zone, buffer.start, buffer.end, false, false);
+// Returns the number of functions of a streamed module that were compiled
+// while its bytes were being added.
+void StreamingCompiledCount(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  args.GetReturnValue().Set(
+      GetStreamingInstantiation(args)->compilation.streamed_count());
+}
 
-  if (result.failed()) {
-    thrower.Failed("", result);
-  } else {
-    // Success. Instantiate the module and return the object.
-    i::Handle<i::JSObject> ffi = i::Handle<i::JSObject>::null();
-    if (args.Length() > 1 && args[1]->IsObject()) {
-      Local<Object> obj = Local<Object>::Cast(args[1]);
-      ffi = i::Handle<i::JSObject>::cast(v8::Utils::OpenHandle(*obj));
-    }
+void CodeCacheStats(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  HandleScope scope(args.GetIsolate());
+  Local<Context> context = args.GetIsolate()->GetCurrentContext();
+
+  internal::wasm::WasmCodeCache::Stats stats = GetCodeCache(args)->GetStats();
+  const struct {
+    const char* name;
+    size_t value;
+  } fields[] = {{"hits", stats.hits},
+                {"misses", stats.misses},
+                {"evictions", stats.evictions},
+                {"entries", stats.entries},
+                {"size", stats.size},
+                {"budget", stats.budget}};
+
+  Local<Object> result = Object::New(args.GetIsolate());
+  for (const auto& field : fields) {
+    Local<String> name =
+        String::NewFromUtf8(args.GetIsolate(), field.name,
+                            NewStringType::kNormal)
+            .ToLocalChecked();
+    Local<Number> value =
+        Number::New(args.GetIsolate(), static_cast<double>(field.value));
+    result->Set(context, name, value).FromJust();
+  }
+  args.GetReturnValue().Set(result);
+}
 
-    i::MaybeHandle<i::JSObject> object =
-        result.val->Instantiate(isolate, ffi, memory);
+// Allows atomic waits on the current thread if the argument is true, and
+// disallows them otherwise. Threads may not wait by default, so embedders
+// call this on their worker threads, which may block.
+void SetAtomicWaitAllowed(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  bool allowed = args.Length() > 0 && args[0]->BooleanValue();
+  internal::wasm::SetAtomicWaitAllowed(allowed);
+}
 
-    if (!object.is_null()) {
-      args.GetReturnValue().Set(v8::Utils::ToLocal(object.ToHandleChecked()));
-    }
+// Returns the bytes held by the instance argument, by kind, as counted by
+// {WasmModule::MemoryUsage}.
+void MemoryUsage(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  HandleScope scope(args.GetIsolate());
+  i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
+  ErrorThrower thrower(isolate, "WASM.memoryUsage()");
+
+  if (args.Length() < 1 || !args[0]->IsObject()) {
+    thrower.Error("Argument 0 must be a WASM instance");
+    return;
+  }
+  i::Handle<i::JSObject> instance =
+      i::Handle<i::JSObject>::cast(v8::Utils::OpenHandle(*args[0]));
+  if (instance->GetInternalFieldCount() !=
+          internal::wasm::kWasmModuleInternalFieldCount ||
+      !instance->GetInternalField(internal::wasm::kWasmInstanceData)
+           ->IsByteArray()) {
+    thrower.Error("Argument 0 must be a WASM instance");
+    return;
   }
 
-  if (result.val) delete result.val;
+  internal::wasm::WasmInstanceMemoryUsage usage =
+      internal::wasm::WasmModule::MemoryUsage(instance);
+  v8::Isolate* api_isolate = args.GetIsolate();
+  Local<Object> result = Object::New(api_isolate);
+  SetProperty(api_isolate, result, "code", static_cast<double>(usage.code));
+  SetProperty(api_isolate, result, "memory",
+              static_cast<double>(usage.memory));
+  SetProperty(api_isolate, result, "globals",
+              static_cast<double>(usage.globals));
+  SetProperty(api_isolate, result, "tables",
+              static_cast<double>(usage.tables));
+  SetProperty(api_isolate, result, "metadata",
+              static_cast<double>(usage.metadata));
+  args.GetReturnValue().Set(result);
 }
 }
 
 // TODO(titzer): we use the API to create the function template because the
 // internal guts are too ugly to replicate here.
-static i::Handle<i::FunctionTemplateInfo> NewTemplate(i::Isolate* i_isolate,
-                                                      FunctionCallback func) {
+static i::Handle<i::FunctionTemplateInfo> NewTemplate(
+    i::Isolate* i_isolate, FunctionCallback func,
+    i::Handle<i::JSObject> data) {
   Isolate* isolate = reinterpret_cast<Isolate*>(i_isolate);
-  Local<FunctionTemplate> local = FunctionTemplate::New(isolate, func);
+  Local<Value> local_data;
+  if (!data.is_null()) local_data = v8::Utils::ToLocal(data);
+  Local<FunctionTemplate> local =
+      FunctionTemplate::New(isolate, func, local_data);
   return v8::Utils::OpenHandle(*local);
 }
 
@@ -285,10 +536,13 @@ static Handle<String> v8_str(Isolate* isolate, const char* str) {
   return isolate->factory()->NewStringFromAsciiChecked(str);
 }
 
+// Installs the function {str} on {object}, calling {func} with {data}, if
+// given, as the data of the call.
 static void InstallFunc(Isolate* isolate, Handle<JSObject> object,
-                        const char* str, FunctionCallback func) {
+                        const char* str, FunctionCallback func,
+                        Handle<JSObject> data = Handle<JSObject>::null()) {
   Handle<String> name = v8_str(isolate, str);
-  Handle<FunctionTemplateInfo> temp = NewTemplate(isolate, func);
+  Handle<FunctionTemplateInfo> temp = NewTemplate(isolate, func, data);
   Handle<JSFunction> function =
       ApiNatives::InstantiateFunction(temp).ToHandleChecked();
   PropertyAttributes attributes =
@@ -296,6 +550,47 @@ static void InstallFunc(Isolate* isolate, Handle<JSObject> object,
   JSObject::AddProperty(object, name, function, attributes);
 }
 
+// Starts the instantiation of a module whose bytes are added in chunks, with
+// the size of the whole module as an optional argument. Returns an object
+// with the methods addBytes(bytes) and finish(ffi, memory), which returns
+// the instance, see {StreamingAddBytes} and {StreamingFinish}.
+static void InstantiateModuleStreaming(
+    const v8::FunctionCallbackInfo<v8::Value>& args) {
+  v8::HandleScope scope(args.GetIsolate());
+  Isolate* isolate = reinterpret_cast<Isolate*>(args.GetIsolate());
+  Factory* factory = isolate->factory();
+
+  size_t expected_size = 0;
+  if (args.Length() > 0 && args[0]->IsNumber()) {
+    double size = v8::Utils::OpenHandle(*args[0])->Number();
+    // Sizes beyond the maximum module size fail upon the first bytes.
+    if (size > 0) {
+      expected_size = static_cast<size_t>(
+          std::min(size, static_cast<double>(wasm::kMaxModuleSize)));
+    }
+  }
+
+  Handle<Map> map = factory->NewMap(
+      JS_OBJECT_TYPE,
+      JSObject::kHeaderSize + kStreamingFieldCount * kPointerSize);
+  Handle<JSObject> holder = factory->NewJSObjectFromMap(map);
+  StreamingInstantiation* streaming =
+      new StreamingInstantiation(isolate, expected_size);
+  holder->SetInternalField(
+      kStreamingForeign,
+      *factory->NewForeign(reinterpret_cast<Address>(streaming)));
+  streaming->holder = isolate->global_handles()->Create(*holder).location();
+  GlobalHandles::MakeWeak(streaming->holder, streaming,
+                          &StreamingInstantiation::WeakCallback,
+                          v8::WeakCallbackType::kParameter);
+
+  InstallFunc(isolate, holder, "addBytes", StreamingAddBytes, holder);
+  InstallFunc(isolate, holder, "finish", StreamingFinish, holder);
+  InstallFunc(isolate, holder, "compiledCount", StreamingCompiledCount,
+              holder);
+  args.GetReturnValue().Set(v8::Utils::ToLocal(holder));
+}
+
 void WasmJs::Install(Isolate* isolate, Handle<JSGlobalObject> global) {
   // Bind the WASM object.
   Factory* factory = isolate->factory();
@@ -309,14 +604,28 @@ void WasmJs::Install(Isolate* isolate, Handle<JSGlobalObject> global) {
   PropertyAttributes attributes = static_cast<PropertyAttributes>(DONT_ENUM);
   JSObject::AddProperty(global, name, wasm_object, attributes);
 
+  // The code cache of the context is only held by the functions using it,
+  // so that it dies with the context.
+  Handle<JSObject> code_cache = wasm::WasmCodeCache::New(isolate);
+
   // Install functions on the WASM object.
-  InstallFunc(isolate, wasm_object, "instantiateModule", InstantiateModule);
+  InstallFunc(isolate, wasm_object, "instantiateModule", InstantiateModule,
+              code_cache);
   InstallFunc(isolate, wasm_object, "verifyModule", VerifyModule);
   InstallFunc(isolate, wasm_object, "verifyFunction", VerifyFunction);
   InstallFunc(isolate, wasm_object, "compileRun", CompileRun);
   InstallFunc(isolate, wasm_object, "asmCompileRun", AsmCompileRun);
   InstallFunc(isolate, wasm_object, "instantiateModuleFromAsm",
-              InstantiateModuleFromAsm);
+              InstantiateModuleFromAsm, code_cache);
+  InstallFunc(isolate, wasm_object, "codeCacheStats", CodeCacheStats,
+              code_cache);
+  InstallFunc(isolate, wasm_object, "instantiateModuleWithStats",
+              InstantiateModuleWithStats, code_cache);
+  InstallFunc(isolate, wasm_object, "instantiateModuleStreaming",
+              InstantiateModuleStreaming);
+  InstallFunc(isolate, wasm_object, "memoryUsage", MemoryUsage);
+  InstallFunc(isolate, wasm_object, "setAtomicWaitAllowed",
+              SetAtomicWaitAllowed);
 }
 }  // namespace internal
 }  // namespace v8
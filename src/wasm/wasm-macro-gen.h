@@ -102,6 +102,41 @@
       v8::internal::wasm::WasmOpcodes::LoadStoreOpcodeOf(type, true)), \
       v8::internal::wasm::WasmOpcodes::LoadStoreAccessOf(true),        \
       static_cast<byte>(offset), index, val
+#define WASM_MEMORY_SIZE kExprMemorySize
+#define WASM_GROW_MEMORY(delta) kExprGrowMemory, delta
+#define WASM_ATOMIC_LOAD_MEM(index)                                      \
+  kExprI32LoadMem, v8::internal::wasm::WasmOpcodes::AtomicAccessOf(false), \
+      index
+#define WASM_ATOMIC_STORE_MEM(index, val)                                   \
+  kExprI32StoreMem, v8::internal::wasm::WasmOpcodes::AtomicAccessOf(false), \
+      index, val
+#define WASM_ATOMIC_LOAD_MEM_OFFSET(offset, index)                        \
+  kExprI32LoadMem, v8::internal::wasm::WasmOpcodes::AtomicAccessOf(true), \
+      static_cast<byte>(offset), index
+#define WASM_ATOMIC_BINOP(op, index, val) \
+  op, v8::internal::wasm::WasmOpcodes::LoadStoreAccessOf(false), index, val
+#define WASM_I32_ATOMIC_ADD(index, val) \
+  WASM_ATOMIC_BINOP(kExprI32AtomicAdd, index, val)
+#define WASM_I32_ATOMIC_SUB(index, val) \
+  WASM_ATOMIC_BINOP(kExprI32AtomicSub, index, val)
+#define WASM_I32_ATOMIC_AND(index, val) \
+  WASM_ATOMIC_BINOP(kExprI32AtomicAnd, index, val)
+#define WASM_I32_ATOMIC_OR(index, val) \
+  WASM_ATOMIC_BINOP(kExprI32AtomicOr, index, val)
+#define WASM_I32_ATOMIC_XOR(index, val) \
+  WASM_ATOMIC_BINOP(kExprI32AtomicXor, index, val)
+#define WASM_I32_ATOMIC_EXCHANGE(index, val) \
+  WASM_ATOMIC_BINOP(kExprI32AtomicExchange, index, val)
+#define WASM_I32_ATOMIC_COMPARE_EXCHANGE(index, expected, replacement)  \
+  kExprI32AtomicCompareExchange,                                        \
+      v8::internal::wasm::WasmOpcodes::LoadStoreAccessOf(false), index, \
+      expected, replacement
+#define WASM_I32_ATOMIC_WAIT(index, expected, timeout)                  \
+  kExprI32AtomicWait,                                                   \
+      v8::internal::wasm::WasmOpcodes::LoadStoreAccessOf(false), index, \
+      expected, timeout
+#define WASM_ATOMIC_NOTIFY(index, count) \
+  WASM_ATOMIC_BINOP(kExprAtomicNotify, index, count)
 #define WASM_CALL_FUNCTION(index, ...) \
   kExprCallFunction, static_cast<byte>(index), __VA_ARGS__
 #define WASM_CALL_INDIRECT(index, func, ...) \
@@ -262,4 +297,50 @@
 #define WASM_I32_REINTERPRET_F32(x) kExprI32ReinterpretF32, x
 #define WASM_I64_REINTERPRET_F64(x) kExprI64ReinterpretF64, x
 
+//------------------------------------------------------------------------------
+// SIMD operations.
+//------------------------------------------------------------------------------
+#define WASM_I32X4_SPLAT(x) kExprI32x4Splat, x
+#define WASM_I32X4_EXTRACT_LANE(lane, x) \
+  kExprI32x4ExtractLane, static_cast<byte>(lane), x
+#define WASM_I32X4_REPLACE_LANE(lane, x, y) \
+  kExprI32x4ReplaceLane, static_cast<byte>(lane), x, y
+#define WASM_I32X4_ADD(x, y) kExprI32x4Add, x, y
+#define WASM_I32X4_SUB(x, y) kExprI32x4Sub, x, y
+#define WASM_I32X4_MUL(x, y) kExprI32x4Mul, x, y
+#define WASM_S128_AND(x, y) kExprS128And, x, y
+#define WASM_S128_OR(x, y) kExprS128Or, x, y
+#define WASM_S128_XOR(x, y) kExprS128Xor, x, y
+#define WASM_F32X4_SPLAT(x) kExprF32x4Splat, x
+#define WASM_F32X4_EXTRACT_LANE(lane, x) \
+  kExprF32x4ExtractLane, static_cast<byte>(lane), x
+#define WASM_F32X4_REPLACE_LANE(lane, x, y) \
+  kExprF32x4ReplaceLane, static_cast<byte>(lane), x, y
+#define WASM_F32X4_ADD(x, y) kExprF32x4Add, x, y
+#define WASM_F32X4_SUB(x, y) kExprF32x4Sub, x, y
+#define WASM_F32X4_MUL(x, y) kExprF32x4Mul, x, y
+#define WASM_F32X4_DIV(x, y) kExprF32x4Div, x, y
+#define WASM_F32X4_MIN(x, y) kExprF32x4Min, x, y
+#define WASM_F32X4_MAX(x, y) kExprF32x4Max, x, y
+#define WASM_F32X4_ABS(x) kExprF32x4Abs, x
+#define WASM_F32X4_NEG(x) kExprF32x4Neg, x
+#define WASM_F32X4_SQRT(x) kExprF32x4Sqrt, x
+#define WASM_F32X4_SCONVERT_I32X4(x) kExprF32x4SConvertI32x4, x
+#define WASM_S32X4_SHUFFLE(a, b, c, d, x, y)                     \
+  kExprS32x4Shuffle, static_cast<byte>(a), static_cast<byte>(b), \
+      static_cast<byte>(c), static_cast<byte>(d), x, y
+#define WASM_S128_LOAD_MEM(index)                                      \
+  kExprS128LoadMem,                                                    \
+      v8::internal::wasm::WasmOpcodes::LoadStoreAccessOf(false), index
+#define WASM_S128_STORE_MEM(index, val)                                     \
+  kExprS128StoreMem,                                                        \
+      v8::internal::wasm::WasmOpcodes::LoadStoreAccessOf(false), index, val
+#define WASM_S128_LOAD_MEM_OFFSET(offset, index)                              \
+  kExprS128LoadMem, v8::internal::wasm::WasmOpcodes::LoadStoreAccessOf(true), \
+      static_cast<byte>(offset), index
+#define WASM_S128_STORE_MEM_OFFSET(offset, index, val)          \
+  kExprS128StoreMem,                                            \
+      v8::internal::wasm::WasmOpcodes::LoadStoreAccessOf(true), \
+      static_cast<byte>(offset), index, val
+
 #endif  // V8_WASM_MACRO_GEN_H_
@@ -0,0 +1,696 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/wasm/wasm-memory.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#if V8_OS_POSIX
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "src/base/atomicops.h"
+#include "src/base/once.h"
+#include "src/base/platform/condition-variable.h"
+#include "src/base/platform/mutex.h"
+#include "src/base/platform/platform.h"
+#include "src/base/platform/time.h"
+#include "src/factory.h"
+#include "src/global-handles.h"
+#include "src/isolate.h"
+#include "src/utils.h"
+#include "src/v8memory.h"
+
+#include "src/wasm/wasm-module.h"
+#include "src/wasm/wasm-opcodes.h"
+
+#if V8_HOST_ARCH_X64 && V8_TARGET_ARCH_X64 && V8_OS_LINUX
+#include <ucontext.h>
+#define WASM_GUARD_REGIONS 1
+#else
+#define WASM_GUARD_REGIONS 0
+#endif
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+namespace {
+// A reservation of address space holding a linear memory. The memory is
+// committed from the start of the reservation as it grows.
+struct Reservation {
+  base::AtomicWord start;  // read by the fault handler without locking.
+  size_t size;             // the reserved bytes.
+  size_t max_size;         // the size the memory may grow to.
+  size_t committed;        // the committed bytes.
+  bool guarded;            // true if the reservation is a guard region.
+  Object** location;       // weak global handle to the buffer.
+  Object** trap_code;      // global handle to the out-of-bounds trap code.
+  Isolate* isolate;        // the isolate of the buffer.
+  size_t reported;         // the committed bytes reported to its heap.
+  bool report_requested;   // true if an interrupt will report the growth.
+};
+
+const int kMaxReservations = kMaxReservedArrayBuffers;
+Reservation reservations[kMaxReservations];
+base::LazyMutex reservations_mutex = LAZY_MUTEX_INITIALIZER;
+
+#if WASM_GUARD_REGIONS
+bool fault_handler_installed = false;
+struct sigaction previous_segv_action;
+struct sigaction previous_bus_action;
+
+// Returns the guard region containing {address}, or nullptr.
+Reservation* FindGuardRegion(uintptr_t address) {
+  for (int i = 0; i < kMaxReservations; i++) {
+    uintptr_t start =
+        static_cast<uintptr_t>(base::Acquire_Load(&reservations[i].start));
+    if (start != 0 && reservations[i].guarded &&
+        address - start < kGuardRegionSize) {
+      return &reservations[i];
+    }
+  }
+  return nullptr;
+}
+
+// Continues a fault at {address} in the trap code of its guard region, if
+// the fault comes from compiled code. The frame of the faulting function is
+// dropped, so that the trap code runs as if called by the function's caller.
+// Compiled functions set up their frame before they access the memory, so
+// the frame pointer holds the caller's frame pointer and return address.
+bool RedirectToTrapCode(uintptr_t address, ucontext_t* context) {
+  Reservation* reservation = FindGuardRegion(address);
+  if (reservation == nullptr || reservation->trap_code == nullptr) {
+    return false;
+  }
+  greg_t* registers = context->uc_mcontext.gregs;
+  Address pc = reinterpret_cast<Address>(registers[REG_RIP]);
+  if (!reservation->isolate->heap()->code_space()->ContainsSlow(pc)) {
+    return false;
+  }
+  Address fp = reinterpret_cast<Address>(registers[REG_RBP]);
+  Code* trap_code = Code::cast(*reservation->trap_code);
+  registers[REG_RBP] = static_cast<greg_t>(Memory::uintptr_at(fp));
+  registers[REG_RSP] = reinterpret_cast<greg_t>(fp + kFPOnStackSize);
+  registers[REG_RIP] =
+      reinterpret_cast<greg_t>(trap_code->instruction_start());
+  return true;
+}
+
+// Turns faults in guard regions into traps. Other faults are passed on to
+// the handler installed before.
+void HandleMemoryFault(int signum, siginfo_t* info, void* context) {
+  if (RedirectToTrapCode(reinterpret_cast<uintptr_t>(info->si_addr),
+                         reinterpret_cast<ucontext_t*>(context))) {
+    return;
+  }
+  struct sigaction* previous =
+      signum == SIGSEGV ? &previous_segv_action : &previous_bus_action;
+  if (previous->sa_flags & SA_SIGINFO) {
+    previous->sa_sigaction(signum, info, context);
+  } else if (previous->sa_handler != SIG_DFL &&
+             previous->sa_handler != SIG_IGN) {
+    previous->sa_handler(signum);
+  } else {
+    // Retrying the access raises the signal again with the default action.
+    sigaction(signum, previous, nullptr);
+  }
+}
+
+// Installs the fault handler. The caller must hold the mutex.
+void InstallFaultHandler() {
+  if (fault_handler_installed) return;
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  sigemptyset(&action.sa_mask);
+  action.sa_sigaction = HandleMemoryFault;
+  action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+  sigaction(SIGSEGV, &action, &previous_segv_action);
+  sigaction(SIGBUS, &action, &previous_bus_action);
+  fault_handler_installed = true;
+}
+#endif  // WASM_GUARD_REGIONS
+
+// Reserves {size} bytes of address space and commits the first {committed}
+// bytes of it. Guard regions are registered with the fault handler. Returns
+// nullptr if the address space cannot be reserved or committed, or if the
+// table of reservations is full.
+Reservation* Reserve(size_t size, size_t committed, bool guarded) {
+  base::LockGuard<base::Mutex> lock(reservations_mutex.Pointer());
+  for (int i = 0; i < kMaxReservations; i++) {
+    Reservation* reservation = &reservations[i];
+    if (base::NoBarrier_Load(&reservation->start) != 0) continue;
+    void* start = base::VirtualMemory::ReserveRegion(size);
+    if (start == nullptr) return nullptr;
+    if (committed > 0 &&
+        !base::VirtualMemory::CommitRegion(start, committed, false)) {
+      base::VirtualMemory::ReleaseRegion(start, size);
+      return nullptr;
+    }
+#if WASM_GUARD_REGIONS
+    if (guarded) InstallFaultHandler();
+#endif
+    reservation->size = size;
+    reservation->committed = committed;
+    reservation->guarded = guarded;
+    reservation->location = nullptr;
+    reservation->trap_code = nullptr;
+    reservation->isolate = nullptr;
+    reservation->reported = 0;
+    reservation->report_requested = false;
+    base::Release_Store(&reservation->start,
+                        reinterpret_cast<base::AtomicWord>(start));
+    return reservation;
+  }
+  return nullptr;
+}
+
+// Returns the reservation starting at {start}, or nullptr. The caller must
+// hold the mutex.
+Reservation* FindReservation(void* start) {
+  if (start == nullptr) return nullptr;
+  for (int i = 0; i < kMaxReservations; i++) {
+    if (base::NoBarrier_Load(&reservations[i].start) ==
+        reinterpret_cast<base::AtomicWord>(start)) {
+      return &reservations[i];
+    }
+  }
+  return nullptr;
+}
+
+// Adjusts the external memory of the heap of {isolate} by {delta} bytes.
+// Must not be called with the mutex held, since it may trigger a GC, which
+// releases reservations.
+void AdjustExternalMemory(Isolate* isolate, int64_t delta) {
+  if (delta == 0) return;
+  reinterpret_cast<v8::Isolate*>(isolate)
+      ->AdjustAmountOfExternalAllocatedMemory(delta);
+}
+
+// Releases the reservation of a buffer once the buffer dies.
+void ReleaseReservation(const v8::WeakCallbackInfo<void>& data) {
+  Reservation* reservation =
+      reinterpret_cast<Reservation*>(data.GetParameter());
+  Isolate* isolate;
+  size_t reported;
+  {
+    base::LockGuard<base::Mutex> lock(reservations_mutex.Pointer());
+    void* start =
+        reinterpret_cast<void*>(base::NoBarrier_Load(&reservation->start));
+    GlobalHandles::Destroy(reservation->location);
+    if (reservation->trap_code != nullptr) {
+      GlobalHandles::Destroy(reservation->trap_code);
+    }
+    isolate = reservation->isolate;
+    reported = reservation->reported;
+    base::Release_Store(&reservation->start, 0);
+    base::VirtualMemory::ReleaseRegion(start, reservation->size);
+  }
+  AdjustExternalMemory(isolate, -static_cast<int64_t>(reported));
+}
+
+struct SharedMemory;
+
+// A buffer holding a shared memory, in the isolate of the buffer.
+struct SharedMemoryHolder {
+  SharedMemory* memory;
+  Object** location;  // weak global handle to the buffer.
+  Isolate* isolate;
+};
+
+// A memory shared between threads, which is freed once the last buffer
+// holding it dies. Buffers of any isolate may hold it.
+struct SharedMemory {
+  void* start;
+  size_t size;
+  std::vector<SharedMemoryHolder*> holders;
+};
+
+std::vector<SharedMemory*>* shared_memories = nullptr;
+base::LazyMutex shared_memories_mutex = LAZY_MUTEX_INITIALIZER;
+
+// Returns the shared memory starting at {start}, or nullptr. The caller must
+// hold the mutex.
+SharedMemory* FindSharedMemory(void* start) {
+  if (start == nullptr || shared_memories == nullptr) return nullptr;
+  for (SharedMemory* memory : *shared_memories) {
+    if (memory->start == start) return memory;
+  }
+  return nullptr;
+}
+
+// Drops the hold of a buffer on its shared memory once the buffer dies, and
+// frees the memory if no other buffer holds it.
+void ReleaseSharedMemory(const v8::WeakCallbackInfo<void>& data) {
+  SharedMemoryHolder* holder =
+      reinterpret_cast<SharedMemoryHolder*>(data.GetParameter());
+  SharedMemory* memory = holder->memory;
+  Isolate* isolate = holder->isolate;
+  size_t size = memory->size;
+  {
+    base::LockGuard<base::Mutex> lock(shared_memories_mutex.Pointer());
+    GlobalHandles::Destroy(holder->location);
+    std::vector<SharedMemoryHolder*>& holders = memory->holders;
+    holders.erase(std::find(holders.begin(), holders.end(), holder));
+    delete holder;
+    if (holders.empty()) {
+      shared_memories->erase(std::find(shared_memories->begin(),
+                                       shared_memories->end(), memory));
+      free(memory->start);
+      delete memory;
+    }
+  }
+  AdjustExternalMemory(isolate, -static_cast<int64_t>(size));
+}
+
+// Makes {buffer} hold {memory}, unless it does already. The caller must hold
+// the mutex. Returns {true} if the hold is new.
+bool AddSharedMemoryHolder(SharedMemory* memory, Handle<JSArrayBuffer> buffer) {
+  Isolate* isolate = buffer->GetIsolate();
+  for (SharedMemoryHolder* holder : memory->holders) {
+    // Only the handles of this isolate can be read on this thread.
+    if (holder->isolate == isolate && *holder->location == *buffer) {
+      return false;
+    }
+  }
+  SharedMemoryHolder* holder = new SharedMemoryHolder();
+  holder->memory = memory;
+  holder->location = isolate->global_handles()->Create(*buffer).location();
+  holder->isolate = isolate;
+  memory->holders.push_back(holder);
+  GlobalHandles::MakeWeak(holder->location, holder, &ReleaseSharedMemory,
+                          v8::WeakCallbackType::kParameter);
+  return true;
+}
+
+// A thread blocked in an atomic wait. Shared memories can be used by several
+// isolates, so the waiters on all memories are kept in a single list, in the
+// order in which they started waiting.
+struct Waiter {
+  int32_t* address;
+  bool notified;
+  base::ConditionVariable cond;
+  Waiter* prev;
+  Waiter* next;
+};
+
+Waiter* first_waiter = nullptr;
+Waiter* last_waiter = nullptr;
+base::LazyMutex waiters_mutex = LAZY_MUTEX_INITIALIZER;
+
+// The key of the thread-local flag that allows a thread to wait.
+base::Thread::LocalStorageKey wait_allowed_key;
+V8_DECLARE_ONCE(wait_allowed_key_once);
+
+void CreateWaitAllowedKey() {
+  wait_allowed_key = base::Thread::CreateThreadLocalKey();
+}
+
+bool IsAtomicWaitAllowed() {
+  base::CallOnce(&wait_allowed_key_once, &CreateWaitAllowedKey);
+  return base::Thread::GetThreadLocal(wait_allowed_key) != nullptr;
+}
+
+void RemoveWaiter(Waiter* waiter) {
+  if (waiter->prev) {
+    waiter->prev->next = waiter->next;
+  } else {
+    first_waiter = waiter->next;
+  }
+  if (waiter->next) {
+    waiter->next->prev = waiter->prev;
+  } else {
+    last_waiter = waiter->prev;
+  }
+}
+
+int32_t AtomicWait(int32_t* address, int32_t expected, int32_t timeout_ms) {
+  if (!IsAtomicWaitAllowed()) return kAtomicWaitNotAllowed;
+  base::Mutex* mutex = waiters_mutex.Pointer();
+  base::LockGuard<base::Mutex> lock(mutex);
+  // Notifying threads take the lock after their store, so they cannot miss
+  // a waiter that has seen the value before the store.
+  if (base::Acquire_Load(address) != expected) return kAtomicWaitNotEqual;
+  Waiter waiter;
+  waiter.address = address;
+  waiter.notified = false;
+  waiter.prev = last_waiter;
+  waiter.next = nullptr;
+  if (last_waiter) {
+    last_waiter->next = &waiter;
+  } else {
+    first_waiter = &waiter;
+  }
+  last_waiter = &waiter;
+
+  base::TimeTicks deadline =
+      base::TimeTicks::Now() + base::TimeDelta::FromMilliseconds(timeout_ms);
+  while (!waiter.notified) {
+    if (timeout_ms < 0) {
+      waiter.cond.Wait(mutex);
+      continue;
+    }
+    base::TimeDelta remaining = deadline - base::TimeTicks::Now();
+    if (remaining.InMicroseconds() <= 0) break;
+    waiter.cond.WaitFor(mutex, remaining);
+  }
+  if (waiter.notified) return kAtomicWaitOk;
+  RemoveWaiter(&waiter);
+  return kAtomicWaitTimedOut;
+}
+
+int32_t AtomicNotify(int32_t* address, int32_t count) {
+  base::LockGuard<base::Mutex> lock(waiters_mutex.Pointer());
+  int32_t notified = 0;
+  Waiter* waiter = first_waiter;
+  while (waiter != nullptr && (count < 0 || notified < count)) {
+    Waiter* next = waiter->next;
+    if (waiter->address == address) {
+      RemoveWaiter(waiter);
+      waiter->notified = true;
+      waiter->cond.NotifyOne();
+      notified++;
+    }
+    waiter = next;
+  }
+  return notified;
+}
+
+int32_t CompareExchange(int32_t* address, int32_t expected,
+                        int32_t replacement) {
+  base::MemoryBarrier();
+  int32_t previous =
+      base::NoBarrier_CompareAndSwap(address, expected, replacement);
+  base::MemoryBarrier();
+  return previous;
+}
+
+int32_t Modify(int32_t opcode, int32_t old_value, int32_t value) {
+  uint32_t left = static_cast<uint32_t>(old_value);
+  uint32_t right = static_cast<uint32_t>(value);
+  switch (opcode) {
+    case kExprI32AtomicAdd:
+      return static_cast<int32_t>(left + right);
+    case kExprI32AtomicSub:
+      return static_cast<int32_t>(left - right);
+    case kExprI32AtomicAnd:
+      return static_cast<int32_t>(left & right);
+    case kExprI32AtomicOr:
+      return static_cast<int32_t>(left | right);
+    case kExprI32AtomicXor:
+      return static_cast<int32_t>(left ^ right);
+    case kExprI32AtomicExchange:
+      return value;
+    default:
+      UNREACHABLE();
+      return 0;
+  }
+}
+}  // namespace
+
+void SetAtomicWaitAllowed(bool allowed) {
+  base::CallOnce(&wait_allowed_key_once, &CreateWaitAllowedKey);
+  base::Thread::SetThreadLocal(wait_allowed_key,
+                               allowed ? &wait_allowed_key : nullptr);
+}
+
+bool GuardRegionsSupported() { return WASM_GUARD_REGIONS != 0; }
+
+Handle<JSArrayBuffer> NewSharedArrayBuffer(Isolate* isolate, size_t size,
+                                           byte** backing_store) {
+  void* start = calloc(size, 1);
+  if (start == nullptr) return Handle<JSArrayBuffer>::null();
+  *backing_store = reinterpret_cast<byte*>(start);
+
+  // The buffer does not own the memory, since buffers on other threads may
+  // still view it once the buffer dies.
+  Handle<JSArrayBuffer> buffer =
+      isolate->factory()->NewJSArrayBuffer(SharedFlag::kShared);
+  JSArrayBuffer::Setup(buffer, isolate, true, start, static_cast<int>(size),
+                       SharedFlag::kShared);
+  buffer->set_is_neuterable(false);
+  {
+    base::LockGuard<base::Mutex> lock(shared_memories_mutex.Pointer());
+    if (shared_memories == nullptr) {
+      shared_memories = new std::vector<SharedMemory*>();
+    }
+    SharedMemory* memory = new SharedMemory();
+    memory->start = start;
+    memory->size = size;
+    shared_memories->push_back(memory);
+    AddSharedMemoryHolder(memory, buffer);
+  }
+  AdjustExternalMemory(isolate, static_cast<int64_t>(size));
+  return buffer;
+}
+
+void HoldSharedMemory(Handle<JSArrayBuffer> buffer) {
+  size_t size;
+  {
+    base::LockGuard<base::Mutex> lock(shared_memories_mutex.Pointer());
+    SharedMemory* memory = FindSharedMemory(buffer->backing_store());
+    if (memory == nullptr || !AddSharedMemoryHolder(memory, buffer)) return;
+    size = memory->size;
+  }
+  AdjustExternalMemory(buffer->GetIsolate(), static_cast<int64_t>(size));
+}
+
+Handle<JSArrayBuffer> NewReservedArrayBuffer(Isolate* isolate, size_t size,
+                                             size_t max_size, bool guarded,
+                                             byte** backing_store) {
+  DCHECK_LE(size, max_size);
+  if (guarded && !GuardRegionsSupported()) return Handle<JSArrayBuffer>::null();
+  size_t page_size = base::OS::CommitPageSize();
+  size_t reserved_size = guarded ? static_cast<size_t>(kGuardRegionSize)
+                                 : RoundUp(max_size, page_size);
+  Reservation* reservation =
+      Reserve(reserved_size, RoundUp(size, page_size), guarded);
+  if (reservation == nullptr) return Handle<JSArrayBuffer>::null();
+  void* start =
+      reinterpret_cast<void*>(base::NoBarrier_Load(&reservation->start));
+  *backing_store = reinterpret_cast<byte*>(start);
+
+  // Freshly committed pages are zero, and the buffer does not own them.
+  Handle<JSArrayBuffer> buffer = isolate->factory()->NewJSArrayBuffer();
+  JSArrayBuffer::Setup(buffer, isolate, true, start, static_cast<int>(size));
+  buffer->set_is_neuterable(false);
+  {
+    base::LockGuard<base::Mutex> lock(reservations_mutex.Pointer());
+    reservation->max_size = max_size;
+    reservation->location =
+        isolate->global_handles()->Create(*buffer).location();
+    reservation->isolate = isolate;
+  }
+  GlobalHandles::MakeWeak(reservation->location, reservation,
+                          &ReleaseReservation,
+                          v8::WeakCallbackType::kParameter);
+  ReportCommittedMemory(isolate);
+  return buffer;
+}
+
+bool ReservedArrayBuffersExhausted() {
+  base::LockGuard<base::Mutex> lock(reservations_mutex.Pointer());
+  for (int i = 0; i < kMaxReservations; i++) {
+    if (base::NoBarrier_Load(&reservations[i].start) == 0) return false;
+  }
+  return true;
+}
+
+bool IsGuardedArrayBuffer(Handle<JSArrayBuffer> buffer) {
+  base::LockGuard<base::Mutex> lock(reservations_mutex.Pointer());
+  Reservation* reservation = FindReservation(buffer->backing_store());
+  return reservation != nullptr && reservation->guarded;
+}
+
+void SetOutOfBoundsTrapCode(Handle<JSArrayBuffer> buffer, Handle<Code> code) {
+  Isolate* isolate = buffer->GetIsolate();
+  base::LockGuard<base::Mutex> lock(reservations_mutex.Pointer());
+  Reservation* reservation = FindReservation(buffer->backing_store());
+  DCHECK(reservation != nullptr && reservation->guarded);
+  if (reservation->trap_code != nullptr) return;
+  reservation->trap_code = isolate->global_handles()->Create(*code).location();
+}
+
+void ReportCommittedMemory(Isolate* isolate) {
+  int64_t delta = 0;
+  {
+    base::LockGuard<base::Mutex> lock(reservations_mutex.Pointer());
+    for (int i = 0; i < kMaxReservations; i++) {
+      Reservation* reservation = &reservations[i];
+      if (base::NoBarrier_Load(&reservation->start) == 0) continue;
+      if (reservation->isolate != isolate) continue;
+      delta += static_cast<int64_t>(reservation->committed) -
+               static_cast<int64_t>(reservation->reported);
+      reservation->reported = reservation->committed;
+      reservation->report_requested = false;
+    }
+  }
+  AdjustExternalMemory(isolate, delta);
+}
+
+namespace {
+void ReportCommittedMemoryInterrupt(v8::Isolate* isolate, void* data) {
+  ReportCommittedMemory(reinterpret_cast<Isolate*>(isolate));
+}
+}  // namespace
+
+int32_t GrowMemory(ByteArray* instance_data, uint32_t delta) {
+  DisallowHeapAllocation no_allocation;
+  Address data = instance_data->GetDataStartAddress();
+  uint32_t old_size =
+      Memory::uint32_at(data + ModuleEnv::kInstanceMemSizeOffset);
+  if (delta == 0) return static_cast<int32_t>(old_size);
+  if (delta % WasmModule::kPageSize != 0) return -1;
+  // The byte length of the buffer must remain a Smi, so that growing does
+  // not allocate.
+  uint64_t new_size = static_cast<uint64_t>(old_size) + delta;
+  if (new_size > static_cast<uint64_t>(Smi::kMaxValue)) return -1;
+
+  base::LockGuard<base::Mutex> lock(reservations_mutex.Pointer());
+  byte* start = reinterpret_cast<byte*>(
+      Memory::uintptr_at(data + ModuleEnv::kInstanceMemStartOffset));
+  Reservation* reservation = FindReservation(start);
+  if (reservation == nullptr || new_size > reservation->max_size) return -1;
+  size_t page_size = base::OS::CommitPageSize();
+  // Accesses past the end of a guarded memory must fault, so it can only
+  // grow by whole commit pages.
+  if (reservation->guarded && new_size % page_size != 0) return -1;
+  size_t committed = RoundUp(static_cast<size_t>(new_size), page_size);
+  if (committed > reservation->committed) {
+    if (!base::VirtualMemory::CommitRegion(
+            start + reservation->committed,
+            committed - reservation->committed, false)) {
+      return -1;
+    }
+    reservation->committed = committed;
+    // Growing cannot trigger a GC, so the growth is reported from the next
+    // interrupt check of the isolate, at the latest when control returns to
+    // JavaScript.
+    if (!reservation->report_requested) {
+      reservation->report_requested = true;
+      reservation->isolate->RequestInterrupt(ReportCommittedMemoryInterrupt,
+                                             nullptr);
+    }
+  }
+  JSArrayBuffer::cast(*reservation->location)
+      ->set_byte_length(Smi::FromInt(static_cast<int>(new_size)));
+  Memory::uint32_at(data + ModuleEnv::kInstanceMemSizeOffset) =
+      static_cast<uint32_t>(new_size);
+  return static_cast<int32_t>(old_size);
+}
+
+int32_t AtomicOp(int32_t opcode, int32_t* address, int32_t value,
+                 int32_t operand) {
+  switch (opcode) {
+    case kExprI32LoadMem: {
+      base::MemoryBarrier();
+      int32_t result = base::NoBarrier_Load(address);
+      base::MemoryBarrier();
+      return result;
+    }
+    case kExprI32StoreMem:
+      base::MemoryBarrier();
+      base::NoBarrier_Store(address, value);
+      base::MemoryBarrier();
+      return value;
+    case kExprI32AtomicCompareExchange:
+      return CompareExchange(address, value, operand);
+    case kExprI32AtomicWait:
+      return AtomicWait(address, value, operand);
+    case kExprAtomicNotify:
+      return AtomicNotify(address, value);
+    default: {
+      // Retry until no other thread changed the value in between.
+      int32_t old_value = base::NoBarrier_Load(address);
+      while (true) {
+        int32_t previous = CompareExchange(
+            address, old_value, Modify(opcode, old_value, value));
+        if (previous == old_value) return old_value;
+        old_value = previous;
+      }
+    }
+  }
+}
+
+#if V8_OS_POSIX
+MemoryImage* MemoryImage::New(WasmModule* module) {
+  // Mapping only pays off once the data covers at least a page.
+  size_t page_size = base::OS::CommitPageSize();
+  size_t data_size = 0;
+  size_t end = 0;
+  for (const WasmDataSegment& segment : *module->data_segments) {
+    if (!segment.init) continue;
+    data_size += segment.source_size;
+    end = std::max(end, static_cast<size_t>(segment.dest_addr) +
+                            segment.source_size);
+  }
+  if (data_size < page_size) return new MemoryImage(-1, 0);
+
+  // The image is an anonymous file. Pages without data remain holes in it.
+#if V8_OS_LINUX && defined(__NR_memfd_create)
+  int fd = static_cast<int>(syscall(__NR_memfd_create, "wasm-memory", 0));
+#else
+  int fd = -1;
+#endif
+  if (fd < 0) {
+    char path[] = "/tmp/wasm-memory-XXXXXX";
+    fd = mkstemp(path);
+    if (fd >= 0) unlink(path);
+  }
+  size_t size = RoundUp(end, page_size);
+  if (fd < 0 || ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    if (fd >= 0) close(fd);
+    return new MemoryImage(-1, 0);
+  }
+  for (const WasmDataSegment& segment : *module->data_segments) {
+    if (!segment.init) continue;
+    const byte* data = module->module_start + segment.source_offset;
+    size_t written = 0;
+    while (written < segment.source_size) {
+      ssize_t result =
+          pwrite(fd, data + written, segment.source_size - written,
+                 static_cast<off_t>(segment.dest_addr + written));
+      if (result <= 0) {
+        close(fd);
+        return new MemoryImage(-1, 0);
+      }
+      written += static_cast<size_t>(result);
+    }
+  }
+  return new MemoryImage(fd, size);
+}
+
+MemoryImage::~MemoryImage() {
+  // Mappings of the image stay valid after the file is closed.
+  if (fd_ >= 0) close(fd_);
+}
+
+bool MemoryImage::MapInto(byte* start) {
+  if (size_ == 0) return false;
+  void* result = mmap(start, size_, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_FIXED, fd_, 0);
+  if (result == start) return true;
+  // A failed mapping may have removed the pages that were there before.
+  CHECK(base::VirtualMemory::CommitRegion(start, size_, false));
+  return false;
+}
+#else  // V8_OS_POSIX
+MemoryImage* MemoryImage::New(WasmModule* module) {
+  return new MemoryImage(-1, 0);
+}
+
+MemoryImage::~MemoryImage() {}
+
+bool MemoryImage::MapInto(byte* start) { return false; }
+#endif  // V8_OS_POSIX
+}
+}
+}
@@ -0,0 +1,146 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8_WASM_MEMORY_H_
+#define V8_WASM_MEMORY_H_
+
+#include "src/handles.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+// On x64 Linux hosts, a linear memory can be placed at the start of a guard
+// region that covers every address a memory access can compute from the
+// memory start, a 32-bit index and a 32-bit offset. The rest of the region
+// is inaccessible, so that compiled code can leave out the explicit bounds
+// checks and let out-of-bounds accesses fault instead. A fault handler then
+// resumes execution in the out-of-bounds trap code of the memory, see
+// {SetOutOfBoundsTrapCode}.
+const uint64_t kGuardRegionSize = static_cast<uint64_t>(1) << 33;
+
+// Returns {true} if guard regions are supported on this host.
+bool GuardRegionsSupported();
+
+// Allocates a zero-initialized memory of {size} bytes at the start of a
+// reservation of address space, and stores its address in {backing_store}.
+// The memory can grow in place up to {max_size} bytes. With {guarded}, the
+// reservation is a guard region, otherwise it covers {max_size} bytes. The
+// reservation is released when the buffer dies, so the instance using the
+// memory must hold the buffer for as long as its code can run. Returns a
+// null handle and leaves {backing_store} alone if the address space cannot
+// be reserved, or if {kMaxReservedArrayBuffers} reserved buffers are alive.
+Handle<JSArrayBuffer> NewReservedArrayBuffer(Isolate* isolate, size_t size,
+                                             size_t max_size, bool guarded,
+                                             byte** backing_store);
+
+// The number of reserved buffers that can be alive at a time. The fault
+// handler looks guard regions up in a table of this size without locking,
+// so the table cannot grow.
+const int kMaxReservedArrayBuffers = 1024;
+
+// Returns {true} if {kMaxReservedArrayBuffers} reserved buffers are alive.
+bool ReservedArrayBuffersExhausted();
+
+// Returns {true} if the memory of {buffer} lies at the start of a guard
+// region.
+bool IsGuardedArrayBuffer(Handle<JSArrayBuffer> buffer);
+
+// Sets the {code} that out-of-bounds accesses into the guard region of
+// {buffer} continue in, unless the region already has trap code. The fault
+// handler drops the frame of the faulting function and enters {code} as if
+// the caller of that function had called it, so {code} must take no stack
+// parameters and throw the trap without returning, see
+// {compiler::CompileOutOfBoundsTrap}. The code stays alive as long as the
+// region.
+void SetOutOfBoundsTrapCode(Handle<JSArrayBuffer> buffer, Handle<Code> code);
+
+// Allocates a zero-initialized memory of {size} bytes that can be shared
+// between threads, and stores its address in {backing_store}. The memory is
+// freed once the last buffer holding it dies: the returned buffer holds it,
+// and so does every buffer passed to {HoldSharedMemory}. Shared memories
+// cannot grow, since the instances on other threads keep their own copy of
+// the memory size. Returns a null handle and leaves {backing_store} alone if the
+// memory cannot be allocated.
+Handle<JSArrayBuffer> NewSharedArrayBuffer(Isolate* isolate, size_t size,
+                                           byte** backing_store);
+
+// Makes {buffer} hold the memory it views, if that memory was allocated by
+// {NewSharedArrayBuffer}, so that the memory is not freed while {buffer} is
+// alive. Used for the buffers through which other threads share the memory.
+void HoldSharedMemory(Handle<JSArrayBuffer> buffer);
+
+// Reports the memory committed for the reserved buffers of {isolate} to its
+// heap as external memory, which counts towards the next GC. Memory that
+// grows from compiled code is reported from an interrupt that {GrowMemory}
+// requests, since growing cannot trigger a GC. Reserved buffers report their
+// memory when they are allocated and stop counting it when they die.
+void ReportCommittedMemory(Isolate* isolate);
+
+// Grows the memory of the instance with the {instance_data} by {delta} bytes,
+// a multiple of the page size. The memory grows in place, so compiled code
+// only needs to reload the memory size. Returns the previous size of the
+// memory in bytes, or -1 if the memory cannot grow that much. Does not
+// allocate on the JS heap, so that compiled code can call it directly.
+int32_t GrowMemory(ByteArray* instance_data, uint32_t delta);
+
+// The results of an atomic wait.
+enum AtomicWaitResult {
+  kAtomicWaitNotAllowed = -1,  // the thread may not block.
+  kAtomicWaitOk = 0,           // the thread was notified.
+  kAtomicWaitNotEqual = 1,     // the value was not the expected one.
+  kAtomicWaitTimedOut = 2      // the thread was not notified in time.
+};
+
+// Allows or disallows atomic waits on the current thread. Threads may not
+// wait unless the embedder allows it, so that waits cannot block the main
+// thread of an isolate. Scripts of a worker thread allow it through
+// {WASM.setAtomicWaitAllowed}.
+void SetAtomicWaitAllowed(bool allowed);
+
+// Performs the atomic {opcode} on the aligned 32-bit integer at {address} in
+// a memory, with sequential consistency, and returns its result. Atomic
+// loads and stores are {kExprI32LoadMem} and {kExprI32StoreMem}. A wait
+// blocks the thread for at most {operand} milliseconds, or without limit if
+// {operand} is negative, and returns {kAtomicWaitNotAllowed} right away on a
+// thread that may not wait. A notify of {value} waiters notifies all of them if
+// {value} is negative. Does not allocate on the JS heap, so that compiled
+// code can call it directly.
+int32_t AtomicOp(int32_t opcode, int32_t* address, int32_t value,
+                 int32_t operand);
+
+struct WasmModule;
+
+// An image of the initial memory of a module, with the contents of its data
+// segments, that is shared between the instances of the module. The image
+// is mapped copy-on-write into their memories, so that instantiation only
+// costs the pages an instance actually touches, instead of copying all the
+// data.
+class MemoryImage {
+ public:
+  // Creates the image for {module}. The image is empty if the host cannot
+  // map images or if the module initializes too little data to make it
+  // worth it.
+  static MemoryImage* New(WasmModule* module);
+  ~MemoryImage();
+
+  // The size of the image, a multiple of the commit page size.
+  size_t size() const { return size_; }
+
+  // Maps the image at the start of the memory at {start}, which must have
+  // been allocated by {NewReservedArrayBuffer} with at least {size()} bytes
+  // committed. Returns {false} on failure, with the memory still zero.
+  bool MapInto(byte* start);
+
+ private:
+  MemoryImage(int fd, size_t size) : fd_(fd), size_(size) {}
+
+  int fd_;
+  size_t size_;
+};
+}
+}
+}
+
+#endif  // V8_WASM_MEMORY_H_
@@ -0,0 +1,101 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <map>
+
+#include "src/wasm/wasm-memory.h"
+#include "src/wasm/wasm-module-bytes.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+namespace {
+// All copies alive in the process, keyed by the hash of their bytes.
+base::LazyMutex registry_mutex = LAZY_MUTEX_INITIALIZER;
+std::multimap<uint32_t, ModuleBytes*>* registry = nullptr;
+
+// FNV-1a over the bytes.
+uint32_t HashBytes(const byte* start, const byte* end) {
+  uint32_t hash = 2166136261u;
+  hash = (hash ^ static_cast<uint32_t>(end - start)) * 16777619u;
+  for (const byte* p = start; p < end; p++) {
+    hash = (hash ^ *p) * 16777619u;
+  }
+  return hash;
+}
+}  // namespace
+
+ModuleBytes* ModuleBytes::Get(const byte* start, const byte* end) {
+  uint32_t hash = HashBytes(start, end);
+  size_t length = static_cast<size_t>(end - start);
+  base::LockGuard<base::Mutex> guard(registry_mutex.Pointer());
+  if (registry == nullptr) {
+    registry = new std::multimap<uint32_t, ModuleBytes*>();
+  }
+  auto range = registry->equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    ModuleBytes* bytes = it->second;
+    if (bytes->length_ != length) continue;
+    if (memcmp(bytes->data_, start, length) != 0) continue;
+    bytes->ref_count_++;
+    return bytes;
+  }
+  ModuleBytes* bytes = new ModuleBytes(start, length, hash);
+  registry->insert(std::make_pair(hash, bytes));
+  return bytes;
+}
+
+uint32_t ModuleBytes::Hash(const byte* start, const byte* end) {
+  return HashBytes(start, end);
+}
+
+size_t ModuleBytes::Count() {
+  base::LockGuard<base::Mutex> guard(registry_mutex.Pointer());
+  return registry == nullptr ? 0 : registry->size();
+}
+
+ModuleBytes::ModuleBytes(const byte* start, size_t length, uint32_t hash)
+    : data_(new byte[length]),
+      length_(length),
+      hash_(hash),
+      ref_count_(1),
+      image_(nullptr) {
+  memcpy(data_, start, length);
+}
+
+ModuleBytes::~ModuleBytes() {
+  delete image_;
+  delete[] data_;
+}
+
+void ModuleBytes::AddRef() {
+  base::LockGuard<base::Mutex> guard(registry_mutex.Pointer());
+  DCHECK_LT(0, ref_count_);
+  ref_count_++;
+}
+
+void ModuleBytes::Release() {
+  {
+    base::LockGuard<base::Mutex> guard(registry_mutex.Pointer());
+    DCHECK_LT(0, ref_count_);
+    if (--ref_count_ > 0) return;
+    auto range = registry->equal_range(hash_);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second != this) continue;
+      registry->erase(it);
+      break;
+    }
+  }
+  delete this;
+}
+
+MemoryImage* ModuleBytes::GetMemoryImage(WasmModule* module) {
+  base::LockGuard<base::Mutex> guard(&image_mutex_);
+  if (image_ == nullptr) image_ = MemoryImage::New(module);
+  return image_;
+}
+}
+}
+}
@@ -0,0 +1,67 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8_WASM_MODULE_BYTES_H_
+#define V8_WASM_MODULE_BYTES_H_
+
+#include "src/base/platform/mutex.h"
+#include "src/globals.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+struct WasmModule;
+class MemoryImage;
+
+// An immutable copy of the bytes of a module, shared by every module that is
+// decoded from the same bytes anywhere in the process. Isolates that load the
+// same module, such as the isolates of workers, keep pointers into a single
+// copy and share the image of its initial memory. The copy is reference
+// counted and is freed once the last module decoded from it dies.
+class ModuleBytes {
+ public:
+  // Returns the copy of the bytes between {start} and {end}, making one if
+  // there is none yet. The caller owns a new reference to it.
+  static ModuleBytes* Get(const byte* start, const byte* end);
+
+  // Returns the number of copies alive in the process.
+  static size_t Count();
+
+  // Returns the hash of the bytes between {start} and {end}, as {hash()}
+  // would for a copy of them.
+  static uint32_t Hash(const byte* start, const byte* end);
+
+  void AddRef();
+  // Drops a reference, freeing the copy when it was the last one.
+  void Release();
+
+  const byte* start() const { return data_; }
+  const byte* end() const { return data_ + length_; }
+  size_t length() const { return length_; }
+  // The hash of the bytes, which identifies the module in profiles.
+  uint32_t hash() const { return hash_; }
+
+  // Returns the image of the initial memory of {module}, which must have
+  // been decoded from these bytes, creating it upon first use.
+  MemoryImage* GetMemoryImage(WasmModule* module);
+
+ private:
+  ModuleBytes(const byte* start, size_t length, uint32_t hash);
+  ~ModuleBytes();
+
+  byte* data_;
+  size_t length_;
+  uint32_t hash_;
+  int ref_count_;  // guarded by the registry mutex.
+  base::Mutex image_mutex_;
+  MemoryImage* image_;  // guarded by {image_mutex_}.
+
+  DISALLOW_COPY_AND_ASSIGN(ModuleBytes);
+};
+}
+}
+}
+
+#endif  // V8_WASM_MODULE_BYTES_H_
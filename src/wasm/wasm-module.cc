@@ -2,14 +2,32 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <set>
+
 #include "src/v8.h"
 #include "src/macro-assembler.h"
 #include "src/objects.h"
 
+#include "include/v8-platform.h"
+#include "src/base/platform/elapsed-timer.h"
+#include "src/base/platform/mutex.h"
+#include "src/base/platform/platform.h"
+#include "src/base/platform/semaphore.h"
+#include "src/conversions-inl.h"
+#include "src/execution.h"
+#include "src/global-handles.h"
+
 #include "src/simulator.h"
+#include "src/v8memory.h"
 
 #include "src/wasm/ast-decoder.h"
 #include "src/wasm/wasm-compiler.h"
+#include "src/wasm/wasm-interpreter.h"
+#include "src/wasm/wasm-memory.h"
+#include "src/wasm/wasm-module-bytes.h"
 #include "src/wasm/module-decoder.h"
 #include "src/wasm/wasm-module.h"
 #include "src/wasm/wasm-result.h"
@@ -18,6 +36,73 @@ namespace v8 {
 namespace internal {
 namespace wasm {
 
+WasmModule::~WasmModule() {
+  delete memory_image;
+  if (bytes != nullptr) bytes->Release();
+}
+
+namespace {
+bool SignaturesEqual(FunctionSig* a, FunctionSig* b) {
+  if (a->parameter_count() != b->parameter_count()) return false;
+  if (a->return_count() != b->return_count()) return false;
+  for (size_t i = 0; i < a->parameter_count(); i++) {
+    if (a->GetParam(i) != b->GetParam(i)) return false;
+  }
+  for (size_t i = 0; i < a->return_count(); i++) {
+    if (a->GetReturn(i) != b->GetReturn(i)) return false;
+  }
+  return true;
+}
+
+// The indices of the signature and the code of the table entry {i} in the
+// function table of an instance.
+int FunctionTableSigIndex(int i) {
+  return i * ModuleEnv::kFunctionTableEntrySize +
+         ModuleEnv::kFunctionTableSigOffset;
+}
+int FunctionTableCodeIndex(int i) {
+  return i * ModuleEnv::kFunctionTableEntrySize +
+         ModuleEnv::kFunctionTableCodeOffset;
+}
+
+// The hash of the bytes of {module}, as a Smi on all hosts.
+Smi* ModuleBytesHash(const WasmModule* module) {
+  uint32_t hash = module->bytes != nullptr
+                      ? module->bytes->hash()
+                      : ModuleBytes::Hash(module->module_start,
+                                          module->module_end);
+  return Smi::FromInt(static_cast<int>(hash & 0x3fffffff));
+}
+}
+
+uint16_t WasmModule::CanonicalSigIndex(uint32_t index) const {
+  if (canonical_sig_indices && index < canonical_sig_indices->size()) {
+    return canonical_sig_indices->at(index);
+  }
+  FunctionSig* sig = signatures->at(index);
+  for (uint32_t i = 0; i < index; i++) {
+    if (SignaturesEqual(signatures->at(i), sig)) {
+      return static_cast<uint16_t>(i);
+    }
+  }
+  return static_cast<uint16_t>(index);
+}
+
+void WasmModule::SetModuleOf(JSObject* instance) const {
+  instance->SetInternalField(kWasmModuleBytesHash, ModuleBytesHash(this));
+}
+
+bool WasmModule::IsModuleOf(JSObject* instance) const {
+  if (instance->GetInternalField(kWasmModuleBytesHash) !=
+      ModuleBytesHash(this)) {
+    return false;
+  }
+  Object* code_table = instance->GetInternalField(kWasmModuleCodeTable);
+  return code_table->IsFixedArray() &&
+         FixedArray::cast(code_table)->length() ==
+             static_cast<int>(functions->size());
+}
+
 std::ostream& operator<<(std::ostream& os, const WasmModule& module) {
   os << "WASM module with ";
   os << (1 << module.min_mem_size_log2) << " min mem";
@@ -50,6 +135,8 @@ std::ostream& operator<<(std::ostream& os, const WasmFunction& function) {
     os << function.local_float32_count << " float32s ";
   if (function.local_float64_count)
     os << function.local_float64_count << " float64s ";
+  if (function.local_simd128_count)
+    os << function.local_simd128_count << " simd128s ";
 
   os << " code bytes: "
      << (function.code_end_offset - function.code_start_offset);
@@ -89,17 +176,21 @@ class WasmLinker {
   }
 
   void Link(Handle<FixedArray> function_table,
-            std::vector<uint16_t>* functions) {
+            ZoneVector<uint16_t>* functions) {
     for (size_t i = 0; i < function_code_.size(); i++) {
       LinkFunction(function_code_[i]);
     }
     if (functions && !function_table.is_null()) {
       int table_size = static_cast<int>(functions->size());
-      DCHECK_EQ(function_table->length(), table_size * 2);
+      DCHECK_EQ(function_table->length(),
+                table_size * ModuleEnv::kFunctionTableEntrySize);
       for (int i = 0; i < table_size; i++) {
-        function_table->set(i + table_size, *function_code_[functions->at(i)]);
+        function_table->set(FunctionTableCodeIndex(i),
+                            *function_code_[functions->at(i)]);
       }
     }
+    // No call site refers to the placeholders any more, so let them die.
+    placeholder_code_.clear();
   }
 
  private:
@@ -142,14 +233,7 @@ class WasmLinker {
 };
 
 namespace {
-// Internal constants for the layout of the module object.
-const int kWasmModuleInternalFieldCount = 4;
-const int kWasmModuleFunctionTable = 0;
-const int kWasmModuleCodeTable = 1;
-const int kWasmMemArrayBuffer = 2;
-const int kWasmGlobalsArrayBuffer = 3;
-
-size_t AllocateGlobalsOffsets(std::vector<WasmGlobal>* globals) {
+size_t AllocateGlobalsOffsets(ZoneVector<WasmGlobal>* globals) {
   uint32_t offset = 0;
   if (!globals) return 0;
   for (WasmGlobal& global : *globals) {
@@ -173,83 +257,183 @@ void LoadDataSegments(WasmModule* module, byte* mem_addr, size_t mem_size) {
   }
 }
 
+// Returns the image of the initial memory of {module}, or nullptr if the
+// data segments are copied instead.
+MemoryImage* GetMemoryImage(WasmModule* module) {
+  MemoryImage* image;
+  if (module->bytes != nullptr) {
+    // Modules decoded from the same bytes, in any isolate, share the image.
+    image = module->bytes->GetMemoryImage(module);
+  } else {
+    if (module->memory_image == nullptr) {
+      module->memory_image = MemoryImage::New(module);
+    }
+    image = module->memory_image;
+  }
+  return image->size() > 0 ? image : nullptr;
+}
+
+// Maps the data segments of {module} copy-on-write into a memory allocated
+// by {NewReservedArrayBuffer}. Returns {false} if they must be copied.
+bool MapDataSegments(MemoryImage* image, WasmModule* module, byte* mem_addr,
+                     size_t mem_size) {
+  for (const WasmDataSegment& segment : *module->data_segments) {
+    if (!segment.init) continue;
+    CHECK_LE(segment.dest_addr + segment.source_size, mem_size);
+  }
+  if (image->size() > RoundUp(mem_size, base::OS::CommitPageSize())) {
+    return false;
+  }
+  return image->MapInto(mem_addr);
+}
+
 Handle<FixedArray> BuildFunctionTable(Isolate* isolate, WasmModule* module) {
   if (!module->function_table || module->function_table->size() == 0) {
     return Handle<FixedArray>::null();
   }
   int table_size = static_cast<int>(module->function_table->size());
-  Handle<FixedArray> fixed = isolate->factory()->NewFixedArray(2 * table_size);
+  Handle<FixedArray> fixed = isolate->factory()->NewFixedArray(
+      table_size * ModuleEnv::kFunctionTableEntrySize);
   for (int i = 0; i < table_size; i++) {
     WasmFunction* function =
         &module->functions->at(module->function_table->at(i));
-    fixed->set(i, Smi::FromInt(function->sig_index));
+    fixed->set(FunctionTableSigIndex(i),
+               Smi::FromInt(module->CanonicalSigIndex(function->sig_index)));
   }
   return fixed;
 }
 
+// Makes the exported {function} keep {instance} alive. Its code uses the
+// memory and globals of the instance, which are freed once their buffers
+// die, and only the instance holds the buffers.
+void SetExportInstance(Handle<JSFunction> function,
+                       Handle<JSObject> instance) {
+  function->shared()->set_function_data(*instance);
+}
+
 Handle<JSArrayBuffer> NewArrayBuffer(Isolate* isolate, int size,
                                      byte** backing_store) {
   void* memory = isolate->array_buffer_allocator()->Allocate(size);
   if (!memory) return Handle<JSArrayBuffer>::null();
   *backing_store = reinterpret_cast<byte*>(memory);
 
-#if DEBUG
-  // Double check the API allocator actually zero-initialized the memory.
-  for (uint32_t i = 0; i < size; i++) {
-    DCHECK_EQ(0, (*backing_store)[i]);
-  }
-#endif
-
+  // The heap owns the memory, so that it reports it as external memory and
+  // frees it with the buffer.
   Handle<JSArrayBuffer> buffer = isolate->factory()->NewJSArrayBuffer();
-  JSArrayBuffer::Setup(buffer, isolate, true, memory, size);
+  JSArrayBuffer::Setup(buffer, isolate, false, memory, size);
   buffer->set_is_neuterable(false);
   return buffer;
 }
 
-}  // namespace
-
-// Instantiates a wasm module as a JSObject.
-//  * allocates a backing store of {mem_size} bytes.
-//  * installs a named property "memory" for that buffer if exported
-//  * installs named properties on the object for exported functions
-//  * compiles wasm code to machine code
-MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
-                                              Handle<JSObject> ffi,
-                                              Handle<JSArrayBuffer> memory) {
-  this->shared_isolate = isolate;  // TODO: have a real shared isolate.
-  ErrorThrower thrower(isolate, "WasmModule::Instantiate()");
+Handle<ByteArray> NewInstanceData(Isolate* isolate, byte* mem_addr,
+                                  size_t mem_size, byte* globals_addr) {
+  Handle<ByteArray> data = isolate->factory()->NewByteArray(
+      ModuleEnv::kInstanceDataSize, TENURED);
+  Address base = data->GetDataStartAddress();
+  Memory::uintptr_at(base + ModuleEnv::kInstanceMemStartOffset) =
+      reinterpret_cast<uintptr_t>(mem_addr);
+  Memory::uintptr_at(base + ModuleEnv::kInstanceGlobalsAreaOffset) =
+      reinterpret_cast<uintptr_t>(globals_addr);
+  Memory::uintptr_at(base + ModuleEnv::kInstanceThrowEntryOffset) =
+      reinterpret_cast<uintptr_t>(
+          ExternalReference(Runtime::kThrow, isolate).address());
+  ApiFunction grow_memory(FUNCTION_ADDR(GrowMemory));
+  Memory::uintptr_at(base + ModuleEnv::kInstanceGrowMemoryEntryOffset) =
+      reinterpret_cast<uintptr_t>(
+          ExternalReference(&grow_memory, ExternalReference::BUILTIN_CALL,
+                            isolate)
+              .address());
+  ApiFunction atomic_op(FUNCTION_ADDR(AtomicOp));
+  Memory::uintptr_at(base + ModuleEnv::kInstanceAtomicEntryOffset) =
+      reinterpret_cast<uintptr_t>(
+          ExternalReference(&atomic_op, ExternalReference::BUILTIN_CALL,
+                            isolate)
+              .address());
+  Memory::uint32_at(base + ModuleEnv::kInstanceMemSizeOffset) =
+      static_cast<uint32_t>(mem_size);
+  return data;
+}
 
+// Allocates the module object, the linear memory, the globals area and the
+// function table of a new instance, and sets up {module_env} for compiling
+// instance-independent code against them. A new memory that may grow is
+// allocated in a reservation for its maximum size, so that it can grow in
+// place, and instantiation fails if it cannot be reserved. With
+// {kGuardRegionBoundsChecks}, the reservation is a guard region if possible.
+// A new memory initialized from an image is reserved as well, so that the
+// image can be mapped into it. A shared memory is initialized by
+// the instance that allocates it; instances given an existing shared memory
+// leave its contents alone, since other threads may already be using it.
+// The time taken by the data segments is recorded in {stats}, if given.
+MaybeHandle<JSObject> SetupInstance(Isolate* isolate, WasmModule* wasm_module,
+                                    Handle<JSArrayBuffer> memory,
+                                    BoundsCheckMode bounds_checks,
+                                    ErrorThrower& thrower,
+                                    ModuleEnv* module_env,
+                                    WasmCompilationStats* stats = nullptr) {
   Factory* factory = isolate->factory();
   // Memory is bigger than maximum supported size.
-  if (memory.is_null() && min_mem_size_log2 > kMaxMemSize) {
+  if (memory.is_null() &&
+      wasm_module->min_mem_size_log2 > WasmModule::kMaxMemSize) {
     thrower.Error("Out of memory: wasm memory too large");
     return MaybeHandle<JSObject>();
   }
 
-  Handle<Map> map = factory->NewMap(
-      JS_OBJECT_TYPE,
-      JSObject::kHeaderSize + kWasmModuleInternalFieldCount * kPointerSize);
-
   //-------------------------------------------------------------------------
   // Allocate the module object.
   //-------------------------------------------------------------------------
-  Handle<JSObject> module = factory->NewJSObjectFromMap(map, TENURED);
-  Handle<FixedArray> code_table =
-      factory->NewFixedArray(static_cast<int>(functions->size()), TENURED);
+  Handle<JSObject> module = WasmModule::NewModuleObject(isolate);
 
   //-------------------------------------------------------------------------
   // Allocate the linear memory.
   //-------------------------------------------------------------------------
-  uint32_t mem_size = 1 << min_mem_size_log2;
+  uint32_t mem_size = 1 << wasm_module->min_mem_size_log2;
+  int max_mem_size_log2 = std::max(wasm_module->min_mem_size_log2,
+                                   wasm_module->max_mem_size_log2);
+  if (max_mem_size_log2 > WasmModule::kMaxMemSize) {
+    max_mem_size_log2 = WasmModule::kMaxMemSize;
+  }
+  uint32_t max_mem_size = 1 << max_mem_size_log2;
   byte* mem_addr = nullptr;
   Handle<JSArrayBuffer> mem_buffer;
+  MemoryImage* image = nullptr;
   if (!memory.is_null()) {
+    if (wasm_module->mem_shared && !memory->is_shared()) {
+      thrower.Error("Shared memory must be a SharedArrayBuffer");
+      return MaybeHandle<JSObject>();
+    }
     memory->set_is_neuterable(false);
+    // The memory of another thread stays alive as long as this buffer.
+    if (memory->is_shared()) HoldSharedMemory(memory);
     mem_addr = reinterpret_cast<byte*>(memory->backing_store());
     mem_size = memory->byte_length()->Number();
     mem_buffer = memory;
+  } else if (wasm_module->mem_shared) {
+    mem_buffer = NewSharedArrayBuffer(isolate, mem_size, &mem_addr);
+    if (!mem_addr) {
+      thrower.Error("Out of memory: wasm shared memory");
+      return MaybeHandle<JSObject>();
+    }
   } else {
-    mem_buffer = NewArrayBuffer(isolate, mem_size, &mem_addr);
+    bool guarded = bounds_checks == kGuardRegionBoundsChecks &&
+                   GuardRegionsSupported();
+    image = GetMemoryImage(wasm_module);
+    if (guarded || max_mem_size > mem_size || image != nullptr) {
+      mem_buffer = NewReservedArrayBuffer(isolate, mem_size, max_mem_size,
+                                          guarded, &mem_addr);
+    }
+    if (mem_buffer.is_null()) {
+      // Memory that was meant to grow would only fail to later, without a
+      // hint why.
+      if (max_mem_size > mem_size) {
+        thrower.Error(ReservedArrayBuffersExhausted()
+                          ? "Out of memory: too many growable wasm memories"
+                          : "Out of memory: wasm memory reservation");
+        return MaybeHandle<JSObject>();
+      }
+      image = nullptr;
+      mem_buffer = NewArrayBuffer(isolate, mem_size, &mem_addr);
+    }
     if (!mem_addr) {
       // Not enough space for backing store of memory
       thrower.Error("Out of memory: wasm memory");
@@ -258,11 +442,22 @@ MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
   }
 
   // Load initialized data segments.
-  LoadDataSegments(this, mem_addr, mem_size);
+  base::ElapsedTimer data_segments_timer;
+  if (stats) data_segments_timer.Start();
+  bool initialized = wasm_module->mem_shared && !memory.is_null();
+  if (!initialized &&
+      (image == nullptr ||
+       !MapDataSegments(image, wasm_module, mem_addr, mem_size))) {
+    LoadDataSegments(wasm_module, mem_addr, mem_size);
+  }
+  if (stats) {
+    stats->data_segments_time =
+        data_segments_timer.Elapsed().InMillisecondsF();
+  }
 
   module->SetInternalField(kWasmMemArrayBuffer, *mem_buffer);
 
-  if (mem_export) {
+  if (wasm_module->mem_export) {
     // Export the memory as a named property.
     Handle<String> name = factory->InternalizeUtf8String("memory");
     JSObject::AddProperty(module, name, mem_buffer, READ_ONLY);
@@ -271,11 +466,11 @@ MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
   //-------------------------------------------------------------------------
   // Allocate the globals area if necessary.
   //-------------------------------------------------------------------------
-  size_t globals_size = AllocateGlobalsOffsets(globals);
+  size_t globals_size = AllocateGlobalsOffsets(wasm_module->globals);
   byte* globals_addr = nullptr;
   if (globals_size > 0) {
-    Handle<JSArrayBuffer> globals_buffer =
-        NewArrayBuffer(isolate, mem_size, &globals_addr);
+    Handle<JSArrayBuffer> globals_buffer = NewArrayBuffer(
+        isolate, static_cast<int>(globals_size), &globals_addr);
     if (!globals_addr) {
       // Not enough space for backing store of globals.
       thrower.Error("Out of memory: wasm globals");
@@ -288,21 +483,1310 @@ MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
   }
 
   //-------------------------------------------------------------------------
-  // Compile all functions in the module.
+  // Set up the environment for compiling against this instance.
+  //-------------------------------------------------------------------------
+  module_env->module = wasm_module;
+  module_env->mem_start = reinterpret_cast<uintptr_t>(mem_addr);
+  module_env->mem_end = reinterpret_cast<uintptr_t>(mem_addr) + mem_size;
+  module_env->globals_area = reinterpret_cast<uintptr_t>(globals_addr);
+  module_env->linker = nullptr;
+  module_env->function_code = nullptr;
+  module_env->function_table = BuildFunctionTable(isolate, wasm_module);
+  module_env->memory = memory;
+  module_env->context = isolate->native_context();
+  module_env->instance_data =
+      NewInstanceData(isolate, mem_addr, mem_size, globals_addr);
+  module_env->asm_js = bounds_checks == kAsmJsBoundsChecks;
+  module_env->guard_region = bounds_checks == kGuardRegionBoundsChecks &&
+                             IsGuardedArrayBuffer(mem_buffer);
+  BoundsCheckMode code_bounds_checks = kExplicitBoundsChecks;
+  if (module_env->asm_js) code_bounds_checks = kAsmJsBoundsChecks;
+  if (module_env->guard_region) {
+    // Faults in the guard region continue in code that throws the trap.
+    SetOutOfBoundsTrapCode(
+        mem_buffer,
+        compiler::CompileOutOfBoundsTrap(isolate, module_env->context));
+    code_bounds_checks = kGuardRegionBoundsChecks;
+  }
+
+  if (module_env->function_table.is_null()) {
+    module->SetInternalField(kWasmModuleFunctionTable, Smi::FromInt(0));
+  } else {
+    module->SetInternalField(kWasmModuleFunctionTable,
+                             *module_env->function_table);
+  }
+  module->SetInternalField(kWasmInstanceData, *module_env->instance_data);
+  module->SetInternalField(kWasmLazyCompilationState, Smi::FromInt(0));
+  module->SetInternalField(kWasmBoundsCheckMode,
+                           Smi::FromInt(code_bounds_checks));
+  wasm_module->SetModuleOf(*module);
+  return module;
+}
+
+// Looks up the JSFunction to import for an external function in {ffi}.
+MaybeHandle<JSFunction> LookupFunction(ErrorThrower& thrower,
+                                       Handle<JSObject> ffi,
+                                       Handle<String> name, int index,
+                                       const char* cstr) {
+  if (ffi.is_null()) {
+    thrower.Error("FFI table is not an object.");
+    return MaybeHandle<JSFunction>();
+  }
+  MaybeHandle<Object> result = Object::GetProperty(ffi, name);
+  if (result.is_null()) {
+    thrower.Error("FFI function #%d:%s not found.", index, cstr);
+    return MaybeHandle<JSFunction>();
+  }
+  Handle<Object> obj = result.ToHandleChecked();
+  if (!obj->IsJSFunction()) {
+    thrower.Error("FFI function #%d:%s is not a JSFunction.", index, cstr);
+    return MaybeHandle<JSFunction>();
+  }
+  return Handle<JSFunction>::cast(obj);
+}
+
+// Redirects code copied from one instance to another: embedded references
+// to the old instance's objects and direct calls to the old instance's
+// functions are patched to refer to the new instance. Works on raw pointers,
+// so no allocation may happen while it is in use.
+class InstanceRelocator {
+ public:
+  void AddObject(Object* old_object, Object* new_object) {
+    objects_[old_object] = new_object;
+  }
+
+  void AddCode(Code* old_code, Code* new_code) {
+    code_[old_code->instruction_start()] = new_code;
+    objects_[old_code] = new_code;
+  }
+
+  void Relocate(Isolate* isolate, Code* code) {
+    int mode_mask = RelocInfo::kCodeTargetMask |
+                    RelocInfo::ModeMask(RelocInfo::EMBEDDED_OBJECT);
+    for (RelocIterator it(code, mode_mask); !it.done(); it.next()) {
+      RelocInfo::Mode mode = it.rinfo()->rmode();
+      if (RelocInfo::IsCodeTarget(mode)) {
+        auto entry = code_.find(it.rinfo()->target_address());
+        if (entry != code_.end()) {
+          it.rinfo()->set_target_address(entry->second->instruction_start(),
+                                         SKIP_WRITE_BARRIER,
+                                         SKIP_ICACHE_FLUSH);
+        }
+      } else {
+        auto entry = objects_.find(it.rinfo()->target_object());
+        if (entry != objects_.end()) {
+          it.rinfo()->set_target_object(entry->second, UPDATE_WRITE_BARRIER,
+                                        SKIP_ICACHE_FLUSH);
+        }
+      }
+    }
+    Assembler::FlushICache(isolate, code->instruction_start(),
+                           code->instruction_size());
+  }
+
+ private:
+  std::map<Object*, Object*> objects_;
+  std::map<Address, Code*> code_;
+};
+
+// Shares the JS<->WASM wrappers of an instance between the functions with
+// equal signatures. The first wrapper for a signature is compiled, and the
+// wrappers of the other functions are copies of it, redirected to the
+// function they wrap.
+class WrapperCache {
+ public:
+  WrapperCache(Isolate* isolate, ModuleEnv* module_env)
+      : isolate_(isolate), module_env_(module_env) {}
+
+  // Returns the WASM->JS wrapper calling the JS {function} that is imported
+  // as the function {index}.
+  Handle<Code> GetWasmToJSWrapper(Handle<JSFunction> function,
+                                  uint32_t index) {
+    FunctionSig* sig = module_env_->GetFunctionSignature(index);
+    // The wrapper depends on whether the arity of {function} matches.
+    bool arity_match =
+        function->shared()->internal_formal_parameter_count() ==
+        static_cast<int>(sig->parameter_count());
+    auto key = std::make_pair(CanonicalSigIndex(index), arity_match);
+    auto entry = wasm_to_js_.find(key);
+    if (entry == wasm_to_js_.end()) {
+      Handle<Code> code = compiler::CompileWasmToJSWrapper(
+          isolate_, module_env_, function, index);
+      wasm_to_js_[key] = std::make_pair(function, code);
+      return code;
+    }
+    Handle<JSFunction> old_function = entry->second.first;
+    Handle<Code> code = isolate_->factory()->CopyCode(entry->second.second);
+    DisallowHeapAllocation no_allocation;
+    InstanceRelocator relocator;
+    relocator.AddObject(*old_function, *function);
+    relocator.AddObject(old_function->context(), function->context());
+    relocator.Relocate(isolate_, *code);
+    compiler::RecordWasmCodeCreation(isolate_, module_env_->module, index,
+                                     "WASM->JS function wrapper", code);
+    return code;
+  }
+
+  // Returns the JSFunction named {name} that calls the {wasm_code} of the
+  // exported function {index} from JavaScript.
+  Handle<JSFunction> GetJSToWasmWrapper(Handle<String> name,
+                                        Handle<Code> wasm_code,
+                                        uint32_t index) {
+    uint16_t key = CanonicalSigIndex(index);
+    auto entry = js_to_wasm_.find(key);
+    if (entry == js_to_wasm_.end()) {
+      Handle<JSFunction> function = compiler::CompileJSToWasmWrapper(
+          isolate_, module_env_, name, wasm_code, index);
+      js_to_wasm_[key] =
+          std::make_pair(wasm_code, handle(function->code(), isolate_));
+      return function;
+    }
+    return CopyJSToWasmWrapper(isolate_, module_env_, name, wasm_code, index,
+                               entry->second.first, entry->second.second);
+  }
+
+  // Returns the JSFunction named {name} that calls the {wasm_code} of the
+  // function {index} through a copy of the JS->WASM {wrapper} of
+  // {wrapped_code}, which has the same signature.
+  static Handle<JSFunction> CopyJSToWasmWrapper(
+      Isolate* isolate, ModuleEnv* module_env, Handle<String> name,
+      Handle<Code> wasm_code, uint32_t index, Handle<Code> wrapped_code,
+      Handle<Code> wrapper) {
+    Handle<Code> code = isolate->factory()->CopyCode(wrapper);
+    {
+      DisallowHeapAllocation no_allocation;
+      InstanceRelocator relocator;
+      relocator.AddCode(*wrapped_code, *wasm_code);
+      relocator.Relocate(isolate, *code);
+    }
+    compiler::RecordWasmCodeCreation(isolate, module_env->module, index,
+                                     "JS->WASM function wrapper", code);
+    return compiler::NewJSToWasmFunction(isolate, module_env, name, wasm_code,
+                                         code, index);
+  }
+
+ private:
+  Isolate* isolate_;
+  ModuleEnv* module_env_;
+  // The first wrapper compiled for each signature, and the function it wraps.
+  std::map<std::pair<uint16_t, bool>,
+           std::pair<Handle<JSFunction>, Handle<Code>>>
+      wasm_to_js_;
+  std::map<uint16_t, std::pair<Handle<Code>, Handle<Code>>> js_to_wasm_;
+
+  uint16_t CanonicalSigIndex(uint32_t index) {
+    WasmModule* module = module_env_->module;
+    return module->CanonicalSigIndex(module->functions->at(index).sig_index);
+  }
+};
+
+// The maximum number of functions whose graphs are alive at the same time
+// during parallel compilation.
+const size_t kCompilationBatchSize = 256;
+
+// A queue of compilation units shared between the main thread and the
+// background compilation tasks.
+class CompilationQueue {
+ public:
+  explicit CompilationQueue(std::vector<compiler::WasmCompilationUnit*>* units)
+      : units_(units), next_(0) {}
+
+  // Builds the graph for the next unit in the queue. Returns {false} if
+  // there is no work left.
+  bool ExecuteNext() {
+    compiler::WasmCompilationUnit* unit;
+    {
+      base::LockGuard<base::Mutex> guard(&mutex_);
+      if (next_ >= units_->size()) return false;
+      unit = units_->at(next_++);
+    }
+    unit->ExecuteCompilation();
+    return true;
+  }
+
+ private:
+  base::Mutex mutex_;
+  std::vector<compiler::WasmCompilationUnit*>* units_;
+  size_t next_;
+};
+
+class CompilationTask : public v8::Task {
+ public:
+  CompilationTask(CompilationQueue* queue, base::Semaphore* done)
+      : queue_(queue), done_(done) {}
+
+  void Run() override {
+    {
+      DisallowHeapAllocation no_allocation;
+      while (queue_->ExecuteNext()) {
+      }
+    }
+    done_->Signal();
+  }
+
+ private:
+  CompilationQueue* queue_;
+  base::Semaphore* done_;
+};
+
+// Compiles the non-external functions of a module using the platform's
+// background threads. Graphs are built in parallel in batches; code
+// generation stays on the main thread and happens in function index order.
+// Functions that fail to decode are left null in {results}, so that the
+// caller can compile them again and report the error in order. Functions
+// that already have code in {results}, such as lazy stubs, are skipped.
+void CompileInParallel(Isolate* isolate, ModuleEnv* module_env,
+                       std::vector<Handle<Code>>* results,
+                       ErrorThrower& thrower,
+                       WasmCompilationStats* stats = nullptr) {
+  v8::Platform* platform = V8::GetCurrentPlatform();
+  size_t num_tasks = platform->NumberOfAvailableBackgroundThreads();
+  ZoneVector<WasmFunction>* functions = module_env->module->functions;
+  if (num_tasks == 0 || functions->size() < 2) return;
+
+  // Allocate all placeholder code objects up front, since graph building
+  // refers to them for direct calls and must not allocate itself.
+  for (uint32_t i = 0; i < functions->size(); i++) {
+    module_env->GetFunctionCode(i);
+  }
+
+  std::vector<compiler::WasmCompilationUnit*> units;
+  uint32_t index = 0;
+  while (index < functions->size()) {
+    // Create the next batch of compilation units on the main thread.
+    units.clear();
+    for (; index < functions->size() && units.size() < kCompilationBatchSize;
+         index++) {
+      const WasmFunction* func = &functions->at(index);
+      if (func->external || !results->at(index).is_null()) continue;
+      units.push_back(new compiler::WasmCompilationUnit(isolate, module_env,
+                                                        func, index, stats));
+    }
+
+    // Build the graphs on the background threads, with the main thread
+    // helping out. Nothing may allocate on the heap until all tasks are done.
+    CompilationQueue queue(&units);
+    base::Semaphore done(0);
+    size_t task_count = std::min(num_tasks, units.size());
+    for (size_t i = 0; i < task_count; i++) {
+      platform->CallOnBackgroundThread(new CompilationTask(&queue, &done),
+                                       v8::Platform::kShortRunningTask);
+    }
+    {
+      DisallowHeapAllocation no_allocation;
+      while (queue.ExecuteNext()) {
+      }
+    }
+    for (size_t i = 0; i < task_count; i++) done.Wait();
+
+    // Generate code for the batch on the main thread.
+    for (compiler::WasmCompilationUnit* unit : units) {
+      if (unit->ok()) {
+        results->at(unit->index()) = unit->FinishCompilation(thrower);
+      }
+      delete unit;
+    }
+  }
+}
+
+// Layout of the object that holds the state of a lazily compiled instance.
+const int kLazyStateForeign = 0;   // the {LazyCompilationState}.
+const int kLazyStateInstance = 1;  // the module object.
+const int kLazyStateStubs = 2;     // the stub code, by function index.
+const int kLazyStateRecords = 3;   // the stub data objects, by function index.
+const int kLazyStateWrappers = 4;  // JSFunctions calling compiled functions.
+// The first JS->WASM wrapper code and the code it wraps, by signature.
+const int kLazyStateSignatureWrappers = 5;
+const int kLazyStateFieldCount = 6;
+
+// Layout of the data object of the native function behind a lazy stub.
+const int kLazyFunctionState = 0;     // the object holding the state.
+const int kLazyFunctionIndex = 1;     // the function index as a Smi.
+const int kLazyFunctionCompiled = 2;  // JSFunction calling the compiled code.
+const int kLazyFunctionFieldCount = 3;
+
+// The number of calls plus loop iterations after which an interpreted
+// function of a tiered instance is recompiled with TurboFan.
+const uint32_t kTierUpThreshold = 1000;
+
+// A recompilation of a hot function with TurboFan. The graph is built on a
+// background thread, with the handles it refers to deferred so that they
+// stay valid until the code is generated on the main thread.
+struct TierUpJob {
+  ModuleEnv module_env;
+  std::vector<Handle<Code>> function_code;
+  DeferredHandles* handles;
+  compiler::WasmCompilationUnit* unit;
+  base::Semaphore finished;
+  bool graph_built;
+
+  TierUpJob()
+      : handles(nullptr), unit(nullptr), finished(0), graph_built(false) {}
+  ~TierUpJob() {
+    WaitForGraph();
+    delete unit;
+    delete handles;
+  }
+
+  bool IsGraphBuilt() {
+    if (!graph_built && finished.WaitFor(base::TimeDelta::FromSeconds(0))) {
+      graph_built = true;
+    }
+    return graph_built;
+  }
+
+  void WaitForGraph() {
+    if (!graph_built) finished.Wait();
+    graph_built = true;
+  }
+};
+
+struct LazyCompilationState;
+
+// Installs the finished recompilations of a tiered instance on the main
+// thread, so that a job does not wait for the next call of its function. The
+// deferred handles of a job keep the instance alive until it is installed,
+// but a call may install the job and the instance may die before the task
+// runs, in which case the state cancels the task.
+class TierUpInstallTask : public v8::Task {
+ public:
+  TierUpInstallTask(Isolate* isolate, LazyCompilationState* state);
+  ~TierUpInstallTask();
+
+  void Run() override;
+  // Called by the state when it dies, with its mutex held.
+  void Cancel() { state_ = nullptr; }
+
+ private:
+  Isolate* isolate_;
+  LazyCompilationState* state_;
+};
+
+// Builds the graph of a {TierUpJob} and then posts a {TierUpInstallTask} to
+// the main thread.
+class TierUpTask : public v8::Task {
+ public:
+  TierUpTask(Isolate* isolate, LazyCompilationState* state, TierUpJob* job)
+      : isolate_(isolate), state_(state), job_(job) {}
+
+  void Run() override {
+    job_->unit->ExecuteCompilation();
+    // The pending job keeps the state alive until it is signaled, and may be
+    // installed and deleted right after.
+    TierUpInstallTask* install = new TierUpInstallTask(isolate_, state_);
+    job_->finished.Signal();
+    V8::GetCurrentPlatform()->CallOnForegroundThread(
+        reinterpret_cast<v8::Isolate*>(isolate_), install);
+  }
+
+ private:
+  Isolate* isolate_;
+  LazyCompilationState* state_;
+  TierUpJob* job_;
+};
+
+// A private copy of the module that a lazily compiled instance compiles its
+// functions from, since the module it was instantiated from may be gone by
+// the time a function is first called. Deleted once the object holding it,
+// which all stubs of the instance refer to, dies. A pending {TierUpJob}
+// refers to the stubs as well and is installed once its graph is built, so
+// the state only dies with jobs pending when the isolate is torn down.
+struct LazyCompilationState {
+  Zone zone;
+  WasmModule* module;  // owns a reference to the module bytes.
+  Object** location;  // weak global handle to the object holding the state.
+  // Per function, the functions calling it directly, the functions it calls
+  // directly and the function table entries referring to it, so that code is
+  // installed by patching only the code and entries that refer to its stub.
+  std::vector<std::vector<uint32_t>> callers;
+  std::vector<std::vector<uint32_t>> callees;
+  std::vector<std::vector<uint32_t>> table_slots;
+  // For tiered instances, per function.
+  std::vector<uint32_t> hotness;  // calls plus loop iterations interpreted.
+  std::vector<bool> verified;     // whether the body has been verified.
+  std::vector<TierUpJob*> jobs;   // the pending recompilation, if any.
+  base::Mutex mutex;
+  std::set<TierUpInstallTask*> install_tasks;  // guarded by {mutex}.
+
+  LazyCompilationState() : module(nullptr), location(nullptr) {}
+  ~LazyCompilationState() {
+    {
+      base::LockGuard<base::Mutex> guard(&mutex);
+      for (TierUpInstallTask* task : install_tasks) task->Cancel();
+    }
+    for (TierUpJob* job : jobs) delete job;
+    delete module;
+  }
+
+  static void WeakCallback(const v8::WeakCallbackInfo<void>& data) {
+    LazyCompilationState* state =
+        reinterpret_cast<LazyCompilationState*>(data.GetParameter());
+    GlobalHandles::Destroy(state->location);
+    delete state;
+  }
+};
+
+LazyCompilationState* GetLazyCompilationState(JSObject* holder) {
+  return reinterpret_cast<LazyCompilationState*>(
+      Foreign::cast(holder->GetInternalField(kLazyStateForeign))
+          ->foreign_address());
+}
+
+void InstallTieredCode(Isolate* isolate, Handle<JSObject> holder, bool wait);
+
+TierUpInstallTask::TierUpInstallTask(Isolate* isolate,
+                                     LazyCompilationState* state)
+    : isolate_(isolate), state_(state) {
+  base::LockGuard<base::Mutex> guard(&state->mutex);
+  state->install_tasks.insert(this);
+}
+
+TierUpInstallTask::~TierUpInstallTask() {
+  if (state_ == nullptr) return;
+  base::LockGuard<base::Mutex> guard(&state_->mutex);
+  state_->install_tasks.erase(this);
+}
+
+void TierUpInstallTask::Run() {
+  if (state_ == nullptr) return;
+  HandleScope scope(isolate_);
+  InstallTieredCode(isolate_,
+                    handle(JSObject::cast(*state_->location), isolate_), false);
+}
+
+// Lazy stubs pass arguments and results as JavaScript numbers, which cannot
+// represent i64 values. Functions that take or return i64 values, as well as
+// exported functions, are always compiled eagerly.
+bool CanCompileLazily(const WasmFunction& func) {
+  if (func.external || func.exported) return false;
+  for (size_t i = 0; i < func.sig->parameter_count(); i++) {
+    if (func.sig->GetParam(i) == kAstI64) return false;
+  }
+  for (size_t i = 0; i < func.sig->return_count(); i++) {
+    if (func.sig->GetReturn(i) == kAstI64) return false;
+  }
+  return true;
+}
+
+// Adds the functions that the body between {pc} and {end} calls directly to
+// {callees}. A body that fails verification is never compiled, so it does
+// not matter that its callees may be wrong, but they are read within bounds.
+void CollectDirectCallees(const byte* pc, const byte* end,
+                          size_t function_count,
+                          std::vector<uint32_t>* callees) {
+  // {OpcodeLength} reads up to 5 bytes past the opcode, so the last bytes
+  // of the body are scanned one at a time.
+  const ptrdiff_t kMaxImmediateLength = 5;
+  while (pc < end) {
+    if (*pc == kExprCallFunction) {
+      int length;
+      uint32_t callee;
+      if (ReadUnsignedLEB128Operand(pc + 1, end, &length, &callee) ==
+              kNoError &&
+          callee < function_count) {
+        callees->push_back(callee);
+      }
+    }
+    pc += end - pc > kMaxImmediateLength ? OpcodeLength(pc) : 1;
+  }
+  std::sort(callees->begin(), callees->end());
+  callees->erase(std::unique(callees->begin(), callees->end()),
+                 callees->end());
+}
+
+// Creates the object holding the state for lazily compiling the functions
+// of {module}, an instantiation of {wasm_module}.
+MaybeHandle<JSObject> NewLazyCompilationState(Isolate* isolate,
+                                              WasmModule* wasm_module,
+                                              Handle<JSObject> module,
+                                              ErrorThrower& thrower) {
+  LazyCompilationState* state = new LazyCompilationState();
+  // The state outlives the bytes of {wasm_module} unless they are shared.
+  ModuleBytes* bytes = wasm_module->bytes;
+  if (bytes != nullptr) {
+    bytes->AddRef();
+  } else {
+    bytes = ModuleBytes::Get(wasm_module->module_start,
+                             wasm_module->module_end);
+  }
+  ModuleResult result = DecodeWasmModule(isolate, &state->zone, bytes->start(),
+                                         bytes->end(), false, false);
+  if (result.failed()) {
+    thrower.Failed("", result);
+    if (result.val) delete result.val;
+    bytes->Release();
+    delete state;
+    return MaybeHandle<JSObject>();
+  }
+  state->module = result.val;
+  state->module->bytes = bytes;
+  AllocateGlobalsOffsets(state->module->globals);
+  size_t size = state->module->functions->size();
+  state->hotness.resize(size, 0);
+  state->verified.resize(size, false);
+  state->jobs.resize(size, nullptr);
+  state->callers.resize(size);
+  state->callees.resize(size);
+  state->table_slots.resize(size);
+  const byte* start = state->module->module_start;
+  for (uint32_t i = 0; i < size; i++) {
+    const WasmFunction& func = state->module->functions->at(i);
+    if (func.external) continue;
+    CollectDirectCallees(start + func.code_start_offset,
+                         start + func.code_end_offset, size,
+                         &state->callees[i]);
+    for (uint32_t callee : state->callees[i]) {
+      state->callers[callee].push_back(i);
+    }
+  }
+  ZoneVector<uint16_t>* function_table = state->module->function_table;
+  for (uint32_t i = 0; i < function_table->size(); i++) {
+    if (function_table->at(i) < size) {
+      state->table_slots[function_table->at(i)].push_back(i);
+    }
+  }
+
+  Factory* factory = isolate->factory();
+  Handle<Map> map = factory->NewMap(
+      JS_OBJECT_TYPE,
+      JSObject::kHeaderSize + kLazyStateFieldCount * kPointerSize);
+  Handle<JSObject> holder = factory->NewJSObjectFromMap(map, TENURED);
+  holder->SetInternalField(
+      kLazyStateForeign,
+      *factory->NewForeign(reinterpret_cast<Address>(state), TENURED));
+  holder->SetInternalField(kLazyStateInstance, *module);
+  for (int field : {kLazyStateStubs, kLazyStateRecords, kLazyStateWrappers}) {
+    holder->SetInternalField(
+        field, *factory->NewFixedArray(static_cast<int>(size), TENURED));
+  }
+  holder->SetInternalField(
+      kLazyStateSignatureWrappers,
+      *factory->NewFixedArray(
+          2 * static_cast<int>(state->module->signatures->size()), TENURED));
+  state->location = isolate->global_handles()->Create(*holder).location();
+  GlobalHandles::MakeWeak(state->location, state,
+                          &LazyCompilationState::WeakCallback,
+                          v8::WeakCallbackType::kParameter);
+  return holder;
+}
+
+// Sets up {module_env} for compiling against the current code of {instance}
+// into {function_code}. Calls to functions that are still lazy go through
+// their stubs.
+void InitLazyModuleEnv(Isolate* isolate, WasmModule* wasm_module,
+                       Handle<JSObject> instance,
+                       std::vector<Handle<Code>>* function_code,
+                       ModuleEnv* module_env) {
+  FixedArray* code_table =
+      FixedArray::cast(instance->GetInternalField(kWasmModuleCodeTable));
+  for (int i = 0; i < code_table->length(); i++) {
+    function_code->push_back(handle(Code::cast(code_table->get(i)), isolate));
+  }
+  module_env->module = wasm_module;
+  // The code loads the memory and globals from the instance data.
+  module_env->mem_start = 0;
+  module_env->mem_end = 0;
+  module_env->globals_area = 0;
+  module_env->linker = nullptr;
+  module_env->function_code = function_code;
+  Object* function_table = instance->GetInternalField(kWasmModuleFunctionTable);
+  if (function_table->IsFixedArray()) {
+    module_env->function_table =
+        handle(FixedArray::cast(function_table), isolate);
+  }
+  module_env->context = isolate->native_context();
+  module_env->instance_data = handle(
+      ByteArray::cast(instance->GetInternalField(kWasmInstanceData)), isolate);
+  Object* bounds_checks = instance->GetInternalField(kWasmBoundsCheckMode);
+  module_env->asm_js = bounds_checks == Smi::FromInt(kAsmJsBoundsChecks);
+  module_env->guard_region =
+      bounds_checks == Smi::FromInt(kGuardRegionBoundsChecks);
+}
+
+// Returns a JSFunction that calls the {code} of the function {index} of the
+// lazily compiled instance whose state is held by {holder}. The first wrapper
+// for each signature is compiled and kept in the state, and the others are
+// copies of it.
+Handle<JSFunction> GetLazyJSToWasmWrapper(Isolate* isolate,
+                                          Handle<JSObject> holder,
+                                          Handle<Code> code, uint32_t index) {
+  WasmModule* wasm_module = GetLazyCompilationState(*holder)->module;
+  Handle<JSObject> instance(
+      JSObject::cast(holder->GetInternalField(kLazyStateInstance)), isolate);
+  std::vector<Handle<Code>> function_code;
+  ModuleEnv module_env;
+  InitLazyModuleEnv(isolate, wasm_module, instance, &function_code,
+                    &module_env);
+  const WasmFunction& func = wasm_module->functions->at(index);
+  Handle<String> name = isolate->factory()->InternalizeUtf8String(
+      wasm_module->GetName(func.name_offset));
+  Handle<FixedArray> wrappers(
+      FixedArray::cast(holder->GetInternalField(kLazyStateSignatureWrappers)),
+      isolate);
+  int key = 2 * wasm_module->CanonicalSigIndex(func.sig_index);
+  if (!wrappers->get(key)->IsCode()) {
+    Handle<JSFunction> function = compiler::CompileJSToWasmWrapper(
+        isolate, &module_env, name, code, index);
+    wrappers->set(key, *code);
+    wrappers->set(key + 1, function->code());
+    return function;
+  }
+  return WrapperCache::CopyJSToWasmWrapper(
+      isolate, &module_env, name, code, index,
+      handle(Code::cast(wrappers->get(key)), isolate),
+      handle(Code::cast(wrappers->get(key + 1)), isolate));
+}
+
+// Installs {code} as the code of the function that the stub with the data
+// object {record} stands for, redirects the calls to the stub within the
+// instance to it and returns a JSFunction that calls it.
+Handle<JSFunction> InstallLazyCode(Isolate* isolate, Handle<JSObject> record,
+                                   Handle<Code> code) {
+  Handle<JSObject> holder(
+      JSObject::cast(record->GetInternalField(kLazyFunctionState)), isolate);
+  LazyCompilationState* state = GetLazyCompilationState(*holder);
+  Handle<JSObject> instance(
+      JSObject::cast(holder->GetInternalField(kLazyStateInstance)), isolate);
+  int index = Smi::cast(record->GetInternalField(kLazyFunctionIndex))->value();
+
+  //-------------------------------------------------------------------------
+  // Patch the code table, the direct calls and the function table.
+  //-------------------------------------------------------------------------
+  {
+    DisallowHeapAllocation no_allocation;
+    FixedArray* code_table =
+        FixedArray::cast(instance->GetInternalField(kWasmModuleCodeTable));
+    FixedArray* stubs =
+        FixedArray::cast(holder->GetInternalField(kLazyStateStubs));
+    Code* stub = Code::cast(stubs->get(index));
+    code_table->set(index, *code);
+    // Code recompiled in the background may still call the stubs of
+    // functions that were compiled in the meantime.
+    InstanceRelocator callees;
+    for (uint32_t callee : state->callees[index]) {
+      int i = static_cast<int>(callee);
+      if (stubs->get(i)->IsCode() && stubs->get(i) != code_table->get(i)) {
+        callees.AddCode(Code::cast(stubs->get(i)),
+                        Code::cast(code_table->get(i)));
+      }
+    }
+    callees.Relocate(isolate, *code);
+    // Only the compiled code of the callers can call the stub.
+    InstanceRelocator callers;
+    callers.AddCode(stub, *code);
+    for (uint32_t caller : state->callers[index]) {
+      int i = static_cast<int>(caller);
+      if (stubs->get(i) != code_table->get(i)) {
+        callers.Relocate(isolate, Code::cast(code_table->get(i)));
+      }
+    }
+    Object* function_table =
+        instance->GetInternalField(kWasmModuleFunctionTable);
+    if (function_table->IsFixedArray()) {
+      FixedArray* table = FixedArray::cast(function_table);
+      for (uint32_t slot : state->table_slots[index]) {
+        table->set(FunctionTableCodeIndex(static_cast<int>(slot)), *code);
+      }
+    }
+  }
+
+  Handle<JSFunction> function =
+      GetLazyJSToWasmWrapper(isolate, holder, code, index);
+  record->SetInternalField(kLazyFunctionCompiled, *function);
+  return function;
+}
+
+// Compiles the function that the stub with the data object {record} stands
+// for and installs its code. Returns an empty handle and schedules an
+// exception if compilation fails.
+MaybeHandle<JSFunction> CompileLazyFunction(Isolate* isolate,
+                                            Handle<JSObject> record) {
+  Object* compiled = record->GetInternalField(kLazyFunctionCompiled);
+  if (compiled->IsJSFunction()) {
+    // Calls that were in flight while the function was compiled still end
+    // up here.
+    return handle(JSFunction::cast(compiled), isolate);
+  }
+  JSObject* holder =
+      JSObject::cast(record->GetInternalField(kLazyFunctionState));
+  WasmModule* wasm_module = GetLazyCompilationState(holder)->module;
+  Handle<JSObject> instance(
+      JSObject::cast(holder->GetInternalField(kLazyStateInstance)), isolate);
+  int index = Smi::cast(record->GetInternalField(kLazyFunctionIndex))->value();
+
+  std::vector<Handle<Code>> function_code;
+  ModuleEnv module_env;
+  InitLazyModuleEnv(isolate, wasm_module, instance, &function_code,
+                    &module_env);
+  ErrorThrower thrower(isolate, "WasmModule::CompileLazy()");
+  Handle<Code> code = compiler::CompileWasmFunction(
+      thrower, isolate, &module_env, wasm_module->functions->at(index), index);
+  if (code.is_null()) return MaybeHandle<JSFunction>();
+  return InstallLazyCode(isolate, record, code);
+}
+
+// Calls {function} with the arguments passed to a stub and returns its result
+// from the stub.
+void CallFromStub(const v8::FunctionCallbackInfo<v8::Value>& args,
+                  Handle<JSFunction> function) {
+  v8::Isolate* v8_isolate = args.GetIsolate();
+  std::vector<v8::Local<v8::Value>> argv;
+  for (int i = 0; i < args.Length(); i++) argv.push_back(args[i]);
+  v8::Local<v8::Value> result;
+  if (Utils::ToLocal(function)
+          ->Call(v8_isolate->GetCurrentContext(), v8::Undefined(v8_isolate),
+                 args.Length(), argv.data())
+          .ToLocal(&result)) {
+    args.GetReturnValue().Set(result);
+  }
+}
+
+// The native function behind a lazy stub. Compiles the function on its
+// first call and calls it with the arguments passed to the stub.
+void CompileLazy(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  Isolate* isolate = reinterpret_cast<Isolate*>(args.GetIsolate());
+  HandleScope scope(isolate);
+  Handle<JSObject> record =
+      Handle<JSObject>::cast(Utils::OpenHandle(*args.Data()));
+  Handle<JSFunction> function;
+  if (!CompileLazyFunction(isolate, record).ToHandle(&function)) return;
+  CallFromStub(args, function);
+}
+
+// Starts recompiling the function {index} of the tiered instance whose
+// state is held by {holder}.
+void StartTierUp(Isolate* isolate, Handle<JSObject> holder, uint32_t index) {
+  LazyCompilationState* state = GetLazyCompilationState(*holder);
+  Handle<JSObject> instance(
+      JSObject::cast(holder->GetInternalField(kLazyStateInstance)), isolate);
+  TierUpJob* job = new TierUpJob();
+  {
+    DeferredHandleScope deferred(isolate);
+    InitLazyModuleEnv(isolate, state->module, instance, &job->function_code,
+                      &job->module_env);
+    job->unit = new compiler::WasmCompilationUnit(
+        isolate, &job->module_env, &state->module->functions->at(index),
+        index);
+    job->handles = deferred.Detach();
+  }
+  state->jobs[index] = job;
+  v8::Platform* platform = V8::GetCurrentPlatform();
+  if (platform->NumberOfAvailableBackgroundThreads() > 0) {
+    platform->CallOnBackgroundThread(new TierUpTask(isolate, state, job),
+                                     v8::Platform::kShortRunningTask);
+  } else {
+    DisallowHeapAllocation no_allocation;
+    TierUpTask(isolate, state, job).Run();
+  }
+}
+
+// Installs the code of the finished recompilations of the tiered instance
+// whose state is held by {holder}. If {wait} is true, waits for the pending
+// recompilations as well.
+void InstallTieredCode(Isolate* isolate, Handle<JSObject> holder, bool wait) {
+  LazyCompilationState* state = GetLazyCompilationState(*holder);
+  for (size_t i = 0; i < state->jobs.size(); i++) {
+    TierUpJob* job = state->jobs[i];
+    if (job == nullptr) continue;
+    if (wait) {
+      job->WaitForGraph();
+    } else if (!job->IsGraphBuilt()) {
+      continue;
+    }
+    state->jobs[i] = nullptr;
+    // The body has been verified before it was interpreted, so this cannot
+    // fail with a decoding error.
+    ErrorThrower thrower(isolate, "WasmModule::TierUp()");
+    Handle<Code> code = job->unit->FinishCompilation(thrower);
+    delete job;
+    DCHECK(!code.is_null());
+    FixedArray* records =
+        FixedArray::cast(holder->GetInternalField(kLazyStateRecords));
+    InstallLazyCode(isolate,
+                    handle(JSObject::cast(records->get(static_cast<int>(i))),
+                           isolate),
+                    code);
+  }
+}
+
+Handle<Object> WasmValToNumber(Isolate* isolate, WasmVal val) {
+  Factory* factory = isolate->factory();
+  switch (val.type) {
+    case kAstI32:
+      return factory->NewNumberFromInt(val.val.i32);
+    case kAstF32:
+      return factory->NewNumber(val.val.f32);
+    case kAstF64:
+      return factory->NewNumber(val.val.f64);
+    default:
+      return factory->undefined_value();
+  }
+}
+
+WasmVal NumberToWasmVal(Object* value, LocalType type) {
+  double number = value->IsNumber() ? value->Number()
+                                    : std::numeric_limits<double>::quiet_NaN();
+  switch (type) {
+    case kAstI32:
+      return WasmVal(DoubleToInt32(number));
+    case kAstF32:
+      return WasmVal(DoubleToFloat32(number));
+    case kAstF64:
+      return WasmVal(number);
+    default:
+      UNREACHABLE();
+      return WasmVal();
+  }
+}
+
+// Runs the functions of a tiered instance that have not been recompiled yet
+// in the interpreter, and calls all other functions through JSFunctions.
+class TieredHost : public WasmInterpreter::Host {
+ public:
+  TieredHost(Isolate* isolate, Handle<JSObject> holder)
+      : isolate_(isolate),
+        holder_(holder),
+        state_(GetLazyCompilationState(*holder)),
+        interpreter_(nullptr),
+        callee_back_edges_(0) {
+    Handle<JSObject> instance(
+        JSObject::cast(holder->GetInternalField(kLazyStateInstance)),
+        isolate);
+    Address data =
+        ByteArray::cast(instance->GetInternalField(kWasmInstanceData))
+            ->GetDataStartAddress();
+    interpreter_.Reset(new WasmInterpreter(
+        isolate, state_->module, this,
+        reinterpret_cast<byte*>(
+            Memory::uintptr_at(data + ModuleEnv::kInstanceMemStartOffset)),
+        Memory::uint32_at(data + ModuleEnv::kInstanceMemSizeOffset),
+        reinterpret_cast<byte*>(
+            Memory::uintptr_at(data + ModuleEnv::kInstanceGlobalsAreaOffset))));
+  }
+
+  // Interprets the function {index} and starts its recompilation once it is
+  // hot. Returns {false} and schedules an exception if the function traps or
+  // throws.
+  bool Interpret(uint32_t index, WasmVal* args, WasmVal* result) {
+    if (!Verify(index)) return false;
+    uint32_t back_edges = interpreter_->back_edges();
+    uint32_t callee_back_edges = callee_back_edges_;
+    WasmInterpreter::Outcome outcome =
+        interpreter_->Execute(index, args, result);
+    // Loop iterations of the functions it called count for them only.
+    uint32_t all_back_edges = interpreter_->back_edges() - back_edges;
+    uint32_t own_back_edges =
+        all_back_edges - (callee_back_edges_ - callee_back_edges);
+    callee_back_edges_ = callee_back_edges + all_back_edges;
+    uint32_t hotness = state_->hotness[index] + 1 + own_back_edges;
+    state_->hotness[index] = std::min(hotness, kTierUpThreshold);
+    if (hotness >= kTierUpThreshold && state_->jobs[index] == nullptr &&
+        outcome != WasmInterpreter::kStackOverflow) {
+      StartTierUp(isolate_, holder_, index);
+    }
+    Factory* factory = isolate_->factory();
+    switch (outcome) {
+      case WasmInterpreter::kReturned:
+        return true;
+      case WasmInterpreter::kTrapped:
+        isolate_->ScheduleThrow(*factory->InternalizeUtf8String(
+            WasmOpcodes::TrapReasonMessage(interpreter_->trap_reason())));
+        return false;
+      case WasmInterpreter::kThrew:
+        return false;  // the exception has been scheduled already.
+      case WasmInterpreter::kStackOverflow:
+        isolate_->ScheduleThrow(
+            *factory->NewRangeError(MessageTemplate::kStackOverflow));
+        return false;
+    }
+    UNREACHABLE();
+    return false;
+  }
+
+  bool CallFunction(uint32_t index, WasmVal* args, WasmVal* result) override {
+    HandleScope scope(isolate_);
+    Handle<JSFunction> function;
+    if (!GetCompiledFunction(index).ToHandle(&function)) {
+      return Interpret(index, args, result);
+    }
+    FunctionSig* sig = state_->module->functions->at(index).sig;
+    std::vector<v8::Local<v8::Value>> argv;
+    for (size_t i = 0; i < sig->parameter_count(); i++) {
+      argv.push_back(Utils::ToLocal(WasmValToNumber(isolate_, args[i])));
+    }
+    v8::Isolate* v8_isolate = reinterpret_cast<v8::Isolate*>(isolate_);
+    v8::Local<v8::Value> value;
+    if (!Utils::ToLocal(function)
+             ->Call(v8_isolate->GetCurrentContext(), v8::Undefined(v8_isolate),
+                    static_cast<int>(argv.size()), argv.data())
+             .ToLocal(&value)) {
+      return false;
+    }
+    if (sig->return_count() > 0) {
+      *result = NumberToWasmVal(*Utils::OpenHandle(*value), sig->GetReturn());
+    }
+    return true;
+  }
+
+  int32_t GrowMemory(uint32_t delta) override {
+    return wasm::GrowMemory(InstanceData(), delta);
+  }
+
+  uint32_t MemorySize() override {
+    return Memory::uint32_at(InstanceData()->GetDataStartAddress() +
+                             ModuleEnv::kInstanceMemSizeOffset);
+  }
+
+ private:
+  Isolate* isolate_;
+  Handle<JSObject> holder_;
+  LazyCompilationState* state_;
+  base::SmartPointer<WasmInterpreter> interpreter_;
+  // The loop iterations interpreted in calls made by the functions that are
+  // being interpreted.
+  uint32_t callee_back_edges_;
+
+  ByteArray* InstanceData() {
+    JSObject* instance =
+        JSObject::cast(holder_->GetInternalField(kLazyStateInstance));
+    return ByteArray::cast(instance->GetInternalField(kWasmInstanceData));
+  }
+
+  // Verifies the body of the function {index} before it is first
+  // interpreted, and reports errors the way compilation would.
+  bool Verify(uint32_t index) {
+    if (state_->verified[index]) return true;
+    WasmModule* module = state_->module;
+    const WasmFunction& func = module->functions->at(index);
+    ModuleEnv module_env;
+    module_env.module = module;
+    module_env.linker = nullptr;
+    module_env.function_code = nullptr;
+    module_env.asm_js = false;
+    FunctionEnv env;
+    env.module = &module_env;
+    env.sig = func.sig;
+    env.local_int32_count = func.local_int32_count;
+    env.local_int64_count = func.local_int64_count;
+    env.local_float32_count = func.local_float32_count;
+    env.local_float64_count = func.local_float64_count;
+    env.local_simd128_count = func.local_simd128_count;
+    env.SumLocals();
+    const byte* start = module->module_start;
+    TreeResult result =
+        VerifyWasmCode(&env, start, start + func.code_start_offset,
+                       start + func.code_end_offset);
+    if (result.failed()) {
+      ErrorThrower thrower(isolate_, "WasmModule::ExecuteTiered()");
+      char buffer[256];
+      snprintf(buffer, 256, "Compiling WASM function #%d:%s failed:", index,
+               module->GetName(func.name_offset));
+      thrower.Failed(buffer, result);
+      return false;
+    }
+    state_->verified[index] = true;
+    return true;
+  }
+
+  // Returns a JSFunction calling the compiled code of the function {index},
+  // or an empty handle if the function is interpreted.
+  MaybeHandle<JSFunction> GetCompiledFunction(uint32_t index) {
+    int i = static_cast<int>(index);
+    Object* record =
+        FixedArray::cast(holder_->GetInternalField(kLazyStateRecords))->get(i);
+    if (record->IsJSObject()) {
+      Object* compiled =
+          JSObject::cast(record)->GetInternalField(kLazyFunctionCompiled);
+      if (!compiled->IsJSFunction()) return MaybeHandle<JSFunction>();
+      return handle(JSFunction::cast(compiled), isolate_);
+    }
+    Handle<FixedArray> wrappers(
+        FixedArray::cast(holder_->GetInternalField(kLazyStateWrappers)),
+        isolate_);
+    if (wrappers->get(i)->IsJSFunction()) {
+      return handle(JSFunction::cast(wrappers->get(i)), isolate_);
+    }
+    JSObject* instance =
+        JSObject::cast(holder_->GetInternalField(kLazyStateInstance));
+    Handle<Code> code(
+        Code::cast(FixedArray::cast(
+                       instance->GetInternalField(kWasmModuleCodeTable))
+                       ->get(i)),
+        isolate_);
+    Handle<JSFunction> function =
+        GetLazyJSToWasmWrapper(isolate_, holder_, code, index);
+    wrappers->set(i, *function);
+    return function;
+  }
+};
+
+// The native function behind a stub of a tiered instance. Interprets the
+// function until it has been recompiled, and calls the compiled code after.
+void ExecuteTiered(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  Isolate* isolate = reinterpret_cast<Isolate*>(args.GetIsolate());
+  HandleScope scope(isolate);
+  Handle<JSObject> record =
+      Handle<JSObject>::cast(Utils::OpenHandle(*args.Data()));
+  Handle<JSObject> holder(
+      JSObject::cast(record->GetInternalField(kLazyFunctionState)), isolate);
+  InstallTieredCode(isolate, holder, false);
+  Object* compiled = record->GetInternalField(kLazyFunctionCompiled);
+  if (compiled->IsJSFunction()) {
+    CallFromStub(args, handle(JSFunction::cast(compiled), isolate));
+    return;
+  }
+
+  uint32_t index = static_cast<uint32_t>(
+      Smi::cast(record->GetInternalField(kLazyFunctionIndex))->value());
+  FunctionSig* sig =
+      GetLazyCompilationState(*holder)->module->functions->at(index).sig;
+  std::vector<WasmVal> argv;
+  for (size_t i = 0; i < sig->parameter_count(); i++) {
+    argv.push_back(NumberToWasmVal(
+        *Utils::OpenHandle(*args[static_cast<int>(i)]), sig->GetParam(i)));
+  }
+  TieredHost host(isolate, holder);
+  WasmVal result;
+  if (!host.Interpret(index, argv.data(), &result)) return;
+  if (sig->return_count() > 0) {
+    args.GetReturnValue().Set(
+        Utils::ToLocal(WasmValToNumber(isolate, result)));
+  }
+}
+
+// Creates stubs for the functions that can be compiled lazily and stores
+// them in {results}. A stub is a WASM->JS wrapper calling a native function
+// that compiles the function upon its first call or, if {mode} is
+// {kTieredCompilation}, interprets it until it is hot. The wrappers come from
+// {wrappers}, so that they are compiled once per signature.
+void CreateLazyStubs(Isolate* isolate, ModuleEnv* module_env,
+                     WrapperCache* wrappers, Handle<JSObject> holder,
+                     CompilationMode mode,
+                     std::vector<Handle<Code>>* results) {
+  Factory* factory = isolate->factory();
+  v8::Local<v8::Context> context = Utils::ToLocal(isolate->native_context());
+  Handle<Map> map = factory->NewMap(
+      JS_OBJECT_TYPE,
+      JSObject::kHeaderSize + kLazyFunctionFieldCount * kPointerSize);
+  Handle<FixedArray> stubs(
+      FixedArray::cast(holder->GetInternalField(kLazyStateStubs)), isolate);
+  Handle<FixedArray> records(
+      FixedArray::cast(holder->GetInternalField(kLazyStateRecords)), isolate);
+  WasmModule* lazy_module = GetLazyCompilationState(*holder)->module;
+  v8::FunctionCallback callback =
+      mode == kTieredCompilation ? ExecuteTiered : CompileLazy;
+  ZoneVector<WasmFunction>* functions = module_env->module->functions;
+  for (uint32_t index = 0; index < functions->size(); index++) {
+    const WasmFunction& func = functions->at(index);
+    if (!CanCompileLazily(func)) continue;
+    if (mode == kTieredCompilation &&
+        !WasmInterpreter::CanInterpret(lazy_module,
+                                       lazy_module->functions->at(index))) {
+      continue;
+    }
+
+    Handle<JSObject> record = factory->NewJSObjectFromMap(map, TENURED);
+    record->SetInternalField(kLazyFunctionState, *holder);
+    record->SetInternalField(kLazyFunctionIndex, Smi::FromInt(index));
+    record->SetInternalField(kLazyFunctionCompiled, Smi::FromInt(0));
+    v8::Local<v8::Function> target =
+        v8::Function::New(context, callback, Utils::ToLocal(record))
+            .ToLocalChecked();
+    Handle<JSFunction> function =
+        Handle<JSFunction>::cast(Utils::OpenHandle(*target));
+
+    Handle<Code> stub = wrappers->GetWasmToJSWrapper(function, index);
+    results->at(index) = stub;
+    stubs->set(static_cast<int>(index), *stub);
+    records->set(static_cast<int>(index), *record);
+  }
+}
+
+}  // namespace
+
+// The client of the decoder of a {WasmStreamingCompilation}. Functions are
+// compiled against a provisional instance data object, and their direct calls
+// go to placeholders, one per function, which {TakeCode} redirects to the
+// instance and to the placeholders of its linker. The compilation lives
+// across calls from JavaScript, so it only holds global handles.
+class WasmStreamingCompilation::Compiler : public StreamingDecoder::Client {
+ public:
+  explicit Compiler(Isolate* isolate) : isolate_(isolate), streamed_count_(0) {
+    HandleScope scope(isolate);
+    module_env_.globals_area = 0;
+    module_env_.mem_start = 0;
+    module_env_.mem_end = 0;
+    module_env_.module = nullptr;
+    module_env_.linker = nullptr;
+    module_env_.function_code = &placeholders_;
+    module_env_.context = NewGlobal(handle(isolate->native_context()));
+    module_env_.instance_data =
+        NewGlobal(NewInstanceData(isolate, nullptr, 0, nullptr));
+    module_env_.asm_js = false;
+  }
+
+  ~Compiler() {
+    DestroyGlobal(module_env_.context);
+    DestroyGlobal(module_env_.instance_data);
+    for (Handle<Code> code : placeholders_) DestroyGlobal(code);
+    for (Handle<Code> code : code_) DestroyGlobal(code);
+  }
+
+  void OnFunctionBody(WasmModule* module, uint32_t index) override {
+    HandleScope scope(isolate_);
+    DCHECK_EQ(index, placeholders_.size());
+    module_env_.module = module;
+    placeholders_.push_back(NewGlobal(NewPlaceholderCode()));
+    code_.push_back(Handle<Code>::null());
+    const WasmFunction* func = &module->functions->at(index);
+    if (func->external || MayCallIndirect(module, func)) return;
+    compiler::WasmCompilationUnit unit(isolate_, &module_env_, func, index);
+    unit.ExecuteCompilation();
+    // A function that fails to decode may only refer to parts of the module
+    // that have not arrived yet. It is compiled again upon instantiation,
+    // which reports the error if there is one.
+    if (!unit.ok()) return;
+    ErrorThrower thrower(isolate_, nullptr);
+    Handle<Code> code = unit.FinishCompilation(thrower);
+    if (code.is_null()) return;
+    code_[index] = NewGlobal(code);
+    streamed_count_++;
+  }
+
+  void OnSection(WasmModule* module, WasmSectionDeclCode section) override {
+    // Functions arriving after the globals access them at their final
+    // offsets, which instantiation computes again in the same way.
+    if (section == kDeclGlobals) AllocateGlobalsOffsets(module->globals);
+  }
+
+  // Redirects the code compiled so far to the instance set up in
+  // {module_env} and to the placeholders of {linker}, and stores it by
+  // function index in {precompiled}.
+  void TakeCode(ModuleEnv* module_env, WasmLinker* linker,
+                std::vector<Handle<Code>>* precompiled) {
+    std::vector<Handle<Code>> targets;
+    for (uint32_t i = 0; i < placeholders_.size(); i++) {
+      targets.push_back(linker->GetFunctionCode(i));
+    }
+    {
+      DisallowHeapAllocation no_allocation;
+      InstanceRelocator relocator;
+      relocator.AddObject(*module_env_.instance_data,
+                          *module_env->instance_data);
+      relocator.AddObject(*module_env_.context, *module_env->context);
+      for (size_t i = 0; i < placeholders_.size(); i++) {
+        relocator.AddCode(*placeholders_[i], *targets[i]);
+      }
+      for (Handle<Code> code : code_) {
+        if (!code.is_null()) relocator.Relocate(isolate_, *code);
+      }
+    }
+    for (size_t i = 0; i < code_.size(); i++) {
+      if (!code_[i].is_null()) precompiled->at(i) = handle(*code_[i]);
+    }
+  }
+
+  int streamed_count() const { return streamed_count_; }
+
+ private:
+  template <typename T>
+  Handle<T> NewGlobal(Handle<T> object) {
+    return Handle<T>::cast(isolate_->global_handles()->Create(*object));
+  }
+
+  template <typename T>
+  static void DestroyGlobal(Handle<T> global) {
+    if (global.is_null()) return;
+    GlobalHandles::Destroy(reinterpret_cast<Object**>(global.location()));
+  }
+
+  Handle<Code> NewPlaceholderCode() {
+    Handle<Code> self(nullptr, isolate_);
+    byte buffer[] = {0, 0, 0, 0, 0, 0, 0, 0};  // fake instructions.
+    CodeDesc desc = {buffer, 8, 8, 0, 0, nullptr};
+    return isolate_->factory()->NewCode(
+        desc, Code::KindField::encode(Code::WASM_FUNCTION), self);
+  }
+
+  // Returns true if the body of {func} may make indirect calls, which need
+  // the function table. Looks for the opcode in all the bytes of the body,
+  // so that immediates matching it only delay the compilation.
+  static bool MayCallIndirect(WasmModule* module, const WasmFunction* func) {
+    const byte* start = module->module_start + func->code_start_offset;
+    const byte* end = module->module_start + func->code_end_offset;
+    return std::find(start, end, kExprCallIndirect) != end;
+  }
+
+  Isolate* isolate_;
+  ModuleEnv module_env_;
+  std::vector<Handle<Code>> placeholders_;  // by function index.
+  std::vector<Handle<Code>> code_;  // the compiled code, by function index.
+  int streamed_count_;
+};
+
+// Instantiates a wasm module as a JSObject.
+//  * allocates a backing store of {mem_size} bytes, in a guard region if
+//    {bounds_checks} is {kGuardRegionBoundsChecks}
+//  * installs a named property "memory" for that buffer if exported
+//  * installs named properties on the object for exported functions
+//  * compiles wasm code to machine code, or creates stubs that compile it
+//    upon first call if {mode} is {kLazyCompilation}, or stubs that
+//    interpret it until it is hot if {mode} is {kTieredCompilation}
+//  * takes over the code that {streamed}, if given, compiled ahead of time
+MaybeHandle<JSObject> WasmModule::Instantiate(
+    Isolate* isolate, Handle<JSObject> ffi, Handle<JSArrayBuffer> memory,
+    CompilationMode mode, BoundsCheckMode bounds_checks,
+    WasmCompilationStats* stats, WasmStreamingCompilation* streamed) {
+  this->shared_isolate = isolate;  // TODO: have a real shared isolate.
+  ErrorThrower thrower(isolate, "WasmModule::Instantiate()");
+  Factory* factory = isolate->factory();
+
+  //-------------------------------------------------------------------------
+  // Allocate the module object, linear memory and globals.
   //-------------------------------------------------------------------------
-  int index = 0;
   WasmLinker linker(isolate, functions->size());
   ModuleEnv module_env;
-  module_env.module = this;
-  module_env.mem_start = reinterpret_cast<uintptr_t>(mem_addr);
-  module_env.mem_end = reinterpret_cast<uintptr_t>(mem_addr) + mem_size;
-  module_env.globals_area = reinterpret_cast<uintptr_t>(globals_addr);
+  Handle<JSObject> module;
+  if (!SetupInstance(isolate, this, memory, bounds_checks, thrower,
+                     &module_env, stats)
+           .ToHandle(&module)) {
+    return MaybeHandle<JSObject>();
+  }
   module_env.linker = &linker;
-  module_env.function_code = nullptr;
-  module_env.function_table = BuildFunctionTable(isolate, this);
-  module_env.memory = memory;
-  module_env.context = isolate->native_context();
-  module_env.asm_js = false;
+  Handle<FixedArray> code_table =
+      factory->NewFixedArray(static_cast<int>(functions->size()), TENURED);
+  Handle<FixedArray> wrapper_table =
+      factory->NewFixedArray(static_cast<int>(functions->size()), TENURED);
+
+  //-------------------------------------------------------------------------
+  // Compile all functions in the module.
+  //-------------------------------------------------------------------------
+  int index = 0;
+  base::ElapsedTimer timer;
+  if (stats) timer.Start();
+
+  // Functions with equal signatures share their wrappers.
+  WrapperCache wrappers(isolate, &module_env);
+
+  // Leave the functions that can be compiled lazily as stubs.
+  std::vector<Handle<Code>> precompiled(functions->size());
+  if (streamed != nullptr) {
+    DCHECK_EQ(kEagerCompilation, mode);
+    streamed->compiler_->TakeCode(&module_env, &linker, &precompiled);
+  }
+  if (mode != kEagerCompilation) {
+    Handle<JSObject> lazy_state;
+    if (!NewLazyCompilationState(isolate, this, module, thrower)
+             .ToHandle(&lazy_state)) {
+      return MaybeHandle<JSObject>();
+    }
+    CreateLazyStubs(isolate, &module_env, &wrappers, lazy_state, mode,
+                    &precompiled);
+    module->SetInternalField(kWasmLazyCompilationState, *lazy_state);
+  }
+
+  // Build the graphs of all other functions in parallel, if possible.
+  CompileInParallel(isolate, &module_env, &precompiled, thrower, stats);
 
   // First pass: compile each function and initialize the code table.
   for (const WasmFunction& func : *functions) {
@@ -314,38 +1798,25 @@ MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
     Handle<JSFunction> function = Handle<JSFunction>::null();
     if (func.external) {
       // Lookup external function in FFI object.
-      if (!ffi.is_null()) {
-        MaybeHandle<Object> result = Object::GetProperty(ffi, name);
-        if (!result.is_null()) {
-          Handle<Object> obj = result.ToHandleChecked();
-          if (obj->IsJSFunction()) {
-            function = Handle<JSFunction>::cast(obj);
-            code = compiler::CompileWasmToJSWrapper(isolate, &module_env,
-                                                    function, index);
-          } else {
-            thrower.Error("FFI function #%d:%s is not a JSFunction.", index,
-                          cstr);
-            return MaybeHandle<JSObject>();
-          }
-        } else {
-          thrower.Error("FFI function #%d:%s not found.", index, cstr);
-          return MaybeHandle<JSObject>();
-        }
-      } else {
-        thrower.Error("FFI table is not an object.");
+      MaybeHandle<JSFunction> lookup =
+          LookupFunction(thrower, ffi, name, index, cstr);
+      if (!lookup.ToHandle(&function)) {
         return MaybeHandle<JSObject>();
       }
+      code = wrappers.GetWasmToJSWrapper(function, index);
     } else {
-      // Compile the function.
-      code = compiler::CompileWasmFunction(thrower, isolate, &module_env, func,
-                                           index);
+      // Compile the function, unless that already happened in parallel.
+      code = precompiled[index];
+      if (code.is_null()) {
+        code = compiler::CompileWasmFunction(thrower, isolate, &module_env,
+                                             func, index, stats);
+      }
       if (code.is_null()) {
         thrower.Error("Compilation of #%d:%s failed.", index, cstr);
         return MaybeHandle<JSObject>();
       }
       if (func.exported) {
-        function = compiler::CompileJSToWasmWrapper(isolate, &module_env, name,
-                                                    code, index);
+        function = wrappers.GetJSToWasmWrapper(name, code, index);
       }
     }
     if (!code.is_null()) {
@@ -355,19 +1826,350 @@ MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
     }
     if (func.exported) {
       // Exported functions are installed as read-only properties on the module.
+      SetExportInstance(function, module);
       JSObject::AddProperty(module, name, function, READ_ONLY);
+      wrapper_table->set(index, function->code());
     }
     index++;
   }
+  if (stats) {
+    stats->compile_time = timer.Elapsed().InMillisecondsF();
+    timer.Restart();
+  }
 
   // Second pass: patch all direct call sites.
   linker.Link(module_env.function_table, this->function_table);
+  if (stats) stats->link_time = timer.Elapsed().InMillisecondsF();
 
-  module->SetInternalField(kWasmModuleFunctionTable, Smi::FromInt(0));
   module->SetInternalField(kWasmModuleCodeTable, *code_table);
+  module->SetInternalField(kWasmExportWrapperTable, *wrapper_table);
   return module;
 }
 
+MaybeHandle<JSObject> WasmModule::Reinstantiate(Isolate* isolate,
+                                                Handle<JSObject> instance,
+                                                Handle<JSObject> ffi,
+                                                Handle<JSArrayBuffer> memory) {
+  this->shared_isolate = isolate;  // TODO: have a real shared isolate.
+  ErrorThrower thrower(isolate, "WasmModule::Reinstantiate()");
+  Factory* factory = isolate->factory();
+  if (!IsModuleOf(*instance)) {
+    // The code would be patched against the tables of the wrong module.
+    thrower.Error("Instance was not instantiated from this module.");
+    return MaybeHandle<JSObject>();
+  }
+  if (instance->GetInternalField(kWasmLazyCompilationState)->IsJSObject()) {
+    // The stubs of lazily compiled instances compile into their instance.
+    thrower.Error("Lazily compiled instances cannot be reinstantiated.");
+    return MaybeHandle<JSObject>();
+  }
+
+  //-------------------------------------------------------------------------
+  // Allocate the module object, linear memory and globals.
+  //-------------------------------------------------------------------------
+  // Code without bounds checks needs a guarded memory as well. The checks of
+  // asm.js code work with any memory.
+  BoundsCheckMode bounds_checks = static_cast<BoundsCheckMode>(
+      Smi::cast(instance->GetInternalField(kWasmBoundsCheckMode))->value());
+  ModuleEnv module_env;
+  Handle<JSObject> module;
+  if (!SetupInstance(isolate, this, memory, bounds_checks, thrower,
+                     &module_env)
+           .ToHandle(&module)) {
+    return MaybeHandle<JSObject>();
+  }
+  if (bounds_checks == kGuardRegionBoundsChecks && !module_env.guard_region) {
+    thrower.Error("Instances without bounds checks need guarded memory.");
+    return MaybeHandle<JSObject>();
+  }
+  int size = static_cast<int>(functions->size());
+  Handle<FixedArray> old_code_table(
+      FixedArray::cast(instance->GetInternalField(kWasmModuleCodeTable)),
+      isolate);
+  Handle<FixedArray> old_wrapper_table(
+      FixedArray::cast(instance->GetInternalField(kWasmExportWrapperTable)),
+      isolate);
+  Handle<FixedArray> code_table = factory->NewFixedArray(size, TENURED);
+  Handle<FixedArray> wrapper_table = factory->NewFixedArray(size, TENURED);
+
+  //-------------------------------------------------------------------------
+  // Copy the code of all functions and create new wrappers for the FFI.
+  //-------------------------------------------------------------------------
+  WrapperCache wrappers(isolate, &module_env);
+  int index = 0;
+  for (const WasmFunction& func : *functions) {
+    Handle<Code> code;
+    if (func.external) {
+      const char* cstr = GetName(func.name_offset);
+      Handle<String> name = factory->InternalizeUtf8String(cstr);
+      Handle<JSFunction> function;
+      MaybeHandle<JSFunction> lookup =
+          LookupFunction(thrower, ffi, name, index, cstr);
+      if (!lookup.ToHandle(&function)) {
+        return MaybeHandle<JSObject>();
+      }
+      code = wrappers.GetWasmToJSWrapper(function, index);
+    } else {
+      Handle<Code> old_code(Code::cast(old_code_table->get(index)), isolate);
+      code = factory->CopyCode(old_code);
+      compiler::RecordWasmCodeCreation(isolate, this, index, "WASM function",
+                                       code);
+    }
+    code_table->set(index, *code);
+    if (func.exported) {
+      Handle<Code> old_wrapper(Code::cast(old_wrapper_table->get(index)),
+                               isolate);
+      Handle<Code> wrapper = factory->CopyCode(old_wrapper);
+      compiler::RecordWasmCodeCreation(isolate, this, index,
+                                       "JS->WASM function wrapper", wrapper);
+      wrapper_table->set(index, *wrapper);
+    }
+    index++;
+  }
+
+  //-------------------------------------------------------------------------
+  // Redirect the copied code to the new instance.
+  //-------------------------------------------------------------------------
+  {
+    DisallowHeapAllocation no_allocation;
+    InstanceRelocator relocator;
+    relocator.AddObject(instance->GetInternalField(kWasmInstanceData),
+                        *module_env.instance_data);
+    if (!module_env.function_table.is_null()) {
+      relocator.AddObject(instance->GetInternalField(kWasmModuleFunctionTable),
+                          *module_env.function_table);
+    }
+    for (int i = 0; i < size; i++) {
+      relocator.AddCode(Code::cast(old_code_table->get(i)),
+                        Code::cast(code_table->get(i)));
+    }
+    for (int i = 0; i < size; i++) {
+      const WasmFunction& func = functions->at(i);
+      if (!func.external) {
+        relocator.Relocate(isolate, Code::cast(code_table->get(i)));
+      }
+      if (func.exported) {
+        relocator.Relocate(isolate, Code::cast(wrapper_table->get(i)));
+      }
+    }
+    if (!module_env.function_table.is_null()) {
+      int table_size = static_cast<int>(this->function_table->size());
+      for (int i = 0; i < table_size; i++) {
+        module_env.function_table->set(
+            FunctionTableCodeIndex(i),
+            code_table->get(this->function_table->at(i)));
+      }
+    }
+  }
+
+  //-------------------------------------------------------------------------
+  // Create the exports.
+  //-------------------------------------------------------------------------
+  index = 0;
+  for (const WasmFunction& func : *functions) {
+    if (func.exported) {
+      Handle<String> name =
+          factory->InternalizeUtf8String(GetName(func.name_offset));
+      Handle<Code> code(Code::cast(code_table->get(index)), isolate);
+      Handle<Code> wrapper(Code::cast(wrapper_table->get(index)), isolate);
+      Handle<JSFunction> function = compiler::NewJSToWasmFunction(
+          isolate, &module_env, name, code, wrapper, index);
+      SetExportInstance(function, module);
+      JSObject::AddProperty(module, name, function, READ_ONLY);
+    }
+    index++;
+  }
+
+  module->SetInternalField(kWasmModuleCodeTable, *code_table);
+  module->SetInternalField(kWasmExportWrapperTable, *wrapper_table);
+  return module;
+}
+
+Handle<JSObject> WasmModule::CreateTemplate(Isolate* isolate,
+                                            Handle<JSObject> instance) {
+  Handle<JSObject> copy = NewModuleObject(isolate);
+  for (int i = 0; i < kWasmModuleInternalFieldCount; i++) {
+    copy->SetInternalField(i, instance->GetInternalField(i));
+  }
+  // Drop the references to the instance's memory and globals.
+  copy->SetInternalField(kWasmMemArrayBuffer, Smi::FromInt(0));
+  copy->SetInternalField(kWasmGlobalsArrayBuffer, Smi::FromInt(0));
+  return copy;
+}
+
+Handle<JSObject> WasmModule::NewModuleObject(Isolate* isolate) {
+  Factory* factory = isolate->factory();
+  Handle<Map> map = factory->NewMap(
+      JS_OBJECT_TYPE,
+      JSObject::kHeaderSize + kWasmModuleInternalFieldCount * kPointerSize);
+  return factory->NewJSObjectFromMap(map, TENURED);
+}
+
+size_t WasmModule::CodeSize(Handle<JSObject> instance) {
+  size_t size = 0;
+  const int kTables[] = {kWasmModuleCodeTable, kWasmExportWrapperTable};
+  for (int table_index : kTables) {
+    FixedArray* table =
+        FixedArray::cast(instance->GetInternalField(table_index));
+    for (int i = 0; i < table->length(); i++) {
+      Object* code = table->get(i);
+      if (code->IsCode()) size += Code::cast(code)->Size();
+    }
+  }
+  return size;
+}
+
+WasmInstanceMemoryUsage WasmModule::MemoryUsage(Handle<JSObject> instance) {
+  Isolate* isolate = instance->GetIsolate();
+  WasmInstanceMemoryUsage usage;
+  usage.code = CodeSize(instance);
+  usage.memory = 0;
+  Object* memory = instance->GetInternalField(kWasmMemArrayBuffer);
+  if (memory->IsJSArrayBuffer()) {
+    usage.memory =
+        NumberToSize(isolate, JSArrayBuffer::cast(memory)->byte_length());
+  }
+  usage.globals = 0;
+  Object* globals = instance->GetInternalField(kWasmGlobalsArrayBuffer);
+  if (globals->IsJSArrayBuffer()) {
+    usage.globals =
+        NumberToSize(isolate, JSArrayBuffer::cast(globals)->byte_length());
+  }
+  usage.tables = 0;
+  const int kTables[] = {kWasmModuleFunctionTable, kWasmModuleCodeTable,
+                         kWasmExportWrapperTable};
+  for (int table_index : kTables) {
+    Object* table = instance->GetInternalField(table_index);
+    if (table->IsFixedArray()) usage.tables += FixedArray::cast(table)->Size();
+  }
+  usage.metadata = instance->Size();
+  Object* data = instance->GetInternalField(kWasmInstanceData);
+  if (data->IsByteArray()) usage.metadata += ByteArray::cast(data)->Size();
+  return usage;
+}
+
+void WasmModule::FinishTieredCompilation(Isolate* isolate,
+                                         Handle<JSObject> instance) {
+  Object* holder = instance->GetInternalField(kWasmLazyCompilationState);
+  if (!holder->IsJSObject()) return;
+  HandleScope scope(isolate);
+  InstallTieredCode(isolate, handle(JSObject::cast(holder), isolate), true);
+}
+
+WasmNativeEntry::WasmNativeEntry(Isolate* isolate, WasmModule* module,
+                                 Handle<JSObject> instance, uint32_t index)
+    : isolate_(isolate) {
+  const WasmFunction& func = module->functions->at(index);
+  CHECK(func.exported);
+  sig_ = func.sig;
+
+  // Exported functions are never lazy, so their code in the code table is
+  // the compiled function.
+  std::vector<Handle<Code>> function_code;
+  ModuleEnv module_env;
+  InitLazyModuleEnv(isolate, module, instance, &function_code, &module_env);
+  Handle<String> name = isolate->factory()->InternalizeUtf8String(
+      module->GetName(func.name_offset));
+  Handle<Code> code = function_code[index];
+
+  // Share the wrapper of the first entry of each signature by copying it.
+  Object* cache = instance->GetInternalField(kWasmNativeEntryWrappers);
+  if (!cache->IsFixedArray()) {
+    cache = *isolate->factory()->NewFixedArray(
+        2 * static_cast<int>(module->signatures->size()), TENURED);
+    instance->SetInternalField(kWasmNativeEntryWrappers, cache);
+  }
+  Handle<FixedArray> wrappers(FixedArray::cast(cache), isolate);
+  int key = 2 * module->CanonicalSigIndex(func.sig_index);
+  Handle<JSFunction> wrapper;
+  if (!wrappers->get(key)->IsCode()) {
+    wrapper = compiler::CompileBatchedJSToWasmWrapper(isolate, &module_env,
+                                                      name, code, index);
+    wrappers->set(key, *code);
+    wrappers->set(key + 1, wrapper->code());
+  } else {
+    Handle<Code> wrapper_code = isolate->factory()->CopyCode(
+        handle(Code::cast(wrappers->get(key + 1)), isolate));
+    {
+      DisallowHeapAllocation no_allocation;
+      InstanceRelocator relocator;
+      relocator.AddCode(Code::cast(wrappers->get(key)), *code);
+      relocator.Relocate(isolate, *wrapper_code);
+    }
+    compiler::RecordWasmCodeCreation(isolate, module, index,
+                                     "batched JS->WASM function wrapper",
+                                     wrapper_code);
+    wrapper = compiler::NewBatchedJSToWasmFunction(isolate, name, wrapper_code);
+  }
+  SetExportInstance(wrapper, instance);
+  wrapper_ = Handle<JSFunction>::cast(
+      isolate->global_handles()->Create(*wrapper));
+
+  Handle<JSArrayBuffer> batch_buffer = isolate->factory()->NewJSArrayBuffer();
+  JSArrayBuffer::Setup(batch_buffer, isolate, true, &batch_, sizeof(batch_));
+  batch_buffer->set_is_neuterable(false);
+  batch_buffer_ = Handle<JSArrayBuffer>::cast(
+      isolate->global_handles()->Create(*batch_buffer));
+}
+
+WasmNativeEntry::~WasmNativeEntry() {
+  GlobalHandles::Destroy(reinterpret_cast<Object**>(wrapper_.location()));
+  GlobalHandles::Destroy(reinterpret_cast<Object**>(batch_buffer_.location()));
+}
+
+bool WasmNativeEntry::CallBatch(const WasmNativeValue* args,
+                                WasmNativeValue* results, int count) {
+  DCHECK(results != nullptr || sig_->return_count() == 0);
+  batch_.args = args;
+  batch_.results = results;
+  batch_.count = count;
+  Handle<Object> argv[] = {batch_buffer_};
+  return !Execution::Call(isolate_, wrapper_,
+                          isolate_->factory()->undefined_value(), 1, argv)
+              .is_null();
+}
+
+WasmStreamingCompilation::WasmStreamingCompilation(Isolate* isolate,
+                                                   size_t expected_size)
+    : isolate_(isolate),
+      compiler_(new Compiler(isolate)),
+      decoder_(nullptr),
+      module_(nullptr) {
+  // Function bodies are verified as they are compiled.
+  decoder_ = new StreamingDecoder(isolate, &zone_, compiler_, false, false,
+                                  expected_size);
+}
+
+WasmStreamingCompilation::~WasmStreamingCompilation() {
+  delete module_;
+  delete decoder_;
+  delete compiler_;
+}
+
+bool WasmStreamingCompilation::AddBytes(const byte* bytes, size_t size) {
+  DCHECK_NULL(module_);
+  return decoder_->AddBytes(bytes, size);
+}
+
+MaybeHandle<JSObject> WasmStreamingCompilation::Finish(
+    Handle<JSObject> ffi, Handle<JSArrayBuffer> memory,
+    ErrorThrower& thrower) {
+  DCHECK_NULL(module_);
+  ModuleResult result = decoder_->Finish();
+  if (result.failed()) {
+    thrower.Failed("", result);
+    if (result.val) delete result.val;
+    return MaybeHandle<JSObject>();
+  }
+  module_ = result.val;
+  return module_->Instantiate(isolate_, ffi, memory, kEagerCompilation,
+                              kExplicitBoundsChecks, nullptr, this);
+}
+
+int WasmStreamingCompilation::streamed_count() const {
+  return compiler_->streamed_count();
+}
+
 Handle<Code> ModuleEnv::GetFunctionCode(uint32_t index) {
   DCHECK(IsValidFunction(index));
   if (linker) return linker->GetFunctionCode(index);
@@ -437,13 +2239,18 @@ int32_t CompileAndRunWasmModule(Isolate* isolate, WasmModule* module) {
   LoadDataSegments(module, mem_addr.get(), mem_size);
 
   // Compile all functions.
+  std::vector<Handle<Code>> precompiled(module->functions->size());
+  CompileInParallel(isolate, &module_env, &precompiled, thrower);
   Handle<Code> main_code = Handle<Code>::null();  // record last code.
   int index = 0;
   for (const WasmFunction& func : *module->functions) {
     if (!func.external) {
       // Compile the function and install it in the code table.
-      Handle<Code> code = compiler::CompileWasmFunction(
-          thrower, isolate, &module_env, func, index);
+      Handle<Code> code = precompiled[index];
+      if (code.is_null()) {
+        code = compiler::CompileWasmFunction(thrower, isolate, &module_env,
+                                             func, index);
+      }
       if (!code.is_null()) {
         if (func.exported) main_code = code;
         linker.Finish(index, code);
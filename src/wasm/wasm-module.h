@@ -5,11 +5,14 @@
 #ifndef V8_WASM_MODULE_H_
 #define V8_WASM_MODULE_H_
 
+#include <type_traits>
+
 #include "wasm-opcodes.h"
 #include "wasm-result.h"
 
 #include "src/api.h"
 #include "src/handles.h"
+#include "src/zone-containers.h"
 
 namespace v8 {
 namespace internal {
@@ -39,7 +42,13 @@ enum WasmFunctionDeclBit {
   kDeclFunctionName = 0x01,
   kDeclFunctionImport = 0x02,
   kDeclFunctionLocals = 0x04,
-  kDeclFunctionExport = 0x08
+  kDeclFunctionExport = 0x08,
+  kDeclFunctionSimdLocals = 0x10
+};
+
+enum WasmMemoryDeclBit {
+  kDeclMemoryExport = 0x01,
+  kDeclMemoryShared = 0x02
 };
 
 // Constants for fixed-size elements within a module.
@@ -47,20 +56,25 @@ static const size_t kDeclMemorySize = 3;
 static const size_t kDeclGlobalSize = 6;
 static const size_t kDeclDataSegmentSize = 13;
 
-// Static representation of a wasm function.
+// Static representation of a wasm function. The fields are ordered so that
+// there is no padding between them, and the flags share a word with the code
+// end offset, which is below {kMaxModuleSize}.
 struct WasmFunction {
-  FunctionSig* sig;      // signature of the function.
-  uint16_t sig_index;    // index into the signature table.
-  uint32_t name_offset;  // offset in the module bytes of the name, if any.
-  uint32_t code_start_offset;    // offset in the module bytes of code start.
-  uint32_t code_end_offset;      // offset in the module bytes of code end.
-  uint16_t local_int32_count;    // number of int32 local variables.
-  uint16_t local_int64_count;    // number of int64 local variables.
-  uint16_t local_float32_count;  // number of float32 local variables.
-  uint16_t local_float64_count;  // number of float64 local variables.
-  bool exported;                 // true if this function is exported.
-  bool external;  // true if this function is externally supplied.
+  FunctionSig* sig;               // signature of the function.
+  uint32_t name_offset;           // offset in the module bytes of the name.
+  uint32_t code_start_offset;     // offset in the module bytes of code start.
+  uint32_t code_end_offset : 30;  // offset in the module bytes of code end.
+  uint32_t exported : 1;          // 1 if this function is exported.
+  uint32_t external : 1;          // 1 if this function is externally supplied.
+  uint16_t sig_index;             // index into the signature table.
+  uint16_t local_int32_count;     // number of int32 local variables.
+  uint16_t local_int64_count;     // number of int64 local variables.
+  uint16_t local_float32_count;   // number of float32 local variables.
+  uint16_t local_float64_count;   // number of float64 local variables.
+  uint16_t local_simd128_count;   // number of simd128 local variables.
 };
+STATIC_ASSERT(kMaxModuleSize <= (1u << 30));
+STATIC_ASSERT(sizeof(WasmFunction) == sizeof(FunctionSig*) + 24);
 
 struct ModuleEnv;  // forward declaration of decoder interface.
 
@@ -80,10 +94,94 @@ struct WasmDataSegment {
   bool init;               // true if loaded upon instantiation.
 };
 
+// Internal constants for the layout of the module object.
+const int kWasmModuleInternalFieldCount = 10;
+const int kWasmModuleFunctionTable = 0;
+const int kWasmModuleCodeTable = 1;
+const int kWasmMemArrayBuffer = 2;
+const int kWasmGlobalsArrayBuffer = 3;
+const int kWasmInstanceData = 4;
+const int kWasmExportWrapperTable = 5;
+const int kWasmLazyCompilationState = 6;
+const int kWasmBoundsCheckMode = 7;  // Smi of the BoundsCheckMode of the code.
+const int kWasmModuleBytesHash = 8;  // Smi identifying the module, see
+                                     // {WasmModule::IsModuleOf}.
+// The first batched wrapper code and the code it wraps, by signature, see
+// {WasmNativeEntry}.
+const int kWasmNativeEntryWrappers = 9;
+
+// Whether instantiation compiles all functions, or leaves the functions that
+// are not exported as stubs that compile them upon their first call, or as
+// stubs that interpret them and recompile them with TurboFan once they are
+// hot.
+enum CompilationMode {
+  kEagerCompilation,
+  kLazyCompilation,
+  kTieredCompilation
+};
+
+// How compiled code keeps memory accesses in bounds. By default, it checks
+// the bounds of every access explicitly and traps if they are exceeded.
+// With {kAsmJsBoundsChecks}, meant for modules translated from asm.js, code
+// follows asm.js semantics instead of trapping: loads out of bounds read 0 or
+// NaN, and stores out of bounds are ignored. Only the start of an access is
+// checked, which suffices for accesses aligned to their size, as the heap
+// accesses of asm.js are.
+// With {kGuardRegionBoundsChecks}, a new memory is placed in a guard region
+// where the host supports that, and code leaves out the checks. Accesses out
+// of bounds fault in the guard region, and the fault handler continues in
+// code that throws the trap, as an explicit check would.
+enum BoundsCheckMode {
+  kExplicitBoundsChecks,
+  kAsmJsBoundsChecks,
+  kGuardRegionBoundsChecks
+};
+
+// Statistics of the compilation of a single function. Times are in
+// milliseconds. {graph_zone_bytes} counts only the zone that holds the graph
+// from decoding until the code is generated; the short-lived zones of the
+// decoder and of the pipeline phases are not included.
+struct WasmFunctionStats {
+  uint32_t index;           // index of the function in the module.
+  double decode_time;       // decoding the body and building the graph.
+  size_t node_count;        // nodes in the graph before the pipeline runs.
+  double pipeline_time;     // running the TurboFan pipeline.
+  size_t code_size;         // bytes of generated machine code.
+  size_t graph_zone_bytes;  // bytes allocated in the graph zone.
+};
+
+// Statistics of the instantiation of a module. Times are in milliseconds.
+// Functions that are not compiled during instantiation, such as lazily
+// compiled ones, are not listed.
+struct WasmCompilationStats {
+  bool cached = false;            // the code was reused from the code cache.
+  double decode_time = 0;         // decoding the module.
+  double compile_time = 0;        // compiling all functions.
+  double link_time = 0;           // patching the direct calls.
+  double data_segments_time = 0;  // loading or mapping the data segments.
+  // The compiled functions, in the order in which their code was generated.
+  std::vector<WasmFunctionStats> functions;
+};
+
+// The bytes held by a single instance, for accounting. The module bytes and
+// the decoded module are shared between instances and are not included.
+struct WasmInstanceMemoryUsage {
+  size_t code;      // compiled code of the functions and export wrappers.
+  size_t memory;    // linear memory.
+  size_t globals;   // globals area.
+  size_t tables;    // function, code and export wrapper tables.
+  size_t metadata;  // the instance object and its instance data.
+};
+
+class MemoryImage;
+class ModuleBytes;
+class WasmStreamingCompilation;
+
 // Static representation of a module.
 struct WasmModule {
   static const uint8_t kMinMemSize = 12;  // Minimum memory size = 4kb
   static const uint8_t kMaxMemSize = 30;  // Maximum memory size = 1gb
+  static const uint32_t kPageSize = 1 << kMinMemSize;  // Memory page = 4kb
 
   Isolate* shared_isolate;    // isolate for storing shared code.
   const byte* module_start;   // starting address for the module bytes.
@@ -91,13 +189,25 @@ struct WasmModule {
   uint8_t min_mem_size_log2;  // minimum size of the memory (log base 2).
   uint8_t max_mem_size_log2;  // maximum size of the memory (log base 2).
   bool mem_export;            // true if the memory is exported.
+  bool mem_shared;            // true if the memory is shared between threads.
   bool mem_external;          // true if the memory is external.
 
-  std::vector<WasmGlobal>* globals;             // globals in this module.
-  std::vector<FunctionSig*>* signatures;        // signatures in this module.
-  std::vector<WasmFunction>* functions;         // functions in this module.
-  std::vector<WasmDataSegment>* data_segments;  // data segments in this module.
-  std::vector<uint16_t>* function_table;        // function table.
+  // The tables of the module are allocated in the zone of the module, along
+  // with its signatures, and are freed with the zone.
+  ZoneVector<WasmGlobal>* globals;             // globals in this module.
+  ZoneVector<FunctionSig*>* signatures;        // signatures in this module.
+  ZoneVector<WasmFunction>* functions;         // functions in this module.
+  ZoneVector<WasmDataSegment>* data_segments;  // data segments in this module.
+  ZoneVector<uint16_t>* function_table;        // function table.
+  // The canonical index of each signature, see {CanonicalSigIndex}.
+  ZoneVector<uint16_t>* canonical_sig_indices = nullptr;
+  // The initial memory shared by the instances, built on first use.
+  MemoryImage* memory_image = nullptr;
+  // The shared copy of the module bytes that the module was decoded from, if
+  // any. The module owns a reference to it, and shares its memory image.
+  ModuleBytes* bytes = nullptr;
+
+  ~WasmModule();
 
   // Get a pointer to a string stored in the module bytes representing a name.
   const char* GetName(uint32_t offset) {
@@ -112,9 +222,58 @@ struct WasmModule {
     return start < size && end < size;
   }
 
+  // Returns the canonical index of the signature {index}: the index of the
+  // first signature in the module that is structurally equal to it. Indirect
+  // calls check canonical indices, so that a function matches calls through
+  // any of the equal signatures. The decoder computes the canonical indices
+  // up front; for modules built by hand they are computed on demand.
+  uint16_t CanonicalSigIndex(uint32_t index) const;
+
+  // Records in {instance} that its code was compiled from this module.
+  void SetModuleOf(JSObject* instance) const;
+
+  // Returns true if the code of {instance} was compiled from this module or
+  // from another one with the same bytes, so that it fits this module.
+  bool IsModuleOf(JSObject* instance) const;
+
   // Creates a new instantiation of the module in the given isolate.
-  MaybeHandle<JSObject> Instantiate(Isolate* isolate, Handle<JSObject> ffi,
-                                    Handle<JSArrayBuffer> memory);
+  // Records the times and sizes of the instantiation in {stats}, if given.
+  // Takes over the code that {streamed}, if given, compiled while the module
+  // was arriving, instead of compiling those functions again.
+  MaybeHandle<JSObject> Instantiate(
+      Isolate* isolate, Handle<JSObject> ffi, Handle<JSArrayBuffer> memory,
+      CompilationMode mode = kEagerCompilation,
+      BoundsCheckMode bounds_checks = kExplicitBoundsChecks,
+      WasmCompilationStats* stats = nullptr,
+      WasmStreamingCompilation* streamed = nullptr);
+
+  // Creates a new instantiation of the module that shares the compiled code
+  // of {instance}, an earlier instantiation of this module in the same
+  // isolate. The function code is copied and patched instead of recompiled.
+  // Fails with an error if {instance} belongs to another module.
+  MaybeHandle<JSObject> Reinstantiate(Isolate* isolate,
+                                      Handle<JSObject> instance,
+                                      Handle<JSObject> ffi,
+                                      Handle<JSArrayBuffer> memory);
+
+  // Creates a copy of {instance} for use with {Reinstantiate} that keeps the
+  // compiled code alive, but not the memory and globals of the instance.
+  static Handle<JSObject> CreateTemplate(Isolate* isolate,
+                                         Handle<JSObject> instance);
+
+  // Allocates a module object with the internal fields laid out as above.
+  static Handle<JSObject> NewModuleObject(Isolate* isolate);
+
+  // Returns the number of bytes of compiled code held by {instance}.
+  static size_t CodeSize(Handle<JSObject> instance);
+
+  // Returns the number of bytes held by {instance}, by kind.
+  static WasmInstanceMemoryUsage MemoryUsage(Handle<JSObject> instance);
+
+  // Waits for the pending background recompilations of a tiered {instance}
+  // and installs their code. Used for testing.
+  static void FinishTieredCompilation(Isolate* isolate,
+                                      Handle<JSObject> instance);
 };
 
 // forward declaration.
@@ -133,7 +292,35 @@ struct ModuleEnv {
   Handle<FixedArray> function_table;
   Handle<JSArrayBuffer> memory;
   Handle<Context> context;
+  // If set, code loads the memory start, memory size, globals area and the
+  // runtime entries for traps, for growing the memory and for atomic
+  // operations from this per-instance object at run time instead of embedding
+  // them, so that it can be shared between instances and does not embed any
+  // external references.
+  // Memory can only grow if this is set, since other code embeds the size.
+  Handle<ByteArray> instance_data;
   bool asm_js;  // true if the module originated from asm.js.
+  // True if the memory lies in a guard region and code compiled against the
+  // {instance_data} leaves out the bounds checks.
+  bool guard_region = false;
+
+  // Layout of the {instance_data}.
+  static const int kInstanceMemStartOffset = 0;
+  static const int kInstanceGlobalsAreaOffset = kPointerSize;
+  static const int kInstanceThrowEntryOffset = 2 * kPointerSize;
+  static const int kInstanceGrowMemoryEntryOffset = 3 * kPointerSize;
+  static const int kInstanceAtomicEntryOffset = 4 * kPointerSize;
+  static const int kInstanceMemSizeOffset = 5 * kPointerSize;
+  static const int kInstanceDataSize = 5 * kPointerSize + kInt32Size;
+
+  // Layout of the {function_table}: a FixedArray with one entry of two
+  // elements per table index, the canonical signature index as a Smi and the
+  // code next to it, so that an indirect call checks the signature and loads
+  // the code from the same cache line.
+  static const int kFunctionTableEntrySizeLog2 = 1;
+  static const int kFunctionTableEntrySize = 1 << kFunctionTableEntrySizeLog2;
+  static const int kFunctionTableSigOffset = 0;
+  static const int kFunctionTableCodeOffset = 1;
 
   bool IsValidGlobal(uint32_t index) {
     return module && index < module->globals->size();
@@ -156,6 +343,10 @@ struct ModuleEnv {
     DCHECK(IsValidSignature(index));
     return module->signatures->at(index);
   }
+  uint16_t GetCanonicalSigIndex(uint32_t index) {
+    DCHECK(IsValidSignature(index));
+    return module->CanonicalSigIndex(index);
+  }
   size_t FunctionTableSize() {
     return module ? module->function_table->size() : 0;
   }
@@ -167,6 +358,173 @@ struct ModuleEnv {
   compiler::CallDescriptor* GetCallDescriptor(Zone* zone, uint32_t index);
 };
 
+// A raw argument or result of a {WasmNativeEntry}, in a slot of 8 bytes.
+union WasmNativeValue {
+  int32_t i32;
+  int64_t i64;
+  float f32;
+  double f64;
+};
+
+// Whether {T} is the C++ type of an i32, i64, f32 or f64 value.
+template <typename T>
+struct IsWasmNativeType
+    : std::integral_constant<bool, std::is_same<T, int32_t>::value ||
+                                       std::is_same<T, int64_t>::value ||
+                                       std::is_same<T, float>::value ||
+                                       std::is_same<T, double>::value> {};
+
+template <typename... Ts>
+struct AllWasmNativeTypes : std::true_type {};
+
+template <typename T, typename... Ts>
+struct AllWasmNativeTypes<T, Ts...>
+    : std::integral_constant<bool, IsWasmNativeType<T>::value &&
+                                       AllWasmNativeTypes<Ts...>::value> {};
+
+// The argument tuples and results of a call of a {WasmNativeEntry}, as read by
+// its wrapper code.
+struct WasmNativeBatch {
+  const WasmNativeValue* args;  // one value per parameter for each call.
+  WasmNativeValue* results;     // one value for each call, if any.
+  int32_t count;                // number of calls.
+};
+
+// Calls an exported function of an instance from C++ with raw i32, i64, f32
+// and f64 values, as they are passed to the function by its wasm call
+// descriptor, instead of converting them from and to JavaScript numbers. A
+// batched call invokes the function over an array of argument tuples within
+// a single call of the wrapper code. Traps throw as for calls from
+// JavaScript, so they can be caught by the embedder.
+class WasmNativeEntry {
+ public:
+  // Creates the entry for the exported function {index} of {instance}, an
+  // instantiation of {module}. The wrapper code is shared by the entries for
+  // functions of the same signature in {instance}. The entry keeps the
+  // instance alive until it is destroyed.
+  WasmNativeEntry(Isolate* isolate, WasmModule* module,
+                  Handle<JSObject> instance, uint32_t index);
+  ~WasmNativeEntry();
+
+  FunctionSig* sig() const { return sig_; }
+
+  // Calls the function once for each of the {count} tuples in {args}, which
+  // hold one value per parameter each, and stores the results in {results},
+  // which can be null if the function returns nothing. Returns false if a
+  // call traps, with the exception pending on the isolate and the results of
+  // the earlier calls stored.
+  bool CallBatch(const WasmNativeValue* args, WasmNativeValue* results,
+                 int count);
+
+  // Calls the function with {args}, whose C++ types must match its
+  // parameters exactly, and stores the result in {result}.
+  template <typename R, typename... Args>
+  bool Call(R* result, Args... args) {
+    static_assert(IsWasmNativeType<R>::value &&
+                      AllWasmNativeTypes<Args...>::value,
+                  "values must be int32_t, int64_t, float or double");
+    DCHECK_EQ(sizeof...(Args), sig_->parameter_count());
+    DCHECK_EQ(1u, sig_->return_count());
+    WasmNativeValue values[sizeof...(Args) + 1];
+    int index = 0;
+    int packed[] = {0, (Pack(&values[index], index, args), index++)...};
+    USE(packed);
+    WasmNativeValue value;
+    if (!CallBatch(values, &value, 1)) return false;
+    Unpack(value, result);
+    return true;
+  }
+
+ private:
+  void Pack(WasmNativeValue* value, int index, int32_t arg) {
+    DCHECK(sig_->GetParam(index) == kAstI32);
+    value->i32 = arg;
+  }
+  void Pack(WasmNativeValue* value, int index, int64_t arg) {
+    DCHECK(sig_->GetParam(index) == kAstI64);
+    value->i64 = arg;
+  }
+  void Pack(WasmNativeValue* value, int index, float arg) {
+    DCHECK(sig_->GetParam(index) == kAstF32);
+    value->f32 = arg;
+  }
+  void Pack(WasmNativeValue* value, int index, double arg) {
+    DCHECK(sig_->GetParam(index) == kAstF64);
+    value->f64 = arg;
+  }
+  void Unpack(const WasmNativeValue& value, int32_t* result) {
+    DCHECK(sig_->GetReturn() == kAstI32);
+    *result = value.i32;
+  }
+  void Unpack(const WasmNativeValue& value, int64_t* result) {
+    DCHECK(sig_->GetReturn() == kAstI64);
+    *result = value.i64;
+  }
+  void Unpack(const WasmNativeValue& value, float* result) {
+    DCHECK(sig_->GetReturn() == kAstF32);
+    *result = value.f32;
+  }
+  void Unpack(const WasmNativeValue& value, double* result) {
+    DCHECK(sig_->GetReturn() == kAstF64);
+    *result = value.f64;
+  }
+
+  Isolate* isolate_;
+  FunctionSig* sig_;
+  // Global handles to the wrapper, which keeps the instance alive, and to
+  // the external array buffer over {batch_} that is passed to it.
+  Handle<JSFunction> wrapper_;
+  Handle<JSArrayBuffer> batch_buffer_;
+  WasmNativeBatch batch_;
+
+  DISALLOW_COPY_AND_ASSIGN(WasmNativeEntry);
+};
+
+class StreamingDecoder;
+
+// Compiles a module whose bytes arrive in chunks, for example over the
+// network, and instantiates it once all of them have arrived. Each function
+// is compiled on the thread adding the bytes as soon as its body has arrived,
+// in between chunks, so that compilation overlaps with the transfer of the
+// rest of the module. Functions that need parts of the module that have not
+// arrived yet, such as functions calling later functions or making indirect
+// calls, which need the function table, are compiled upon instantiation.
+class WasmStreamingCompilation {
+ public:
+  // {expected_size}, if not 0, is the size of the whole module, see
+  // {StreamingDecoder}.
+  WasmStreamingCompilation(Isolate* isolate, size_t expected_size = 0);
+  ~WasmStreamingCompilation();
+
+  // Appends the next chunk of module bytes, decodes as much of the module as
+  // possible and compiles the functions that have arrived. Returns {false}
+  // once decoding failed; the error is reported by {Finish}.
+  bool AddBytes(const byte* bytes, size_t size);
+
+  // Decodes the rest of the module after the last chunk has arrived and
+  // instantiates it with {ffi} and {memory}, compiling the functions that
+  // were not compiled yet. Reports errors to {thrower}. May only be called
+  // once. The instance does not refer to the module, so it may outlive this.
+  MaybeHandle<JSObject> Finish(Handle<JSObject> ffi,
+                               Handle<JSArrayBuffer> memory,
+                               ErrorThrower& thrower);
+
+  // Returns the number of functions compiled while the bytes were arriving.
+  int streamed_count() const;
+
+ private:
+  friend struct WasmModule;
+  class Compiler;
+
+  Isolate* isolate_;
+  Zone zone_;
+  Compiler* compiler_;
+  StreamingDecoder* decoder_;
+  WasmModule* module_;  // the decoded module, once finished.
+
+  DISALLOW_COPY_AND_ASSIGN(WasmStreamingCompilation);
+};
+
 std::ostream& operator<<(std::ostream& os, const WasmModule& module);
 std::ostream& operator<<(std::ostream& os, const WasmFunction& function);
 
@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include "src/wasm/wasm-opcodes.h"
+#include "src/base/once.h"
 #include "src/signature.h"
 
 namespace v8 {
@@ -48,16 +49,31 @@ static void InitSigTable() {
 #define SET_SIG_TABLE(name, opcode, sig) \
   kSimpleExprSigTable[opcode] = static_cast<int>(kSigEnum_##sig) + 1;
   FOREACH_SIMPLE_OPCODE(SET_SIG_TABLE);
+  FOREACH_SIMD_SIMPLE_OPCODE(SET_SIG_TABLE);
 #undef SET_SIG_TABLE
 }
 
+V8_DECLARE_ONCE(init_sig_table_once);
+
 FunctionSig* WasmOpcodes::Signature(WasmOpcode opcode) {
-  // TODO(titzer): use LazyInstance to make this thread safe.
-  if (kSimpleExprSigTable[kExprI32Add] == 0) InitSigTable();
+  // Functions may be decoded concurrently on background threads.
+  base::CallOnce(&init_sig_table_once, &InitSigTable);
   return const_cast<FunctionSig*>(
       kSimpleExprSigs[kSimpleExprSigTable[static_cast<byte>(opcode)]]);
 }
 
+static const char* kTrapMessages[] = {
+    "unreachable",       "memory access out of bounds",
+    "divide by zero",    "divide result unrepresentable",
+    "remainder by zero", "integer result unrepresentable",
+    "invalid function",  "function signature mismatch",
+    "unaligned atomic access", "atomic wait not allowed"};
+
+const char* WasmOpcodes::TrapReasonMessage(TrapReason reason) {
+  DCHECK_LT(reason, kTrapCount);
+  return kTrapMessages[reason];
+}
+
 // TODO(titzer): pull WASM_64 up to a common header.
 #if !V8_TARGET_ARCH_32_BIT || V8_TARGET_ARCH_X64
 #define WASM_64 1
@@ -65,6 +81,28 @@ FunctionSig* WasmOpcodes::Signature(WasmOpcode opcode) {
 #define WASM_64 0
 #endif
 
+bool WasmOpcodes::IsSimdOpcode(WasmOpcode opcode) {
+  switch (opcode) {
+#define DECLARE_OPCODE_CASE(name, opcode, sig) case kExpr##name:
+    FOREACH_SIMD_OPCODE(DECLARE_OPCODE_CASE)
+#undef DECLARE_OPCODE_CASE
+    return true;
+    default:
+      return false;
+  }
+}
+
+bool WasmOpcodes::IsAtomicOpcode(WasmOpcode opcode) {
+  switch (opcode) {
+#define DECLARE_OPCODE_CASE(name, opcode, sig) case kExpr##name:
+    FOREACH_ATOMIC_OPCODE(DECLARE_OPCODE_CASE)
+#undef DECLARE_OPCODE_CASE
+    return true;
+    default:
+      return false;
+  }
+}
+
 bool WasmOpcodes::IsSupported(WasmOpcode opcode) {
   switch (opcode) {
 #if !WASM_64
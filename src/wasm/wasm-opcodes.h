@@ -18,7 +18,8 @@ enum LocalTypeCode {
   kLocalI32 = 1,
   kLocalI64 = 2,
   kLocalF32 = 3,
-  kLocalF64 = 4
+  kLocalF64 = 4,
+  kLocalS128 = 5
 };
 
 // Binary encoding of memory types.
@@ -43,6 +44,11 @@ const LocalType kAstI32 = MachineRepresentation::kWord32;
 const LocalType kAstI64 = MachineRepresentation::kWord64;
 const LocalType kAstF32 = MachineRepresentation::kFloat32;
 const LocalType kAstF64 = MachineRepresentation::kFloat64;
+// There is no machine representation for 128-bit values, so SIMD values are
+// lowered to four 32-bit lanes. We use kBit here because no other AST type
+// is represented by it.
+const LocalType kAstS128 = MachineRepresentation::kBit;
+const int kSimd128Lanes = 4;
 // We use kTagged here because kNone is already used by kAstStmt.
 const LocalType kAstEnd = MachineRepresentation::kTagged;
 
@@ -251,6 +257,65 @@ typedef Signature<LocalType> FunctionSig;
   V(I32ReinterpretF32, 0xb4, i_f) \
   V(I64ReinterpretF64, 0xb5, l_d)
 
+// SIMD expressions with signatures, which operate on all lanes at once.
+#define FOREACH_SIMD_SIMPLE_OPCODE(V) \
+  V(I32x4Splat, 0xc0, s_i)            \
+  V(I32x4Add, 0xc1, s_ss)             \
+  V(I32x4Sub, 0xc2, s_ss)             \
+  V(I32x4Mul, 0xc3, s_ss)             \
+  V(S128And, 0xc4, s_ss)              \
+  V(S128Or, 0xc5, s_ss)               \
+  V(S128Xor, 0xc6, s_ss)              \
+  V(F32x4Splat, 0xc7, s_f)            \
+  V(F32x4Add, 0xc8, s_ss)             \
+  V(F32x4Sub, 0xc9, s_ss)             \
+  V(F32x4Mul, 0xca, s_ss)             \
+  V(F32x4Div, 0xcb, s_ss)             \
+  V(F32x4Min, 0xcc, s_ss)             \
+  V(F32x4Max, 0xcd, s_ss)             \
+  V(F32x4Abs, 0xce, s_s)              \
+  V(F32x4Neg, 0xcf, s_s)              \
+  V(F32x4Sqrt, 0xd0, s_s)             \
+  V(F32x4SConvertI32x4, 0xd1, s_s)
+
+// SIMD expressions on a single lane, with the lane index as an operand.
+#define FOREACH_SIMD_LANE_OPCODE(V) \
+  V(I32x4ExtractLane, 0xd2, i_s)    \
+  V(I32x4ReplaceLane, 0xd3, s_si)   \
+  V(F32x4ExtractLane, 0xd4, f_s)    \
+  V(F32x4ReplaceLane, 0xd5, s_sf)
+
+// SIMD shuffle, with the index of the source lane of each result lane as an
+// operand. Indexes 0-3 select lanes of the first input, 4-7 of the second.
+#define FOREACH_SIMD_SHUFFLE_OPCODE(V) V(S32x4Shuffle, 0xd6, s_ss)
+
+// SIMD load and store memory expressions.
+#define FOREACH_SIMD_MEM_OPCODE(V) \
+  V(S128LoadMem, 0xd8, s_i)        \
+  V(S128StoreMem, 0xd9, s_is)
+
+// All SIMD opcodes.
+#define FOREACH_SIMD_OPCODE(V)   \
+  FOREACH_SIMD_SIMPLE_OPCODE(V)  \
+  FOREACH_SIMD_LANE_OPCODE(V)    \
+  FOREACH_SIMD_SHUFFLE_OPCODE(V) \
+  FOREACH_SIMD_MEM_OPCODE(V)
+
+// Atomic read-modify-write, wait and notify expressions on 32-bit integers in
+// the memory, with a memory access operand like loads and stores. Atomic
+// loads and stores are the 32-bit integer loads and stores with an atomicity
+// annotation in their memory access byte.
+#define FOREACH_ATOMIC_OPCODE(V)           \
+  V(I32AtomicAdd, 0xe0, i_ii)              \
+  V(I32AtomicSub, 0xe1, i_ii)              \
+  V(I32AtomicAnd, 0xe2, i_ii)              \
+  V(I32AtomicOr, 0xe3, i_ii)               \
+  V(I32AtomicXor, 0xe4, i_ii)              \
+  V(I32AtomicExchange, 0xe5, i_ii)         \
+  V(I32AtomicCompareExchange, 0xe6, i_iii) \
+  V(I32AtomicWait, 0xe7, i_iii)            \
+  V(AtomicNotify, 0xe8, i_ii)
+
 // All opcodes.
 #define FOREACH_OPCODE(V)     \
   FOREACH_CONTROL_OPCODE(V)   \
@@ -258,37 +323,49 @@ typedef Signature<LocalType> FunctionSig;
   FOREACH_SIMPLE_OPCODE(V)    \
   FOREACH_STORE_MEM_OPCODE(V) \
   FOREACH_LOAD_MEM_OPCODE(V)  \
-  FOREACH_MISC_MEM_OPCODE(V)
+  FOREACH_MISC_MEM_OPCODE(V)  \
+  FOREACH_SIMD_OPCODE(V)      \
+  FOREACH_ATOMIC_OPCODE(V)
 
 // All signatures.
-#define FOREACH_SIGNATURE(V)         \
-  V(i_ii, kAstI32, kAstI32, kAstI32) \
-  V(i_i, kAstI32, kAstI32)           \
-  V(i_v, kAstI32)                    \
-  V(i_ff, kAstI32, kAstF32, kAstF32) \
-  V(i_f, kAstI32, kAstF32)           \
-  V(i_dd, kAstI32, kAstF64, kAstF64) \
-  V(i_d, kAstI32, kAstF64)           \
-  V(i_l, kAstI32, kAstI64)           \
-  V(l_ll, kAstI64, kAstI64, kAstI64) \
-  V(i_ll, kAstI32, kAstI64, kAstI64) \
-  V(l_l, kAstI64, kAstI64)           \
-  V(l_i, kAstI64, kAstI32)           \
-  V(l_f, kAstI64, kAstF32)           \
-  V(l_d, kAstI64, kAstF64)           \
-  V(f_ff, kAstF32, kAstF32, kAstF32) \
-  V(f_f, kAstF32, kAstF32)           \
-  V(f_d, kAstF32, kAstF64)           \
-  V(f_i, kAstF32, kAstI32)           \
-  V(f_l, kAstF32, kAstI64)           \
-  V(d_dd, kAstF64, kAstF64, kAstF64) \
-  V(d_d, kAstF64, kAstF64)           \
-  V(d_f, kAstF64, kAstF32)           \
-  V(d_i, kAstF64, kAstI32)           \
-  V(d_l, kAstF64, kAstI64)           \
-  V(d_id, kAstF64, kAstI32, kAstF64) \
-  V(f_if, kAstF32, kAstI32, kAstF32) \
-  V(l_il, kAstI64, kAstI32, kAstI64)
+#define FOREACH_SIGNATURE(V)                   \
+  V(i_ii, kAstI32, kAstI32, kAstI32)           \
+  V(i_iii, kAstI32, kAstI32, kAstI32, kAstI32) \
+  V(i_i, kAstI32, kAstI32)                     \
+  V(i_v, kAstI32)                              \
+  V(i_ff, kAstI32, kAstF32, kAstF32)           \
+  V(i_f, kAstI32, kAstF32)                     \
+  V(i_dd, kAstI32, kAstF64, kAstF64)           \
+  V(i_d, kAstI32, kAstF64)                     \
+  V(i_l, kAstI32, kAstI64)                     \
+  V(l_ll, kAstI64, kAstI64, kAstI64)           \
+  V(i_ll, kAstI32, kAstI64, kAstI64)           \
+  V(l_l, kAstI64, kAstI64)                     \
+  V(l_i, kAstI64, kAstI32)                     \
+  V(l_f, kAstI64, kAstF32)                     \
+  V(l_d, kAstI64, kAstF64)                     \
+  V(f_ff, kAstF32, kAstF32, kAstF32)           \
+  V(f_f, kAstF32, kAstF32)                     \
+  V(f_d, kAstF32, kAstF64)                     \
+  V(f_i, kAstF32, kAstI32)                     \
+  V(f_l, kAstF32, kAstI64)                     \
+  V(d_dd, kAstF64, kAstF64, kAstF64)           \
+  V(d_d, kAstF64, kAstF64)                     \
+  V(d_f, kAstF64, kAstF32)                     \
+  V(d_i, kAstF64, kAstI32)                     \
+  V(d_l, kAstF64, kAstI64)                     \
+  V(d_id, kAstF64, kAstI32, kAstF64)           \
+  V(f_if, kAstF32, kAstI32, kAstF32)           \
+  V(l_il, kAstI64, kAstI32, kAstI64)           \
+  V(s_ss, kAstS128, kAstS128, kAstS128)        \
+  V(s_s, kAstS128, kAstS128)                   \
+  V(s_i, kAstS128, kAstI32)                    \
+  V(s_f, kAstS128, kAstF32)                    \
+  V(i_s, kAstI32, kAstS128)                    \
+  V(f_s, kAstF32, kAstS128)                    \
+  V(s_si, kAstS128, kAstS128, kAstI32)         \
+  V(s_sf, kAstS128, kAstS128, kAstF32)         \
+  V(s_is, kAstS128, kAstI32, kAstS128)
 
 enum WasmOpcode {
 // Declare expression opcodes.
@@ -297,12 +374,30 @@ enum WasmOpcode {
 #undef DECLARE_NAMED_ENUM
 };
 
+// The reasons for a trap in wasm code.
+enum TrapReason {
+  kTrapUnreachable,
+  kTrapMemOutOfBounds,
+  kTrapDivByZero,
+  kTrapDivUnrepresentable,
+  kTrapRemByZero,
+  kTrapFloatUnrepresentable,
+  kTrapFuncInvalid,
+  kTrapFuncSigMismatch,
+  kTrapUnalignedAtomic,
+  kTrapAtomicWait,
+  kTrapCount
+};
+
 // A collection of opcode-related static methods.
 class WasmOpcodes {
  public:
   static bool IsSupported(WasmOpcode opcode);
+  static bool IsSimdOpcode(WasmOpcode opcode);
+  static bool IsAtomicOpcode(WasmOpcode opcode);
   static const char* OpcodeName(WasmOpcode opcode);
   static FunctionSig* Signature(WasmOpcode opcode);
+  static const char* TrapReasonMessage(TrapReason reason);
 
   static byte MemSize(MachineType type) {
     return 1 << ElementSizeLog2Of(type.representation());
@@ -318,6 +413,8 @@ class WasmOpcodes {
         return kLocalF32;
       case kAstF64:
         return kLocalF64;
+      case kAstS128:
+        return kLocalS128;
       case kAstStmt:
         return kLocalVoid;
       default:
@@ -430,6 +527,11 @@ class WasmOpcodes {
     return MemoryAccess::OffsetField::encode(with_offset);
   }
 
+  static byte AtomicAccessOf(bool with_offset) {
+    return MemoryAccess::OffsetField::encode(with_offset) |
+           MemoryAccess::AtomicityField::encode(MemoryAccess::kSequential);
+  }
+
   static char ShortNameOf(LocalType type) {
     switch (type) {
       case kAstI32:
@@ -440,6 +542,8 @@ class WasmOpcodes {
         return 'f';
       case kAstF64:
         return 'd';
+      case kAstS128:
+        return 's';
       case kAstStmt:
         return 'v';
       case kAstEnd:
@@ -460,6 +564,8 @@ class WasmOpcodes {
         return "f32";
       case kAstF64:
         return "f64";
+      case kAstS128:
+        return "s128";
       case kAstStmt:
         return "<stmt>";
       case kAstEnd:
@@ -0,0 +1,668 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <map>
+
+#include "src/assembler.h"
+#include "src/base/platform/platform.h"
+#include "src/code-stubs.h"
+#include "src/factory.h"
+#include "src/flags.h"
+#include "src/objects.h"
+#include "src/version.h"
+
+#include "src/wasm/decoder.h"
+#include "src/wasm/module-decoder.h"
+#include "src/wasm/wasm-serializer.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+namespace {
+// The serialized format starts with a header of 32-bit words that identify
+// the format, the V8 build and the configuration the code was generated for,
+// followed by the size and checksum of the payload.
+const uint32_t kMagic = 0x43534157;  // "WASC"
+const uint32_t kFormatVersion = 2;
+const int kHeaderSize = 8 * sizeof(uint32_t);
+const int kPayloadSizeOffset = 6 * sizeof(uint32_t);
+const int kChecksumOffset = 7 * sizeof(uint32_t);
+
+// The payload holds the module bytes, followed by a record for each function
+// with its code and, for exported functions, its JS wrapper. Each code object
+// is stored as its instructions and relocation info, plus a reference for
+// each relocation entry that points to a heap object or other code.
+enum FunctionRecordBits : uint8_t { kHasCode = 1, kHasWrapper = 2 };
+
+enum CodeBits : uint8_t { kIsTurbofanned = 1, kIsCrankshafted = 2 };
+
+enum ReferenceKind : uint8_t {
+  kFunctionRef,            // code of a function in the module.
+  kBuiltinRef,             // a builtin, by id.
+  kStubRef,                // a code stub, by key.
+  kRootRef,                // a heap root, by index.
+  kInstanceDataRef,        // the instance data.
+  kFunctionTableRef,       // the function table.
+  kNativeContextRef,       // the native context.
+  kStringRef,              // a string, by contents.
+  kInternalizedStringRef,  // an internalized string, by contents.
+  kNumberRef               // a heap number, by value.
+};
+
+// Relocation modes that are serialized as references.
+const int kReferenceMask = RelocInfo::kCodeTargetMask |
+                           RelocInfo::ModeMask(RelocInfo::EMBEDDED_OBJECT);
+
+// Relocation modes that the format cannot express.
+const int kUnsupportedMask =
+    RelocInfo::ModeMask(RelocInfo::EXTERNAL_REFERENCE) |
+    RelocInfo::ModeMask(RelocInfo::RUNTIME_ENTRY) |
+    RelocInfo::ModeMask(RelocInfo::CELL);
+
+// Adler-32 of the bytes between {start} and {end}.
+uint32_t Checksum(const byte* start, const byte* end) {
+  static const uint32_t kModulus = 65521;
+  // The largest number of bytes that can be summed without overflow.
+  static const size_t kBlockSize = 5552;
+  uint32_t a = 1;
+  uint32_t b = 0;
+  while (start < end) {
+    const byte* block_end =
+        start + std::min(kBlockSize, static_cast<size_t>(end - start));
+    for (; start < block_end; start++) {
+      a += *start;
+      b += a;
+    }
+    a %= kModulus;
+    b %= kModulus;
+  }
+  return (b << 16) | a;
+}
+
+// A helper to write little endian integers and raw bytes to a buffer.
+class Writer {
+ public:
+  explicit Writer(std::vector<byte>* buffer) : buffer_(buffer) {}
+
+  void u8(uint8_t val) { buffer_->push_back(val); }
+
+  void u32(uint32_t val) {
+    for (int i = 0; i < 4; i++) u8(static_cast<uint8_t>(val >> (8 * i)));
+  }
+
+  void u64(uint64_t val) {
+    u32(static_cast<uint32_t>(val));
+    u32(static_cast<uint32_t>(val >> 32));
+  }
+
+  void bytes(const byte* start, size_t size) {
+    buffer_->insert(buffer_->end(), start, start + size);
+  }
+
+  void patch_u32(size_t offset, uint32_t val) {
+    for (int i = 0; i < 4; i++) {
+      buffer_->at(offset + i) = static_cast<uint8_t>(val >> (8 * i));
+    }
+  }
+
+ private:
+  std::vector<byte>* buffer_;
+};
+
+// Serializes the code of an instance. Works on raw pointers, so no
+// allocation may happen while it is in use.
+class ModuleSerializer {
+ public:
+  ModuleSerializer(Isolate* isolate, WasmModule* module,
+                   Handle<JSObject> instance, std::vector<byte>* buffer)
+      : isolate_(isolate),
+        module_(module),
+        code_table_(
+            FixedArray::cast(instance->GetInternalField(kWasmModuleCodeTable))),
+        wrapper_table_(FixedArray::cast(
+            instance->GetInternalField(kWasmExportWrapperTable))),
+        instance_data_(instance->GetInternalField(kWasmInstanceData)),
+        function_table_(instance->GetInternalField(kWasmModuleFunctionTable)),
+        buffer_(buffer),
+        writer_(buffer) {
+    for (int i = 0; i < code_table_->length(); i++) {
+      functions_[code_table_->get(i)] = i;
+    }
+    Builtins* builtins = isolate->builtins();
+    for (int i = 0; i < Builtins::builtin_count; i++) {
+      builtins_[builtins->builtin(static_cast<Builtins::Name>(i))] = i;
+    }
+    Heap* heap = isolate->heap();
+    for (int i = 0; i < Heap::kStrongRootListLength; i++) {
+      Object* root = heap->root(static_cast<Heap::RootListIndex>(i));
+      // Keep the first index for roots that appear more than once.
+      if (root->IsHeapObject() && roots_.count(root) == 0) roots_[root] = i;
+    }
+  }
+
+  bool Serialize() {
+    writer_.u32(kMagic);
+    writer_.u32(kFormatVersion);
+    writer_.u32(static_cast<uint32_t>(Version::Hash()));
+    writer_.u32(FlagList::Hash());
+    writer_.u32(CpuFeatures::SupportedFeatures());
+    writer_.u32(kPointerSize);
+    writer_.u32(0);  // payload size, patched below.
+    writer_.u32(0);  // checksum, patched below.
+
+    size_t module_size = module_->module_end - module_->module_start;
+    writer_.u32(static_cast<uint32_t>(module_size));
+    writer_.bytes(module_->module_start, module_size);
+
+    writer_.u32(static_cast<uint32_t>(module_->functions->size()));
+    int index = 0;
+    for (const WasmFunction& func : *module_->functions) {
+      uint8_t bits = (func.external ? 0 : kHasCode) |
+                     (func.exported ? kHasWrapper : 0);
+      writer_.u8(bits);
+      if (!func.external && !SerializeCode(code_table_->get(index))) {
+        return false;
+      }
+      if (func.exported && !SerializeCode(wrapper_table_->get(index))) {
+        return false;
+      }
+      index++;
+    }
+
+    const byte* payload = &buffer_->at(0) + kHeaderSize;
+    const byte* end = &buffer_->at(0) + buffer_->size();
+    writer_.patch_u32(kPayloadSizeOffset,
+                      static_cast<uint32_t>(end - payload));
+    writer_.patch_u32(kChecksumOffset, Checksum(payload, end));
+    return true;
+  }
+
+ private:
+  Isolate* isolate_;
+  WasmModule* module_;
+  FixedArray* code_table_;
+  FixedArray* wrapper_table_;
+  Object* instance_data_;
+  Object* function_table_;
+  std::vector<byte>* buffer_;
+  Writer writer_;
+  std::map<Object*, int> functions_;
+  std::map<Object*, int> builtins_;
+  std::map<Object*, int> roots_;
+  DisallowHeapAllocation no_allocation_;
+
+  bool SerializeCode(Object* object) {
+    Code* code = Code::cast(object);
+    if (!RelocIterator(code, kUnsupportedMask).done()) return false;
+
+    ByteArray* reloc_info = code->relocation_info();
+    uint8_t bits = (code->is_turbofanned() ? kIsTurbofanned : 0) |
+                   (code->is_crankshafted() ? kIsCrankshafted : 0);
+    bool has_safepoints = code->is_turbofanned() || code->is_crankshafted();
+    writer_.u32(static_cast<uint32_t>(code->flags()));
+    writer_.u32(static_cast<uint32_t>(code->instruction_size()));
+    writer_.u32(static_cast<uint32_t>(reloc_info->length()));
+    writer_.u32(has_safepoints ? code->stack_slots() : 0);
+    writer_.u32(has_safepoints ? code->safepoint_table_offset() : 0);
+    writer_.u32(static_cast<uint32_t>(code->constant_pool_offset()));
+    writer_.u8(bits);
+    writer_.u64(reinterpret_cast<uintptr_t>(code->instruction_start()));
+    writer_.bytes(code->instruction_start(), code->instruction_size());
+    writer_.bytes(reloc_info->GetDataStartAddress(), reloc_info->length());
+
+    uint32_t count = 0;
+    for (RelocIterator it(code, kReferenceMask); !it.done(); it.next()) {
+      count++;
+    }
+    writer_.u32(count);
+    for (RelocIterator it(code, kReferenceMask); !it.done(); it.next()) {
+      if (!SerializeReference(it.rinfo())) return false;
+    }
+    return true;
+  }
+
+  bool SerializeReference(RelocInfo* rinfo) {
+    if (RelocInfo::IsCodeTarget(rinfo->rmode())) {
+      Code* target = Code::GetCodeFromTargetAddress(rinfo->target_address());
+      return WriteIndexed(kFunctionRef, functions_, target) ||
+             WriteIndexed(kBuiltinRef, builtins_, target) ||
+             WriteStub(target);
+    }
+    Object* target = rinfo->target_object();
+    if (target == instance_data_) {
+      writer_.u8(kInstanceDataRef);
+      return true;
+    }
+    if (target == function_table_) {
+      writer_.u8(kFunctionTableRef);
+      return true;
+    }
+    if (target == *isolate_->native_context()) {
+      writer_.u8(kNativeContextRef);
+      return true;
+    }
+    if (WriteIndexed(kFunctionRef, functions_, target) ||
+        WriteIndexed(kRootRef, roots_, target)) {
+      return true;
+    }
+    if (target->IsString()) {
+      int length = 0;
+      base::SmartArrayPointer<char> chars = String::cast(target)->ToCString(
+          ALLOW_NULLS, ROBUST_STRING_TRAVERSAL, &length);
+      writer_.u8(target->IsInternalizedString() ? kInternalizedStringRef
+                                                : kStringRef);
+      writer_.u32(static_cast<uint32_t>(length));
+      writer_.bytes(reinterpret_cast<const byte*>(chars.get()), length);
+      return true;
+    }
+    if (target->IsHeapNumber()) {
+      writer_.u8(kNumberRef);
+      writer_.u64(bit_cast<uint64_t>(HeapNumber::cast(target)->value()));
+      return true;
+    }
+    return false;
+  }
+
+  bool WriteIndexed(ReferenceKind kind, const std::map<Object*, int>& map,
+                    Object* target) {
+    auto entry = map.find(target);
+    if (entry == map.end()) return false;
+    writer_.u8(kind);
+    writer_.u32(static_cast<uint32_t>(entry->second));
+    return true;
+  }
+
+  bool WriteStub(Code* target) {
+    if (target->kind() != Code::STUB) return false;
+    writer_.u8(kStubRef);
+    writer_.u32(target->stub_key());
+    return true;
+  }
+};
+
+// Deserializes a module and creates a template instance for it.
+class ModuleDeserializer : public Decoder {
+ public:
+  ModuleDeserializer(Isolate* isolate, Zone* zone, const byte* start,
+                     const byte* end)
+      : Decoder(start, end), isolate_(isolate), zone_(zone) {}
+
+  MaybeHandle<JSObject> Deserialize(ErrorThrower& thrower,
+                                    WasmModule** module_out) {
+    if (!CheckHeader(thrower)) return MaybeHandle<JSObject>();
+
+    Factory* factory = isolate_->factory();
+    uint32_t module_size = u32("module size");
+    const byte* module_start = bytes(module_size);
+    if (failed()) return Fail(thrower);
+    ModuleResult result = DecodeWasmModule(isolate_, zone_, module_start,
+                                           module_start + module_size, false,
+                                           false);
+    if (result.failed()) {
+      thrower.Failed("", result);
+      if (result.val) delete result.val;
+      return MaybeHandle<JSObject>();
+    }
+    WasmModule* module = result.val;
+    *module_out = module;
+
+    int size = static_cast<int>(module->functions->size());
+    if (u32("function count") != static_cast<uint32_t>(size)) {
+      error("function count does not match the module");
+    }
+    Handle<FixedArray> code_table = factory->NewFixedArray(size, TENURED);
+    Handle<FixedArray> wrapper_table = factory->NewFixedArray(size, TENURED);
+    for (int i = 0; i < size && ok(); i++) {
+      uint8_t bits = u8("function record");
+      Handle<Code> code = (bits & kHasCode) ? ReadCode() : NewPlaceholder();
+      if (!code.is_null()) code_table->set(i, *code);
+      if (bits & kHasWrapper) {
+        Handle<Code> wrapper = ReadCode();
+        if (!wrapper.is_null()) wrapper_table->set(i, *wrapper);
+      }
+    }
+    if (ok() && pc_ != limit_) error("unexpected bytes after the functions");
+    if (failed()) return Fail(thrower);
+
+    // Stand-ins for the per-instance objects that {Reinstantiate} redirects
+    // the code to.
+    instance_data_ =
+        factory->NewByteArray(ModuleEnv::kInstanceDataSize, TENURED);
+    if (module->function_table && module->function_table->size() > 0) {
+      function_table_ = factory->NewFixedArray(
+          static_cast<int>(ModuleEnv::kFunctionTableEntrySize *
+                           module->function_table->size()),
+          TENURED);
+    }
+    ResolveReferences(code_table);
+    if (failed()) return Fail(thrower);
+
+    {
+      DisallowHeapAllocation no_allocation;
+      for (const PendingCode& pending : pending_) Relocate(pending);
+    }
+
+    Handle<JSObject> instance = WasmModule::NewModuleObject(isolate_);
+    instance->SetInternalField(kWasmModuleCodeTable, *code_table);
+    instance->SetInternalField(kWasmExportWrapperTable, *wrapper_table);
+    instance->SetInternalField(kWasmInstanceData, *instance_data_);
+    if (function_table_.is_null()) {
+      instance->SetInternalField(kWasmModuleFunctionTable, Smi::FromInt(0));
+    } else {
+      instance->SetInternalField(kWasmModuleFunctionTable, *function_table_);
+    }
+    instance->SetInternalField(kWasmMemArrayBuffer, Smi::FromInt(0));
+    instance->SetInternalField(kWasmGlobalsArrayBuffer, Smi::FromInt(0));
+    instance->SetInternalField(kWasmLazyCompilationState, Smi::FromInt(0));
+    instance->SetInternalField(kWasmBoundsCheckMode,
+                               Smi::FromInt(kExplicitBoundsChecks));
+    module->SetModuleOf(*instance);
+    return instance;
+  }
+
+ private:
+  struct Reference {
+    ReferenceKind kind;
+    uint32_t value;
+    Handle<Object> object;
+  };
+
+  // A code object whose references have not been patched yet.
+  struct PendingCode {
+    Handle<Code> code;
+    uintptr_t old_start;
+    std::vector<Reference> references;
+  };
+
+  Isolate* isolate_;
+  Zone* zone_;
+  Handle<ByteArray> instance_data_;
+  Handle<FixedArray> function_table_;
+  std::vector<PendingCode> pending_;
+
+  MaybeHandle<JSObject> Fail(ErrorThrower& thrower) {
+    thrower.Error("Invalid serialized module: %s", error_msg_.get());
+    return MaybeHandle<JSObject>();
+  }
+
+  bool CheckHeader(ErrorThrower& thrower) {
+    if (limit_ - start_ < kHeaderSize) {
+      thrower.Error("Invalid serialized module: too short");
+      return false;
+    }
+    if (u32("magic") != kMagic || u32("version") != kFormatVersion) {
+      thrower.Error("Invalid serialized module: unknown format");
+      return false;
+    }
+    if (u32("v8 version") != static_cast<uint32_t>(Version::Hash()) ||
+        u32("flags") != FlagList::Hash() ||
+        u32("cpu features") != CpuFeatures::SupportedFeatures() ||
+        u32("pointer size") != static_cast<uint32_t>(kPointerSize)) {
+      thrower.Error("Serialized module was produced by another configuration");
+      return false;
+    }
+    uint32_t payload_size = u32("payload size");
+    uint32_t checksum = u32("checksum");
+    if (payload_size != static_cast<uint32_t>(limit_ - pc_) ||
+        checksum != Checksum(pc_, limit_)) {
+      thrower.Error("Invalid serialized module: checksum mismatch");
+      return false;
+    }
+    return true;
+  }
+
+  // Reads {size} raw bytes and advances {pc_}.
+  const byte* bytes(uint32_t size) {
+    const byte* start = pc_;
+    if (static_cast<size_t>(limit_ - pc_) < size) {
+      error("expected more bytes, fell off end");
+      pc_ = limit_;
+      return nullptr;
+    }
+    pc_ += size;
+    return start;
+  }
+
+  Handle<Code> NewPlaceholder() {
+    // External functions are compiled for each instance by {Reinstantiate},
+    // which redirects calls from this placeholder to the real wrapper.
+    byte buffer[] = {0, 0, 0, 0, 0, 0, 0, 0};  // fake instructions.
+    CodeDesc desc = {buffer, 8, 8, 0, 0, nullptr};
+    return isolate_->factory()->NewCode(
+        desc, Code::KindField::encode(Code::WASM_FUNCTION),
+        Handle<Object>::null());
+  }
+
+  Handle<Code> ReadCode() {
+    uint32_t flags = u32("code flags");
+    uint32_t instruction_size = u32("instruction size");
+    uint32_t reloc_size = u32("reloc size");
+    uint32_t stack_slots = u32("stack slots");
+    uint32_t safepoint_table_offset = u32("safepoint table offset");
+    uint32_t constant_pool_offset = u32("constant pool offset");
+    uint8_t bits = u8("code bits");
+    uint64_t old_start = u32("start low");
+    old_start |= static_cast<uint64_t>(u32("start high")) << 32;
+    const byte* instructions = bytes(instruction_size);
+    const byte* reloc = bytes(reloc_size);
+
+    PendingCode pending;
+    pending.old_start = static_cast<uintptr_t>(old_start);
+    uint32_t count = u32("reference count");
+    for (uint32_t i = 0; i < count && ok(); i++) {
+      pending.references.push_back(ReadReference());
+    }
+    if (failed()) return Handle<Code>::null();
+
+    Factory* factory = isolate_->factory();
+    int size = static_cast<int>(instruction_size);
+    CodeDesc desc = {const_cast<byte*>(instructions), size, size, 0, 0,
+                     nullptr};
+    Handle<Code> code = factory->NewCode(
+        desc, static_cast<Code::Flags>(flags), Handle<Object>::null(), false,
+        (bits & kIsCrankshafted) != 0);
+    Handle<ByteArray> reloc_info =
+        factory->NewByteArray(static_cast<int>(reloc_size), TENURED);
+    memcpy(reloc_info->GetDataStartAddress(), reloc, reloc_size);
+    code->set_relocation_info(*reloc_info);
+    if (bits & kIsTurbofanned) code->set_is_turbofanned(true);
+    if (bits & (kIsTurbofanned | kIsCrankshafted)) {
+      code->set_stack_slots(stack_slots);
+      code->set_safepoint_table_offset(safepoint_table_offset);
+    }
+    code->set_constant_pool_offset(static_cast<int>(constant_pool_offset));
+
+    uint32_t reloc_count = 0;
+    for (RelocIterator it(*code, kReferenceMask); !it.done(); it.next()) {
+      reloc_count++;
+    }
+    if (reloc_count != count) {
+      error("reference count does not match the relocation info");
+      return Handle<Code>::null();
+    }
+    pending.code = code;
+    pending_.push_back(pending);
+    return code;
+  }
+
+  Reference ReadReference() {
+    Reference ref = {static_cast<ReferenceKind>(u8("reference kind")), 0,
+                     Handle<Object>::null()};
+    switch (ref.kind) {
+      case kFunctionRef:
+      case kBuiltinRef:
+      case kStubRef:
+      case kRootRef:
+        ref.value = u32("reference index");
+        break;
+      case kInstanceDataRef:
+      case kFunctionTableRef:
+      case kNativeContextRef:
+        break;
+      case kStringRef:
+      case kInternalizedStringRef: {
+        uint32_t length = u32("string length");
+        const char* chars = reinterpret_cast<const char*>(bytes(length));
+        if (failed()) break;
+        Vector<const char> str(chars, static_cast<int>(length));
+        Factory* factory = isolate_->factory();
+        ref.object = ref.kind == kInternalizedStringRef
+                         ? Handle<Object>(factory->InternalizeUtf8String(str))
+                         : Handle<Object>(factory->NewStringFromUtf8(
+                               str, TENURED).ToHandleChecked());
+        break;
+      }
+      case kNumberRef: {
+        uint64_t bits = u32("number low");
+        bits |= static_cast<uint64_t>(u32("number high")) << 32;
+        ref.object = isolate_->factory()->NewHeapNumber(
+            bit_cast<double>(bits), IMMUTABLE, TENURED);
+        break;
+      }
+      default:
+        error("unknown reference kind");
+        break;
+    }
+    return ref;
+  }
+
+  // Resolves the references that need the complete code table or that refer
+  // to the stand-in instance objects.
+  void ResolveReferences(Handle<FixedArray> code_table) {
+    for (PendingCode& pending : pending_) {
+      for (Reference& ref : pending.references) {
+        ref.object = Resolve(ref, code_table);
+        if (ref.object.is_null()) {
+          error("unresolved reference");
+          return;
+        }
+      }
+    }
+  }
+
+  Handle<Object> Resolve(const Reference& ref,
+                         Handle<FixedArray> code_table) {
+    switch (ref.kind) {
+      case kFunctionRef:
+        if (ref.value >= static_cast<uint32_t>(code_table->length())) break;
+        return handle(code_table->get(ref.value), isolate_);
+      case kBuiltinRef:
+        if (ref.value >= static_cast<uint32_t>(Builtins::builtin_count)) break;
+        return handle(isolate_->builtins()->builtin(
+                          static_cast<Builtins::Name>(ref.value)),
+                      isolate_);
+      case kStubRef: {
+        Handle<Code> stub;
+        if (!CodeStub::GetCode(isolate_, ref.value).ToHandle(&stub)) break;
+        return stub;
+      }
+      case kRootRef:
+        if (ref.value >= static_cast<uint32_t>(Heap::kStrongRootListLength)) {
+          break;
+        }
+        return handle(isolate_->heap()->root(
+                          static_cast<Heap::RootListIndex>(ref.value)),
+                      isolate_);
+      case kInstanceDataRef:
+        return instance_data_;
+      case kFunctionTableRef:
+        return function_table_;
+      case kNativeContextRef:
+        return isolate_->native_context();
+      default:
+        return ref.object;
+    }
+    return Handle<Object>::null();
+  }
+
+  void Relocate(const PendingCode& pending) {
+    Code* code = *pending.code;
+    intptr_t delta = reinterpret_cast<intptr_t>(code->instruction_start()) -
+                     static_cast<intptr_t>(pending.old_start);
+    for (RelocIterator it(code, RelocInfo::kApplyMask); !it.done();
+         it.next()) {
+      it.rinfo()->apply(delta);
+    }
+    size_t index = 0;
+    for (RelocIterator it(code, kReferenceMask); !it.done(); it.next()) {
+      Object* target = *pending.references[index++].object;
+      if (RelocInfo::IsCodeTarget(it.rinfo()->rmode())) {
+        it.rinfo()->set_target_address(Code::cast(target)->instruction_start(),
+                                       UPDATE_WRITE_BARRIER,
+                                       SKIP_ICACHE_FLUSH);
+      } else {
+        it.rinfo()->set_target_object(target, UPDATE_WRITE_BARRIER,
+                                      SKIP_ICACHE_FLUSH);
+      }
+    }
+    Assembler::FlushICache(isolate_, code->instruction_start(),
+                           code->instruction_size());
+  }
+};
+}  // namespace
+
+bool SerializeWasmModule(Isolate* isolate, WasmModule* module,
+                         Handle<JSObject> instance, std::vector<byte>* buffer) {
+  buffer->clear();
+  // Code without bounds checks is only safe with memory in a guard region,
+  // which the format does not record.
+  if (instance->GetInternalField(kWasmBoundsCheckMode) ==
+      Smi::FromInt(kGuardRegionBoundsChecks)) {
+    return false;
+  }
+  ModuleSerializer serializer(isolate, module, instance, buffer);
+  if (serializer.Serialize()) return true;
+  buffer->clear();
+  return false;
+}
+
+MaybeHandle<JSObject> DeserializeWasmModule(Isolate* isolate,
+                                            ErrorThrower& thrower, Zone* zone,
+                                            const byte* start, const byte* end,
+                                            WasmModule** module) {
+  *module = nullptr;
+  ModuleDeserializer deserializer(isolate, zone, start, end);
+  return deserializer.Deserialize(thrower, module);
+}
+
+bool WriteWasmModuleFile(const char* path, const std::vector<byte>& buffer) {
+  FILE* file = base::OS::FOpen(path, "wb");
+  if (file == nullptr) return false;
+  size_t written = fwrite(&buffer[0], 1, buffer.size(), file);
+  fclose(file);
+  return written == buffer.size();
+}
+
+MaybeHandle<JSObject> InstantiateWasmModuleFile(Isolate* isolate,
+                                                ErrorThrower& thrower,
+                                                const char* path,
+                                                Handle<JSObject> ffi,
+                                                Handle<JSArrayBuffer> memory) {
+  base::OS::MemoryMappedFile* file = base::OS::MemoryMappedFile::open(path);
+  if (file == nullptr) {
+    thrower.Error("Could not open serialized module %s", path);
+    return MaybeHandle<JSObject>();
+  }
+  const byte* start = reinterpret_cast<const byte*>(file->memory());
+  const byte* end = start + file->size();
+
+  // The module and the template only live until the new instance is set up,
+  // which copies everything it needs out of the mapped file.
+  Zone zone;
+  WasmModule* module = nullptr;
+  Handle<JSObject> templ;
+  MaybeHandle<JSObject> instance;
+  if (DeserializeWasmModule(isolate, thrower, &zone, start, end, &module)
+          .ToHandle(&templ)) {
+    instance = module->Reinstantiate(isolate, templ, ffi, memory);
+  }
+  if (module) delete module;
+  delete file;
+  return instance;
+}
+}
+}
+}
@@ -0,0 +1,50 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8_WASM_SERIALIZER_H_
+#define V8_WASM_SERIALIZER_H_
+
+#include <vector>
+
+#include "src/handles.h"
+
+#include "src/wasm/wasm-module.h"
+#include "src/wasm/wasm-result.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+// Serializes the compiled code of {instance}, an instantiation of {module}
+// in the given isolate, together with the module bytes into {buffer}. The
+// format is versioned and checksummed. Returns {false} if the code refers to
+// objects that cannot be expressed in the format; such modules have to be
+// compiled from the module bytes instead.
+bool SerializeWasmModule(Isolate* isolate, WasmModule* module,
+                         Handle<JSObject> instance, std::vector<byte>* buffer);
+
+// Deserializes a module serialized with {SerializeWasmModule}. Decodes the
+// module into {zone} and returns it in {module}, along with a template that
+// can be instantiated with {WasmModule::Reinstantiate}. Both refer to the
+// serialized bytes, which must outlive them.
+MaybeHandle<JSObject> DeserializeWasmModule(Isolate* isolate,
+                                            ErrorThrower& thrower, Zone* zone,
+                                            const byte* start, const byte* end,
+                                            WasmModule** module);
+
+// Writes the serialized module in {buffer} to the file at {path}.
+bool WriteWasmModuleFile(const char* path, const std::vector<byte>& buffer);
+
+// Memory-maps the serialized module at {path} and instantiates it by
+// relocating the serialized code rather than compiling the module.
+MaybeHandle<JSObject> InstantiateWasmModuleFile(Isolate* isolate,
+                                                ErrorThrower& thrower,
+                                                const char* path,
+                                                Handle<JSObject> ffi,
+                                                Handle<JSArrayBuffer> memory);
+}
+}
+}
+
+#endif  // V8_WASM_SERIALIZER_H_
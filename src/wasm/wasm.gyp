@@ -22,18 +22,28 @@
           'encoder.h',
 	  'module-decoder.cc',
 	  'module-decoder.h',
+          'wasm-code-cache.cc',
+          'wasm-code-cache.h',
           'wasm-compiler.h',
           'wasm-compiler.cc',
+          'wasm-interpreter.cc',
+          'wasm-interpreter.h',
           'wasm-js.cc',
           'wasm-js.h',
           'wasm-linkage.cc',
           'wasm-macro-gen.h',
+          'wasm-memory.cc',
+          'wasm-memory.h',
+          'wasm-module-bytes.cc',
+          'wasm-module-bytes.h',
           'wasm-module.cc',
           'wasm-module.h',
           'wasm-opcodes.cc',
           'wasm-opcodes.h',
           'wasm-result.cc',
           'wasm-result.h',
+          'wasm-serializer.cc',
+          'wasm-serializer.h',
         ],
       },
     },
@@ -5,10 +5,18 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <string>
+#include <vector>
+
+#include "src/execution.h"
 #include "src/wasm/encoder.h"
+#include "src/wasm/module-decoder.h"
 #include "src/wasm/wasm-macro-gen.h"
+#include "src/wasm/wasm-memory.h"
+#include "src/wasm/wasm-module-bytes.h"
 #include "src/wasm/wasm-module.h"
 #include "src/wasm/wasm-opcodes.h"
+#include "src/wasm/wasm-serializer.h"
 
 #include "test/cctest/cctest.h"
 
@@ -25,6 +33,19 @@ void TestModule(WasmModuleIndex* module, int32_t expected_result) {
       CompileAndRunWasmModule(isolate, module->Begin(), module->End());
   CHECK_EQ(expected_result, result);
 }
+
+
+int32_t CallExport(Isolate* isolate, Handle<JSObject> instance,
+                   const char* name) {
+  Handle<String> str = isolate->factory()->InternalizeUtf8String(name);
+  Handle<Object> function =
+      Object::GetProperty(instance, str).ToHandleChecked();
+  Handle<Object> undefined = isolate->factory()->undefined_value();
+  Handle<Object> result =
+      Execution::Call(isolate, function, undefined, 0, nullptr)
+          .ToHandleChecked();
+  return static_cast<int32_t>(result->Number());
+}
 }  // namespace
 
 
@@ -118,6 +139,67 @@ TEST(Run_WasmModule_ReadLoadedDataSegment) {
 }
 
 
+TEST(Run_WasmModule_MappedDataSegments) {
+  static const uint32_t kDest = 4096;
+  static const uint32_t kSize = 3 * 4096;
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {WASM_LOAD_MEM(MachineType::Int32(), WASM_I32(kDest + 4))};
+  f->EmitCode(code, sizeof(code));
+  byte data[kSize];
+  for (uint32_t i = 0; i < kSize; i++) data[i] = static_cast<byte>(i * 7);
+  builder->AddDataSegment(
+      new(&zone) WasmDataSegmentEncoder(&zone, data, kSize, kDest));
+  // A later segment overwrites part of the first one.
+  byte patch[] = {0xaa, 0xbb, 0xcc, 0xdd};
+  builder->AddDataSegment(
+      new(&zone) WasmDataSegmentEncoder(&zone, patch, sizeof(patch),
+                                        kDest + 4));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+  Handle<JSObject> first =
+      result.val->Instantiate(isolate, ffi, memory).ToHandleChecked();
+  Handle<JSObject> second =
+      result.val->Instantiate(isolate, ffi, memory).ToHandleChecked();
+  byte* first_memory = reinterpret_cast<byte*>(
+      JSArrayBuffer::cast(first->GetInternalField(kWasmMemArrayBuffer))
+          ->backing_store());
+  byte* second_memory = reinterpret_cast<byte*>(
+      JSArrayBuffer::cast(second->GetInternalField(kWasmMemArrayBuffer))
+          ->backing_store());
+  CHECK_EQ(static_cast<int32_t>(0xddccbbaa),
+           CallExport(isolate, first, "main"));
+  for (uint32_t i = 0; i < kSize; i++) {
+    byte expected = i >= 4 && i < 8 ? patch[i - 4] : data[i];
+    CHECK_EQ(expected, first_memory[kDest + i]);
+    CHECK_EQ(expected, second_memory[kDest + i]);
+  }
+  CHECK_EQ(0, first_memory[kDest - 1]);
+  CHECK_EQ(0, first_memory[kDest + kSize]);
+
+  // Writes to one instance are private to it.
+  first_memory[kDest + 4] = 0x11;
+  CHECK_EQ(static_cast<int32_t>(0xddccbb11),
+           CallExport(isolate, first, "main"));
+  CHECK_EQ(static_cast<int32_t>(0xddccbbaa),
+           CallExport(isolate, second, "main"));
+  delete result.val;
+}
+
+
 TEST(Run_WasmModule_CheckMemoryIsZero) {
   static const int kCheckSize = 16 * 1024;
   Zone zone;
@@ -193,3 +275,1156 @@ TEST(Run_WasmModule_Global) {
   WasmModuleWriter* writer = builder->Build(&zone);
   TestModule(writer->WriteTo(&zone), 97);
 }
+
+
+TEST(Run_WasmModule_CallChain) {
+  // Enough functions to spread over several background compilation tasks.
+  static const int kChainLength = 100;
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  for (int i = 0; i < kChainLength; i++) {
+    uint16_t f_index = builder->AddFunction();
+    WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+    f->ReturnType(kAstI32);
+    if (i == kChainLength - 1) {
+      byte code[] = {WASM_I8(0)};
+      f->EmitCode(code, sizeof(code));
+    } else {
+      byte code[] = {
+          WASM_I32_ADD(WASM_CALL_FUNCTION0(f_index + 1), WASM_I8(1))};
+      f->EmitCode(code, sizeof(code));
+    }
+  }
+  uint16_t f_index = builder->AddFunction();
+  WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {WASM_CALL_FUNCTION0(0)};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleWriter* writer = builder->Build(&zone);
+  TestModule(writer->WriteTo(&zone), kChainLength - 1);
+}
+
+
+TEST(Run_WasmModule_InlinedCalls) {
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  // A small callee that returns from two places.
+  uint16_t f1_index = builder->AddFunction();
+  WasmFunctionBuilder* f = builder->FunctionAt(f1_index);
+  f->ReturnType(kAstI32);
+  uint16_t param = f->AddParam(kAstI32);
+  byte code1[] = {
+      WASM_IF(WASM_I32_LTS(WASM_GET_LOCAL(param), WASM_ZERO),
+              WASM_RETURN(WASM_I32_SUB(WASM_ZERO, WASM_GET_LOCAL(param)))),
+      WASM_GET_LOCAL(param)};
+  f->EmitCode(code1, sizeof(code1));
+  uint16_t f2_index = builder->AddFunction();
+  f = builder->FunctionAt(f2_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code2[] = {WASM_I32_ADD(WASM_CALL_FUNCTION(f1_index, WASM_I8(-77)),
+                               WASM_CALL_FUNCTION(f1_index, WASM_I8(22)))};
+  f->EmitCode(code2, sizeof(code2));
+  WasmModuleWriter* writer = builder->Build(&zone);
+  TestModule(writer->WriteTo(&zone), 99);
+}
+
+
+TEST(Run_WasmModule_SharedWrappers) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  // The exported functions share one signature, and so their wrapper.
+  static const char* names[] = {"a", "b", "c"};
+  for (int i = 0; i < 3; i++) {
+    uint16_t f_index = builder->AddFunction(
+        reinterpret_cast<const unsigned char*>(names[i]), 1);
+    WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+    f->ReturnType(kAstI32);
+    f->Exported(1);
+    byte code[] = {WASM_I8(11 * (i + 1))};
+    f->EmitCode(code, sizeof(code));
+  }
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+  Handle<JSObject> instance =
+      result.val->Instantiate(isolate, ffi, memory).ToHandleChecked();
+  CHECK_EQ(11, CallExport(isolate, instance, "a"));
+  CHECK_EQ(22, CallExport(isolate, instance, "b"));
+  CHECK_EQ(33, CallExport(isolate, instance, "c"));
+  delete result.val;
+}
+
+TEST(Run_WasmModule_Reinstantiate) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint32_t global = builder->AddGlobal(MachineType::Int32(), 0);
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {
+      WASM_STORE_MEM(MachineType::Int32(), WASM_ZERO,
+                     WASM_I32_ADD(WASM_LOAD_MEM(MachineType::Int32(),
+                                                WASM_ZERO),
+                                  WASM_I8(1))),
+      WASM_STORE_GLOBAL(global, WASM_I32_ADD(WASM_LOAD_GLOBAL(global),
+                                             WASM_I8(10))),
+      WASM_RETURN(WASM_I32_ADD(WASM_LOAD_MEM(MachineType::Int32(), WASM_ZERO),
+                               WASM_LOAD_GLOBAL(global)))};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+
+  // Each instance has its own memory and globals, but shares the code.
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+  Handle<JSObject> first =
+      result.val->Instantiate(isolate, ffi, memory).ToHandleChecked();
+  Handle<JSObject> second = result.val->Reinstantiate(isolate, first, ffi,
+                                                      memory)
+                                .ToHandleChecked();
+  CHECK_EQ(11, CallExport(isolate, first, "main"));
+  CHECK_EQ(22, CallExport(isolate, first, "main"));
+  CHECK_EQ(11, CallExport(isolate, second, "main"));
+  CHECK_EQ(33, CallExport(isolate, first, "main"));
+
+  // An instance of another module with as many functions does not fit.
+  WasmModuleBuilder* other_builder = new(&zone) WasmModuleBuilder(&zone);
+  uint16_t other_index =
+      other_builder->AddFunction(reinterpret_cast<const unsigned char*>("main"),
+                                 4);
+  WasmFunctionBuilder* other_f = other_builder->FunctionAt(other_index);
+  other_f->ReturnType(kAstI32);
+  other_f->Exported(1);
+  byte other_code[] = {WASM_I8(7)};
+  other_f->EmitCode(other_code, sizeof(other_code));
+  WasmModuleIndex* other = other_builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult other_result = DecodeWasmModule(
+      isolate, &zone, other->Begin(), other->End(), false, false);
+  CHECK(other_result.ok());
+  Handle<JSObject> foreign =
+      other_result.val->Instantiate(isolate, ffi, memory).ToHandleChecked();
+  CHECK(result.val->Reinstantiate(isolate, foreign, ffi, memory).is_null());
+  CHECK(isolate->has_scheduled_exception());
+  isolate->clear_scheduled_exception();
+  CHECK_EQ(7, CallExport(isolate, foreign, "main"));
+  delete other_result.val;
+  delete result.val;
+}
+
+
+TEST(Run_WasmModule_ExportKeepsInstanceAlive) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint32_t global = builder->AddGlobal(MachineType::Int32(), 0);
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {
+      WASM_STORE_MEM(MachineType::Int32(), WASM_ZERO,
+                     WASM_I32_ADD(WASM_LOAD_MEM(MachineType::Int32(),
+                                                WASM_ZERO),
+                                  WASM_I8(1))),
+      WASM_STORE_GLOBAL(global, WASM_I32_ADD(WASM_LOAD_GLOBAL(global),
+                                             WASM_I8(10))),
+      WASM_RETURN(WASM_I32_ADD(WASM_LOAD_MEM(MachineType::Int32(), WASM_ZERO),
+                               WASM_LOAD_GLOBAL(global)))};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+
+  // Only the exported function survives the scope of the instance.
+  Handle<Object> function;
+  {
+    HandleScope instance_scope(isolate);
+    Handle<JSObject> ffi = Handle<JSObject>::null();
+    Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+    Handle<JSObject> instance =
+        result.val->Instantiate(isolate, ffi, memory).ToHandleChecked();
+    Handle<String> name = isolate->factory()->InternalizeUtf8String("main");
+    function = instance_scope.CloseAndEscape(
+        Object::GetProperty(instance, name).ToHandleChecked());
+  }
+  delete result.val;
+
+  Handle<Object> undefined = isolate->factory()->undefined_value();
+  for (int i = 1; i <= 3; i++) {
+    CcTest::heap()->CollectAllAvailableGarbage();
+    Handle<Object> value =
+        Execution::Call(isolate, function, undefined, 0, nullptr)
+            .ToHandleChecked();
+    CHECK_EQ(11 * i, static_cast<int32_t>(value->Number()));
+  }
+}
+
+
+TEST(Run_WasmModule_Streaming) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint32_t global = builder->AddGlobal(MachineType::Int32(), 0);
+  uint16_t add_index = builder->AddFunction();
+  WasmFunctionBuilder* f = builder->FunctionAt(add_index);
+  f->ReturnType(kAstI32);
+  uint16_t param1 = f->AddParam(kAstI32);
+  uint16_t param2 = f->AddParam(kAstI32);
+  byte add_code[] = {
+      WASM_I32_ADD(WASM_GET_LOCAL(param1), WASM_GET_LOCAL(param2))};
+  f->EmitCode(add_code, sizeof(add_code));
+  uint16_t main_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  uint16_t count_index = builder->AddFunction();
+  f = builder->FunctionAt(main_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte main_code[] = {WASM_CALL_FUNCTION(add_index,
+                                         WASM_CALL_FUNCTION0(count_index),
+                                         WASM_I8(100))};
+  f->EmitCode(main_code, sizeof(main_code));
+  f = builder->FunctionAt(count_index);
+  f->ReturnType(kAstI32);
+  byte count_code[] = {
+      WASM_STORE_MEM(MachineType::Int32(), WASM_ZERO,
+                     WASM_I32_ADD(WASM_LOAD_MEM(MachineType::Int32(),
+                                                WASM_ZERO),
+                                  WASM_I8(1))),
+      WASM_STORE_GLOBAL(global, WASM_I32_ADD(WASM_LOAD_GLOBAL(global),
+                                             WASM_I8(10))),
+      WASM_RETURN(WASM_I32_ADD(WASM_LOAD_MEM(MachineType::Int32(), WASM_ZERO),
+                               WASM_LOAD_GLOBAL(global)))};
+  f->EmitCode(count_code, sizeof(count_code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+
+  // The functions that only access memory and globals are compiled while the
+  // bytes arrive; "main" calls a later function, so it waits for the rest.
+  Handle<JSObject> instance;
+  {
+    WasmStreamingCompilation streaming(isolate);
+    const byte* bytes = index->Begin();
+    while (bytes < index->End()) {
+      size_t size = std::min<size_t>(3, index->End() - bytes);
+      CHECK(streaming.AddBytes(bytes, size));
+      bytes += size;
+    }
+    CHECK_EQ(2, streaming.streamed_count());
+    ErrorThrower thrower(isolate, "Streaming");
+    instance = streaming.Finish(Handle<JSObject>::null(),
+                                Handle<JSArrayBuffer>::null(), thrower)
+                   .ToHandleChecked();
+  }
+
+  // The instance does not need the compilation any more.
+  CHECK_EQ(111, CallExport(isolate, instance, "main"));
+  CHECK_EQ(122, CallExport(isolate, instance, "main"));
+}
+
+
+namespace {
+std::vector<std::string> wasm_code_names;
+
+void CollectWasmCodeNames(const v8::JitCodeEvent* event) {
+  if (event->type != v8::JitCodeEvent::CODE_ADDED) return;
+  std::string name(event->name.str, event->name.len);
+  if (name.find("WASM") != std::string::npos) wasm_code_names.push_back(name);
+}
+
+size_t CountWasmCodeNames(const char* prefix) {
+  size_t count = 0;
+  for (const std::string& name : wasm_code_names) {
+    if (name.find(prefix) != std::string::npos) count++;
+  }
+  return count;
+}
+}  // namespace
+
+
+TEST(Run_WasmModule_CodeEvents) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {WASM_I8(42)};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+
+  // Both the compiled code and the copies made for another instance are
+  // reported, named after the function.
+  wasm_code_names.clear();
+  CcTest::isolate()->SetJitCodeEventHandler(v8::kJitCodeEventDefault,
+                                            CollectWasmCodeNames);
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+  Handle<JSObject> first =
+      result.val->Instantiate(isolate, ffi, memory).ToHandleChecked();
+  Handle<JSObject> second = result.val->Reinstantiate(isolate, first, ffi,
+                                                      memory)
+                                .ToHandleChecked();
+  CcTest::isolate()->SetJitCodeEventHandler(v8::kJitCodeEventDefault,
+                                            nullptr);
+
+  CHECK_EQ(2u, CountWasmCodeNames("WASM function #0:main <module "));
+  CHECK_EQ(2u,
+           CountWasmCodeNames("JS->WASM function wrapper #0:main <module "));
+  CHECK_EQ(42, CallExport(isolate, first, "main"));
+  CHECK_EQ(42, CallExport(isolate, second, "main"));
+  delete result.val;
+}
+
+TEST(Run_WasmModule_SharedModuleBytes) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {WASM_I8(77)};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+
+  // Equal bytes at different addresses end up in a single shared copy.
+  size_t length = static_cast<size_t>(index->End() - index->Begin());
+  byte* copy = new byte[length];
+  memcpy(copy, index->Begin(), length);
+  size_t count = ModuleBytes::Count();
+  ModuleBytes* first = ModuleBytes::Get(index->Begin(), index->End());
+  ModuleBytes* second = ModuleBytes::Get(copy, copy + length);
+  delete[] copy;
+  CHECK_EQ(first, second);
+  CHECK_EQ(count + 1, ModuleBytes::Count());
+  CHECK_EQ(0, memcmp(first->start(), index->Begin(), length));
+
+  // Modules decoded from the shared copy keep it alive.
+  ModuleResult result = DecodeWasmModule(isolate, &zone, first->start(),
+                                         first->end(), false, false);
+  CHECK(result.ok());
+  result.val->bytes = first;
+  second->Release();
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+  Handle<JSObject> instance =
+      result.val->Instantiate(isolate, ffi, memory).ToHandleChecked();
+  CHECK_EQ(77, CallExport(isolate, instance, "main"));
+  CHECK_EQ(count + 1, ModuleBytes::Count());
+  delete result.val;
+  CHECK_EQ(count, ModuleBytes::Count());
+}
+
+
+TEST(Run_WasmModule_LazyCompilation) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  // f0 is called through a stub, f1 is never called.
+  uint16_t f0_index = builder->AddFunction();
+  WasmFunctionBuilder* f = builder->FunctionAt(f0_index);
+  f->ReturnType(kAstI32);
+  f->AddParam(kAstI32);
+  byte code0[] = {WASM_I32_ADD(WASM_GET_LOCAL(0), WASM_I8(7))};
+  f->EmitCode(code0, sizeof(code0));
+  uint16_t f1_index = builder->AddFunction();
+  f = builder->FunctionAt(f1_index);
+  f->ReturnType(kAstI32);
+  byte code1[] = {WASM_I8(11)};
+  f->EmitCode(code1, sizeof(code1));
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {WASM_CALL_FUNCTION(f0_index, WASM_I8(35))};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+  Handle<JSObject> instance =
+      result.val->Instantiate(isolate, ffi, memory, kLazyCompilation)
+          .ToHandleChecked();
+  // The module bytes are copied, so the decoded module may go away.
+  delete result.val;
+
+  Handle<FixedArray> code_table(
+      FixedArray::cast(instance->GetInternalField(kWasmModuleCodeTable)));
+  Handle<Object> stub0(code_table->get(f0_index), isolate);
+  Handle<Object> stub1(code_table->get(f1_index), isolate);
+  CHECK_EQ(42, CallExport(isolate, instance, "main"));
+  CHECK_NE(*stub0, code_table->get(f0_index));
+  CHECK_EQ(*stub1, code_table->get(f1_index));
+  // The call site in main now calls the compiled code directly.
+  CHECK_EQ(42, CallExport(isolate, instance, "main"));
+  CHECK_EQ(*stub1, code_table->get(f1_index));
+}
+
+
+TEST(Run_WasmModule_LazyCompilationCallers) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  // f1 calls f0 and both are compiled lazily, f0 first.
+  uint16_t f0_index = builder->AddFunction();
+  WasmFunctionBuilder* f = builder->FunctionAt(f0_index);
+  f->ReturnType(kAstI32);
+  f->AddParam(kAstI32);
+  byte code0[] = {WASM_I32_ADD(WASM_GET_LOCAL(0), WASM_I8(7))};
+  f->EmitCode(code0, sizeof(code0));
+  uint16_t f1_index = builder->AddFunction();
+  f = builder->FunctionAt(f1_index);
+  f->ReturnType(kAstI32);
+  f->AddParam(kAstI32);
+  byte code1[] = {WASM_CALL_FUNCTION(f0_index, WASM_GET_LOCAL(0))};
+  f->EmitCode(code1, sizeof(code1));
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {
+      WASM_I32_ADD(WASM_CALL_FUNCTION(f0_index, WASM_I8(1)),
+                   WASM_CALL_FUNCTION(f1_index, WASM_I8(20)))};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+  Handle<JSObject> instance =
+      result.val->Instantiate(isolate, ffi, memory, kLazyCompilation)
+          .ToHandleChecked();
+  delete result.val;
+
+  Handle<FixedArray> code_table(
+      FixedArray::cast(instance->GetInternalField(kWasmModuleCodeTable)));
+  Handle<Object> stub0(code_table->get(f0_index), isolate);
+  Handle<Object> stub1(code_table->get(f1_index), isolate);
+  CHECK_EQ(35, CallExport(isolate, instance, "main"));
+  CHECK_NE(*stub0, code_table->get(f0_index));
+  CHECK_NE(*stub1, code_table->get(f1_index));
+  // Neither main nor f1 calls a stub any more.
+  for (uint16_t caller : {f1_index, f_index}) {
+    Code* caller_code = Code::cast(code_table->get(caller));
+    for (RelocIterator it(caller_code, RelocInfo::kCodeTargetMask); !it.done();
+         it.next()) {
+      Code* target =
+          Code::GetCodeFromTargetAddress(it.rinfo()->target_address());
+      CHECK_NE(*stub0, target);
+      CHECK_NE(*stub1, target);
+    }
+  }
+  CHECK_EQ(35, CallExport(isolate, instance, "main"));
+}
+
+
+TEST(Run_WasmModule_TieredCompilation) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  // f0 sums up the numbers from 1 to its first argument in a loop, which
+  // makes it hot upon its first call.
+  uint16_t f0_index = builder->AddFunction();
+  WasmFunctionBuilder* f = builder->FunctionAt(f0_index);
+  f->ReturnType(kAstI32);
+  f->AddParam(kAstI32);
+  f->AddParam(kAstI32);
+  byte code0[] = {
+      WASM_WHILE(
+          WASM_GET_LOCAL(0),
+          WASM_BLOCK(
+              2, WASM_SET_LOCAL(
+                     1, WASM_I32_ADD(WASM_GET_LOCAL(1), WASM_GET_LOCAL(0))),
+              WASM_SET_LOCAL(0, WASM_I32_SUB(WASM_GET_LOCAL(0), WASM_I8(1))))),
+      WASM_GET_LOCAL(1)};
+  f->EmitCode(code0, sizeof(code0));
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {WASM_CALL_FUNCTION(f0_index, WASM_I32(1000), WASM_ZERO)};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+  Handle<JSObject> instance =
+      result.val->Instantiate(isolate, ffi, memory, kTieredCompilation)
+          .ToHandleChecked();
+  delete result.val;
+
+  Handle<FixedArray> code_table(
+      FixedArray::cast(instance->GetInternalField(kWasmModuleCodeTable)));
+  Handle<Object> stub0(code_table->get(f0_index), isolate);
+  // The first call is interpreted and starts the recompilation of f0.
+  CHECK_EQ(500500, CallExport(isolate, instance, "main"));
+  CHECK_EQ(*stub0, code_table->get(f0_index));
+  WasmModule::FinishTieredCompilation(isolate, instance);
+  CHECK_NE(*stub0, code_table->get(f0_index));
+  CHECK_EQ(500500, CallExport(isolate, instance, "main"));
+}
+
+
+TEST(Run_WasmModule_TieredCompilationCalleeLoops) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  // f0 loops, f1 only calls f0, so only f0 becomes hot.
+  uint16_t f0_index = builder->AddFunction();
+  WasmFunctionBuilder* f = builder->FunctionAt(f0_index);
+  f->ReturnType(kAstI32);
+  f->AddParam(kAstI32);
+  f->AddParam(kAstI32);
+  byte code0[] = {
+      WASM_WHILE(
+          WASM_GET_LOCAL(0),
+          WASM_BLOCK(
+              2, WASM_SET_LOCAL(
+                     1, WASM_I32_ADD(WASM_GET_LOCAL(1), WASM_GET_LOCAL(0))),
+              WASM_SET_LOCAL(0, WASM_I32_SUB(WASM_GET_LOCAL(0), WASM_I8(1))))),
+      WASM_GET_LOCAL(1)};
+  f->EmitCode(code0, sizeof(code0));
+  uint16_t f1_index = builder->AddFunction();
+  f = builder->FunctionAt(f1_index);
+  f->ReturnType(kAstI32);
+  f->AddParam(kAstI32);
+  byte code1[] = {WASM_CALL_FUNCTION(f0_index, WASM_GET_LOCAL(0), WASM_ZERO)};
+  f->EmitCode(code1, sizeof(code1));
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {WASM_CALL_FUNCTION(f1_index, WASM_I32(1000))};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+  Handle<JSObject> instance =
+      result.val->Instantiate(isolate, ffi, memory, kTieredCompilation)
+          .ToHandleChecked();
+  delete result.val;
+
+  Handle<FixedArray> code_table(
+      FixedArray::cast(instance->GetInternalField(kWasmModuleCodeTable)));
+  Handle<Object> stub0(code_table->get(f0_index), isolate);
+  Handle<Object> stub1(code_table->get(f1_index), isolate);
+  CHECK_EQ(500500, CallExport(isolate, instance, "main"));
+  WasmModule::FinishTieredCompilation(isolate, instance);
+  CHECK_NE(*stub0, code_table->get(f0_index));
+  CHECK_EQ(*stub1, code_table->get(f1_index));
+  CHECK_EQ(500500, CallExport(isolate, instance, "main"));
+}
+
+
+TEST(Run_WasmModule_OutOfBoundsTraps) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {
+      WASM_STORE_MEM(MachineType::Int32(), WASM_I8(8), WASM_I8(42)),
+      WASM_LOAD_MEM(MachineType::Int32(), WASM_I32(0x7ffffff0))};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+  Handle<JSObject> instance =
+      result.val->Instantiate(isolate, ffi, memory).ToHandleChecked();
+  Handle<JSObject> second =
+      result.val->Reinstantiate(isolate, instance, ffi, memory)
+          .ToHandleChecked();
+  Handle<String> name = isolate->factory()->InternalizeUtf8String("main");
+  Handle<Object> undefined = isolate->factory()->undefined_value();
+  // The access throws the trap as an exception that JavaScript can catch,
+  // in copies of the code as well.
+  for (Handle<JSObject> object : {instance, second}) {
+    Handle<Object> function =
+        Object::GetProperty(object, name).ToHandleChecked();
+    CHECK(Execution::Call(isolate, function, undefined, 0, nullptr).is_null());
+    CHECK(isolate->has_pending_exception());
+    Handle<Object> exception(isolate->pending_exception(), isolate);
+    isolate->clear_pending_exception();
+    CHECK(exception->IsString());
+    CHECK(String::cast(*exception)
+              ->IsUtf8EqualTo(CStrVector(
+                  WasmOpcodes::TrapReasonMessage(kTrapMemOutOfBounds))));
+  }
+  delete result.val;
+}
+
+
+TEST(Run_WasmModule_GuardRegion) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->AddParam(kAstI32);
+  f->Exported(1);
+  byte code[] = {
+      WASM_STORE_MEM(MachineType::Int32(), WASM_I8(8), WASM_I8(42)),
+      WASM_LOAD_MEM(MachineType::Int32(), WASM_GET_LOCAL(0))};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+  Handle<JSObject> instance =
+      result.val->Instantiate(isolate, ffi, memory, kEagerCompilation,
+                              kGuardRegionBoundsChecks)
+          .ToHandleChecked();
+  Handle<JSArrayBuffer> buffer(
+      JSArrayBuffer::cast(instance->GetInternalField(kWasmMemArrayBuffer)));
+  CHECK_EQ(GuardRegionsSupported(), IsGuardedArrayBuffer(buffer));
+  CHECK_EQ(Smi::FromInt(GuardRegionsSupported() ? kGuardRegionBoundsChecks
+                                                : kExplicitBoundsChecks),
+           instance->GetInternalField(kWasmBoundsCheckMode));
+
+  // Copies of the code get a guarded memory of their own, and the code
+  // cannot be serialized.
+  Handle<JSObject> second =
+      result.val->Reinstantiate(isolate, instance, ffi, memory)
+          .ToHandleChecked();
+  std::vector<byte> serialized;
+  CHECK_EQ(!GuardRegionsSupported(),
+           SerializeWasmModule(isolate, result.val, instance, &serialized));
+
+  // Accesses out of bounds fault in the guard region and throw the trap as
+  // an exception that JavaScript can catch, and the code keeps working.
+  Handle<String> name = isolate->factory()->InternalizeUtf8String("main");
+  Handle<Object> undefined = isolate->factory()->undefined_value();
+  for (Handle<JSObject> object : {instance, second}) {
+    Handle<Object> function =
+        Object::GetProperty(object, name).ToHandleChecked();
+    for (int32_t address : {0x7ffffff0, -4, 0x10000}) {
+      Handle<Object> args[] = {isolate->factory()->NewNumber(8)};
+      Handle<Object> value =
+          Execution::Call(isolate, function, undefined, 1, args)
+              .ToHandleChecked();
+      CHECK_EQ(42, value->Number());
+
+      args[0] = isolate->factory()->NewNumber(address);
+      CHECK(Execution::Call(isolate, function, undefined, 1, args).is_null());
+      CHECK(isolate->has_pending_exception());
+      Handle<Object> exception(isolate->pending_exception(), isolate);
+      isolate->clear_pending_exception();
+      CHECK(exception->IsString());
+      CHECK(String::cast(*exception)
+                ->IsUtf8EqualTo(CStrVector(
+                    WasmOpcodes::TrapReasonMessage(kTrapMemOutOfBounds))));
+    }
+  }
+  delete result.val;
+}
+
+
+TEST(Run_WasmModule_AsmJsBoundsChecks) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  // Accesses out of bounds of the 64kb memory follow asm.js semantics: the
+  // store past the end is ignored, and the loads past the end read 0.
+  // Unaligned accesses in bounds work.
+  byte code[] = {
+      WASM_STORE_MEM(MachineType::Int32(), WASM_I8(8), WASM_I8(40)),
+      WASM_STORE_MEM(MachineType::Int32(), WASM_I32(0x10008), WASM_I8(99)),
+      WASM_STORE_MEM(MachineType::Int8(), WASM_I8(13), WASM_I8(2)),
+      WASM_I32_ADD(
+          WASM_I32_ADD(WASM_LOAD_MEM(MachineType::Int32(), WASM_I8(8)),
+                       WASM_LOAD_MEM(MachineType::Int32(), WASM_I8(10))),
+          WASM_I32_ADD(
+              WASM_LOAD_MEM(MachineType::Int32(), WASM_I32(0x10008)),
+              WASM_LOAD_MEM(MachineType::Int32(), WASM_I32(0x10000))))};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+  Handle<JSObject> instance =
+      result.val->Instantiate(isolate, ffi, memory, kEagerCompilation,
+                              kAsmJsBoundsChecks)
+          .ToHandleChecked();
+  // mem[8] is 40 and the unaligned mem[10] is 2 << 24.
+  CHECK_EQ(40 + (2 << 24), CallExport(isolate, instance, "main"));
+  CHECK_EQ(Smi::FromInt(kAsmJsBoundsChecks),
+           instance->GetInternalField(kWasmBoundsCheckMode));
+
+  // Copies of the code keep the asm.js semantics.
+  Handle<JSObject> second =
+      result.val->Reinstantiate(isolate, instance, ffi, memory)
+          .ToHandleChecked();
+  CHECK_EQ(40 + (2 << 24), CallExport(isolate, second, "main"));
+  CHECK_EQ(Smi::FromInt(kAsmJsBoundsChecks),
+           second->GetInternalField(kWasmBoundsCheckMode));
+  delete result.val;
+}
+
+
+TEST(Run_WasmModule_NativeEntry) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint16_t add_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("add"), 3);
+  WasmFunctionBuilder* f = builder->FunctionAt(add_index);
+  f->ReturnType(kAstF64);
+  f->AddParam(kAstI32);
+  f->AddParam(kAstF64);
+  f->Exported(1);
+  byte add_code[] = {WASM_F64_ADD(WASM_F64_SCONVERT_I32(WASM_GET_LOCAL(0)),
+                                  WASM_GET_LOCAL(1))};
+  f->EmitCode(add_code, sizeof(add_code));
+  uint16_t div_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("div"), 3);
+  f = builder->FunctionAt(div_index);
+  f->ReturnType(kAstI32);
+  f->AddParam(kAstI32);
+  f->AddParam(kAstI32);
+  f->Exported(1);
+  byte div_code[] = {WASM_I32_DIVS(WASM_GET_LOCAL(0), WASM_GET_LOCAL(1))};
+  f->EmitCode(div_code, sizeof(div_code));
+  uint16_t mul_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("mul"), 3);
+  f = builder->FunctionAt(mul_index);
+  f->ReturnType(kAstI32);
+  f->AddParam(kAstI32);
+  f->AddParam(kAstI32);
+  f->Exported(1);
+  byte mul_code[] = {WASM_I32_MUL(WASM_GET_LOCAL(0), WASM_GET_LOCAL(1))};
+  f->EmitCode(mul_code, sizeof(mul_code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+  Handle<JSObject> instance =
+      result.val->Instantiate(isolate, ffi, memory).ToHandleChecked();
+
+  // A typed call.
+  WasmNativeEntry add(isolate, result.val, instance, add_index);
+  double sum = 0;
+  CHECK(add.Call(&sum, 40, 2.5));
+  CHECK_EQ(42.5, sum);
+
+  // A batched call over three argument tuples.
+  WasmNativeEntry div(isolate, result.val, instance, div_index);
+  WasmNativeValue args[6];
+  WasmNativeValue results[3];
+  for (int i = 0; i < 3; i++) {
+    args[2 * i].i32 = 84 * (i + 1);
+    args[2 * i + 1].i32 = i + 1;
+  }
+  CHECK(div.CallBatch(args, results, 3));
+  for (int i = 0; i < 3; i++) CHECK_EQ(84, results[i].i32);
+
+  {
+    // An entry of the same signature copies the wrapper of the first one.
+    WasmNativeEntry mul(isolate, result.val, instance, mul_index);
+    int32_t product = 0;
+    CHECK(mul.Call(&product, 6, 7));
+    CHECK_EQ(42, product);
+    CHECK(div.CallBatch(args, results, 3));
+    for (int i = 0; i < 3; i++) CHECK_EQ(84, results[i].i32);
+  }
+
+  // An entry keeps its instance alive beyond the handle scope.
+  WasmNativeEntry* entry;
+  {
+    HandleScope inner_scope(isolate);
+    Handle<JSObject> other =
+        result.val->Instantiate(isolate, ffi, memory).ToHandleChecked();
+    entry = new WasmNativeEntry(isolate, result.val, other, mul_index);
+  }
+  isolate->heap()->CollectAllAvailableGarbage();
+  int32_t product = 0;
+  CHECK(entry->Call(&product, 6, 7));
+  CHECK_EQ(42, product);
+  delete entry;
+
+  // A trap stops the batch and throws.
+  v8::TryCatch try_catch(CcTest::isolate());
+  args[3].i32 = 0;
+  results[0].i32 = 0;
+  results[1].i32 = 0;
+  CHECK(!div.CallBatch(args, results, 3));
+  CHECK(try_catch.HasCaught());
+  CHECK_EQ(84, results[0].i32);
+  CHECK_EQ(0, results[1].i32);
+  delete result.val;
+}
+
+
+TEST(Run_WasmModule_GrowMemory) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  byte size_code[] = {WASM_MEMORY_SIZE};
+  byte grow_code[] = {WASM_GROW_MEMORY(WASM_I32(0x10000))};
+  // The store only fits once the memory has grown during the function.
+  byte grow_store_code[] = {
+      WASM_BLOCK(2, WASM_GROW_MEMORY(WASM_I32(0x10000)),
+                 WASM_STORE_MEM(MachineType::Int32(), WASM_I32(140000),
+                                WASM_I8(42)))};
+  byte load_code[] = {WASM_LOAD_MEM(MachineType::Int32(), WASM_I32(140000))};
+  struct {
+    const char* name;
+    byte* code;
+    size_t size;
+  } functions[] = {{"size", size_code, sizeof(size_code)},
+                   {"grow", grow_code, sizeof(grow_code)},
+                   {"grow_store", grow_store_code, sizeof(grow_store_code)},
+                   {"load", load_code, sizeof(load_code)}};
+  for (auto& function : functions) {
+    uint16_t f_index = builder->AddFunction(
+        reinterpret_cast<const unsigned char*>(function.name),
+        static_cast<int>(strlen(function.name)));
+    WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+    f->ReturnType(kAstI32);
+    f->Exported(1);
+    f->EmitCode(function.code, static_cast<uint32_t>(function.size));
+  }
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+  // The builder declares a fixed 64kb memory. Let it grow to 256kb.
+  CHECK_EQ(16, result.val->min_mem_size_log2);
+  result.val->max_mem_size_log2 = 18;
+
+  CompilationMode modes[] = {kEagerCompilation, kTieredCompilation};
+  for (CompilationMode mode : modes) {
+    Handle<JSObject> instance =
+        result.val->Instantiate(isolate, Handle<JSObject>::null(),
+                                Handle<JSArrayBuffer>::null(), mode)
+            .ToHandleChecked();
+    Handle<JSArrayBuffer> buffer(
+        JSArrayBuffer::cast(instance->GetInternalField(kWasmMemArrayBuffer)));
+    CHECK_EQ(0x10000, CallExport(isolate, instance, "size"));
+    CHECK_EQ(0x10000, CallExport(isolate, instance, "grow"));
+    CHECK_EQ(0x20000, CallExport(isolate, instance, "size"));
+    CHECK_EQ(0x20000, buffer->byte_length()->Number());
+    CHECK_EQ(42, CallExport(isolate, instance, "grow_store"));
+    CHECK_EQ(42, CallExport(isolate, instance, "load"));
+    CHECK_EQ(42, reinterpret_cast<int32_t*>(buffer->backing_store())[35000]);
+    CHECK_EQ(0x30000, CallExport(isolate, instance, "grow"));
+    // The memory cannot grow past its maximum size.
+    CHECK_EQ(-1, CallExport(isolate, instance, "grow"));
+    CHECK_EQ(0x40000, CallExport(isolate, instance, "size"));
+    CHECK_EQ(0x40000, buffer->byte_length()->Number());
+  }
+  delete result.val;
+}
+
+
+TEST(Run_WasmModule_MemoryUsage) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint32_t global = builder->AddGlobal(MachineType::Int32(), 0);
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("grow"), 4);
+  WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {WASM_STORE_GLOBAL(global, WASM_I8(1)),
+                 WASM_GROW_MEMORY(WASM_I32(0x10000))};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+  result.val->max_mem_size_log2 = 18;
+
+  // The committed memory is reported to the heap.
+  int64_t external =
+      CcTest::isolate()->AdjustAmountOfExternalAllocatedMemory(0);
+  Handle<JSObject> instance =
+      result.val->Instantiate(isolate, Handle<JSObject>::null(),
+                              Handle<JSArrayBuffer>::null())
+          .ToHandleChecked();
+  CHECK_LE(external + 0x10000,
+           CcTest::isolate()->AdjustAmountOfExternalAllocatedMemory(0));
+
+  WasmInstanceMemoryUsage usage = WasmModule::MemoryUsage(instance);
+  CHECK_EQ(WasmModule::CodeSize(instance), usage.code);
+  CHECK_EQ(0x10000u, usage.memory);
+  CHECK_LE(4u, usage.globals);
+  CHECK_LT(0u, usage.tables);
+  CHECK_LT(0u, usage.metadata);
+
+  // Growing from compiled code is reported from the next interrupt check.
+  external = CcTest::isolate()->AdjustAmountOfExternalAllocatedMemory(0);
+  CHECK_EQ(0x10000, CallExport(isolate, instance, "grow"));
+  CHECK_EQ(0x20000u, WasmModule::MemoryUsage(instance).memory);
+  isolate->stack_guard()->HandleInterrupts();
+  CHECK_EQ(external + 0x10000,
+           CcTest::isolate()->AdjustAmountOfExternalAllocatedMemory(0));
+  // Growing again reports only the new pages.
+  CHECK_EQ(0x20000, CallExport(isolate, instance, "grow"));
+  CompileRun("0");
+  CHECK_EQ(external + 0x20000,
+           CcTest::isolate()->AdjustAmountOfExternalAllocatedMemory(0));
+  delete result.val;
+}
+
+
+TEST(Run_WasmModule_SharedMemoryReleased) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {WASM_LOAD_MEM(MachineType::Int32(), WASM_I8(8))};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+  result.val->mem_shared = true;
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> no_memory = Handle<JSArrayBuffer>::null();
+
+  // The shared memories of dead instances are freed.
+  int64_t external =
+      CcTest::isolate()->AdjustAmountOfExternalAllocatedMemory(0);
+  for (int i = 0; i < 32; i++) {
+    HandleScope inner_scope(isolate);
+    result.val->Instantiate(isolate, ffi, no_memory).ToHandleChecked();
+  }
+  CHECK_LE(external + 32 * 0x10000,
+           CcTest::isolate()->AdjustAmountOfExternalAllocatedMemory(0));
+  CcTest::heap()->CollectAllAvailableGarbage();
+  CHECK_EQ(external,
+           CcTest::isolate()->AdjustAmountOfExternalAllocatedMemory(0));
+
+  // A buffer viewing the memory, as another thread would, holds it after
+  // the buffer it was allocated with dies.
+  {
+    HandleScope second_scope(isolate);
+    Handle<JSObject> second;
+    {
+      HandleScope first_scope(isolate);
+      Handle<JSObject> first =
+          result.val->Instantiate(isolate, ffi, no_memory).ToHandleChecked();
+      Handle<JSArrayBuffer> buffer(
+          JSArrayBuffer::cast(first->GetInternalField(kWasmMemArrayBuffer)));
+      reinterpret_cast<int32_t*>(buffer->backing_store())[2] = 42;
+      Handle<JSArrayBuffer> view =
+          isolate->factory()->NewJSArrayBuffer(SharedFlag::kShared);
+      JSArrayBuffer::Setup(view, isolate, true, buffer->backing_store(),
+                           static_cast<int>(buffer->byte_length()->Number()),
+                           SharedFlag::kShared);
+      second = first_scope.CloseAndEscape(
+          result.val->Instantiate(isolate, ffi, view).ToHandleChecked());
+    }
+    CcTest::heap()->CollectAllAvailableGarbage();
+    CHECK_EQ(external + 0x10000,
+             CcTest::isolate()->AdjustAmountOfExternalAllocatedMemory(0));
+    CHECK_EQ(42, CallExport(isolate, second, "main"));
+  }
+  CcTest::heap()->CollectAllAvailableGarbage();
+  CHECK_EQ(external,
+           CcTest::isolate()->AdjustAmountOfExternalAllocatedMemory(0));
+  delete result.val;
+}
+
+
+TEST(Run_WasmModule_TooManyGrowableMemories) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {WASM_I8(7)};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+  result.val->max_mem_size_log2 = 17;
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> no_memory = Handle<JSArrayBuffer>::null();
+
+  // Once every reservation is taken, instantiation fails rather than giving
+  // the instance a memory that cannot grow.
+  {
+    HandleScope inner_scope(isolate);
+    int instances = 0;
+    while (!result.val->Instantiate(isolate, ffi, no_memory).is_null()) {
+      CHECK_LT(instances++, kMaxReservedArrayBuffers);
+    }
+    CHECK(ReservedArrayBuffersExhausted());
+    CHECK(isolate->has_scheduled_exception());
+    isolate->clear_scheduled_exception();
+  }
+
+  // The reservations of dead instances can be taken again.
+  CcTest::heap()->CollectAllAvailableGarbage();
+  CHECK(!ReservedArrayBuffersExhausted());
+  Handle<JSObject> instance =
+      result.val->Instantiate(isolate, ffi, no_memory).ToHandleChecked();
+  CHECK_EQ(7, CallExport(isolate, instance, "main"));
+  delete result.val;
+}
+
+
+TEST(Run_WasmModule_SerializeRoundTrip) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint32_t global = builder->AddGlobal(MachineType::Int32(), 0);
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {
+      WASM_STORE_GLOBAL(global, WASM_I32_ADD(WASM_LOAD_GLOBAL(global),
+                                             WASM_I8(7))),
+      WASM_RETURN(WASM_I32_ADD(WASM_LOAD_MEM(MachineType::Int32(), WASM_ZERO),
+                               WASM_LOAD_GLOBAL(global)))};
+  f->EmitCode(code, sizeof(code));
+  WasmModuleIndex* index = builder->Build(&zone)->WriteTo(&zone);
+  ModuleResult result = DecodeWasmModule(isolate, &zone, index->Begin(),
+                                         index->End(), false, false);
+  CHECK(result.ok());
+
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+  Handle<JSObject> original =
+      result.val->Instantiate(isolate, ffi, memory).ToHandleChecked();
+  CHECK_EQ(7, CallExport(isolate, original, "main"));
+  std::vector<byte> buffer;
+  CHECK(SerializeWasmModule(isolate, result.val, original, &buffer));
+  delete result.val;
+
+  // The deserialized module runs with fresh memory and globals.
+  {
+    ErrorThrower thrower(isolate, "Run_WasmModule_SerializeRoundTrip");
+    WasmModule* module = nullptr;
+    Handle<JSObject> templ =
+        DeserializeWasmModule(isolate, thrower, &zone, &buffer[0],
+                              &buffer[0] + buffer.size(), &module)
+            .ToHandleChecked();
+    Handle<JSObject> instance =
+        module->Reinstantiate(isolate, templ, ffi, memory).ToHandleChecked();
+    CHECK_EQ(7, CallExport(isolate, instance, "main"));
+    CHECK_EQ(14, CallExport(isolate, instance, "main"));
+    delete module;
+  }
+
+  // A corrupted buffer fails the checksum.
+  {
+    buffer[buffer.size() / 2] ^= 0xff;
+    ErrorThrower thrower(isolate, "Run_WasmModule_SerializeRoundTrip");
+    WasmModule* module = nullptr;
+    CHECK(DeserializeWasmModule(isolate, thrower, &zone, &buffer[0],
+                                &buffer[0] + buffer.size(), &module)
+              .is_null());
+    CHECK(thrower.error());
+    CHECK_NULL(module);
+    isolate->clear_pending_exception();
+  }
+}
@@ -5,12 +5,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "src/base/platform/platform.h"
 #include "src/compiler/graph-visualizer.h"
+#include "src/compiler/instruction-selector.h"
 #include "src/compiler/js-graph.h"
 #include "src/wasm/wasm-compiler.h"
 
 #include "src/wasm/ast-decoder.h"
 #include "src/wasm/wasm-macro-gen.h"
+#include "src/wasm/wasm-memory.h"
 #include "src/wasm/wasm-module.h"
 #include "src/wasm/wasm-opcodes.h"
 
@@ -46,6 +49,7 @@ static void init_env(FunctionEnv* env, FunctionSig* sig) {
   env->local_int64_count = 0;
   env->local_float32_count = 0;
   env->local_float64_count = 0;
+  env->local_simd128_count = 0;
   env->SumLocals();
 }
 
@@ -70,9 +74,6 @@ class TestingModule : public ModuleEnv {
       free(raw_mem_start<byte>());
     }
     if (module) {
-      if (module->globals) delete module->globals;
-      if (module->signatures) delete module->signatures;
-      if (module->functions) delete module->functions;
       if (globals_area) free(reinterpret_cast<byte*>(globals_area));
       delete module;
     }
@@ -104,7 +105,7 @@ class TestingModule : public ModuleEnv {
   byte AddSignature(FunctionSig* sig) {
     AllocModule();
     if (!module->signatures) {
-      module->signatures = new std::vector<FunctionSig*>();
+      module->signatures = NewVector<FunctionSig*>();
     }
     module->signatures->push_back(sig);
     size_t size = module->signatures->size();
@@ -153,23 +154,38 @@ class TestingModule : public ModuleEnv {
   WasmFunction* AddFunction(FunctionSig* sig, Handle<Code> code) {
     AllocModule();
     if (module->functions == nullptr) {
-      module->functions = new std::vector<WasmFunction>();
+      module->functions = NewVector<WasmFunction>();
       function_code = new std::vector<Handle<Code>>();
     }
-    module->functions->push_back({sig, 0, 0, 0, 0, 0, 0, 0, false, false});
+    module->functions->push_back(
+        {sig, 0, 0, 0, false, false, 0, 0, 0, 0, 0, 0});
     function_code->push_back(code);
     return &module->functions->back();
   }
 
+  void AddIndirectFunction(uint16_t index) {
+    AllocModule();
+    if (module->function_table == nullptr) {
+      module->function_table = NewVector<uint16_t>();
+    }
+    module->function_table->push_back(index);
+  }
+
  private:
   size_t mem_size;
   unsigned global_offset;
+  Zone zone;  // holds the tables of the module.
+
+  template <typename T>
+  ZoneVector<T>* NewVector() {
+    return new (zone.New(sizeof(ZoneVector<T>))) ZoneVector<T>(&zone);
+  }
 
   WasmGlobal* AddGlobal(MachineType mem_type) {
     AllocModule();
     if (globals_area == 0) {
       globals_area = reinterpret_cast<uintptr_t>(malloc(kMaxGlobalsSize));
-      module->globals = new std::vector<WasmGlobal>();
+      module->globals = NewVector<WasmGlobal>();
     }
     byte size = WasmOpcodes::MemSize(mem_type);
     global_offset = (global_offset + size - 1) & ~(size - 1);  // align
@@ -184,6 +200,8 @@ class TestingModule : public ModuleEnv {
       module->globals = nullptr;
       module->functions = nullptr;
       module->data_segments = nullptr;
+      module->function_table = nullptr;
+      module->mem_shared = false;
     }
   }
 };
@@ -194,7 +212,13 @@ class WasmFunctionCompiler : public HandleAndZoneScope,
                              private GraphAndBuilders {
  public:
   explicit WasmFunctionCompiler(FunctionSig* sig)
+      : WasmFunctionCompiler(
+            sig, InstructionSelector::SupportedMachineOperatorFlags()) {}
+
+  // Compiles with only the optional machine operators in {flags}.
+  WasmFunctionCompiler(FunctionSig* sig, MachineOperatorBuilder::Flags flags)
       : GraphAndBuilders(main_zone()),
+        machine_(main_zone(), MachineType::PointerRepresentation(), flags),
         jsgraph(this->isolate(),
                 this->graph(),
                 this->common(),
@@ -205,6 +229,11 @@ class WasmFunctionCompiler : public HandleAndZoneScope,
     init_env(&env, sig);
   }
 
+ private:
+  // The machine operators, with only the optional ones in the flags.
+  MachineOperatorBuilder machine_;
+
+ public:
   JSGraph jsgraph;
   FunctionEnv env;
   // The call descriptor is initialized when the function is compiled.
@@ -214,7 +243,7 @@ class WasmFunctionCompiler : public HandleAndZoneScope,
   Graph* graph() const { return main_graph_; }
   Zone* zone() const { return graph()->zone(); }
   CommonOperatorBuilder* common() { return &main_common_; }
-  MachineOperatorBuilder* machine() { return &main_machine_; }
+  MachineOperatorBuilder* machine() { return &machine_; }
   CallDescriptor* descriptor() { return descriptor_; }
 
   void Build(const byte* start, const byte* end) {
@@ -275,13 +304,24 @@ template <typename ReturnType>
 class WasmRunner {
  public:
   WasmRunner(MachineType p0 = MachineType::None(),
+             MachineType p1 = MachineType::None(),
+             MachineType p2 = MachineType::None(),
+             MachineType p3 = MachineType::None())
+      : WasmRunner(InstructionSelector::SupportedMachineOperatorFlags(), p0,
+                   p1, p2, p3) {}
+
+
+  // Compiles with only the optional machine operators in {flags}, to test
+  // the lowering of opcodes on machines without the other ones.
+  WasmRunner(MachineOperatorBuilder::Flags flags,
+             MachineType p0 = MachineType::None(),
              MachineType p1 = MachineType::None(),
              MachineType p2 = MachineType::None(),
              MachineType p3 = MachineType::None()) :
     signature_(MachineTypeForC<ReturnType>() == MachineType::None() ? 0 : 1,
                GetParameterCount(p0, p1, p2, p3),
                storage_),
-    compiler_(&signature_),
+    compiler_(&signature_, flags),
     call_wrapper_(p0, p1, p2, p3),
     compilation_done_(false) {
 
@@ -501,6 +541,24 @@ TEST(Run_WasmInt32Param0_fallthru) {
 }
 
 
+TEST(Run_Wasm_ManyTopLevelExpressions) {
+  // local[0] = local[0] + 1; ... local[0]
+  const int kCount = 1000;
+  byte inc[] = {WASM_INC_LOCAL(0)};
+  std::vector<byte> code;
+  for (int i = 0; i < kCount; i++) {
+    code.insert(code.end(), inc, inc + arraysize(inc));
+  }
+  code.push_back(kExprGetLocal);
+  code.push_back(0);
+
+  WasmRunner<int32_t> r(MachineType::Int32());
+  r.Build(&code[0], &code[0] + code.size());
+  CHECK_EQ(kCount, r.Call(0));
+  CHECK_EQ(kCount - 7, r.Call(-7));
+}
+
+
 TEST(Run_WasmInt32Param1) {
   WasmRunner<int32_t> r(MachineType::Int32(), MachineType::Int32());
   // local[1]
@@ -709,6 +767,25 @@ TEST(Run_WasmInt32Popcnt) {
 }
 
 
+TEST(Run_WasmInt32CtzPopcntWithoutInstructions) {
+  WasmRunner<int32_t> ctz(MachineOperatorBuilder::kNoFlags,
+                          MachineType::Uint32());
+  BUILD(ctz, WASM_I32_CTZ(WASM_GET_LOCAL(0)));
+  WasmRunner<int32_t> popcnt(MachineOperatorBuilder::kNoFlags,
+                             MachineType::Uint32());
+  BUILD(popcnt, WASM_I32_POPCNT(WASM_GET_LOCAL(0)));
+
+  FOR_UINT32_INPUTS(i) {
+    int32_t trailing = 0;
+    while (trailing < 32 && ((*i >> trailing) & 1) == 0) trailing++;
+    int32_t population = 0;
+    for (int bit = 0; bit < 32; bit++) population += (*i >> bit) & 1;
+    CHECK_EQ(trailing, ctz.Call(*i));
+    CHECK_EQ(population, popcnt.Call(*i));
+  }
+}
+
+
 #if WASM_64
 void TestInt64Binop(WasmOpcode opcode, int64_t expected, int64_t a, int64_t b) {
   if (!WasmOpcodes::IsSupported(opcode)) return;
@@ -2026,6 +2103,156 @@ TEST(Run_Wasm_StoreMem_offset_oob) {
 }
 
 
+TEST(Run_Wasm_LoadMem_merged_checks) {
+  TestingModule module;
+  int32_t* memory = module.AddMemoryElems<int32_t>(8);
+  for (int i = 0; i < 8; i++) memory[i] = i * 11;
+
+  for (int reverse = 0; reverse < 2; reverse++) {
+    // Two loads of the same index, checked once against the larger offset.
+    WasmRunner<int32_t> r(MachineType::Uint32());
+    r.env()->module = &module;
+    if (reverse) {
+      BUILD(r,
+            WASM_I32_ADD(
+                WASM_LOAD_MEM_OFFSET(MachineType::Int32(), 4,
+                                     WASM_GET_LOCAL(0)),
+                WASM_LOAD_MEM(MachineType::Int32(), WASM_GET_LOCAL(0))));
+    } else {
+      BUILD(r,
+            WASM_I32_ADD(
+                WASM_LOAD_MEM(MachineType::Int32(), WASM_GET_LOCAL(0)),
+                WASM_LOAD_MEM_OFFSET(MachineType::Int32(), 4,
+                                     WASM_GET_LOCAL(0))));
+    }
+
+    for (uint32_t i = 0; i < 7; i++) {
+      CHECK_EQ(static_cast<int32_t>(i * 11 + (i + 1) * 11), r.Call(i * 4));
+    }
+    for (uint32_t offset = 25; offset < 40; offset++) {
+      CHECK_TRAP(r.Call(offset));
+    }
+  }
+}
+
+
+TEST(Run_Wasm_StoreMem_then_oob_load) {
+  // The store must happen before the load traps.
+  const int32_t kWritten = 0x12345678;
+  TestingModule module;
+  int32_t* memory = module.AddMemoryElems<int32_t>(8);
+  WasmRunner<int32_t> r(MachineType::Uint32());
+  r.env()->module = &module;
+
+  BUILD(r,
+        WASM_STORE_MEM(MachineType::Int32(), WASM_GET_LOCAL(0),
+                       WASM_I32(kWritten)),
+        WASM_LOAD_MEM_OFFSET(MachineType::Int32(), 4, WASM_GET_LOCAL(0)));
+
+  memory[7] = 0;
+  CHECK_TRAP(r.Call(28u));
+  CHECK_EQ(kWritten, memory[7]);
+}
+
+
+TEST(Run_Wasm_Loop_ManyLocals) {
+  WasmRunner<int32_t> r(MachineType::Int32());
+  byte last = 0;
+  for (int i = 0; i < 40; i++) last = r.AllocateLocal(kAstI32);
+  // The locals lie in different chunks of the SSA environment, and the loop
+  // only assigns some of them.
+  const byte kSum = last;
+  const byte kOdd = last - 8;
+  const byte kOuter = last - 25;
+
+  BUILD(r,
+        WASM_SET_LOCAL(kOuter, WASM_I8(100)),
+        WASM_BLOCK(
+            2,
+            WASM_LOOP(
+                4,
+                WASM_SET_LOCAL(kSum, WASM_I32_ADD(WASM_GET_LOCAL(kSum),
+                                                  WASM_GET_LOCAL(0))),
+                WASM_IF(WASM_I32_AND(WASM_GET_LOCAL(0), WASM_I8(1)),
+                        WASM_SET_LOCAL(kOdd, WASM_I32_ADD(WASM_GET_LOCAL(kOdd),
+                                                          WASM_I8(1)))),
+                WASM_SET_LOCAL(0, WASM_I32_SUB(WASM_GET_LOCAL(0), WASM_I8(1))),
+                WASM_BR_IF(0, WASM_GET_LOCAL(0))),
+            WASM_I32_ADD(
+                WASM_I32_ADD(WASM_GET_LOCAL(kSum), WASM_GET_LOCAL(kOuter)),
+                WASM_I32_MUL(WASM_GET_LOCAL(kOdd), WASM_I8(10)))));
+
+  for (int32_t n = 1; n < 20; n++) {
+    CHECK_EQ(n * (n + 1) / 2 + 100 + 10 * ((n + 1) / 2), r.Call(n));
+  }
+}
+
+
+TEST(Run_Wasm_LoadMem_loop_invariant) {
+  TestingModule module;
+  int32_t* memory = module.AddMemoryElems<int32_t>(8);
+  WasmRunner<int32_t> r(MachineType::Int32(), MachineType::Uint32());
+  r.env()->module = &module;
+  byte sum = r.AllocateLocal(kAstI32);
+
+  // Store to memory[0], then sum memory[p1] over p0 iterations.
+  BUILD(r,
+        WASM_STORE_MEM(MachineType::Int32(), WASM_ZERO, WASM_I8(7)),
+        WASM_BLOCK(
+            2,
+            WASM_LOOP(
+                3,
+                WASM_SET_LOCAL(sum, WASM_I32_ADD(WASM_GET_LOCAL(sum),
+                                                 WASM_LOAD_MEM(
+                                                     MachineType::Int32(),
+                                                     WASM_GET_LOCAL(1)))),
+                WASM_SET_LOCAL(0, WASM_I32_SUB(WASM_GET_LOCAL(0), WASM_I8(1))),
+                WASM_BR_IF(0, WASM_GET_LOCAL(0))),
+            WASM_GET_LOCAL(sum)));
+
+  memory[2] = 5;
+  CHECK_EQ(7, r.Call(1, 0u));
+  CHECK_EQ(50, r.Call(10, 8u));
+  CHECK_EQ(70, r.Call(10, 0u));
+  for (uint32_t offset = 29; offset < 40; offset++) {
+    memory[0] = 0;
+    CHECK_TRAP(r.Call(10, offset));
+    CHECK_EQ(7, memory[0]);
+  }
+}
+
+
+TEST(Run_Wasm_LoadMem_loop_after_store) {
+  TestingModule module;
+  int32_t* memory = module.AddMemoryElems<int32_t>(8);
+  WasmRunner<int32_t> r(MachineType::Int32(), MachineType::Uint32());
+  r.env()->module = &module;
+
+  // The store in the loop comes first, so the check cannot leave the loop.
+  BUILD(r,
+        WASM_BLOCK(
+            2,
+            WASM_LOOP(
+                3,
+                WASM_STORE_MEM(MachineType::Int32(), WASM_ZERO,
+                               WASM_GET_LOCAL(0)),
+                WASM_SET_LOCAL(0, WASM_I32_SUB(WASM_LOAD_MEM(
+                                                   MachineType::Int32(),
+                                                   WASM_GET_LOCAL(1)),
+                                               WASM_I8(1))),
+                WASM_BR_IF(0, WASM_GET_LOCAL(0))),
+            WASM_GET_LOCAL(0)));
+
+  memory[1] = 1;
+  CHECK_EQ(0, r.Call(3, 4u));
+  CHECK_EQ(3, memory[0]);
+  for (uint32_t offset = 29; offset < 40; offset++) {
+    CHECK_TRAP(r.Call(5, offset));
+    CHECK_EQ(5, memory[0]);
+  }
+}
+
+
 #if WASM_64
 TEST(Run_Wasm_F64ReinterpretI64) {
   WasmRunner<int64_t> r;
@@ -3196,16 +3423,14 @@ TEST(Run_Wasm_SimpleCallIndirect) {
 
   // Function table.
   int table_size = 2;
-  std::vector<uint16_t> function_table;
-  module.module->function_table = &function_table;
-  module.module->function_table->push_back(0);
-  module.module->function_table->push_back(1);
+  module.AddIndirectFunction(0);
+  module.AddIndirectFunction(1);
 
   // Function table.
   Handle<FixedArray> fixed = isolate->factory()->NewFixedArray(2 * table_size);
   fixed->set(0, Smi::FromInt(1));
-  fixed->set(1, Smi::FromInt(1));
-  fixed->set(2, *module.function_code->at(0));
+  fixed->set(1, *module.function_code->at(0));
+  fixed->set(2, Smi::FromInt(1));
   fixed->set(3, *module.function_code->at(1));
   module.function_table = fixed;
 
@@ -3240,16 +3465,14 @@ TEST(Run_Wasm_MultipleCallIndirect) {
 
   // Function table.
   int table_size = 2;
-  std::vector<uint16_t> function_table;
-  module.module->function_table = &function_table;
-  module.module->function_table->push_back(0);
-  module.module->function_table->push_back(1);
+  module.AddIndirectFunction(0);
+  module.AddIndirectFunction(1);
 
   // Function table.
   Handle<FixedArray> fixed = isolate->factory()->NewFixedArray(2 * table_size);
   fixed->set(0, Smi::FromInt(1));
-  fixed->set(1, Smi::FromInt(1));
-  fixed->set(2, *module.function_code->at(0));
+  fixed->set(1, *module.function_code->at(0));
+  fixed->set(2, Smi::FromInt(1));
   fixed->set(3, *module.function_code->at(1));
   module.function_table = fixed;
 
@@ -3275,6 +3498,42 @@ TEST(Run_Wasm_MultipleCallIndirect) {
 }
 
 
+TEST(Run_Wasm_CallIndirect_EqualSignatures) {
+  Isolate* isolate = CcTest::InitIsolateOnce();
+
+  WasmRunner<int32_t> r(MachineType::Int32());
+  TestSignatures sigs;
+  TestingModule module;
+  r.env()->module = &module;
+  WasmFunctionCompiler t1(sigs.i_ii());
+  BUILD(t1, WASM_I32_ADD(WASM_GET_LOCAL(0), WASM_GET_LOCAL(1)));
+  t1.CompileAndAdd(&module);
+
+  // Signature table, with i_ii declared twice.
+  module.AddSignature(sigs.f_ff());
+  module.AddSignature(sigs.i_ii());
+  module.AddSignature(sigs.d_dd());
+  byte sig_index = module.AddSignature(sigs.i_ii());
+  CHECK_EQ(1, static_cast<int>(module.GetCanonicalSigIndex(sig_index)));
+
+  // Function table.
+  int table_size = 1;
+  module.AddIndirectFunction(0);
+
+  // Function table, with the canonical signature index.
+  Handle<FixedArray> fixed = isolate->factory()->NewFixedArray(2 * table_size);
+  fixed->set(0, Smi::FromInt(1));
+  fixed->set(1, *module.function_code->at(0));
+  module.function_table = fixed;
+
+  // Builder the caller function.
+  BUILD(r, WASM_CALL_INDIRECT(sig_index, WASM_GET_LOCAL(0), WASM_I8(66),
+                              WASM_I8(22)));
+
+  CHECK_EQ(88, r.Call(0));
+  CHECK_TRAP(r.Call(1));
+}
+
 TEST(Run_Wasm_F32Floor) {
   WasmRunner<float> r(MachineType::Float32());
   BUILD(r, WASM_F32_FLOOR(WASM_GET_LOCAL(0)));
@@ -3355,6 +3614,53 @@ TEST(Run_Wasm_F64NearestInt) {
 }
 
 
+// Tests the lowering of the rounding {opcode} on machines without rounding
+// instructions.
+static void TestFloat32RoundWithoutInstruction(WasmOpcode opcode,
+                                               float (*expected)(float)) {
+  WasmRunner<float> r(MachineOperatorBuilder::kNoFlags, MachineType::Float32());
+  BUILD(r, WASM_UNOP(opcode, WASM_GET_LOCAL(0)));
+
+  FOR_FLOAT32_INPUTS(i) { CheckFloatEq(expected(*i), r.Call(*i)); }
+  CheckFloatEq(-0.0f, r.Call(-0.0f));
+  CheckFloatEq(expected(-0.5f), r.Call(-0.5f));
+  CheckFloatEq(expected(2.5f), r.Call(2.5f));
+  CheckFloatEq(expected(8388607.5f), r.Call(8388607.5f));
+  CheckFloatEq(expected(-8388609.0f), r.Call(-8388609.0f));
+}
+
+
+TEST(Run_Wasm_F32RoundWithoutInstructions) {
+  TestFloat32RoundWithoutInstruction(kExprF32Floor, floorf);
+  TestFloat32RoundWithoutInstruction(kExprF32Ceil, ceilf);
+  TestFloat32RoundWithoutInstruction(kExprF32Trunc, truncf);
+  TestFloat32RoundWithoutInstruction(kExprF32NearestInt, nearbyintf);
+}
+
+
+static void TestFloat64RoundWithoutInstruction(WasmOpcode opcode,
+                                               double (*expected)(double)) {
+  WasmRunner<double> r(MachineOperatorBuilder::kNoFlags,
+                       MachineType::Float64());
+  BUILD(r, WASM_UNOP(opcode, WASM_GET_LOCAL(0)));
+
+  FOR_FLOAT64_INPUTS(i) { CheckDoubleEq(expected(*i), r.Call(*i)); }
+  CheckDoubleEq(-0.0, r.Call(-0.0));
+  CheckDoubleEq(expected(-0.5), r.Call(-0.5));
+  CheckDoubleEq(expected(2.5), r.Call(2.5));
+  CheckDoubleEq(expected(4503599627370495.5), r.Call(4503599627370495.5));
+  CheckDoubleEq(expected(-4503599627370497.0), r.Call(-4503599627370497.0));
+}
+
+
+TEST(Run_Wasm_F64RoundWithoutInstructions) {
+  TestFloat64RoundWithoutInstruction(kExprF64Floor, floor);
+  TestFloat64RoundWithoutInstruction(kExprF64Ceil, ceil);
+  TestFloat64RoundWithoutInstruction(kExprF64Trunc, trunc);
+  TestFloat64RoundWithoutInstruction(kExprF64NearestInt, nearbyint);
+}
+
+
 TEST(Run_Wasm_F32Min) {
   WasmRunner<float> r(MachineType::Float32(), MachineType::Float32());
   BUILD(r, WASM_F32_MIN(WASM_GET_LOCAL(0), WASM_GET_LOCAL(1)));
@@ -3469,3 +3775,323 @@ TEST(Run_Wasm_F32CopySign) {
     }
   }
 }
+
+
+TEST(Run_Wasm_I32x4Add) {
+  WasmRunner<int32_t> r(MachineType::Int32(), MachineType::Int32());
+  const byte kSimd = r.AllocateLocal(kAstS128);
+  BUILD(r, WASM_SET_LOCAL(kSimd, WASM_I32X4_REPLACE_LANE(
+                                     1, WASM_I32X4_SPLAT(WASM_GET_LOCAL(0)),
+                                     WASM_GET_LOCAL(1))),
+        WASM_SET_LOCAL(kSimd, WASM_I32X4_ADD(WASM_GET_LOCAL(kSimd),
+                                             WASM_GET_LOCAL(kSimd))),
+        WASM_I32_SUB(WASM_I32X4_EXTRACT_LANE(1, WASM_GET_LOCAL(kSimd)),
+                     WASM_I32X4_EXTRACT_LANE(3, WASM_GET_LOCAL(kSimd))));
+
+  FOR_INT32_INPUTS(i) {
+    FOR_INT32_INPUTS(j) {
+      uint32_t expected = 2 * static_cast<uint32_t>(*j) -
+                          2 * static_cast<uint32_t>(*i);
+      CHECK_EQ(static_cast<int32_t>(expected), r.Call(*i, *j));
+    }
+  }
+}
+
+
+TEST(Run_Wasm_F32x4Arithmetic) {
+  WasmRunner<float> r(MachineType::Float32(), MachineType::Float32());
+  BUILD(r, WASM_F32X4_EXTRACT_LANE(
+               2, WASM_F32X4_ADD(
+                      WASM_F32X4_MUL(WASM_F32X4_SPLAT(WASM_GET_LOCAL(0)),
+                                     WASM_F32X4_SPLAT(WASM_GET_LOCAL(1))),
+                      WASM_F32X4_NEG(WASM_F32X4_SPLAT(WASM_GET_LOCAL(0))))));
+
+  FOR_FLOAT32_INPUTS(i) {
+    FOR_FLOAT32_INPUTS(j) {
+      float product = *i * *j;
+      float expect = product - *i;
+      float result = r.Call(*i, *j);
+      if (std::isnan(expect)) {
+        CHECK(std::isnan(result));
+      } else {
+        CHECK_EQ(expect, result);
+      }
+    }
+  }
+}
+
+
+TEST(Run_Wasm_F32x4SConvertI32x4) {
+  WasmRunner<float> r(MachineType::Int32());
+  BUILD(r, WASM_F32X4_EXTRACT_LANE(
+               0, WASM_F32X4_SCONVERT_I32X4(
+                      WASM_I32X4_SPLAT(WASM_GET_LOCAL(0)))));
+
+  FOR_INT32_INPUTS(i) {
+    CHECK_EQ(static_cast<float>(*i), r.Call(*i));
+  }
+}
+
+
+TEST(Run_Wasm_S32x4Shuffle) {
+  static const int32_t kExpected[] = {12, 21, 10, 23};
+  for (int lane = 0; lane < kSimd128Lanes; lane++) {
+    WasmRunner<int32_t> r;
+    const byte kLeft = r.AllocateLocal(kAstS128);
+    const byte kRight = r.AllocateLocal(kAstS128);
+    BUILD(r, WASM_SET_LOCAL(kLeft, WASM_I32X4_SPLAT(WASM_I8(10))),
+          WASM_SET_LOCAL(kLeft, WASM_I32X4_REPLACE_LANE(
+                                    1, WASM_GET_LOCAL(kLeft), WASM_I8(11))),
+          WASM_SET_LOCAL(kLeft, WASM_I32X4_REPLACE_LANE(
+                                    2, WASM_GET_LOCAL(kLeft), WASM_I8(12))),
+          WASM_SET_LOCAL(kRight, WASM_I32X4_SPLAT(WASM_I8(21))),
+          WASM_SET_LOCAL(kRight, WASM_I32X4_REPLACE_LANE(
+                                     3, WASM_GET_LOCAL(kRight), WASM_I8(23))),
+          WASM_I32X4_EXTRACT_LANE(
+              lane, WASM_S32X4_SHUFFLE(2, 5, 0, 7, WASM_GET_LOCAL(kLeft),
+                                       WASM_GET_LOCAL(kRight))));
+    CHECK_EQ(kExpected[lane], r.Call());
+  }
+}
+
+
+TEST(Run_Wasm_S128LoadStoreMem) {
+  WasmRunner<int32_t> r(MachineType::Int32());
+  TestingModule module;
+  int32_t* memory = module.AddMemoryElems<int32_t>(8);
+  r.env()->module = &module;
+
+  // mem[16..32) = mem[index..index+16) + 1
+  BUILD(r, WASM_S128_STORE_MEM(
+               WASM_I8(16),
+               WASM_I32X4_ADD(WASM_S128_LOAD_MEM(WASM_GET_LOCAL(0)),
+                              WASM_I32X4_SPLAT(WASM_ONE))),
+        WASM_ZERO);
+
+  for (int i = 0; i < 8; i++) memory[i] = i * 100;
+  CHECK_EQ(0, r.Call(0));
+  for (int i = 0; i < 4; i++) CHECK_EQ(i * 100 + 1, memory[4 + i]);
+
+  for (int i = 0; i < 8; i++) memory[i] = i * 100;
+  CHECK_EQ(0, r.Call(8));
+  for (int i = 0; i < 4; i++) CHECK_EQ((i + 2) * 100 + 1, memory[4 + i]);
+
+  CHECK_EQ(0, r.Call(16));
+  CHECK_TRAP(r.Call(17));
+  CHECK_TRAP(r.Call(32));
+  CHECK_TRAP(r.Call(-1));
+}
+
+
+TEST(Run_Wasm_I32x4Loop) {
+  WasmRunner<int32_t> r(MachineType::Int32());
+  const byte kSum = r.AllocateLocal(kAstS128);
+  // Lane 0 counts the iterations and lane 2 sums the loop counter.
+  BUILD(r, WASM_WHILE(
+               WASM_GET_LOCAL(0),
+               WASM_BLOCK(
+                   2, WASM_SET_LOCAL(
+                          kSum, WASM_I32X4_ADD(
+                                    WASM_GET_LOCAL(kSum),
+                                    WASM_I32X4_REPLACE_LANE(
+                                        2, WASM_I32X4_SPLAT(WASM_ONE),
+                                        WASM_GET_LOCAL(0)))),
+                   WASM_SET_LOCAL(0, WASM_I32_SUB(WASM_GET_LOCAL(0),
+                                                  WASM_ONE)))),
+        WASM_I32_ADD(WASM_I32X4_EXTRACT_LANE(0, WASM_GET_LOCAL(kSum)),
+                     WASM_I32X4_EXTRACT_LANE(2, WASM_GET_LOCAL(kSum))));
+
+  for (int32_t n = 0; n < 20; n++) {
+    CHECK_EQ(n + n * (n + 1) / 2, r.Call(n));
+  }
+}
+
+
+TEST(Run_Wasm_AtomicLoadStore) {
+  WasmRunner<int32_t> r(MachineType::Int32());
+  TestingModule module;
+  int32_t* memory = module.AddMemoryElems<int32_t>(8);
+  r.env()->module = &module;
+
+  // mem[4] = p0; return mem[index 8 + offset 8]
+  BUILD(r, WASM_ATOMIC_STORE_MEM(WASM_I8(16), WASM_GET_LOCAL(0)),
+        WASM_ATOMIC_LOAD_MEM_OFFSET(8, WASM_I8(8)));
+
+  FOR_INT32_INPUTS(i) {
+    memory[4] = 0;
+    CHECK_EQ(*i, r.Call(*i));
+    CHECK_EQ(*i, memory[4]);
+  }
+}
+
+
+TEST(Run_Wasm_I32AtomicBinops) {
+  static const struct {
+    WasmOpcode opcode;
+    uint32_t (*expected)(uint32_t, uint32_t);
+  } kOps[] = {
+      {kExprI32AtomicAdd, [](uint32_t a, uint32_t b) { return a + b; }},
+      {kExprI32AtomicSub, [](uint32_t a, uint32_t b) { return a - b; }},
+      {kExprI32AtomicAnd, [](uint32_t a, uint32_t b) { return a & b; }},
+      {kExprI32AtomicOr, [](uint32_t a, uint32_t b) { return a | b; }},
+      {kExprI32AtomicXor, [](uint32_t a, uint32_t b) { return a ^ b; }},
+      {kExprI32AtomicExchange, [](uint32_t a, uint32_t b) { return b; }}};
+  for (size_t k = 0; k < arraysize(kOps); k++) {
+    WasmRunner<uint32_t> r(MachineType::Uint32());
+    TestingModule module;
+    uint32_t* memory = module.AddMemoryElems<uint32_t>(4);
+    r.env()->module = &module;
+    BUILD(r, WASM_ATOMIC_BINOP(kOps[k].opcode, WASM_I8(8), WASM_GET_LOCAL(0)));
+
+    FOR_UINT32_INPUTS(i) {
+      FOR_UINT32_INPUTS(j) {
+        memory[2] = *i;
+        CHECK_EQ(*i, r.Call(*j));
+        CHECK_EQ(kOps[k].expected(*i, *j), memory[2]);
+      }
+    }
+  }
+}
+
+
+TEST(Run_Wasm_I32AtomicCompareExchange) {
+  WasmRunner<int32_t> r(MachineType::Int32(), MachineType::Int32());
+  TestingModule module;
+  int32_t* memory = module.AddMemoryElems<int32_t>(4);
+  r.env()->module = &module;
+  BUILD(r, WASM_I32_ATOMIC_COMPARE_EXCHANGE(WASM_I8(4), WASM_GET_LOCAL(0),
+                                            WASM_GET_LOCAL(1)));
+
+  memory[1] = 11;
+  CHECK_EQ(11, r.Call(10, 22));
+  CHECK_EQ(11, memory[1]);
+  CHECK_EQ(11, r.Call(11, 22));
+  CHECK_EQ(22, memory[1]);
+}
+
+
+TEST(Run_Wasm_AtomicAlignmentAndBounds) {
+  WasmRunner<int32_t> r(MachineType::Int32());
+  TestingModule module;
+  module.AddMemoryElems<int32_t>(8);
+  r.env()->module = &module;
+  BUILD(r, WASM_I32_ATOMIC_ADD(WASM_GET_LOCAL(0), WASM_ONE));
+
+  for (int32_t i = 0; i < 32; i++) {
+    if (i % 4 == 0) {
+      CHECK_EQ(0, r.Call(i));
+    } else {
+      CHECK_TRAP(r.Call(i));
+    }
+  }
+  CHECK_TRAP(r.Call(32));
+  CHECK_TRAP(r.Call(-4));
+}
+
+
+TEST(Run_Wasm_AtomicAsmJsMemoryBounds) {
+  WasmRunner<int32_t> r(MachineType::Int32());
+  TestingModule module;
+  int32_t* memory = module.AddMemoryElems<int32_t>(8);
+  module.asm_js = true;
+  r.env()->module = &module;
+  BUILD(r, WASM_I32_ATOMIC_ADD(WASM_GET_LOCAL(0), WASM_ONE));
+
+  // Atomics trap out of bounds instead of following asm.js semantics.
+  CHECK_TRAP(r.Call(32));
+  CHECK_TRAP(r.Call(36));
+  CHECK_EQ(0, memory[0]);
+  CHECK_EQ(0, memory[1]);
+  CHECK_EQ(0, r.Call(4));
+  CHECK_EQ(1, memory[1]);
+}
+
+
+TEST(Run_Wasm_AtomicWaitUnshared) {
+  TestingModule module;
+  int32_t* memory = module.AddMemoryElems<int32_t>(4);
+  memory[0] = 7;
+  module.AllocModule();
+
+  // Nothing could notify a wait on a memory that is not shared.
+  WasmRunner<int32_t> r(MachineType::Int32());
+  r.env()->module = &module;
+  BUILD(r, WASM_I32_ATOMIC_WAIT(WASM_ZERO, WASM_GET_LOCAL(0), WASM_ONE));
+  SetAtomicWaitAllowed(true);
+  CHECK_TRAP(r.Call(6));
+  CHECK_TRAP(r.Call(7));
+  SetAtomicWaitAllowed(false);
+}
+
+
+TEST(Run_Wasm_AtomicWaitNotify) {
+  TestingModule module;
+  int32_t* memory = module.AddMemoryElems<int32_t>(4);
+  memory[0] = 7;
+  module.AllocModule();
+  module.module->mem_shared = true;
+
+  {
+    // Waits for at most a millisecond on mem[0] holding p0.
+    WasmRunner<int32_t> r(MachineType::Int32());
+    r.env()->module = &module;
+    BUILD(r, WASM_I32_ATOMIC_WAIT(WASM_ZERO, WASM_GET_LOCAL(0), WASM_ONE));
+    SetAtomicWaitAllowed(true);
+    CHECK_EQ(kAtomicWaitNotEqual, r.Call(6));
+    CHECK_EQ(kAtomicWaitTimedOut, r.Call(7));
+    SetAtomicWaitAllowed(false);
+    // The thread may not block, even if the value differs.
+    CHECK_TRAP(r.Call(6));
+    CHECK_TRAP(r.Call(7));
+  }
+  {
+    // Nothing is waiting to be notified.
+    WasmRunner<int32_t> r(MachineType::Int32());
+    r.env()->module = &module;
+    BUILD(r, WASM_ATOMIC_NOTIFY(WASM_ZERO, WASM_GET_LOCAL(0)));
+    CHECK_EQ(0, r.Call(1));
+    CHECK_EQ(0, r.Call(-1));
+  }
+}
+
+
+namespace {
+// Notifies one waiter on {address} once a thread waits there.
+class NotifyThread : public v8::base::Thread {
+ public:
+  explicit NotifyThread(int32_t* address)
+      : Thread(Options("NotifyThread")), address_(address) {}
+
+  void Run() override {
+    while (AtomicOp(kExprAtomicNotify, address_, 1, 0) == 0) {
+      v8::base::OS::Sleep(v8::base::TimeDelta::FromMilliseconds(1));
+    }
+  }
+
+ private:
+  int32_t* address_;
+};
+}  // namespace
+
+
+TEST(Run_Wasm_AtomicWaitNotifyThreads) {
+  TestingModule module;
+  int32_t* memory = module.AddMemoryElems<int32_t>(4);
+  memory[1] = 7;
+  module.AllocModule();
+  module.module->mem_shared = true;
+
+  // Waits for at most ten seconds on mem[4] holding p0, until the other
+  // thread notifies it.
+  WasmRunner<int32_t> r(MachineType::Int32());
+  r.env()->module = &module;
+  BUILD(r, WASM_I32_ATOMIC_WAIT(WASM_I8(4), WASM_GET_LOCAL(0),
+                                WASM_I32(10000)));
+  SetAtomicWaitAllowed(true);
+  NotifyThread thread(&memory[1]);
+  thread.Start();
+  CHECK_EQ(kAtomicWaitOk, r.Call(7));
+  thread.Join();
+  SetAtomicWaitAllowed(false);
+}
+
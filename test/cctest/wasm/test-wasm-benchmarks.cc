@@ -0,0 +1,554 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Benchmarks for the throughput of decoding, compiling, instantiating and
+// running wasm modules. Each benchmark builds synthetic modules of a
+// controlled shape with the WasmModuleBuilder, checks that they work, and
+// prints one result per line as a JSON object, e.g.
+//   {"benchmark": "decode/many-functions", "value": 52.125, "unit": "MB/s"}
+// so that the results can be collected and compared across revisions. Every
+// value is the median over several rounds of repeated runs.
+//
+// The benchmarks take long, so they are built into their own executable
+// instead of cctest, and are run by name, e.g.
+//   out/x64.release/wasm_benchmarks test-wasm-benchmarks/Bench_WasmDecode
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "src/base/platform/elapsed-timer.h"
+#include "src/execution.h"
+#include "src/wasm/encoder.h"
+#include "src/wasm/module-decoder.h"
+#include "src/wasm/wasm-compiler.h"
+#include "src/wasm/wasm-macro-gen.h"
+#include "src/wasm/wasm-module.h"
+#include "src/wasm/wasm-opcodes.h"
+
+#include "test/cctest/cctest.h"
+#include "test/cctest/wasm/test-signatures.h"
+
+using namespace v8::base;
+using namespace v8::internal;
+using namespace v8::internal::compiler;
+using namespace v8::internal::wasm;
+
+
+namespace {
+// The number of measured rounds, and the time each round runs at least.
+const int kRounds = 7;
+const double kMinRoundTimeMs = 20;
+
+// Runs {op} once to warm up, then in {kRounds} rounds, and returns the median
+// of the average times of {op} in the rounds, in milliseconds.
+template <typename Op>
+double MedianMillis(Op op) {
+  op();
+  std::vector<double> times;
+  for (int round = 0; round < kRounds; round++) {
+    ElapsedTimer timer;
+    timer.Start();
+    int count = 0;
+    double elapsed;
+    do {
+      op();
+      count++;
+      elapsed = timer.Elapsed().InMillisecondsF();
+    } while (elapsed < kMinRoundTimeMs);
+    times.push_back(elapsed / count);
+  }
+  std::sort(times.begin(), times.end());
+  return times[kRounds / 2];
+}
+
+
+void Report(const char* benchmark, const char* shape, double value,
+            const char* unit) {
+  PrintF("{\"benchmark\": \"%s/%s\", \"value\": %.3f, \"unit\": \"%s\"}\n",
+         benchmark, shape, value, unit);
+}
+
+
+void Append(std::vector<byte>* body, const byte* code, size_t size) {
+  body->insert(body->end(), code, code + size);
+}
+
+
+WasmFunctionBuilder* AddMain(WasmModuleBuilder* builder) {
+  uint16_t f_index =
+      builder->AddFunction(reinterpret_cast<const unsigned char*>("main"), 4);
+  WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  return f;
+}
+
+
+// Many small functions.
+void BuildManyFunctions(Zone* zone, WasmModuleBuilder* builder) {
+  static const int kFunctionCount = 1000;
+  for (int i = 0; i < kFunctionCount; i++) {
+    uint16_t f_index = builder->AddFunction();
+    WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+    f->ReturnType(kAstI32);
+    f->AddParam(kAstI32);
+    byte code[] = {WASM_I32_ADD(WASM_GET_LOCAL(0), WASM_I8(i))};
+    f->EmitCode(code, sizeof(code));
+  }
+}
+
+
+// A single function with a long straight-line body.
+void BuildBigBody(Zone* zone, WasmModuleBuilder* builder) {
+  static const int kStatementCount = 5000;
+  WasmFunctionBuilder* f = AddMain(builder);
+  f->AddLocal(kAstI32);
+  std::vector<byte> body;
+  for (int i = 0; i < kStatementCount; i++) {
+    byte code[] = {WASM_SET_LOCAL(
+        0, WASM_I32_ADD(WASM_I32_MUL(WASM_GET_LOCAL(0), WASM_I8(3)),
+                        WASM_I8(i)))};
+    Append(&body, code, sizeof(code));
+  }
+  byte code[] = {WASM_GET_LOCAL(0)};
+  Append(&body, code, sizeof(code));
+  f->EmitCode(&body[0], static_cast<uint32_t>(body.size()));
+}
+
+
+// A single function of deeply nested conditionals.
+void BuildDeepNesting(Zone* zone, WasmModuleBuilder* builder) {
+  static const int kDepth = 100;
+  WasmFunctionBuilder* f = AddMain(builder);
+  f->AddLocal(kAstI32);
+  std::vector<byte> body;
+  for (int i = 0; i < kDepth; i++) {
+    byte code[] = {kExprIfElse, WASM_I32_LTS(WASM_GET_LOCAL(0), WASM_I8(i))};
+    Append(&body, code, sizeof(code));
+  }
+  byte innermost[] = {WASM_BLOCK(1, WASM_I8(kDepth))};
+  Append(&body, innermost, sizeof(innermost));
+  for (int i = 0; i < kDepth; i++) {
+    byte code[] = {WASM_I8(i)};
+    Append(&body, code, sizeof(code));
+  }
+  f->EmitCode(&body[0], static_cast<uint32_t>(body.size()));
+}
+
+
+// A single function with many locals. All locals are i32s, so that their
+// indices do not change when the builder orders them by type.
+void BuildManyLocals(Zone* zone, WasmModuleBuilder* builder) {
+  static const int kLocalCount = 120;
+  WasmFunctionBuilder* f = AddMain(builder);
+  for (int i = 0; i < kLocalCount; i++) f->AddLocal(kAstI32);
+  std::vector<byte> body;
+  for (int i = 1; i < kLocalCount; i++) {
+    byte code[] = {WASM_SET_LOCAL(
+        i, WASM_I32_ADD(WASM_GET_LOCAL(i - 1), WASM_I8(i)))};
+    Append(&body, code, sizeof(code));
+  }
+  byte code[] = {WASM_GET_LOCAL(kLocalCount - 1)};
+  Append(&body, code, sizeof(code));
+  f->EmitCode(&body[0], static_cast<uint32_t>(body.size()));
+}
+
+
+// Data segments that fill the whole memory.
+void BuildLargeData(Zone* zone, WasmModuleBuilder* builder) {
+  static const int kSegmentCount = 16;
+  static const uint32_t kSegmentSize = 4096;
+  WasmFunctionBuilder* f = AddMain(builder);
+  byte code[] = {WASM_LOAD_MEM(MachineType::Int32(), WASM_ZERO)};
+  f->EmitCode(code, sizeof(code));
+  byte data[kSegmentSize];
+  for (int i = 0; i < kSegmentCount; i++) {
+    for (uint32_t j = 0; j < kSegmentSize; j++) {
+      data[j] = static_cast<byte>(i + j);
+    }
+    builder->AddDataSegment(new (zone) WasmDataSegmentEncoder(
+        zone, data, kSegmentSize, i * kSegmentSize));
+  }
+}
+
+
+struct ModuleShape {
+  const char* name;
+  void (*build)(Zone* zone, WasmModuleBuilder* builder);
+};
+
+const ModuleShape kShapes[] = {{"many-functions", BuildManyFunctions},
+                               {"big-body", BuildBigBody},
+                               {"deep-nesting", BuildDeepNesting},
+                               {"many-locals", BuildManyLocals},
+                               {"large-data", BuildLargeData}};
+
+
+WasmModuleIndex* BuildModule(Zone* zone, const ModuleShape& shape) {
+  WasmModuleBuilder* builder = new (zone) WasmModuleBuilder(zone);
+  shape.build(zone, builder);
+  return builder->Build(zone)->WriteTo(zone);
+}
+
+
+WasmModule* DecodeModule(Isolate* isolate, Zone* zone,
+                         WasmModuleIndex* index) {
+  ModuleResult result = DecodeWasmModule(isolate, zone, index->Begin(),
+                                         index->End(), true, false);
+  CHECK(result.ok());
+  return result.val;
+}
+
+
+Handle<JSObject> InstantiateModule(
+    Isolate* isolate, WasmModule* module,
+    BoundsCheckMode bounds_checks = kExplicitBoundsChecks) {
+  Handle<JSObject> ffi = Handle<JSObject>::null();
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::null();
+  return module
+      ->Instantiate(isolate, ffi, memory, kEagerCompilation, bounds_checks)
+      .ToHandleChecked();
+}
+
+
+int32_t CallExport(Isolate* isolate, Handle<JSObject> instance,
+                   const char* name) {
+  Handle<String> str = isolate->factory()->InternalizeUtf8String(name);
+  Handle<Object> function =
+      Object::GetProperty(instance, str).ToHandleChecked();
+  Handle<Object> undefined = isolate->factory()->undefined_value();
+  Handle<Object> result =
+      Execution::Call(isolate, function, undefined, 0, nullptr)
+          .ToHandleChecked();
+  return static_cast<int32_t>(result->Number());
+}
+
+
+byte* InstanceMemory(Handle<JSObject> instance) {
+  return reinterpret_cast<byte*>(
+      JSArrayBuffer::cast(instance->GetInternalField(kWasmMemArrayBuffer))
+          ->backing_store());
+}
+
+
+// Measures the time of a call of the export "main" of {module}, which must
+// return {expected}.
+void ReportKernel(Isolate* isolate, WasmModule* module, const char* kernel,
+                  int32_t expected) {
+  Handle<JSObject> instance = InstantiateModule(isolate, module);
+  CHECK_EQ(expected, CallExport(isolate, instance, "main"));
+  double ms = MedianMillis([=]() {
+    HandleScope scope(isolate);
+    CallExport(isolate, instance, "main");
+  });
+  Report("execute", kernel, ms, "ms");
+}
+}  // namespace
+
+
+TEST(Bench_WasmDecode) {
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  for (const ModuleShape& shape : kShapes) {
+    Zone zone;
+    WasmModuleIndex* index = BuildModule(&zone, shape);
+    double size = static_cast<double>(index->End() - index->Begin());
+    double ms = MedianMillis([=]() {
+      Zone decode_zone;
+      delete DecodeModule(isolate, &decode_zone, index);
+    });
+    Report("decode", shape.name, size / MB / (ms / 1000), "MB/s");
+  }
+}
+
+
+TEST(Bench_WasmCompile) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  for (const ModuleShape& shape : kShapes) {
+    Zone zone;
+    WasmModule* module =
+        DecodeModule(isolate, &zone, BuildModule(&zone, shape));
+
+    // The functions do not call each other or use globals, so they can be
+    // compiled without linking. The memory accesses of the large-data shape
+    // are compiled against an empty memory, which is fine since the code is
+    // never run.
+    std::vector<Handle<Code>> function_code(module->functions->size());
+    ModuleEnv module_env;
+    module_env.module = module;
+    module_env.mem_start = 0;
+    module_env.mem_end = 0;
+    module_env.globals_area = 0;
+    module_env.linker = nullptr;
+    module_env.function_code = &function_code;
+    module_env.asm_js = false;
+
+    double ms = MedianMillis([=, &module_env]() {
+      HandleScope scope(isolate);
+      ErrorThrower thrower(isolate, "Bench_WasmCompile");
+      int index = 0;
+      for (const WasmFunction& func : *module->functions) {
+        Handle<Code> code = CompileWasmFunction(thrower, isolate, &module_env,
+                                                func, index++);
+        CHECK(!code.is_null());
+      }
+    });
+    double count = static_cast<double>(module->functions->size());
+    Report("compile", shape.name, count / (ms / 1000), "functions/s");
+    delete module;
+  }
+}
+
+
+TEST(Bench_WasmInstantiate) {
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  for (const ModuleShape& shape : kShapes) {
+    Zone zone;
+    WasmModule* module =
+        DecodeModule(isolate, &zone, BuildModule(&zone, shape));
+    double ms = MedianMillis([=]() {
+      HandleScope scope(isolate);
+      InstantiateModule(isolate, module);
+    });
+    Report("instantiate", shape.name, ms, "ms");
+    delete module;
+  }
+}
+
+
+TEST(Bench_WasmMemoryCopy) {
+  static const uint32_t kCopySize = 32 * KB;
+  static const uint32_t kSegmentSize = 4 * KB;
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new (&zone) WasmModuleBuilder(&zone);
+  WasmFunctionBuilder* f = AddMain(builder);
+  f->AddLocal(kAstI32);
+  // Copies the lower half of the memory into the upper half, one word at a
+  // time, and returns the last word copied.
+  byte code[] = {WASM_BLOCK(
+      2, WASM_WHILE(
+             WASM_I32_LTU(WASM_GET_LOCAL(0), WASM_I32(kCopySize)),
+             WASM_BLOCK(
+                 2, WASM_STORE_MEM(
+                        MachineType::Int32(),
+                        WASM_I32_ADD(WASM_GET_LOCAL(0), WASM_I32(kCopySize)),
+                        WASM_LOAD_MEM(MachineType::Int32(), WASM_GET_LOCAL(0))),
+                 WASM_INC_LOCAL_BY(0, 4))),
+      WASM_LOAD_MEM(MachineType::Int32(), WASM_I32(2 * kCopySize - 4)))};
+  f->EmitCode(code, sizeof(code));
+  byte data[kSegmentSize];
+  for (uint32_t i = 0; i < kCopySize; i += kSegmentSize) {
+    for (uint32_t j = 0; j < kSegmentSize; j++) {
+      data[j] = static_cast<byte>((i + j) * 7);
+    }
+    builder->AddDataSegment(new (&zone) WasmDataSegmentEncoder(
+        &zone, data, kSegmentSize, i));
+  }
+  WasmModule* module =
+      DecodeModule(isolate, &zone, builder->Build(&zone)->WriteTo(&zone));
+
+  Handle<JSObject> instance = InstantiateModule(isolate, module);
+  CallExport(isolate, instance, "main");
+  byte* memory = InstanceMemory(instance);
+  CHECK_EQ(0, memcmp(memory, memory + kCopySize, kCopySize));
+  int32_t expected;
+  memcpy(&expected, memory + kCopySize - 4, sizeof(expected));
+  ReportKernel(isolate, module, "memory-copy", expected);
+  delete module;
+}
+
+
+TEST(Bench_WasmBoundsChecks) {
+  // Stores each word of the 64kb memory, and returns the sum of the words
+  // loaded back, under each way of keeping the accesses in bounds.
+  static const uint32_t kMemSize = 64 * KB;
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new (&zone) WasmModuleBuilder(&zone);
+  WasmFunctionBuilder* f = AddMain(builder);
+  f->AddLocal(kAstI32);
+  f->AddLocal(kAstI32);
+  byte code[] = {WASM_BLOCK(
+      2, WASM_WHILE(
+             WASM_I32_LTU(WASM_GET_LOCAL(0), WASM_I32(kMemSize)),
+             WASM_BLOCK(
+                 3, WASM_STORE_MEM(MachineType::Int32(), WASM_GET_LOCAL(0),
+                                   WASM_GET_LOCAL(0)),
+                 WASM_SET_LOCAL(
+                     1, WASM_I32_ADD(WASM_GET_LOCAL(1),
+                                     WASM_LOAD_MEM(MachineType::Int32(),
+                                                   WASM_GET_LOCAL(0)))),
+                 WASM_INC_LOCAL_BY(0, 4))),
+      WASM_GET_LOCAL(1))};
+  f->EmitCode(code, sizeof(code));
+  WasmModule* module =
+      DecodeModule(isolate, &zone, builder->Build(&zone)->WriteTo(&zone));
+
+  const int32_t kExpected = 4 * ((kMemSize / 4) * (kMemSize / 4 - 1) / 2);
+  const struct {
+    const char* name;
+    BoundsCheckMode mode;
+  } modes[] = {{"bounds-checks/explicit", kExplicitBoundsChecks},
+               {"bounds-checks/asm-js", kAsmJsBoundsChecks},
+               {"bounds-checks/guard-region", kGuardRegionBoundsChecks}};
+  for (const auto& mode : modes) {
+    Handle<JSObject> instance = InstantiateModule(isolate, module, mode.mode);
+    CHECK_EQ(kExpected, CallExport(isolate, instance, "main"));
+    double ms = MedianMillis([=]() {
+      HandleScope scope(isolate);
+      CallExport(isolate, instance, "main");
+    });
+    Report("execute", mode.name, ms, "ms");
+    Report("code-size", mode.name,
+           static_cast<double>(WasmModule::CodeSize(instance)), "bytes");
+  }
+  delete module;
+}
+
+
+TEST(Bench_WasmMatrixMultiply) {
+  // Multiplies two 32x32 matrices of i32s, A at 0 and B right after it, into
+  // C after B, and returns the sum of the elements of C.
+  static const int kLog2N = 5;
+  static const int kN = 1 << kLog2N;
+  static const int kMatrixSize = kN * kN * 4;
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  Zone zone;
+  WasmModuleBuilder* builder = new (&zone) WasmModuleBuilder(&zone);
+  WasmFunctionBuilder* f = AddMain(builder);
+  const byte kI = f->AddLocal(kAstI32);
+  const byte kJ = f->AddLocal(kAstI32);
+  const byte kK = f->AddLocal(kAstI32);
+  const byte kSum = f->AddLocal(kAstI32);
+  const byte kTotal = f->AddLocal(kAstI32);
+#define ELEMENT_ADDRESS(base, row, column)                                  \
+  WASM_I32_ADD(WASM_I32(base),                                              \
+               WASM_I32_SHL(WASM_I32_ADD(WASM_I32_SHL(WASM_GET_LOCAL(row),  \
+                                                      WASM_I8(kLog2N)),     \
+                                         WASM_GET_LOCAL(column)),           \
+                            WASM_I8(2)))
+  byte code[] = {WASM_BLOCK(
+      2,
+      WASM_WHILE(
+          WASM_I32_LTS(WASM_GET_LOCAL(kI), WASM_I8(kN)),
+          WASM_BLOCK(
+              3, WASM_SET_LOCAL(kJ, WASM_ZERO),
+              WASM_WHILE(
+                  WASM_I32_LTS(WASM_GET_LOCAL(kJ), WASM_I8(kN)),
+                  WASM_BLOCK(
+                      6, WASM_SET_LOCAL(kSum, WASM_ZERO),
+                      WASM_SET_LOCAL(kK, WASM_ZERO),
+                      WASM_WHILE(
+                          WASM_I32_LTS(WASM_GET_LOCAL(kK), WASM_I8(kN)),
+                          WASM_BLOCK(
+                              2,
+                              WASM_SET_LOCAL(
+                                  kSum,
+                                  WASM_I32_ADD(
+                                      WASM_GET_LOCAL(kSum),
+                                      WASM_I32_MUL(
+                                          WASM_LOAD_MEM(
+                                              MachineType::Int32(),
+                                              ELEMENT_ADDRESS(0, kI, kK)),
+                                          WASM_LOAD_MEM(
+                                              MachineType::Int32(),
+                                              ELEMENT_ADDRESS(kMatrixSize, kK,
+                                                              kJ))))),
+                              WASM_INC_LOCAL(kK))),
+                      WASM_STORE_MEM(MachineType::Int32(),
+                                     ELEMENT_ADDRESS(2 * kMatrixSize, kI, kJ),
+                                     WASM_GET_LOCAL(kSum)),
+                      WASM_SET_LOCAL(kTotal,
+                                     WASM_I32_ADD(WASM_GET_LOCAL(kTotal),
+                                                  WASM_GET_LOCAL(kSum))),
+                      WASM_INC_LOCAL(kJ))),
+              WASM_INC_LOCAL(kI))),
+      WASM_GET_LOCAL(kTotal))};
+#undef ELEMENT_ADDRESS
+  f->EmitCode(code, sizeof(code));
+  int32_t a[kN * kN];
+  int32_t b[kN * kN];
+  for (int i = 0; i < kN * kN; i++) {
+    a[i] = i % 7 - 3;
+    b[i] = i % 11 - 5;
+  }
+  builder->AddDataSegment(new (&zone) WasmDataSegmentEncoder(
+      &zone, reinterpret_cast<byte*>(a), kMatrixSize, 0));
+  builder->AddDataSegment(new (&zone) WasmDataSegmentEncoder(
+      &zone, reinterpret_cast<byte*>(b), kMatrixSize, kMatrixSize));
+  WasmModule* module =
+      DecodeModule(isolate, &zone, builder->Build(&zone)->WriteTo(&zone));
+
+  uint32_t expected = 0;
+  for (int i = 0; i < kN; i++) {
+    for (int j = 0; j < kN; j++) {
+      for (int k = 0; k < kN; k++) {
+        expected += static_cast<uint32_t>(a[i * kN + k] * b[k * kN + j]);
+      }
+    }
+  }
+  ReportKernel(isolate, module, "matrix-multiply",
+               static_cast<int32_t>(expected));
+  delete module;
+}
+
+
+TEST(Bench_WasmIndirectCalls) {
+  // Calls through the function table, rotating over its entries.
+  static const int kTableSize = 4;
+  static const int kCallCount = 4096;
+  v8::HandleScope scope(CcTest::isolate());
+  LocalContext env;
+  Isolate* isolate = CcTest::i_isolate();
+  TestSignatures sigs;
+  Zone zone;
+  WasmModuleBuilder* builder = new (&zone) WasmModuleBuilder(&zone);
+  uint16_t sig_index = builder->AddSignature(sigs.i_i());
+  for (int i = 0; i < kTableSize; i++) {
+    uint16_t f_index = builder->AddFunction();
+    WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+    f->ReturnType(kAstI32);
+    f->AddParam(kAstI32);
+    byte code[] = {WASM_I32_ADD(WASM_GET_LOCAL(0), WASM_I8(i + 1))};
+    f->EmitCode(code, sizeof(code));
+    builder->AddIndirectFunction(f_index);
+  }
+  WasmFunctionBuilder* f = AddMain(builder);
+  const byte kCounter = f->AddLocal(kAstI32);
+  const byte kSum = f->AddLocal(kAstI32);
+  byte code[] = {WASM_BLOCK(
+      2, WASM_WHILE(
+             WASM_I32_LTS(WASM_GET_LOCAL(kCounter), WASM_I32(kCallCount)),
+             WASM_BLOCK(
+                 2, WASM_SET_LOCAL(
+                        kSum, WASM_CALL_INDIRECT(
+                                  sig_index,
+                                  WASM_I32_AND(WASM_GET_LOCAL(kCounter),
+                                               WASM_I8(kTableSize - 1)),
+                                  WASM_GET_LOCAL(kSum))),
+                 WASM_INC_LOCAL(kCounter))),
+      WASM_GET_LOCAL(kSum))};
+  f->EmitCode(code, sizeof(code));
+  WasmModule* module =
+      DecodeModule(isolate, &zone, builder->Build(&zone)->WriteTo(&zone));
+
+  // Each round over the table adds 1 + 2 + ... + kTableSize.
+  int32_t expected =
+      kCallCount / kTableSize * (kTableSize * (kTableSize + 1) / 2);
+  ReportKernel(isolate, module, "indirect-calls", expected);
+  delete module;
+}
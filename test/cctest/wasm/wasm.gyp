@@ -3,6 +3,10 @@
 # found in the LICENSE file.
 
 {
+  'variables': {
+    'v8_code': 1,
+  },
+  'includes': ['../../../build/toolchain.gypi', '../../../build/features.gypi'],
   'targets': [
     {
       'target_name': 'wasm_cctest',
@@ -17,5 +21,35 @@
         ],
       },
     },
+    {
+      'target_name': 'wasm_benchmarks',
+      'type': 'executable',
+      # The throughput benchmarks, which print their results as JSON lines.
+      # They are too slow for the test runs, so they get their own copy of the
+      # cctest runner instead of being injected into cctest.
+      'include_dirs': ['../../..'],
+      'sources': [
+        '../cctest.cc',
+        '../print-extension.cc',
+        '../profiler-extension.cc',
+        '../trace-extension.cc',
+        'test-wasm-benchmarks.cc',
+      ],
+      'conditions': [
+        ['component=="shared_library"', {
+          # Like cctest, the benchmarks use internals that a shared library
+          # does not export.
+          'dependencies': [
+            '../../../tools/gyp/v8.gyp:v8_maybe_snapshot',
+            '../../../tools/gyp/v8.gyp:v8_libplatform',
+          ],
+        }, {
+          'dependencies': [
+            '../../../tools/gyp/v8.gyp:v8',
+            '../../../tools/gyp/v8.gyp:v8_libplatform',
+          ],
+        }],
+      ],
+    },
   ],
 }
@@ -396,6 +396,16 @@ function TestFloatHeapAccess(stdlib, foreign, buffer) {
 
 assertEquals(1, WASM.asmCompileRun(TestFloatHeapAccess.toString()));
 
+// Instantiated asm.js modules mask the indices of their heap accesses.
+function TestMaskedHeapAccess() {
+  var module = WASM.instantiateModuleFromAsm(TestInt32HeapAccess.toString());
+  assertEquals(7, module.caller());
+  module = WASM.instantiateModuleFromAsm(TestFloatHeapAccess.toString());
+  assertEquals(1, module.caller());
+}
+
+TestMaskedHeapAccess();
+
 function TestConvertI32() {
   "use asm";
 
@@ -0,0 +1,74 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+var kReturnValue = 97;
+
+var kBodySize = 2;
+var kNameOffset = 19 + kBodySize + 1;
+
+var data = bytes(
+  // -- memory
+  kDeclMemory,
+  10, 10, 1,
+  // -- signatures
+  kDeclSignatures, 1,
+  0, kAstI32,                 // signature: void -> int
+  // -- main function
+  kDeclFunctions, 1,
+  kDeclFunctionName | kDeclFunctionExport,
+  0, 0,                       // signature index
+  kNameOffset, 0, 0, 0,       // name offset
+  kBodySize, 0,               // body size
+  // -- body
+  kExprI8Const,               // --
+  kReturnValue,               // --
+  kDeclEnd,
+  'm', 'a', 'i', 'n', 0       // name
+);
+
+assertEquals("function", typeof WASM.codeCacheStats);
+
+var before = WASM.codeCacheStats();
+var module1 = WASM.instantiateModule(data);
+var after1 = WASM.codeCacheStats();
+assertEquals(before.misses + 1, after1.misses);
+assertEquals(before.hits, after1.hits);
+assertTrue(after1.size <= after1.budget);
+
+// A second instantiation of the same bytes reuses the cached code.
+var module2 = WASM.instantiateModule(data);
+var after2 = WASM.codeCacheStats();
+assertEquals(after1.misses, after2.misses);
+assertEquals(after1.hits + 1, after2.hits);
+assertEquals(after1.entries, after2.entries);
+
+assertEquals(kReturnValue, module1.main());
+assertEquals(kReturnValue, module2.main());
+
+// Each instance still gets its own memory.
+assertFalse(module1.memory === module2.memory);
+assertEquals(1024, module2.memory.byteLength);
+
+// A typed array view of equal bytes, at an offset into a larger buffer, hits
+// the same cached code.
+var view = new Uint8Array(new ArrayBuffer(data.byteLength + 16), 8,
+                          data.byteLength);
+view.set(new Uint8Array(data));
+var module3 = WASM.instantiateModule(view);
+var after3 = WASM.codeCacheStats();
+assertEquals(after2.misses, after3.misses);
+assertEquals(after2.hits + 1, after3.hits);
+assertEquals(kReturnValue, module3.main());
+
+// Every context has a cache of its own, which dies with the context.
+var realm = Realm.create();
+Realm.shared = data;
+assertEquals(0, Realm.eval(realm, "WASM.codeCacheStats().entries"));
+assertEquals(kReturnValue,
+             Realm.eval(realm, "WASM.instantiateModule(Realm.shared).main()"));
+assertEquals(1, Realm.eval(realm, "WASM.codeCacheStats().misses"));
+assertEquals(after3.entries, WASM.codeCacheStats().entries);
+Realm.dispose(realm);
@@ -0,0 +1,62 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+var kReturnValue = 55;
+
+var kBodySize = 2;
+var kNameOffset = 19 + kBodySize + 1;
+
+var data = bytes(
+  // -- memory
+  kDeclMemory,
+  10, 10, 1,
+  // -- signatures
+  kDeclSignatures, 1,
+  0, kAstI32,                 // signature: void -> int
+  // -- main function
+  kDeclFunctions, 1,
+  kDeclFunctionName | kDeclFunctionExport,
+  0, 0,                       // signature index
+  kNameOffset, 0, 0, 0,       // name offset
+  kBodySize, 0,               // body size
+  // -- body
+  kExprI8Const,               // --
+  kReturnValue,               // --
+  kDeclEnd,
+  'm', 'a', 'i', 'n', 0       // name
+);
+
+assertEquals("function", typeof WASM.instantiateModuleWithStats);
+
+function assertTime(time) {
+  assertEquals("number", typeof time);
+  assertTrue(time >= 0);
+}
+
+var result = WASM.instantiateModuleWithStats(data);
+assertEquals(kReturnValue, result.instance.main());
+
+var stats = result.stats;
+assertFalse(stats.cached);
+assertTime(stats.decodeTime);
+assertTime(stats.compileTime);
+assertTime(stats.linkTime);
+assertTime(stats.dataSegmentsTime);
+
+assertEquals(1, stats.functions.length);
+var main = stats.functions[0];
+assertEquals(0, main.index);
+assertTime(main.decodeTime);
+assertTime(main.pipelineTime);
+assertTrue(main.nodeCount > 0);
+assertTrue(main.codeSize > 0);
+assertTrue(main.graphZoneBytes > 0);
+
+// A second instantiation reuses the cached code and compiles nothing.
+var cached = WASM.instantiateModuleWithStats(data);
+assertEquals(kReturnValue, cached.instance.main());
+assertTrue(cached.stats.cached);
+assertEquals(0, cached.stats.functions.length);
@@ -0,0 +1,58 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Flags: --expose-gc --stress-compaction
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+// Returns the exported function of a new instance that adds its argument to
+// the i32 at address 0 of the memory and returns the sum. Nothing else of the
+// instance is kept alive.
+function genAccumulator(min_mem_log2, max_mem_log2) {
+  var kBodySize = 11;
+  var kNameAddOffset = 28 + kBodySize + 1;
+
+  var data = bytes(
+    kDeclMemory,
+    min_mem_log2, max_mem_log2, 0,  // memory, not exported
+    // -- signatures
+    kDeclSignatures, 1,
+    1, kAstI32, kAstI32,            // int->int
+    // -- add function
+    kDeclFunctions, 1,
+    kDeclFunctionLocals | kDeclFunctionName | kDeclFunctionExport,
+    0, 0,
+    kNameAddOffset, 0, 0, 0,        // name offset
+    0, 0,                           // local int32 count
+    0, 0,                           // local int64 count
+    0, 0,                           // local float32 count
+    0, 0,                           // local float64 count
+    kBodySize, 0,                   // code size
+    // add body: return mem[0] = mem[0] + a;
+    kExprI32StoreMem, 0, kExprI8Const, 0,
+      kExprI32Add,
+        kExprI32LoadMem, 0, kExprI8Const, 0,
+        kExprGetLocal, 0,
+    // names
+    kDeclEnd,
+    'a', 'd', 'd', 0                //  --
+  );
+
+  return WASM.instantiateModule(data, null, null).add;
+}
+
+function testExportKeepsMemoryAlive(min_mem_log2, max_mem_log2) {
+  var add = genAccumulator(min_mem_log2, max_mem_log2);
+  var sum = 0;
+  for (var i = 1; i <= 5; i++) {
+    gc();
+    sum += i;
+    assertEquals(sum, add(i));
+  }
+}
+
+// A memory allocated by the heap.
+testExportKeepsMemoryAlive(12, 12);
+// A memory in a reservation, so that it can grow.
+testExportKeepsMemoryAlive(12, 16);
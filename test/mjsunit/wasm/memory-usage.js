@@ -0,0 +1,46 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+var kReturnValue = 55;
+
+var kBodySize = 2;
+var kNameOffset = 19 + kBodySize + 1;
+
+var data = bytes(
+  // -- memory
+  kDeclMemory,
+  10, 10, 1,
+  // -- signatures
+  kDeclSignatures, 1,
+  0, kAstI32,                 // signature: void -> int
+  // -- main function
+  kDeclFunctions, 1,
+  kDeclFunctionName | kDeclFunctionExport,
+  0, 0,                       // signature index
+  kNameOffset, 0, 0, 0,       // name offset
+  kBodySize, 0,               // body size
+  // -- body
+  kExprI8Const,               // --
+  kReturnValue,               // --
+  kDeclEnd,
+  'm', 'a', 'i', 'n', 0       // name
+);
+
+assertEquals("function", typeof WASM.memoryUsage);
+
+var instance = WASM.instantiateModule(data);
+assertEquals(kReturnValue, instance.main());
+
+var usage = WASM.memoryUsage(instance);
+assertTrue(usage.code > 0);
+assertEquals(1 << 10, usage.memory);
+assertTrue(usage.globals >= 0);
+assertTrue(usage.tables > 0);
+assertTrue(usage.metadata > 0);
+
+assertThrows(function() { WASM.memoryUsage(); });
+assertThrows(function() { WASM.memoryUsage({}); });
+assertThrows(function() { WASM.memoryUsage(instance.main); });
@@ -137,3 +137,59 @@ testSelect10(kAstF32);
 testSelect10(kAstF64);
 
 
+
+
+function testConvertParam(type, inputs) {
+  var kBodySize = 2;
+  var kNameOffset = 16 + kBodySize + 1;
+
+  print("type = " + type);
+
+  var data = bytes(
+    // -- signatures
+    kDeclSignatures, 1,
+    1, type, type,              // signature: t->t
+    // -- id
+    kDeclFunctions, 1,
+    kDeclFunctionName | kDeclFunctionExport,
+    0, 0,
+    kNameOffset, 0, 0, 0,       // name offset
+    kBodySize, 0,               // body size
+    kExprGetLocal, 0,           // --
+    kDeclEnd,
+    'i','d',0                   // name
+  );
+
+  var module = WASM.instantiateModule(data);
+
+  assertEquals("function", typeof module.id);
+  for (var i = 0; i < inputs.length; i += 2) {
+    assertEquals(inputs[i + 1], module.id(inputs[i]));
+  }
+}
+
+var objWithValueOf = {valueOf: function() { return 5.25; }};
+
+testConvertParam(kAstI32, [
+  7, 7,
+  -7, -7,
+  7.5, 7,
+  -0.5, 0,
+  4294967299, 3,
+  "9", 9,
+  true, 1,
+  null, 0,
+  undefined, 0,
+  objWithValueOf, 5
+]);
+
+testConvertParam(kAstF64, [
+  7, 7,
+  7.5, 7.5,
+  -Infinity, -Infinity,
+  "9.5", 9.5,
+  false, 0,
+  null, 0,
+  undefined, NaN,
+  objWithValueOf, 5.25
+]);
@@ -0,0 +1,96 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Flags: --harmony-sharedarraybuffer
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+var kMemSize = 4096;
+
+function instantiate(memory) {
+  var kNameAddOffset = 61;
+  var kNameLoadOffset = kNameAddOffset + 4;
+  var kNameWaitOffset = kNameLoadOffset + 5;
+
+  var data = bytes(
+    kDeclMemory,
+    12, 12, kDeclMemoryExport | kDeclMemoryShared,
+    // -- signatures
+    kDeclSignatures, 2,
+    2, kAstI32, kAstI32, kAstI32,  // (int, int) -> int
+    1, kAstI32, kAstI32,           // int -> int
+    // -- functions
+    kDeclFunctions, 3,
+    // add: atomically adds p1 to mem[p0] and returns the old value.
+    kDeclFunctionName | kDeclFunctionExport,
+    0, 0,
+    kNameAddOffset, 0, 0, 0,       // name offset
+    6, 0,                          // code size
+    kExprI32AtomicAdd, 0, kExprGetLocal, 0, kExprGetLocal, 1,
+    // load: atomically loads mem[p0].
+    kDeclFunctionName | kDeclFunctionExport,
+    1, 0,
+    kNameLoadOffset, 0, 0, 0,      // name offset
+    4, 0,                          // code size
+    kExprI32LoadMem, kAtomicAccess, kExprGetLocal, 0,
+    // wait: waits for at most a millisecond on mem[p0] holding p1.
+    kDeclFunctionName | kDeclFunctionExport,
+    0, 0,
+    kNameWaitOffset, 0, 0, 0,      // name offset
+    8, 0,                          // code size
+    kExprI32AtomicWait, 0, kExprGetLocal, 0, kExprGetLocal, 1,
+    kExprI8Const, 1,
+    kDeclEnd,
+    // names
+    'a', 'd', 'd', 0,
+    'l', 'o', 'a', 'd', 0,
+    'w', 'a', 'i', 't', 0
+  );
+
+  return WASM.instantiateModule(data, null, memory);
+}
+
+(function TestSharedMemory() {
+  var first = instantiate(null);
+  var memory = first.memory;
+  assertTrue(memory instanceof SharedArrayBuffer);
+  assertEquals(kMemSize, memory.byteLength);
+
+  // A second instance uses the same memory.
+  var second = instantiate(memory);
+  assertEquals(memory, second.memory);
+  assertEquals(0, first.add(8, 5));
+  assertEquals(5, second.add(8, 2));
+  assertEquals(7, first.load(8));
+  assertEquals(7, second.load(8));
+
+  var view = new Int32Array(memory);
+  assertEquals(7, view[2]);
+  view[3] = 42;
+  assertEquals(42, first.load(12));
+  assertEquals(42, second.load(12));
+})();
+
+(function TestAtomicTraps() {
+  var module = instantiate(null);
+  assertTraps(kTrapUnalignedAtomic, "module.add(2, 1)");
+  assertTraps(kTrapUnalignedAtomic, "module.load(7)");
+  assertTraps(kTrapMemOutOfBounds, "module.add(kMemSize, 1)");
+  assertTraps(kTrapMemOutOfBounds, "module.load(kMemSize - 2)");
+})();
+
+(function TestAtomicWait() {
+  var module = instantiate(null);
+  // Threads may only block once they are allowed to.
+  assertTraps(kTrapAtomicWait, "module.wait(0, 0)");
+  WASM.setAtomicWaitAllowed(true);
+  assertEquals(1, module.wait(0, 1));  // not equal
+  assertEquals(2, module.wait(0, 0));  // timed out
+  WASM.setAtomicWaitAllowed(false);
+  assertTraps(kTrapAtomicWait, "module.wait(0, 0)");
+})();
+
+(function TestUnsharedMemory() {
+  assertThrows(function() { instantiate(new ArrayBuffer(kMemSize)); });
+})();
@@ -0,0 +1,62 @@
+// Copyright 2016 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+var kReturnValue = 73;
+
+var kBodySize = 2;
+var kNameOffset = 19 + kBodySize + 1;
+
+var data = bytes(
+  // -- memory
+  kDeclMemory,
+  10, 10, 1,
+  // -- signatures
+  kDeclSignatures, 1,
+  0, kAstI32,                 // signature: void -> int
+  // -- main function
+  kDeclFunctions, 1,
+  kDeclFunctionName | kDeclFunctionExport,
+  0, 0,                       // signature index
+  kNameOffset, 0, 0, 0,       // name offset
+  kBodySize, 0,               // body size
+  // -- body
+  kExprI8Const,               // --
+  kReturnValue,               // --
+  kDeclEnd,
+  'm', 'a', 'i', 'n', 0       // name
+);
+
+// The bytes can arrive in chunks of any size, and the function is compiled
+// as soon as its body has arrived.
+for (var chunk = 1; chunk <= data.byteLength; chunk++) {
+  var streaming = WASM.instantiateModuleStreaming();
+  for (var i = 0; i < data.byteLength; i += chunk) {
+    var end = Math.min(i + chunk, data.byteLength);
+    assertTrue(streaming.addBytes(new Uint8Array(data, i, end - i)));
+  }
+  assertEquals(1, streaming.compiledCount());
+  var module = streaming.finish();
+  assertEquals(kReturnValue, module.main());
+  assertEquals(1024, module.memory.byteLength);
+
+  // A streaming instantiation is only finished once.
+  assertThrows(function() { streaming.finish(); });
+  assertThrows(function() { streaming.addBytes(data); });
+}
+
+// With the expected size of the module, more bytes are an error.
+var streaming = WASM.instantiateModuleStreaming(data.byteLength);
+assertTrue(streaming.addBytes(data));
+assertEquals(kReturnValue, streaming.finish().main());
+
+streaming = WASM.instantiateModuleStreaming(data.byteLength - 1);
+assertFalse(streaming.addBytes(data));
+assertThrows(function() { streaming.finish(); });
+
+// A truncated module fails upon finishing.
+streaming = WASM.instantiateModuleStreaming();
+assertTrue(streaming.addBytes(new Uint8Array(data, 0, data.byteLength - 8)));
+assertThrows(function() { streaming.finish(); });
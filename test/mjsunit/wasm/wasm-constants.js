@@ -28,6 +28,10 @@ var kDeclFunctionImport = 0x02;
 var kDeclFunctionLocals = 0x04;
 var kDeclFunctionExport = 0x08;
 
+// Memory declaration flags
+var kDeclMemoryExport = 0x01;
+var kDeclMemoryShared = 0x02;
+
 // Local types
 var kAstStmt = 0;
 var kAstI32 = 1;
@@ -88,6 +92,19 @@ var kExprF64StoreMem = 0x36;
 var kExprMemorySize = 0x3b;
 var kExprGrowMemory = 0x39;
 
+// Memory access byte of sequentially consistent atomic loads and stores
+var kAtomicAccess = 0x20;
+
+var kExprI32AtomicAdd = 0xe0;
+var kExprI32AtomicSub = 0xe1;
+var kExprI32AtomicAnd = 0xe2;
+var kExprI32AtomicOr = 0xe3;
+var kExprI32AtomicXor = 0xe4;
+var kExprI32AtomicExchange = 0xe5;
+var kExprI32AtomicCompareExchange = 0xe6;
+var kExprI32AtomicWait = 0xe7;
+var kExprAtomicNotify = 0xe8;
+
 var kExprI32Add = 0x40;
 var kExprI32Sub = 0x41;
 var kExprI32Mul = 0x42;
@@ -215,6 +232,8 @@ var kTrapRemByZero            = 4;
 var kTrapFloatUnrepresentable = 5;
 var kTrapFuncInvalid          = 6;
 var kTrapFuncSigMismatch      = 7;
+var kTrapUnalignedAtomic      = 8;
+var kTrapAtomicWait           = 9;
 
 var kTrapMsgs = [
   "unreachable",
@@ -224,7 +243,9 @@ var kTrapMsgs = [
   "remainder by zero",
   "integer result unrepresentable",
   "invalid function",
-  "function signature mismatch"
+  "function signature mismatch",
+  "unaligned atomic access",
+  "atomic wait not allowed"
 ];
 
 function assertTraps(trap, code) {
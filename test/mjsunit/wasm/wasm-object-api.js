@@ -7,3 +7,4 @@ assertFalse(undefined == WASM);
 assertEquals("function", typeof WASM.verifyModule);
 assertEquals("function", typeof WASM.verifyFunction);
 assertEquals("function", typeof WASM.compileRun);
+assertEquals("function", typeof WASM.instantiateModuleStreaming);
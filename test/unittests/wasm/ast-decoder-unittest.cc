@@ -93,6 +93,7 @@ class WasmDecoderTest : public TestWithZone {
     env->local_int64_count = 0;
     env->local_float32_count = 0;
     env->local_float64_count = 0;
+    env->local_simd128_count = 0;
     env->SumLocals();
   }
 
@@ -184,6 +185,7 @@ static FunctionEnv CreateInt32FunctionEnv(FunctionSig* sig, int count) {
   env.local_int32_count = count;
   env.local_float64_count = 0;
   env.local_float32_count = 0;
+  env.local_simd128_count = 0;
   env.total_locals = static_cast<unsigned>(count + sig->parameter_count());
   return env;
 }
@@ -1141,7 +1143,7 @@ namespace {
 // globals.
 class TestModuleEnv : public ModuleEnv {
  public:
-  TestModuleEnv() {
+  TestModuleEnv() : globals(&zone), signatures(&zone), functions(&zone) {
     mem_start = 0;
     mem_end = 0;
     module = &mod;
@@ -1169,9 +1171,10 @@ class TestModuleEnv : public ModuleEnv {
 
  private:
   WasmModule mod;
-  std::vector<WasmGlobal> globals;
-  std::vector<FunctionSig*> signatures;
-  std::vector<WasmFunction> functions;
+  Zone zone;
+  ZoneVector<WasmGlobal> globals;
+  ZoneVector<FunctionSig*> signatures;
+  ZoneVector<WasmFunction> functions;
 };
 }
 
@@ -1926,6 +1929,134 @@ TEST_F(WasmDecoderTest, Select_TypeCheck) {
 }
 
 
+TEST_F(WasmDecoderTest, SimdLocals) {
+  FunctionEnv env;
+  init_env(&env, sigs.i_i());
+  env.AddLocals(kAstS128, 1);
+  EXPECT_VERIFIES_INLINE(
+      &env, WASM_SET_LOCAL(1, WASM_I32X4_SPLAT(WASM_GET_LOCAL(0))),
+      WASM_I32X4_EXTRACT_LANE(3, WASM_GET_LOCAL(1)));
+  EXPECT_FAILURE_INLINE(&env, WASM_GET_LOCAL(1));
+  EXPECT_FAILURE_INLINE(&env, WASM_SET_LOCAL(1, WASM_GET_LOCAL(0)),
+                        WASM_GET_LOCAL(0));
+  EXPECT_FAILURE_INLINE(&env, WASM_SET_LOCAL(0, WASM_GET_LOCAL(1)));
+}
+
+
+TEST_F(WasmDecoderTest, SimdExpressions) {
+  FunctionEnv env;
+  init_env(&env, sigs.i_i());
+  env.AddLocals(kAstS128, 1);
+  EXPECT_VERIFIES_INLINE(
+      &env, WASM_I32X4_EXTRACT_LANE(
+                0, WASM_I32X4_ADD(WASM_GET_LOCAL(1), WASM_GET_LOCAL(1))));
+  EXPECT_VERIFIES_INLINE(
+      &env, WASM_I32_REINTERPRET_F32(WASM_F32X4_EXTRACT_LANE(
+                1, WASM_F32X4_SQRT(WASM_F32X4_SPLAT(WASM_F32(4.0))))));
+  EXPECT_VERIFIES_INLINE(
+      &env, WASM_I32X4_EXTRACT_LANE(
+                2, WASM_I32X4_REPLACE_LANE(2, WASM_GET_LOCAL(1),
+                                           WASM_GET_LOCAL(0))));
+  EXPECT_VERIFIES_INLINE(
+      &env, WASM_I32X4_EXTRACT_LANE(
+                0, WASM_S32X4_SHUFFLE(7, 6, 1, 0, WASM_GET_LOCAL(1),
+                                      WASM_GET_LOCAL(1))));
+
+  EXPECT_FAILURE_INLINE(
+      &env, WASM_I32X4_EXTRACT_LANE(
+                0, WASM_I32X4_ADD(WASM_GET_LOCAL(0), WASM_GET_LOCAL(1))));
+  EXPECT_FAILURE_INLINE(&env,
+                        WASM_F32X4_EXTRACT_LANE(0, WASM_GET_LOCAL(1)));
+  EXPECT_FAILURE_INLINE(
+      &env, WASM_I32X4_EXTRACT_LANE(
+                0, WASM_F32X4_REPLACE_LANE(0, WASM_GET_LOCAL(1),
+                                           WASM_GET_LOCAL(0))));
+}
+
+
+TEST_F(WasmDecoderTest, SimdLaneIndexes) {
+  FunctionEnv env;
+  init_env(&env, sigs.i_i());
+  env.AddLocals(kAstS128, 1);
+  EXPECT_FAILURE_INLINE(&env, WASM_I32X4_EXTRACT_LANE(4, WASM_GET_LOCAL(1)));
+  EXPECT_FAILURE_INLINE(
+      &env, WASM_I32X4_EXTRACT_LANE(
+                0, WASM_I32X4_REPLACE_LANE(4, WASM_GET_LOCAL(1),
+                                           WASM_GET_LOCAL(0))));
+  EXPECT_FAILURE_INLINE(
+      &env, WASM_I32X4_EXTRACT_LANE(
+                0, WASM_S32X4_SHUFFLE(0, 1, 2, 8, WASM_GET_LOCAL(1),
+                                      WASM_GET_LOCAL(1))));
+  EXPECT_FAILURE_INLINE(&env, kExprS32x4Shuffle, 0, 1);
+}
+
+
+TEST_F(WasmDecoderTest, SimdLoadStore) {
+  FunctionEnv env;
+  init_env(&env, sigs.i_i());
+  env.AddLocals(kAstS128, 1);
+  EXPECT_VERIFIES_INLINE(
+      &env, WASM_SET_LOCAL(1, WASM_S128_LOAD_MEM(WASM_GET_LOCAL(0))),
+      WASM_S128_STORE_MEM(WASM_ZERO, WASM_GET_LOCAL(1)), WASM_ZERO);
+  EXPECT_VERIFIES_INLINE(
+      &env, WASM_I32X4_EXTRACT_LANE(
+                0, WASM_S128_LOAD_MEM_OFFSET(16, WASM_GET_LOCAL(0))));
+  EXPECT_FAILURE_INLINE(
+      &env, WASM_S128_STORE_MEM(WASM_ZERO, WASM_GET_LOCAL(0)), WASM_ZERO);
+}
+
+
+TEST_F(WasmDecoderTest, AtomicLoadStore) {
+  EXPECT_VERIFIES_INLINE(&env_i_i, WASM_ATOMIC_LOAD_MEM(WASM_GET_LOCAL(0)));
+  EXPECT_VERIFIES_INLINE(
+      &env_i_i, WASM_ATOMIC_LOAD_MEM_OFFSET(4, WASM_GET_LOCAL(0)));
+  EXPECT_VERIFIES_INLINE(
+      &env_i_i, WASM_ATOMIC_STORE_MEM(WASM_GET_LOCAL(0), WASM_GET_LOCAL(0)));
+  EXPECT_FAILURE_INLINE(&env_i_i, WASM_ATOMIC_LOAD_MEM(WASM_F32(1.0)));
+
+  // Only 32-bit integer loads and stores can be atomic.
+  static const byte kAccess = WasmOpcodes::AtomicAccessOf(false);
+  EXPECT_FAILURE_INLINE(&env_i_i, kExprI32LoadMem8S, kAccess, WASM_ZERO);
+  EXPECT_FAILURE_INLINE(&env_i_i, kExprI32LoadMem16U, kAccess, WASM_ZERO);
+  EXPECT_FAILURE_INLINE(&env_i_i, kExprI32StoreMem8, kAccess, WASM_ZERO,
+                        WASM_ZERO);
+  EXPECT_FAILURE_INLINE(&env_l_l, kExprI64LoadMem, kAccess, WASM_ZERO);
+  EXPECT_FAILURE_INLINE(&env_f_ff, kExprF32LoadMem, kAccess, WASM_ZERO);
+}
+
+
+TEST_F(WasmDecoderTest, AtomicExpressions) {
+  EXPECT_VERIFIES_INLINE(
+      &env_i_i, WASM_I32_ATOMIC_ADD(WASM_ZERO, WASM_GET_LOCAL(0)));
+  EXPECT_VERIFIES_INLINE(
+      &env_i_i, WASM_I32_ATOMIC_SUB(WASM_ZERO, WASM_GET_LOCAL(0)));
+  EXPECT_VERIFIES_INLINE(
+      &env_i_i, WASM_I32_ATOMIC_AND(WASM_ZERO, WASM_GET_LOCAL(0)));
+  EXPECT_VERIFIES_INLINE(
+      &env_i_i, WASM_I32_ATOMIC_OR(WASM_ZERO, WASM_GET_LOCAL(0)));
+  EXPECT_VERIFIES_INLINE(
+      &env_i_i, WASM_I32_ATOMIC_XOR(WASM_ZERO, WASM_GET_LOCAL(0)));
+  EXPECT_VERIFIES_INLINE(
+      &env_i_i, WASM_I32_ATOMIC_EXCHANGE(WASM_ZERO, WASM_GET_LOCAL(0)));
+  EXPECT_VERIFIES_INLINE(
+      &env_i_i, WASM_I32_ATOMIC_COMPARE_EXCHANGE(WASM_ZERO, WASM_GET_LOCAL(0),
+                                                 WASM_ONE));
+  EXPECT_VERIFIES_INLINE(
+      &env_i_i, WASM_I32_ATOMIC_WAIT(WASM_ZERO, WASM_GET_LOCAL(0), WASM_ONE));
+  EXPECT_VERIFIES_INLINE(
+      &env_i_i, WASM_ATOMIC_NOTIFY(WASM_ZERO, WASM_GET_LOCAL(0)));
+
+  EXPECT_FAILURE_INLINE(
+      &env_i_i, WASM_I32_ATOMIC_ADD(WASM_ZERO, WASM_F32(1.0)));
+  EXPECT_FAILURE_INLINE(
+      &env_i_i, WASM_I32_ATOMIC_ADD(WASM_F32(1.0), WASM_GET_LOCAL(0)));
+  EXPECT_FAILURE_INLINE(
+      &env_i_i, WASM_I32_ATOMIC_COMPARE_EXCHANGE(WASM_ZERO, WASM_ZERO,
+                                                 WASM_F32(1.0)));
+  EXPECT_FAILURE_INLINE(&env_i_i, kExprI32AtomicAdd);
+}
+
+
 class WasmOpcodeLengthTest : public TestWithZone {
  public:
   WasmOpcodeLengthTest() : TestWithZone() { }
@@ -2142,6 +2273,32 @@ TEST_F(WasmOpcodeLengthTest, SimpleExpressions) {
 }
 
 
+TEST_F(WasmOpcodeLengthTest, SimdExpressions) {
+  EXPECT_LENGTH(1, kExprI32x4Splat);
+  EXPECT_LENGTH(1, kExprI32x4Add);
+  EXPECT_LENGTH(1, kExprS128Xor);
+  EXPECT_LENGTH(1, kExprF32x4Mul);
+  EXPECT_LENGTH(1, kExprF32x4SConvertI32x4);
+  EXPECT_LENGTH(2, kExprI32x4ExtractLane);
+  EXPECT_LENGTH(2, kExprI32x4ReplaceLane);
+  EXPECT_LENGTH(2, kExprF32x4ExtractLane);
+  EXPECT_LENGTH(2, kExprF32x4ReplaceLane);
+  EXPECT_LENGTH(5, kExprS32x4Shuffle);
+  EXPECT_LENGTH(2, kExprS128LoadMem);
+  EXPECT_LENGTH(2, kExprS128StoreMem);
+}
+
+
+TEST_F(WasmOpcodeLengthTest, AtomicExpressions) {
+  EXPECT_LENGTH(2, kExprI32AtomicAdd);
+  EXPECT_LENGTH(2, kExprI32AtomicXor);
+  EXPECT_LENGTH(2, kExprI32AtomicExchange);
+  EXPECT_LENGTH(2, kExprI32AtomicCompareExchange);
+  EXPECT_LENGTH(2, kExprI32AtomicWait);
+  EXPECT_LENGTH(2, kExprAtomicNotify);
+}
+
+
 class WasmOpcodeArityTest : public TestWithZone {
  public:
   WasmOpcodeArityTest() : TestWithZone() { }
@@ -2397,6 +2554,38 @@ TEST_F(WasmOpcodeArityTest, SimpleExpressions) {
   EXPECT_ARITY(1, kExprI64ReinterpretF64);
 }
 
+
+TEST_F(WasmOpcodeArityTest, SimdExpressions) {
+  FunctionEnv env;
+
+  EXPECT_ARITY(1, kExprI32x4Splat);
+  EXPECT_ARITY(2, kExprI32x4Add);
+  EXPECT_ARITY(2, kExprS128Xor);
+  EXPECT_ARITY(1, kExprF32x4Sqrt);
+  EXPECT_ARITY(1, kExprI32x4ExtractLane);
+  EXPECT_ARITY(2, kExprI32x4ReplaceLane);
+  EXPECT_ARITY(1, kExprF32x4ExtractLane);
+  EXPECT_ARITY(2, kExprF32x4ReplaceLane);
+  EXPECT_ARITY(2, kExprS32x4Shuffle);
+  EXPECT_ARITY(1, kExprS128LoadMem);
+  EXPECT_ARITY(2, kExprS128StoreMem);
+}
+
+
+TEST_F(WasmOpcodeArityTest, AtomicExpressions) {
+  FunctionEnv env;
+
+  EXPECT_ARITY(2, kExprI32AtomicAdd);
+  EXPECT_ARITY(2, kExprI32AtomicSub);
+  EXPECT_ARITY(2, kExprI32AtomicAnd);
+  EXPECT_ARITY(2, kExprI32AtomicOr);
+  EXPECT_ARITY(2, kExprI32AtomicXor);
+  EXPECT_ARITY(2, kExprI32AtomicExchange);
+  EXPECT_ARITY(3, kExprI32AtomicCompareExchange);
+  EXPECT_ARITY(3, kExprI32AtomicWait);
+  EXPECT_ARITY(2, kExprAtomicNotify);
+}
+
 }
 }
 }
@@ -120,6 +120,32 @@ TEST_F(EncoderTest, Function_Builder_Indexing_Variable_Width) {
   CHECK_EQ(0x00, static_cast<size_t>(*(body + 2*127 + 4)));
 }
 
+TEST_F(EncoderTest, Function_Builder_Serialized_Size) {
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint16_t f_index = builder->AddFunction();
+  WasmFunctionBuilder* function = builder->FunctionAt(f_index);
+  // Remapping grows the index of local 127 to two bytes and shrinks the index
+  // of the i32 local to one byte.
+  for (size_t i = 0; i < 200; i++) {
+    AddLocal(function, kAstF32);
+  }
+  AddLocal(function, kAstI32);
+  byte code[] = {kExprI8Const, 0x80};
+  function->EmitCode(code, sizeof(code));
+
+  WasmFunctionEncoder* f = function->Build(&zone, builder);
+  ZoneVector<uint8_t> buffer_vector(f->HeaderSize() + f->BodySize(), &zone);
+  byte* buffer = buffer_vector.data();
+  byte* header = buffer;
+  byte* body = buffer + f->HeaderSize();
+  f->Serialize(buffer, &header, &body);
+  CHECK(header == buffer + f->HeaderSize() + f->BodySize());
+  // The code that is not a local index is copied unchanged.
+  CHECK_EQ(kExprI8Const, static_cast<size_t>(*(header - 2)));
+  CHECK_EQ(0x80, static_cast<size_t>(*(header - 1)));
+}
+
 TEST_F(EncoderTest, LEB_Functions) {
   byte leb_value[5] = {0, 0, 0, 0, 0};
   CheckReadValue(leb_value, 0, 1, kNoError);
@@ -199,6 +199,59 @@ TEST_F(WasmModuleVerifyTest, TwoGlobals) {
 }
 
 
+TEST_F(WasmModuleVerifyTest, TwoGlobalsSecondInvalid) {
+  const byte data[] = {
+    kDeclGlobals, 2,
+    0, 0, 0, 0,                    // #0: name offset
+    kMemI32,                       // memory type
+    0,                             // exported
+    0, 0, 0, 0,                    // #1: name offset
+    33,                            // invalid memory type
+    0,                             // exported
+  };
+
+  // The error points at the invalid field, as when decoding field by field.
+  ModuleResult result = DecodeModule(data, data + arraysize(data));
+  EXPECT_FALSE(result.ok());
+  EXPECT_EQ(data + 12, result.error_pc);
+  if (result.val) delete result.val;
+}
+
+
+TEST_F(WasmModuleVerifyTest, GlobalsCountPaddedVarint) {
+  const byte data[] = {
+    kDeclGlobals, 0x82, 0x80, 0x80, 0x80, 0x00,  // 2 globals, 5-byte varint
+    0, 0, 0, 0,                    // #0: name offset
+    kMemI32,                       // memory type
+    0,                             // exported
+    0, 0, 0, 0,                    // #1: name offset
+    kMemF64,                       // memory type
+    1,                             // exported
+  };
+
+  ModuleResult result = DecodeModule(data, data + arraysize(data));
+  EXPECT_TRUE(result.ok());
+  EXPECT_EQ(2, result.val->globals->size());
+  EXPECT_EQ(MachineType::Float64(), result.val->globals->at(1).type);
+  if (result.val) delete result.val;
+}
+
+
+TEST_F(WasmModuleVerifyTest, GlobalsCountVarintTooLarge) {
+  const byte data[] = {
+    kDeclGlobals, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00,  // too long varint
+    0, 0, 0, 0,                    // name offset
+    kMemI32,                       // memory type
+    0,                             // exported
+  };
+
+  ModuleResult result = DecodeModule(data, data + arraysize(data));
+  EXPECT_FALSE(result.ok());
+  EXPECT_EQ(data + 5, result.error_pc);
+  if (result.val) delete result.val;
+}
+
+
 TEST_F(WasmModuleVerifyTest, OneSignature) {
   static const byte data[] = {
     kDeclSignatures, 1,
@@ -236,6 +289,29 @@ TEST_F(WasmModuleVerifyTest, MultipleSignatures) {
   }
 }
 
+TEST_F(WasmModuleVerifyTest, CanonicalSignatures) {
+  static const byte data[] = {
+    kDeclSignatures, 5,
+    1, kLocalI32, kLocalF32,            // f32 -> i32
+    2, kLocalI32, kLocalF64, kLocalF64, // (f64,f64) -> i32
+    1, kLocalI32, kLocalF32,            // f32 -> i32
+    1, kLocalI32, kLocalF64,            // f64 -> i32
+    2, kLocalI32, kLocalF64, kLocalF64, // (f64,f64) -> i32
+  };
+
+  ModuleResult result = DecodeModule(data, data + arraysize(data));
+  EXPECT_TRUE(result.ok());
+  EXPECT_EQ(5, result.val->signatures->size());
+  if (result.val->signatures->size() == 5) {
+    EXPECT_EQ(0, result.val->CanonicalSigIndex(0));
+    EXPECT_EQ(1, result.val->CanonicalSigIndex(1));
+    EXPECT_EQ(0, result.val->CanonicalSigIndex(2));
+    EXPECT_EQ(3, result.val->CanonicalSigIndex(3));
+    EXPECT_EQ(1, result.val->CanonicalSigIndex(4));
+  }
+}
+
+
 TEST_F(WasmModuleVerifyTest, FunctionWithoutSig) {
   static const byte data[] = {
     kDeclFunctions, 1,
@@ -299,8 +375,8 @@ TEST_F(WasmModuleVerifyTest, OneEmptyVoidVoidFunction) {
     EXPECT_EQ(1551, function->local_float32_count);
     EXPECT_EQ(2065, function->local_float64_count);
 
-    EXPECT_EQ(true, function->exported);
-    EXPECT_EQ(false, function->external);
+    EXPECT_TRUE(function->exported);
+    EXPECT_FALSE(function->external);
   }
 
   for (size_t size = 5; size < arraysize(data); size++) {
@@ -336,8 +412,8 @@ TEST_F(WasmModuleVerifyTest, OneFunctionImported) {
   EXPECT_EQ(0, function->local_float32_count);
   EXPECT_EQ(0, function->local_float64_count);
 
-  EXPECT_EQ(false, function->exported);
-  EXPECT_EQ(true, function->external);
+  EXPECT_FALSE(function->exported);
+  EXPECT_TRUE(function->external);
 }
 
 
@@ -371,8 +447,8 @@ TEST_F(WasmModuleVerifyTest, OneFunctionWithNopBody) {
   EXPECT_EQ(0, function->local_float32_count);
   EXPECT_EQ(0, function->local_float64_count);
 
-  EXPECT_EQ(false, function->exported);
-  EXPECT_EQ(false, function->external);
+  EXPECT_FALSE(function->exported);
+  EXPECT_FALSE(function->external);
 }
 
 
@@ -409,9 +485,58 @@ TEST_F(WasmModuleVerifyTest, OneFunctionWithNopBody_WithLocals) {
   EXPECT_EQ(1027, function->local_int64_count);
   EXPECT_EQ(1541, function->local_float32_count);
   EXPECT_EQ(2055, function->local_float64_count);
+  EXPECT_EQ(0, function->local_simd128_count);
 
-  EXPECT_EQ(false, function->exported);
-  EXPECT_EQ(false, function->external);
+  EXPECT_FALSE(function->exported);
+  EXPECT_FALSE(function->external);
+}
+
+
+TEST_F(WasmModuleVerifyTest, OneFunctionWithSimdLocals) {
+  static const byte kCodeStartOffset = 21;
+  static const byte kCodeEndOffset = kCodeStartOffset + 1;
+
+  static const byte data[] = {
+      kDeclSignatures, 1,
+      // sig#0 -------------------------------------------------------
+      0, 0,                          // void -> void
+      kDeclFunctions, 1,
+      // func#0 ------------------------------------------------------
+      kDeclFunctionLocals | kDeclFunctionSimdLocals,
+      0, 0,                          // signature index
+      1, 0,                          // local int32 count
+      2, 0,                          // local int64 count
+      3, 0,                          // local float32 count
+      4, 0,                          // local float64 count
+      5, 1,                          // local simd128 count
+      1, 0,                          // body size
+      kExprNop                       // body
+  };
+
+  ModuleResult result = DecodeModule(data, data + arraysize(data));
+  EXPECT_TRUE(result.ok());
+  EXPECT_EQ(1, result.val->functions->size());
+  WasmFunction* function = &result.val->functions->back();
+
+  EXPECT_EQ(kCodeStartOffset, function->code_start_offset);
+  EXPECT_EQ(kCodeEndOffset, function->code_end_offset);
+
+  EXPECT_EQ(1, function->local_int32_count);
+  EXPECT_EQ(2, function->local_int64_count);
+  EXPECT_EQ(3, function->local_float32_count);
+  EXPECT_EQ(4, function->local_float64_count);
+  EXPECT_EQ(261, function->local_simd128_count);
+}
+
+
+TEST_F(WasmModuleVerifyTest, SimdTypeInSignature) {
+  static const byte data[] = {
+      kDeclSignatures, 1,
+      // sig#0 -------------------------------------------------------
+      1, kLocalI32, kLocalS128,      // s128 -> i32
+  };
+
+  EXPECT_FAILURE(data);
 }
 
 
@@ -471,8 +596,8 @@ TEST_F(WasmModuleVerifyTest, OneGlobalOneFunctionWithNopBodyOneDataSegment) {
     EXPECT_EQ(kCodeStartOffset, function->code_start_offset);
     EXPECT_EQ(kCodeEndOffset, function->code_end_offset);
 
-    EXPECT_EQ(false, function->exported);
-    EXPECT_EQ(false, function->external);
+    EXPECT_FALSE(function->exported);
+    EXPECT_FALSE(function->external);
 
     WasmDataSegment* segment = &result.val->data_segments->back();
 
@@ -484,6 +609,29 @@ TEST_F(WasmModuleVerifyTest, OneGlobalOneFunctionWithNopBodyOneDataSegment) {
 }
 
 
+TEST_F(WasmModuleVerifyTest, MemoryFlags) {
+  static const struct {
+    byte flags;
+    bool exported;
+    bool shared;
+  } kCases[] = {{0, false, false},
+                {kDeclMemoryExport, true, false},
+                {kDeclMemoryShared, false, true},
+                {kDeclMemoryExport | kDeclMemoryShared, true, true}};
+  for (size_t i = 0; i < arraysize(kCases); i++) {
+    const byte data[] = {
+        kDeclMemory, 12, 14, kCases[i].flags,  // memory
+    };
+    ModuleResult result = DecodeModule(data, data + arraysize(data));
+    EXPECT_TRUE(result.ok());
+    EXPECT_EQ(12, result.val->min_mem_size_log2);
+    EXPECT_EQ(14, result.val->max_mem_size_log2);
+    EXPECT_EQ(kCases[i].exported, result.val->mem_export);
+    EXPECT_EQ(kCases[i].shared, result.val->mem_shared);
+  }
+}
+
+
 TEST_F(WasmModuleVerifyTest, OneDataSegment) {
   const byte data[] = {
       kDeclDataSegments, 1,
@@ -558,6 +706,64 @@ TEST_F(WasmModuleVerifyTest, TwoDataSegments) {
 }
 
 
+TEST_F(WasmModuleVerifyTest, DataSegmentWithInvalidSourceOffset) {
+  const byte data[] = {
+      kDeclDataSegments, 2,
+      0, 0, 0, 0,              // #0: dest addr
+      9, 0, 0, 0,              // source offset
+      4, 0, 0, 0,              // source size
+      0,                       // init
+      0, 0, 0, 0,              // #1: dest addr
+      0, 1, 0, 0,              // invalid source offset
+      4, 0, 0, 0,              // source size
+      0,                       // init
+  };
+
+  ModuleResult result = DecodeModule(data, data + arraysize(data));
+  EXPECT_FALSE(result.ok());
+  EXPECT_EQ(data + 19, result.error_pc);
+  if (result.val) delete result.val;
+}
+
+
+TEST_F(WasmModuleVerifyTest, VerifyManyFunctions) {
+  static const uint32_t kFunctionCount = 64;
+  for (uint32_t invalid : {kFunctionCount, 0u, 5u, 63u}) {
+    std::vector<byte> buffer = {
+        kDeclSignatures, 1,
+        0, 0,                        // void -> void
+        kDeclFunctions};
+    AppendUint32v(buffer, kFunctionCount);
+    for (uint32_t i = 0; i < kFunctionCount; i++) {
+      // Every function after the invalid one is invalid too.
+      const byte function[] = {
+          0,                         // no name, no locals
+          0, 0,                      // signature index
+          2, 0,                      // body size
+          static_cast<byte>(i < invalid ? kExprNop : kExprGetLocal),  // body
+          static_cast<byte>(i < invalid ? kExprNop : 7),
+      };
+      buffer.insert(buffer.end(), function, function + arraysize(function));
+    }
+
+    ModuleResult result = DecodeWasmModule(nullptr, zone(), &buffer[0],
+                                           &buffer[0] + buffer.size(), true,
+                                           false);
+    if (invalid == kFunctionCount) {
+      EXPECT_TRUE(result.ok());
+    } else {
+      // The first invalid function is reported, whichever failed first.
+      EXPECT_FALSE(result.ok());
+      std::ostringstream expected;
+      expected << "in function #" << invalid << ":";
+      EXPECT_NE(nullptr, strstr(result.error_msg.get(),
+                                expected.str().c_str()));
+    }
+    if (result.val) delete result.val;
+  }
+}
+
+
 // To make below tests for indirect calls much shorter.
 #define FUNCTION(sig_index, external)		\
   kDeclFunctionImport,				\
@@ -626,6 +832,34 @@ TEST_F(WasmModuleVerifyTest, MultipleIndirectFunctions) {
 }
 
 
+TEST_F(WasmModuleVerifyTest, CanonicalFunctionSignatures) {
+  static const byte data[] = {
+      // sig#0 -------------------------------------------------------
+      kDeclSignatures, 3,
+      0, kLocalI32,                  // void -> i32
+      0, 0,                          // void -> void
+      0, kLocalI32,                  // void -> i32
+      // func#0 ------------------------------------------------------
+      kDeclFunctions, 3,
+      FUNCTION(0, 1),
+      FUNCTION(1, 1),
+      FUNCTION(2, 1),
+  };
+
+  ModuleResult result = DecodeModule(data, data + arraysize(data));
+  EXPECT_TRUE(result.ok());
+  if (result.ok()) {
+    EXPECT_EQ(3, result.val->functions->size());
+    EXPECT_EQ(0, result.val->CanonicalSigIndex(
+                     result.val->functions->at(0).sig_index));
+    EXPECT_EQ(1, result.val->CanonicalSigIndex(
+                     result.val->functions->at(1).sig_index));
+    EXPECT_EQ(0, result.val->CanonicalSigIndex(
+                     result.val->functions->at(2).sig_index));
+  }
+}
+
+
 TEST_F(WasmModuleVerifyTest, IndirectFunctionNoFunctions) {
   static const byte data[] = {
       // sig#0 -------------------------------------------------------
@@ -657,6 +891,239 @@ TEST_F(WasmModuleVerifyTest, IndirectFunctionInvalidIndex) {
 }
 
 
+class TestStreamingClient : public StreamingDecoder::Client {
+ public:
+  TestStreamingClient()
+      : function_count(0), section_count(0), module_start(nullptr) {}
+
+  void OnFunctionBody(WasmModule* module, uint32_t index) override {
+    EXPECT_EQ(function_count, index);
+    module_start = module->module_start;
+    // The whole body must have arrived.
+    const WasmFunction& function = module->functions->at(index);
+    for (uint32_t i = function.code_start_offset; i < function.code_end_offset;
+         i++) {
+      EXPECT_EQ(kExprNop, module->module_start[i]);
+    }
+    function_count++;
+  }
+
+  void OnSection(WasmModule* module, WasmSectionDeclCode section) override {
+    section_count++;
+  }
+
+  uint32_t function_count;
+  uint32_t section_count;
+  const byte* module_start;  // as of the last function body.
+};
+
+
+TEST_F(WasmModuleVerifyTest, StreamingByteByByte) {
+  static const byte data[] = {
+      // sig#0 -----------------------------------------------------
+      kDeclSignatures, 1,
+      0, 0,                       // void -> void
+      // func#0 ----------------------------------------------------
+      kDeclFunctions, 2,
+      kDeclFunctionName,
+      0, 0,                       // signature index
+      32, 0, 0, 0,                // name offset
+      2, 0,                       // body size
+      kExprNop,                   // func#0 body
+      kExprNop,                   // func#0 body
+      // func#1 ----------------------------------------------------
+      kDeclFunctionLocals,
+      0, 0,                       // signature index
+      1, 0,                       // local int32 count
+      0, 0,                       // local int64 count
+      0, 0,                       // local float32 count
+      0, 0,                       // local float64 count
+      1, 0,                       // body size
+      kExprNop,                   // func#1 body
+      // rest ------------------------------------------------------
+      kDeclEnd,
+      'f', 0                      // name
+  };
+
+  ModuleResult expected = DecodeModule(data, data + arraysize(data));
+  EXPECT_TRUE(expected.ok());
+
+  TestStreamingClient client;
+  StreamingDecoder decoder(nullptr, zone(), &client, true, false);
+  for (size_t i = 0; i < arraysize(data); i++) {
+    EXPECT_TRUE(decoder.AddBytes(data + i, 1));
+  }
+  ModuleResult result = decoder.Finish();
+  EXPECT_TRUE(result.ok());
+  EXPECT_EQ(2, client.function_count);
+  EXPECT_EQ(3, client.section_count);
+
+  if (result.ok() && expected.ok()) {
+    EXPECT_EQ(arraysize(data), result.val->module_end -
+                                   result.val->module_start);
+    EXPECT_EQ(expected.val->functions->size(), result.val->functions->size());
+    for (size_t i = 0; i < result.val->functions->size(); i++) {
+      const WasmFunction& a = expected.val->functions->at(i);
+      const WasmFunction& b = result.val->functions->at(i);
+      EXPECT_EQ(a.name_offset, b.name_offset);
+      EXPECT_EQ(a.code_start_offset, b.code_start_offset);
+      EXPECT_EQ(a.code_end_offset, b.code_end_offset);
+      EXPECT_EQ(a.local_int32_count, b.local_int32_count);
+    }
+    EXPECT_STREQ("f", result.val->GetName(result.val->functions->at(0)
+                                              .name_offset));
+  }
+  if (result.val) delete result.val;
+}
+
+
+TEST_F(WasmModuleVerifyTest, StreamingTruncated) {
+  static const byte data[] = {
+      // sig#0 -----------------------------------------------------
+      kDeclSignatures, 2,
+      0, 0,                       // void -> void
+  };
+
+  TestStreamingClient client;
+  StreamingDecoder decoder(nullptr, zone(), &client, false, false);
+  EXPECT_TRUE(decoder.AddBytes(data, arraysize(data)));
+  ModuleResult result = decoder.Finish();
+  EXPECT_FALSE(result.ok());
+  EXPECT_EQ(0, client.section_count);
+  if (result.val) delete result.val;
+}
+
+
+TEST_F(WasmModuleVerifyTest, StreamingNameOffsetOutOfBounds) {
+  static const byte data[] = {
+      // global#0 --------------------------------------------------
+      kDeclGlobals, 1,
+      100, 0, 0, 0,               // name offset
+      kMemU8,                     // memory type
+      0,                          // exported
+  };
+
+  // The offset can only be checked once all bytes have arrived.
+  TestStreamingClient client;
+  StreamingDecoder decoder(nullptr, zone(), &client, false, false);
+  EXPECT_TRUE(decoder.AddBytes(data, arraysize(data)));
+  ModuleResult result = decoder.Finish();
+  EXPECT_FALSE(result.ok());
+  if (result.val) delete result.val;
+}
+
+
+TEST_F(WasmModuleVerifyTest, StreamingInvalidSection) {
+  static const byte data[] = {0xff};
+
+  TestStreamingClient client;
+  StreamingDecoder decoder(nullptr, zone(), &client, false, false);
+  EXPECT_FALSE(decoder.AddBytes(data, arraysize(data)));
+  ModuleResult result = decoder.Finish();
+  EXPECT_FALSE(result.ok());
+  if (result.val) delete result.val;
+}
+
+
+TEST_F(WasmModuleVerifyTest, StreamingBytesDoNotMove) {
+  static const byte data[] = {
+      // sig#0 -----------------------------------------------------
+      kDeclSignatures, 1,
+      0, 0,                       // void -> void
+      // func#0 ----------------------------------------------------
+      kDeclFunctions, 1,
+      0,                          // no name, no locals
+      0, 0,                       // signature index
+      1, 0,                       // body size
+      kExprNop,                   // func#0 body
+  };
+
+  // With the size of the module given, pointers into the bytes that have
+  // arrived stay valid while more arrive.
+  std::vector<byte> rest(1024 * 1024, 0);
+  rest[0] = kDeclEnd;
+  TestStreamingClient client;
+  StreamingDecoder decoder(nullptr, zone(), &client, false, false,
+                           arraysize(data) + rest.size());
+  EXPECT_TRUE(decoder.AddBytes(data, arraysize(data)));
+  EXPECT_EQ(1, client.function_count);
+  EXPECT_TRUE(decoder.AddBytes(&rest[0], rest.size()));
+  EXPECT_EQ(kExprNop, client.module_start[arraysize(data) - 1]);
+  ModuleResult result = decoder.Finish();
+  EXPECT_TRUE(result.ok());
+  if (result.ok()) EXPECT_EQ(client.module_start, result.val->module_start);
+  if (result.val) delete result.val;
+}
+
+
+TEST_F(WasmModuleVerifyTest, StreamingBytesGrow) {
+  static const byte data[] = {
+      // sig#0 -----------------------------------------------------
+      kDeclSignatures, 1,
+      0, 0,                       // void -> void
+      // func#0 ----------------------------------------------------
+      kDeclFunctions, 1,
+      0,                          // no name, no locals
+      0, 0,                       // signature index
+      1, 0,                       // body size
+      kExprNop,                   // func#0 body
+  };
+
+  // Without the size of the module, the bytes move to a larger reservation
+  // when they outgrow it, and decoding continues on the copy.
+  TestStreamingClient client;
+  StreamingDecoder decoder(nullptr, zone(), &client, false, false);
+  EXPECT_TRUE(decoder.AddBytes(data, arraysize(data)));
+  EXPECT_EQ(1, client.function_count);
+  std::vector<byte> rest(1024 * 1024, 0);
+  rest[0] = kDeclEnd;
+  for (size_t offset = 0; offset < rest.size(); offset += 4096) {
+    EXPECT_TRUE(decoder.AddBytes(&rest[offset], 4096));
+  }
+  ModuleResult result = decoder.Finish();
+  EXPECT_TRUE(result.ok());
+  if (result.ok()) {
+    const WasmModule* module = result.val;
+    EXPECT_EQ(arraysize(data) + rest.size(),
+              static_cast<size_t>(module->module_end - module->module_start));
+    EXPECT_EQ(kExprNop, module->module_start[arraysize(data) - 1]);
+    EXPECT_EQ(kDeclEnd, module->module_start[arraysize(data)]);
+  }
+  if (result.val) delete result.val;
+}
+
+
+TEST_F(WasmModuleVerifyTest, StreamingExpectedSize) {
+  static const byte data[] = {
+      // sig#0 -----------------------------------------------------
+      kDeclSignatures, 1,
+      0, 0,                       // void -> void
+      kDeclEnd,
+  };
+
+  {
+    TestStreamingClient client;
+    StreamingDecoder decoder(nullptr, zone(), &client, false, false,
+                             arraysize(data));
+    EXPECT_TRUE(decoder.AddBytes(data, 2));
+    EXPECT_TRUE(decoder.AddBytes(data + 2, arraysize(data) - 2));
+    ModuleResult result = decoder.Finish();
+    EXPECT_TRUE(result.ok());
+    if (result.val) delete result.val;
+  }
+  {
+    // More bytes than expected are an error.
+    TestStreamingClient client;
+    StreamingDecoder decoder(nullptr, zone(), &client, false, false,
+                             arraysize(data) - 1);
+    EXPECT_FALSE(decoder.AddBytes(data, arraysize(data)));
+    ModuleResult result = decoder.Finish();
+    EXPECT_FALSE(result.ok());
+    if (result.val) delete result.val;
+  }
+}
+
+
 class WasmSignatureDecodeTest : public TestWithZone {};
 
 